@@ -73,7 +73,9 @@ public:
 
   // weight of cubature_1d points
   array<double> weights;
-  
-  // cubature data file
-  ifstream datfile;
 };
+
+// points and weights of the n point Gauss-Jacobi rule on [-1,1] for the weight (1-x)^in_alpha
+// (Gauss-Legendre for in_alpha=0), exact to degree 2n-1; the rules are computed once per process
+// and kept in memory, so no data file is read
+void gauss_jacobi_rule(int in_n_pts, int in_alpha, array<double>& out_locs, array<double>& out_weights);
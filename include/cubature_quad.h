@@ -76,7 +76,4 @@ public:
 
   // weight of cubature points
   array<double> weights;
-
-  // cubature data file
-  ifstream datfile;
 };
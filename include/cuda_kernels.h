@@ -105,13 +105,13 @@ void calc_perturb_grid_vel_spts_kernel_wrapper(int n_dims, int n_eles, int max_n
 void calc_grid_vel_spts_kernel_wrapper(int n_dims, int n_eles, int max_n_spts_per_ele, int* n_spts_per_ele, double* shape_dyn, double* grid_vel, double dt);
 
 /*! Wrapper for gpu kernel to interpolate the grid veloicty at the shape points to either the solution or flux points */
-void eval_grid_vel_pts_kernel_wrapper(int n_dims, int n_eles, int n_pts_per_ele, int max_n_spts_per_ele, int* n_spts_per_ele, double* nodal_s_basis_pts, double* grid_vel_spts, double* grid_vel_pts);
+void eval_grid_vel_pts_kernel_wrapper(int n_dims, int n_eles, int n_pts_per_ele, int max_n_spts_per_ele, int* n_spts_per_ele, int* s_basis_ele, double* nodal_s_basis_pts, double* grid_vel_spts, double* grid_vel_pts);
 
 /*! Wrapper for GPU kernel to update coordinate transformation at flux points for moving grids */
-void set_transforms_dynamic_fpts_kernel_wrapper(int n_fpts_per_ele, int n_eles, int n_dims, int max_n_spts_per_ele, int* n_spts_per_ele, double* J_fpts_ptr, double* J_dyn_fpts_ptr, double* JGinv_fpts_ptr, double* JGinv_dyn_fpts_ptr, double* tdA_dyn_fpts_ptr, double* norm_fpts_ptr, double* norm_dyn_fpts_ptr, double *d_nodal_s_basis_fpts, double *shape_dyn);
+void set_transforms_dynamic_fpts_kernel_wrapper(int n_fpts_per_ele, int n_eles, int n_dims, int max_n_spts_per_ele, int* n_spts_per_ele, int* s_basis_ele, double* J_fpts_ptr, double* J_dyn_fpts_ptr, double* JGinv_fpts_ptr, double* JGinv_dyn_fpts_ptr, double* tdA_dyn_fpts_ptr, double* norm_fpts_ptr, double* norm_dyn_fpts_ptr, double *d_nodal_s_basis_fpts, double *shape_dyn);
 
 /*! Wrapper for GPU kernel to update coordinate transformation at solution points for moving grids */
-void set_transforms_dynamic_upts_kernel_wrapper(int n_upts_per_ele, int n_eles, int n_dims, int max_n_spts_per_ele, int *n_spts_per_ele, double* J_upts_ptr, double *J_dyn_upts_ptr, double *JGinv_upts_ptr, double *JGinv_dyn_upts_ptr, double *d_nodal_s_basis_upts, double *shape_dyn);
+void set_transforms_dynamic_upts_kernel_wrapper(int n_upts_per_ele, int n_eles, int n_dims, int max_n_spts_per_ele, int *n_spts_per_ele, int* s_basis_ele, double* J_upts_ptr, double *J_dyn_upts_ptr, double *JGinv_upts_ptr, double *JGinv_dyn_upts_ptr, double *d_nodal_s_basis_upts, double *shape_dyn);
 
 /*! Wrapper for GPU kernel to */
 void push_back_shape_dyn_kernel_wrapper(int n_dims, int n_eles, int max_n_spts_per_ele, int n_levels, int* n_spts_per_ele, double* shape_dyn);
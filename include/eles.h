@@ -27,6 +27,10 @@
 
 #include "array.h"
 #include "input.h"
+#include "kdtree.h"
+#include "eles_kernels.h"
+#include "eles_stats.h"
+#include "eles_diag.h"
 
 #if defined _GPU
 #include "cuda_runtime_api.h"
@@ -45,7 +49,7 @@ public:
 
   // default destructor
 
-  ~eles();
+  virtual ~eles();
 
   // #### methods ####
 
@@ -64,6 +68,24 @@ public:
   /*! write extra restart file containing x,y,z of solution points instead of solution data */
   void write_restart_mesh(ofstream& restart_file);
 
+  /*! write element header (sizes, restart info and global element numbers) to binary restart file */
+  void write_restart_header_bin(ofstream& restart_file);
+
+  /*! write data to binary restart file */
+  void write_restart_data_bin(ofstream& restart_file);
+
+  /*! read restart info from the header of a binary restart file */
+  int read_restart_info_bin(string& in_info);
+
+  /*! read data of one element from binary restart file */
+  void read_restart_ele_bin(ifstream& restart_file, int in_ele);
+
+  /*! set solution at solution points of an element from solution at restart points */
+  void set_disu_upts_restart(int in_ele, array<double>& in_disu_upts_rest);
+
+  /*! calculate element reference lengths (if required) */
+  void set_h_ref(void);
+
 	/*! move all to from cpu to gpu */
 	void mv_all_cpu_gpu(void);
 
@@ -108,6 +130,18 @@ public:
   /*! calculate the discontinuous solution at the flux points */
   void extrapolate_solution(int in_disu_upts_from);
 
+  /*! mark an element as having a face on an MPI interface */
+  void set_halo_ele(int in_ele);
+
+  /*! list the elements on MPI interfaces and allocate their gather/scatter buffers, after all the MPI interfaces are set up */
+  void setup_halo(void);
+
+  /*! calculate the discontinuous solution at the flux points of the elements on MPI interfaces only (all elements on the GPU) */
+  void extrapolate_solution_halo(int in_disu_upts_from);
+
+  /*! calculate the discontinuous solution at the flux points after extrapolate_solution_halo */
+  void extrapolate_solution_interior(int in_disu_upts_from);
+
   /*! Calculate terms for some LES models */
   void calc_sgs_terms(int in_disu_upts_from);
 
@@ -135,6 +169,27 @@ public:
   /*! calculate corrected gradient of the discontinuous solution at flux points */
   void extrapolate_corrected_gradient(void);
 
+  /*! calculate corrected gradient at the flux points of the elements on MPI interfaces only (all elements on the GPU) */
+  void extrapolate_corrected_gradient_halo(void);
+
+  /*! calculate corrected gradient at the flux points after extrapolate_corrected_gradient_halo */
+  void extrapolate_corrected_gradient_interior(void);
+
+  /*! apply in_opp to the columns (upt,ele,block) of the elements on MPI interfaces, as one matrix product */
+  void extrapolate_halo(array<double>& in_opp, double* in_upts, double* out_fpts, int in_n_blocks);
+
+  /*! single precision copies of the flux operators opp_1 and opp_2 (mixed precision mode) */
+  void setup_opp_sp(void);
+
+  /*! C = A*B + beta*C with A and B in single precision, C in double (mixed precision mode) */
+  void apply_opp_sp(array<float>& in_opp_sp, int in_n_b_cols, float* in_b, double in_beta, double* inout_c);
+
+  /*! estimated bytes moved by in_n_mats dense (in_rows,in_cols) operators applied to in_n_cols columns, for the profiler */
+  double op_bytes(int in_rows, int in_cols, int in_n_mats, int in_n_cols);
+
+  /*! estimated flops of in_n_mats dense (in_rows,in_cols) operators applied to in_n_cols columns, for the profiler */
+  double op_flops(int in_rows, int in_cols, int in_n_mats, int in_n_cols);
+
   /*! calculate corrected gradient of solution at flux points */
   //void extrapolate_corrected_gradient(void);
 
@@ -156,9 +211,15 @@ public:
   /*! advance solution using a runge-kutta scheme */
   void AdvanceSolution(int in_step, int adv_type);
 
+  /*! reduce the residual norm in the last RK update of the next step, for compute_res_upts */
+  void set_fuse_res_norm(bool in_fuse);
+
   /*! Calculate element local timestep */
   double calc_dt_local(int in_ele);
 
+  /*! minimum element local timestep over the elements of this type */
+  double calc_dt_min(void);
+
   /*! get number of elements */
   int get_n_eles(void);
 
@@ -174,6 +235,9 @@ public:
   /*! get number of solution points per element */
   int get_n_upts_per_ele(void);
 
+  /*! get number of flux points per element */
+  int get_n_fpts_per_ele(void);
+
   /*! get element type */
   int get_ele_type(void);
 
@@ -182,6 +246,49 @@ public:
 
   /*! get number of fields */
   int get_n_fields(void);
+
+  /*! get CPU pointer to the solution at the solution points */
+  double* get_disu_upts_ptr_cpu(void);
+
+  /*! get du/dt at the solution points from the last residual, in the layout of disu_upts */
+  void get_dudt_upts(double* out_dudt);
+
+  /*! add a source in_forcing (layout of disu_upts) to du/dt of the last residual */
+  void add_dudt_forcing(double* in_forcing);
+
+  /*! add the squared scaled error estimate of the last adaptive RK step and the no. of values */
+  void calc_rk_error(double& out_sum, double& out_n_vals);
+
+  /*! restore the solution at the start of a rejected adaptive RK step */
+  void reject_rk_step(void);
+
+  /*! set the colour of an element (no two elements of a colour share a neighbour) */
+  void set_color(int in_ele, int in_color);
+
+  /*! get the colour of an element */
+  int get_color(int in_ele);
+
+  /*! set the local time stepping level of the elements */
+  void set_lts_level(int in_level);
+
+  /*! get the local time stepping level of the elements */
+  int get_lts_level(void);
+
+  /*! flag a face whose neighbour is on the next finer local time stepping level */
+  void set_lts_fine_face(int in_ele, int in_inter);
+
+  /*! set up the flux integrals at the flagged faces */
+  void setup_lts(void);
+
+  /*! weight of the residual of an RK stage in the update of the solution over a step */
+  double get_rk_weight(int in_step, int adv_type);
+
+  /*! add in_weight times the common normal flux at the flagged faces to the integral of this level (in_own=1, after the
+   corrected divergence) or of the finer neighbours (in_own=0) */
+  void accumulate_lts_flux(int in_own, double in_weight);
+
+  /*! replace the flux integral of this level at the flagged faces by the one of the finer neighbours, and reset both */
+  void reflux_lts(void);
   
   /*! set shape */
   void set_shape(int in_max_n_spts_per_ele);
@@ -204,6 +311,9 @@ public:
   /*!  set global element number */
   void set_ele2global_ele(int in_ele, int in_global_ele);
 
+  /*!  get global element number */
+  int get_ele2global_ele(int in_ele);
+
   /*! get a pointer to the transformed discontinuous solution at a flux point */
   double* get_disu_fpts_ptr(int in_inter_local_fpt, int in_ele_local_inter, int in_field, int in_ele);
   
@@ -273,6 +383,18 @@ public:
   /*! set opp_6 */
   void set_opp_6(int in_sparse);
 
+  /*! set 1-D factors of opp_0 to opp_6 for tensor-product elements */
+  void set_opp_tensor_product(void);
+
+  /*! sum-factorized solution points to flux points (opp_0, opp_1 and opp_6) */
+  void tp_extrapolate(double* in_upts, double* out_fpts, int in_dim, int in_add);
+
+  /*! sum-factorized derivative at solution points (opp_2 and opp_4) */
+  void tp_derivative(double* in_upts, double* out_upts, int in_dim, int in_add);
+
+  /*! sum-factorized flux point correction at solution points (opp_3 and opp_5) */
+  void tp_correct(double* in_fpts, double* out_upts, int in_dim);
+
   /*! set opp_p */
   void set_opp_p(void);
 
@@ -311,8 +433,38 @@ public:
   /*! calculate time-averaged diagnostic fields at the plot points */
   void calc_time_average_ppts(int in_ele, array<double>& out_disu_average_ppts);
 
+  /*! allocate in_n_slots snapshots of the fields read by the output routines */
+  void setup_output_slots(int in_n_slots);
+
+  /*! copy the fields read by the output routines into snapshot in_slot */
+  void stage_output(int in_slot);
+
+  /*! make the output routines read snapshot in_slot (-1: the current solution) */
+  void set_output_slot(int in_slot);
+
+  /*! calculate solution at the plot points of all elements, indexing: (ppt,ele,field) */
+  void calc_disu_ppts_all(array<double>& out_disu_ppts);
+
+  /*! calculate gradient of solution at the plot points of all elements, indexing: (ppt,ele,field,dim) */
+  void calc_grad_disu_ppts_all(array<double>& out_grad_disu_ppts);
+
+  /*! calculate AV-co-efficients at the plot points of all elements, indexing: (ppt,ele) */
+  void calc_epsilon_ppts_all(array<double>& out_epsilon_ppts);
+
+  /*! calculate time-averaged diagnostic fields at the plot points of all elements, indexing: (ppt,ele,field) */
+  void calc_time_average_ppts_all(array<double>& out_disu_average_ppts);
+
+  /*! apply opp_p to in_n_cols contiguous columns of solution point data (one matrix product) */
+  void calc_ppts_batch(double* in_upts, int in_n_cols, double* out_ppts);
+
+  /*! apply opp_volume_cubpts to in_n_cols contiguous columns of solution point data (one matrix product) */
+  void calc_cubpts_batch(double* in_upts, int in_n_cols, double* out_cubpts);
+
   /*! calculate diagnostic fields at the plot points */
-  void calc_diagnostic_fields_ppts(int in_ele, array<double>& in_disu_ppts, array<double>& in_grad_disu_ppts, array<double>& in_sensor_ppts, array<double> &in_epsilon_ppts, array<double>& out_diag_field_ppts, double& time);
+  void calc_diagnostic_fields_ppts(int in_ele, array<double>& in_disu_ppts, array<double>& in_grad_disu_ppts, array<double>& in_sensor_ppts, array<double> &in_epsilon_ppts, array<double>& out_diag_field_ppts);
+
+  /*! calculate diagnostic fields at the plot points of all elements from the solution there (from calc_disu_ppts_all), indexing: (ppt,ele,field) */
+  void calc_diagnostic_fields_ppts_all(array<double>& in_disu_ppts, array<double>& out_diag_field_ppts);
 
   /*! calculate position of a solution point */
   void calc_pos_upt(int in_upt, int in_ele, array<double>& out_pos);
@@ -332,11 +484,11 @@ public:
   /*! set transforms at the volume cubature points */
   void set_transforms_vol_cubpts(void);
 
-	/*! Calculate distance of solution points to no-slip wall */
-	void calc_wall_distance(int n_seg_noslip_inters, int n_tri_noslip_inters, int n_quad_noslip_inters, array< array<double> > loc_noslip_bdy);
+	/*! Calculate distance of solution points to the no-slip wall points in in_wall_tree */
+	void calc_wall_distance(kdtree& in_wall_tree);
 
-	/*! Calculate distance of solution points to no-slip wall in parallel */
-	void calc_wall_distance_parallel(array<int> n_seg_noslip_inters, array<int> n_tri_noslip_inters, array<int> n_quad_noslip_inters, array< array<double> > loc_noslip_bdy_global, int nproc);
+	/*! Set the wall distance vector and magnitude of a solution point */
+	void set_wall_distance(int in_upt, int in_ele, array<double>& in_vec, double in_dist);
 
   /*! calculate position */
   void calc_pos(array<double> in_loc, int in_ele, array<double>& out_pos);
@@ -357,9 +509,9 @@ public:
   /*! prototype for element reference length calculation */
   virtual double calc_h_ref_specific(int in_eles) = 0;
 
-  virtual int read_restart_info(ifstream& restart_file)=0;
+  virtual int read_restart_info(istream& restart_file)=0;
 
-  virtual void write_restart_info(ofstream& restart_file)=0;
+  virtual void write_restart_info(ostream& restart_file)=0;
 
   /*! Compute interface jacobian determinant on face */
   virtual double compute_inter_detjac_inters_cubpts(int in_inter, array<double> d_pos)=0;
@@ -407,7 +559,7 @@ public:
   /*! Compute volume integral of diagnostic quantities */
   void CalcIntegralQuantities(int n_integral_quantities, array <double>& integral_quantities);
 
-  /*! Compute time-average diagnostic quantities */
+  /*! Add a sample at the given time to the time statistics and update the time-averaged fields */
   void CalcTimeAverageQuantities(double& time);
 
   void compute_wall_forces(array<double>& inv_force, array<double>& vis_force, double& temp_cl, double& temp_cd, ofstream& coeff_file, bool write_forces);
@@ -503,6 +655,9 @@ public:
    */
   void calc_d_pos_dyn_inters_cubpt(int in_cubpt, int in_face, int in_ele, array<double> &out_d_pos);
 
+  /*! index the distinct shape-point counts and allocate one shape basis table for each */
+  void setup_s_basis(void);
+
   /*! pre-computing shape basis contributions at flux points for more efficient access */
   void store_nodal_s_basis_fpts(void);
 
@@ -630,6 +785,10 @@ protected:
   /*!  number of diagnostic fields */
   int n_diagnostic_fields;
 
+  /*! compiled kernels of the diagnostic fields and of the integrands of the integral quantities */
+  diag_plan diag_fields_plan;
+  diag_plan integral_plan;
+
   /*!  number of time averaged diagnostic fields */
   int n_average_fields;
 
@@ -686,6 +845,22 @@ protected:
   /*! number of shape points per element */
   array<int> n_spts_per_ele;
 
+  /*! colour of each element for the implicit block Jacobian, indexing: (ele) */
+  array<int> color;
+
+  /*! local time stepping level */
+  int lts_level;
+
+  /*! faces with a neighbour on the next finer level, indexing: (ele, local_inter) */
+  array<int> lts_fine_face;
+
+  /*! flux points of those faces, indexing: (0: fpt / 1: ele, lts_fpt) */
+  int n_lts_fpts;
+  array<int> lts_fpts;
+
+  /*! time integral of the common normal flux at those flux points, indexing: (lts_fpt, field, 0: own / 1: finer neighbours) */
+  array<double> lts_flux;
+
   /*! transformed normal at flux points */
   array<double> tnorm_fpts;
 
@@ -761,6 +936,15 @@ protected:
   */
   array<double> grid_vel_upts, grid_vel_fpts, vel_ppts;
 
+  /*! no. of shape basis tables, one for each distinct no. of shape points */
+  int n_s_bases;
+
+  /*! no. of shape points of each shape basis table, indexing: (s_basis) */
+  array<int> n_spts_s_basis;
+
+  /*! shape basis table of each element, indexing: (ele) */
+  array<int> s_basis_ele;
+
   /*! nodal shape basis contributions at flux points */
   array<double> nodal_s_basis_fpts;
 
@@ -806,6 +990,9 @@ protected:
   /*! constansts for RK time-stepping */
   array<double> RK_a, RK_b, RK_c;
 
+  /*! weights of the embedded solution of the adaptive RK pairs */
+  array<double> RK_bhat;
+
 	/*! temporary solution gradient storage */
 	array<double> temp_grad_u;
 
@@ -839,6 +1026,9 @@ protected:
   /*! determinant of Jacobian (transformation matrix) at solution points
    *  (J = |G|) */
 	array<double> detjac_upts;
+
+  /*! inverse of the determinant of Jacobian at solution points */
+  array<double> inv_detjac_upts;
 	
   /*! determinant of Jacobian (transformation matrix) at flux points
    *  (J = |G|) */
@@ -925,6 +1115,37 @@ protected:
 	*/
   double spinup_time;
 
+  /*! compiled statistics of the time averaged fields */
+  time_stats stats;
+
+  /*! accumulators of the statistics at the solution points, indexing: (upt,ele,accumulator) */
+  array<double> stats_accum_upts;
+
+  /*! total weight (time) of the statistics, negative before the first sample, and time of the last sample */
+  double stats_weight;
+  double stats_time;
+
+  /*!
+  snapshots of the fields read by the output routines, so that files can be written
+  by a background thread while the solution advances, indexing: (slot)
+  */
+  array< array<double> > disu_upts_out;
+  array< array<double> > grad_disu_upts_out;
+  array< array<double> > disu_average_upts_out;
+  array< array<double> > epsilon_upts_out;
+  array< array<double> > sensor_out;
+
+  /*! snapshot read by the output routines (-1: the current solution) */
+  int output_slot;
+
+  /*! elements with a face on an MPI interface, extrapolated first so that their values can be sent early */
+  int n_halo_eles;
+  array<int> halo_ele_flag;
+  array<int> halo_eles;
+
+  /*! gathered solution point and flux point data of the elements on MPI interfaces, sized for n_fields*n_dims blocks */
+  array<double> halo_upts_buf, halo_fpts_buf;
+
 	/*!
 	filtered solution at solution points for similarity and SVV LES models
 	*/
@@ -946,6 +1167,9 @@ protected:
 	matrix mapping: (in_upt, in_dim || in_field, in_ele)
 	*/
 	array<double> tdisf_upts;
+
+	/*! transformed discontinuous flux at solution points in single precision, used instead of tdisf_upts in the mixed precision mode */
+	array<float> tdisf_upts_sp;
 	
 	/*!
 	description: subgrid-scale flux at the solution points \n
@@ -1148,6 +1372,33 @@ protected:
   int opp_6_nnz_per_row;
 #endif
 
+  /*! single precision copies of the flux operators, for the mixed precision mode */
+  array< array<float> > opp_1_sp;
+  array< array<float> > opp_2_sp;
+
+  /*! sum-factorized form of opp_0 to opp_6 for tensor-product elements (opp_X_sparse==2) */
+  int n_upts_1d;
+  array<double> loc_1d_upts_tp;
+
+  /*! 1-D nodal basis at the ends of the standard interval, indexing: (in_upt_1d, in_side) */
+  array<double> opp_tp_interp;
+
+  /*! derivative of 1-D nodal basis at the 1-D solution points, indexing: (in_upt_1d_from, in_upt_1d_to) */
+  array<double> opp_tp_grad;
+
+  /*! divergence of correction function along the line of each flux point, indexing: (in_upt_1d, in_fpt) */
+  array<double> opp_tp_corr;
+
+  /*! first solution point and stride of the line normal to the face of each flux point, and which end it is at */
+  array<int> tp_fpt_base;
+  array<int> tp_fpt_stride;
+  array<int> tp_fpt_side;
+
+  /*! 1-D index of each solution point in each direction, first solution point of that line, and stride */
+  array<int> tp_upt_idx;
+  array<int> tp_upt_base;
+  array<int> tp_upt_stride;
+
   /*! operator to go from discontinuous solution at the solution points to discontinuous solution at the plot points */
   array<double> opp_p;
 
@@ -1189,10 +1440,24 @@ protected:
   /*! reference element length */
   array<double> h_ref;
   
-  /*! element local timestep */
+  /*! timestep of each element in the update */
   array<double> dt_local;
-  double dt_local_new;
-  array<double> dt_local_mpi;
+
+  /*! set the timestep of each element for the update of RK stage in_step */
+  void set_dt_ele(int in_step);
+
+  /*! streaming update of the solution from the last residual, forward Euler or a low-storage RK stage */
+  void update_upts(bool in_low_storage, double in_a, double in_b, bool in_last_stage);
+
+  /*! reduce the residual norm in the last update */
+  bool fuse_res_norm;
+
+  /*! CPU kernels specialized for the element type and order */
+  eles_kernels kernels;
+
+  /*! residual norm of each field from the last update, and whether it is from the last residual */
+  array<double> res_norm_upts;
+  bool res_norm_valid;
 
   /*! Artificial Viscosity variables */
   array<double> vandermonde;
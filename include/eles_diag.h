@@ -0,0 +1,84 @@
+/*!
+ * \file eles_diag.h
+ * \brief _____________________________
+ * \author - Original code: SD++ developed by Patrice Castonguay, Antony Jameson,
+ *                          Peter Vincent, David Williams (alphabetical by surname).
+ *         - Current development: Aerospace Computing Laboratory (ACL)
+ *
+ * \version 0.1.0
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ * Copyright (C) 2014 Aerospace Computing Laboratory (ACL).
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "array.h"
+
+/*!
+ * Diagnostic fields (at the plot points) and integrands of the integral
+ * quantities (at the volume cubature points) of the Euler/NS equations,
+ * resolved once from their names into a table of kernels and evaluated
+ * in batch over the points of all elements of a type. The arrays are
+ * passed with the storage of the batched eles data: disu (pt,field),
+ * grad_disu (pt,field,dim), sensor and epsilon (pt), and the values
+ * (pt,quantity).
+ */
+
+/*! primitive variables and velocity gradient at a point; the components beyond n_dims are zero */
+struct diag_state
+{
+  int n_dims;
+  double gamma;
+  double rho;
+  double vel[3];
+  double v_sq;
+  double ene;
+  double pressure;
+  /*! dvel[i][j] = d vel_i / d x_j */
+  double dvel[3][3];
+  double sensor;
+  double epsilon;
+};
+
+/*! value of a quantity at a point */
+typedef double (*diag_kernel)(const diag_state& in_state);
+
+struct diag_plan
+{
+  int n_dims;
+  /*! number of fields of the element type, the stride of the gradient components (n_dims+3 with the SA model) */
+  int n_fields;
+  int n_quantities;
+  array<diag_kernel> kernels;
+
+  /*! whether the kernels need the gradient, the sensor or the artificial viscosity */
+  bool need_grad;
+  bool need_sensor;
+  bool need_epsilon;
+};
+
+/*! compile the diagnostic fields of the plot files (names in lower case) */
+void compile_diag_fields(array<std::string>& in_names, int in_n_dims, int in_n_fields, diag_plan& out_plan);
+
+/*! compile the integrands of the integral quantities (names in lower case) */
+void compile_integral_quantities(array<std::string>& in_names, int in_n_dims, int in_n_fields, diag_plan& out_plan);
+
+/*! evaluate the quantities at in_n_pts points; the inputs the plan does not need may be NULL */
+void eval_diag(diag_plan& in_plan, int in_n_pts, double in_gamma, const double* in_disu, const double* in_grad_disu,
+               const double* in_sensor, const double* in_epsilon, double* out_values);
@@ -0,0 +1,70 @@
+/*!
+ * \file eles_kernels.h
+ * \brief _____________________________
+ * \author - Original code: SD++ developed by Patrice Castonguay, Antony Jameson,
+ *                          Peter Vincent, David Williams (alphabetical by surname).
+ *         - Current development: Aerospace Computing Laboratory (ACL)
+ *
+ * \version 0.1.0
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ * Copyright (C) 2014 Aerospace Computing Laboratory (ACL).
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*!
+ * CPU element kernels specialized at compile time for the element type and
+ * order (orders 1 to 6), so the no. of solution points and dimensions are
+ * constants and the loops over points can be unrolled and vectorized. The
+ * arrays are passed with the storage of the eles members: disu_upts
+ * (upt,ele,field), tdisf_upts and grad_disu_upts (upt,ele,field,dim) and
+ * JGinv_upts (dim,dim,upt,ele).
+ */
+
+/*! transformed inviscid flux of the Euler/NS equations at the solution points */
+typedef void (*inv_flux_kernel)(int in_n_eles, const double* in_disu_upts, const double* in_JGinv_upts,
+                                double* out_tdisf_upts, double in_gamma);
+
+/*! the same, stored in single precision (mixed precision mode) */
+typedef void (*inv_flux_sp_kernel)(int in_n_eles, const double* in_disu_upts, const double* in_JGinv_upts,
+                                   float* out_tdisf_upts, double in_gamma);
+
+/*! transformation of the gradient at the solution points from the computational to the physical domain */
+typedef void (*transform_grad_kernel)(int in_n_eles, int in_n_fields, double* inout_grad_disu_upts,
+                                      const double* in_JGinv_upts, const double* in_inv_detjac_upts);
+
+/*! update of one field of the solution, forward Euler or a low-storage RK stage, optionally reducing the residual norm */
+typedef void (*update_kernel)(int in_n_upts_per_ele, int in_n_eles, double* inout_u, double* inout_r, const double* in_div,
+                              const double* in_src, const double* in_inv_detjac, const double* in_dt, double in_a, double in_b,
+                              double in_const_src, double* out_norm);
+
+struct eles_kernels
+{
+  /*! NULL if there is no specialization, the generic code is used */
+  inv_flux_kernel inv_flux;
+  inv_flux_sp_kernel inv_flux_sp;
+  transform_grad_kernel transform_grad;
+
+  /*! indexed by (low storage, reduce norm), generic if there is no specialization */
+  update_kernel update[2][2];
+};
+
+/*!
+ * select the kernels of an element type and order, for a solution of
+ * in_n_upts_per_ele points, returns 1 if they are specialized
+ */
+int select_eles_kernels(int in_ele_type, int in_order, int in_n_upts_per_ele, eles_kernels& out_kernels);
@@ -74,10 +74,10 @@ public:
   void setup_ele_type_specific(void);
 
   /*! read restart info */
-  int read_restart_info(ifstream& restart_file);
+  int read_restart_info(istream& restart_file);
 
   /*! write restart info */
-  void write_restart_info(ofstream& restart_file);
+  void write_restart_info(ostream& restart_file);
 
   /*! Compute interface jacobian determinant on face */
   double compute_inter_detjac_inters_cubpts(int in_inter, array<double> d_pos);
@@ -0,0 +1,90 @@
+/*!
+ * \file eles_stats.h
+ * \brief _____________________________
+ * \author - Original code: SD++ developed by Patrice Castonguay, Antony Jameson,
+ *                          Peter Vincent, David Williams (alphabetical by surname).
+ *         - Current development: Aerospace Computing Laboratory (ACL)
+ *
+ * \version 0.1.0
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ * Copyright (C) 2014 Aerospace Computing Laboratory (ACL).
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "array.h"
+
+/*!
+ * Time statistics of the average_fields, compiled once from their names
+ * into tables of sampled variables and accumulators, and updated at all
+ * solution points in one streaming pass. The names are <var>_average,
+ * <var>_variance, <var>_skewness, <var>_kurtosis (not the excess one) and
+ * <var1><var2>_covariance (e.g. uv_covariance, a Reynolds stress), with
+ * the variables rho, u, v, w, p and e (total energy per unit mass). The
+ * central moments and covariances are accumulated with the weighted
+ * updates of Welford and Pebay, the weight of a sample being the time
+ * elapsed since the previous one. The arrays are passed with the storage
+ * of the eles members: disu_upts (upt,ele,field), the accumulators
+ * (upt,ele,accumulator) and disu_average_upts (upt,ele,average field).
+ */
+
+/*! variables sampled by the time statistics */
+enum { STAT_RHO, STAT_U, STAT_V, STAT_W, STAT_P, STAT_E, STAT_N_VARS };
+
+/*! statistics of the average fields */
+enum { STAT_MEAN, STAT_VARIANCE, STAT_SKEWNESS, STAT_KURTOSIS, STAT_COVARIANCE };
+
+/*! max. no. of covariances of distinct variables */
+#define STAT_MAX_COVS (STAT_N_VARS*(STAT_N_VARS-1)/2)
+
+struct time_stats
+{
+  int n_dims;
+
+  /*! sampled variables, the highest central moment of each (1 for the mean only) and the accumulator of its mean, followed by those of its moments 2 to order */
+  int n_vars;
+  int var[STAT_N_VARS];
+  int order[STAT_N_VARS];
+  int accum[STAT_N_VARS];
+
+  /*! covariances of two sampled variables (indices into var) and their accumulators */
+  int n_covs;
+  int cov_a[STAT_MAX_COVS];
+  int cov_b[STAT_MAX_COVS];
+  int cov_accum[STAT_MAX_COVS];
+
+  /*! total no. of accumulators per solution point */
+  int n_accums;
+
+  /*! statistic of each average field and its accumulator: that of the mean of the variable, or of the covariance */
+  int n_fields;
+  array<int> field_stat;
+  array<int> field_accum;
+};
+
+/*! compile the statistics of the average fields (names in lower case) */
+void compile_time_stats(array<std::string>& in_names, int in_n_dims, time_stats& out_stats);
+
+/*!
+ * add a sample of the solution at in_n_pts points to the accumulators, with weight in_dt
+ * after a total weight in_weight, and write the average fields; with in_reset the
+ * statistics restart from the sample (before the end of the spinup)
+ */
+void update_time_stats(time_stats& in_stats, int in_n_pts, const double* in_disu_upts, double in_gamma,
+                       bool in_reset, double in_weight, double in_dt, double* inout_accum_upts, double* out_average_upts);
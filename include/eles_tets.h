@@ -71,10 +71,10 @@ public:
   void setup_ele_type_specific(void);
 
   /*! read restart info */
-  int read_restart_info(ifstream& restart_file);
+  int read_restart_info(istream& restart_file);
 
   /*! write restart info */
-  void write_restart_info(ofstream& restart_file);
+  void write_restart_info(ostream& restart_file);
 
   /*! Compute interface jacobian determinant on face */
   double compute_inter_detjac_inters_cubpts(int in_inter, array<double> d_pos);
@@ -93,9 +93,13 @@ public:
 
   void fill_opp_3(array<double>& opp_3);
 
-  void get_opp_3_dg_tet(array<double>& opp_3_dg);
+  void get_opp_3_dg_tet(array<double>& opp_3_dg, int in_cub_order);
 
-  double eval_div_dg_tet(int in_index, array<double>& loc);
+  double eval_div_dg_tet(int in_index, array<double>& loc, int in_cub_order);
+
+  /*! largest difference between the divergence of the DG correction basis with the face
+      cubature rule of the residual and with a stronger rule, relative to its largest entry */
+  double check_opp_3_dg(void);
 
   void compute_filt_matrix_tet(array<double>& Filt, int vcjh_scheme_tet, double c_tet);
 
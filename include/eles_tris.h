@@ -71,10 +71,10 @@ public:
   void setup_ele_type_specific(void);
 
   /*! read restart info */
-  int read_restart_info(ifstream& restart_file);
+  int read_restart_info(istream& restart_file);
 
   /*! write restart info */
-  void write_restart_info(ofstream& restart_file);
+  void write_restart_info(ostream& restart_file);
 
   /*! Compute interface jacobian determinant on face */
   double compute_inter_detjac_inters_cubpts(int in_inter, array<double> d_pos);
@@ -93,6 +93,10 @@ public:
 
   void fill_opp_3(array<double>& opp_3);
 
+  /*! largest difference between the divergence of the DG correction basis with the edge
+      cubature rule of the residual and with a stronger rule, relative to its largest entry */
+  double check_opp_3_dg(void);
+
   /*! evaluate nodal shape basis */
   double eval_nodal_s_basis(int in_index, array<double> in_loc, int in_n_spts);
 
@@ -59,7 +59,11 @@ double eval_d_ofr_1d(double in_r, int in_mode, int in_order);
 
 void get_opp_3_tri(array<double>& opp_3, array<double>& loc_upts_tri, array<double>& loc_fpts_tri, array<double>& vandermonde_tri, array<double>& inv_vandermonde_tri, int n_upts_per_tri, int order, double c_tri, int vcjh_scheme_tri);
 
-void get_opp_3_dg(array<double>& opp_3_dg, array<double>& loc_upts_tri, array<double>& loc_fpts_tri, int n_upts_per_tri, int order);
+/*! strength of the cubature rules exact for the face and edge integrands (of degree 2*order) of the DG correction basis */
+int get_opp_3_dg_cub_order(int in_order);
+
+/*! divergence of the DG correction basis on triangle, with edge integrals by a 1D rule of order in_cub_order */
+void get_opp_3_dg(array<double>& opp_3_dg, array<double>& loc_upts_tri, array<double>& loc_fpts_tri, int n_upts_per_tri, int order, int in_cub_order);
 
 void compute_modal_filter_1d(array <double>& filter_upts, array<double>& vandermonde, array<double>& inv_vandermonde, int N, int order);
 
@@ -70,7 +74,7 @@ void compute_modal_filter_tet(array <double>& filter_upts, array<double>& vander
 void compute_filt_matrix_tri(array<double>& Filt, array<double>& vandermonde_tri, array<double>& inv_vandermonde_tri, int n_upts_per_ele, int order, double c_tri, int vcjh_scheme_tri, array<double>& loc_upts_tri);
 
 /*! evaluate divergenge of vcjh basis on triangle */
-double eval_div_dg_tri(array<double> &in_loc , int in_edge, int in_edge_fpt, int in_order, array<double> &in_loc_fpts_1d);
+double eval_div_dg_tri(array<double> &in_loc , int in_edge, int in_edge_fpt, int in_order, array<double> &in_loc_fpts_1d, int in_cub_order);
 
 /*! get intel mkl csr 4 array format (1 indexed column major) */
 void array_to_mklcsr(array<double>& in_array, array<double>& out_data, array<int>& out_cols, array<int>& out_b, array<int>& out_e);
@@ -26,6 +26,8 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <set>
 
 #include "array.h"
 #include "input.h"
@@ -58,6 +60,12 @@ void SetInput(struct solution* FlowSol);
  */
 void GeoPreprocess(struct solution* FlowSol, mesh &Mesh);
 
+/*!
+ * \brief Free the element slots of the local time stepping levels allocated by GeoPreprocess.
+ * \param[in] FlowSol - Structure with the entire solution and mesh information.
+ */
+void GeoRelease(struct solution* FlowSol);
+
 /*!
  * \brief Method to read a mesh.
  * \param[in] in_file_name - Name of mesh file to read.
@@ -104,7 +112,40 @@ void read_connectivity_gmsh(string& in_file_name, int &out_n_cells, array<int> &
 void read_boundary_gambit(string& in_file_name, int &in_n_cells, array<int>& in_ic2icg, array<int>& out_bctype, array<int> &out_bclist, array<array<int> > &out_bccells, array<array<int> > &out_bcfaces);
 
 /*! method to read boundary faces in a gmsh mesh */
-void read_boundary_gmsh(string& in_file_name, int &in_n_cells, array<int>& in_ic2icg, array<int>& in_c2v, array<int>& in_c2n_v, array<int>& out_bctype, array<int> &out_bclist, array<int> &out_bound_flag, array<array<int> > &out_boundpts, array<int> &in_iv2ivg, int in_n_verts, array<int>& in_ctype, array<int> &in_icvsta, array<int> &in_icvert, solution *FlowSol);
+void read_boundary_gmsh(string& in_file_name, array<int>& in_c2v, array<int>& in_c2n_v, array<int>& out_bctype, array<int> &out_bclist, array<int> &out_bound_flag, array<array<int> > &out_boundpts, array<int> &in_iv2ivg, int in_n_verts, array<int>& in_ctype, array<int> &in_icvsta, array<int> &in_icvert, solution *FlowSol);
+
+/*! method to read the format version of a gmsh mesh */
+double get_gmsh_version(string& in_file_name);
+
+/*! method to read cell connectivity in a gmsh 4.1 mesh (ASCII or binary) */
+void read_connectivity_gmsh4(string& in_file_name, int &out_n_cells, array<int> &out_c2v, array<int> &out_c2n_v, array<int> &out_ctype, array<int> &out_ic2icg, struct solution* FlowSol);
+
+/*! method to read position vertices in a gmsh 4.1 mesh (ASCII or binary) */
+void read_vertices_gmsh4(string& in_file_name, int in_n_verts, int& out_n_verts_global, array<int> &in_iv2ivg, array<double> &out_xv, struct solution* FlowSol);
+
+/*! method to read boundary faces in a gmsh 4.1 mesh (ASCII or binary) */
+void read_boundary_gmsh4(string& in_file_name, array<int>& in_c2v, array<int>& in_c2n_v, array<int>& out_bctype, array<int> &out_bclist, array<int> &out_bound_flag, array<array<int> > &out_boundpts, array<int> &in_iv2ivg, int in_n_verts, array<int>& in_ctype, array<int> &in_icvsta, array<int> &in_icvert, solution *FlowSol);
+
+/*! method to generate the cells of this rank's block of a structured box mesh (mesh_gen=1), with global vertex indices */
+void generate_connectivity_box(int &out_n_cells, array<int> &out_c2v, array<int> &out_c2n_v, array<int> &out_ctype, array<int> &out_ic2icg, struct solution* FlowSol);
+
+/*! method to compute the position of the vertices of a generated box mesh, with grading and distortion */
+void generate_vertices_box(int in_n_verts, int& out_n_verts_global, array<int> &in_iv2ivg, array<double> &out_xv, struct solution* FlowSol);
+
+/*! method to set the boundary conditions of the faces on the sides of a generated box mesh, one boundary group per side */
+void generate_boundary_box(int in_n_cells, array<int>& in_ctype, array<int>& in_c2f, array<int>& in_f2v, array<int>& in_f2nv, array<int>& in_iv2ivg, array<int>& out_bctype, array<int> &out_bclist, array<array<int> > &out_bccells, array<array<int> > &out_bcfaces, struct solution* FlowSol);
+
+/*! method to set the type and vertices of cell in_cell from the nodes of a gmsh element */
+void set_cell_gmsh(int in_elmtype, int* in_nodes, int in_cell, array<int> &out_c2v, array<int> &out_c2n_v, array<int> &out_ctype);
+
+/*! method to get the (0-indexed) vertices of a gmsh boundary element, returns the no. of vertices */
+int get_boundary_face_gmsh(int in_elmtype, int* in_nodes, array<int>& out_vlist_bound);
+
+/*! method to find the cell face of a boundary face and set its boundary condition */
+void set_boundary_face(array<int>& in_vlist_bound, int in_num_face_vert, int in_bcflag, set<int>& out_bound, array<int>& out_bctype, array<int>& in_iv2ivg, int in_n_verts, array<int>& in_c2v, array<int>& in_c2n_v, array<int>& in_ctype, array<int>& in_icvsta, array<int>& in_icvert, struct solution* FlowSol);
+
+/*! method to flag the boundaries listed as moving in the input file */
+void set_moving_bound_flags(array<int>& in_bclist, array<int>& out_bound_flag);
 
 /*! method to create bounpts array from Gambit reader output (vertex id = boundpts(bcid,i_pt) */
 void create_boundpts(array<array<int> >& out_boundpts, array<int> &in_bclist, array<int> &out_bound_flag, array<array<int> >& in_bccells, array<array<int> > &in_bcfaces, array<int>& in_c2f, array<int>& in_f2v, array<int> &in_f2nv);
@@ -151,6 +192,18 @@ void compare_cyclic_faces(array<double> &xvert1, array<double> &xvert2, int& num
 /*! Method that checks if two cyclic faces are distance delta_cyclic apart */
 bool check_cyclic(array<double> &delta_cyclic, array<double> &loc_center_inter_0, array<double> &loc_center_inter_1, double tol, struct solution* FlowSol);
 
+/*! Method that sorts face centroids by their coordinates quantized to cells of size 2*tol */
+void sort_face_centers(array<double>& in_centers, int in_n_faces, double tol, array<double>& out_key, array<int>& out_order);
+
+/*! Method that returns the (sorted) faces whose centroid may lie within tol of in_center, unshifted or shifted by delta_cyclic in one direction */
+void find_cyclic_face_centers(array<double>& in_key, array<int>& in_order, int in_n_faces, array<double>& in_center, array<double>& delta_cyclic, double tol, vector<int>& out_faces);
+
+/*! Method that colours the elements so that cells of equal colour do not share residual dependencies (implicit solver) */
+void color_elements(array<int>& in_f2c, array<int>& in_ctype, array<int>& in_local_c, struct solution* FlowSol);
+
+/*! Method that assigns each cell the local time stepping level of its stable timestep, neighbours differing by one level at most */
+void assign_lts_levels(array<double>& in_xv, array<int>& in_c2v, array<int>& in_c2n_v, array<int>& in_f2c, array<int>& in_f2loc_f, array<int>& in_bctype_c, array<int>& out_level, struct solution* FlowSol);
+
 int get_bc_number(string& bcname);
 
 #ifdef _MPI
@@ -164,4 +217,7 @@ void find_rot_mpifaces(array<int> &in_f2v, array<int> &in_f2nv, array<double>& i
 
 void compare_mpi_faces(array<double> &xvert1, array<double> &xvert2, int& num_v_per_f, int& rtag, array<double> &delta_cyclic, double tol, struct solution* FlowSol);
 
+/*! Method that computes the wall distance of all solution points, querying only the partitions whose no-slip wall points can be closer */
+void calc_wall_distance_parallel(kdtree& in_wall_tree, struct solution* FlowSol);
+
 #endif
@@ -0,0 +1,117 @@
+/*!
+ * \file gmsh4_file.h
+ * \brief _____________________________
+ * \author - Original code: SD++ developed by Patrice Castonguay, Antony Jameson,
+ *                          Peter Vincent, David Williams (alphabetical by surname).
+ *         - Current development: Aerospace Computing Laboratory (ACL)
+ *                                
+ * \version 0.1.0
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ * Copyright (C) 2014 Aerospace Computing Laboratory (ACL).
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <map>
+
+#include "array.h"
+
+/*!
+ * Sequential reader of Gmsh 4.1 mesh files, ASCII or binary. The physical
+ * names and the entity -> physical group map are read when the file is
+ * opened; node and element blocks are then read (or skipped) value by value.
+ */
+class gmsh4_file
+{
+public:
+
+  // #### constructors ####
+
+  // default constructor
+
+  gmsh4_file();
+
+  // default destructor
+
+  ~gmsh4_file();
+
+  // #### methods ####
+
+  /*! open the file and read its format, physical names and entities */
+  void open(string& in_file_name);
+
+  /*! close the file */
+  void close(void);
+
+  /*! move to the data of section $in_name (e.g. "Nodes", "Elements"), returns false if there is none */
+  bool find_section(const char* in_name);
+
+  /*! read values of the section data */
+  size_t read_size(void);
+  int read_int(void);
+  void read_sizes(size_t* out_vals, size_t in_n);
+  void read_doubles(double* out_vals, size_t in_n);
+
+  /*! skip values of the section data */
+  void skip_sizes(size_t in_n);
+  void skip_doubles(size_t in_n);
+
+  /*! physical group of entity in_tag of dimension in_dim (0 if it has none) */
+  int get_physical(int in_dim, int in_tag);
+
+  /*! no. of physical groups */
+  int get_n_physicals(void);
+
+  /*! tag of the in_i-th physical group */
+  int get_physical_tag(int in_i);
+
+  /*! dimension of a physical group */
+  int get_physical_dim(int in_phys);
+
+  /*! name of a physical group, without quotes */
+  string get_physical_name(int in_phys);
+
+  /*! no. of nodes of a Gmsh element type */
+  static int get_n_nodes(int in_elmtype);
+
+protected:
+
+  /*! skip the data of a $Nodes section in a binary file */
+  void skip_nodes(void);
+
+  /*! skip the data of an $Elements section in a binary file */
+  void skip_elements(void);
+
+  // #### members ####
+
+  ifstream mesh_file;
+
+  /*! 1 for binary files */
+  int binary;
+
+  /*! physical group tags in file order */
+  array<int> phys_tags;
+
+  /*! dimension and name of each physical group */
+  map<int,int> phys_dim;
+  map<int,string> phys_name;
+
+  /*! first physical group of the entities of each dimension */
+  map<int,int> entity_phys[4];
+};
@@ -0,0 +1,151 @@
+/*!
+ * \file implicit.h
+ * \brief _____________________________
+ * \author - Original code: SD++ developed by Patrice Castonguay, Antony Jameson,
+ *                          Peter Vincent, David Williams (alphabetical by surname).
+ *         - Current development: Aerospace Computing Laboratory (ACL)
+ *                                
+ * \version 0.1.0
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ * Copyright (C) 2014 Aerospace Computing Laboratory (ACL).
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "array.h"
+#include "solution.h"
+#include "linear_solvers_structure.hpp"
+
+/*!
+ * Jacobian-free Newton-Krylov solver for steady problems (adv_type=4).
+ * Each step solves (I/dtau - dR/du) du = R(u) with FGMRES, where R is the
+ * time derivative of the solution at the solution points from CalcResidual
+ * and dtau is the element local pseudo time step. Jacobian-vector products
+ * are finite differences of R, and the preconditioner is the element block
+ * diagonal of the same operator, built by finite differences over element
+ * colours. The pseudo time step CFL grows as the residual drops (switched
+ * evolution relaxation).
+ */
+class implicit_solver
+{
+public:
+
+  // #### constructors ####
+
+  // default constructor
+
+  implicit_solver();
+
+  // default destructor
+
+  ~implicit_solver();
+
+  // #### methods ####
+
+  /*! allocate the Newton-Krylov vectors and the element blocks */
+  void setup(struct solution* FlowSol);
+
+  /*! take one pseudo-transient Newton step towards the steady state */
+  void advance(int in_file_num);
+
+  /*! Jacobian-vector product, out_prod = v/dtau - dR/du v */
+  void apply_jacobian(const CSysVector& in_v, CSysVector& out_prod);
+
+  /*! apply the element block Jacobi preconditioner */
+  void apply_preconditioner(const CSysVector& in_v, CSysVector& out_prod);
+
+protected:
+
+  /*! copy in_u into the solution at the solution points of all elements */
+  void set_solution(CSysVector& in_u);
+
+  /*! evaluate R(in_u) into out_res, leaving in_u as the solution */
+  void calc_residual(CSysVector& in_u, CSysVector& out_res);
+
+  /*! inverse of the pseudo time step of each element at the current CFL */
+  void calc_dtau_inv(void);
+
+  /*! build and factor the element blocks of I/dtau - dR/du */
+  void calc_block_jacobi(void);
+
+  /*! index of a solution point value in the solver vectors */
+  int get_index(int in_ele_type, int in_ele, int in_upt, int in_field);
+
+  // #### members ####
+
+  struct solution* FlowSol;
+
+  /*! file number passed to CalcResidual */
+  int file_num;
+
+  /*! no. of nonlinear steps taken */
+  int n_iters;
+
+  /*! current pseudo time step CFL */
+  double cfl;
+
+  /*! pseudo time step CFL of the I/dtau diagonal in the current block factors */
+  double cfl_jac;
+
+  /*! norm of the residual at the current solution */
+  double res_norm;
+
+  /*! no. of element colours over all ranks */
+  int n_colors;
+
+  /*! largest element block size over all ranks */
+  int max_n_block;
+
+  /*! solution, residual at the solution, update and scratch vectors, indexing: (dof) */
+  CSysVector u, res, du, u_pert, res_pert;
+
+  /*! inverse of the pseudo time step, indexing: (dof) */
+  CSysVector dtau_inv;
+
+  /*! offset of each element type in the solver vectors, indexing: (ele_type) */
+  array<int> offset;
+
+  /*! LU factors of the element blocks, indexing: (ele_type)(row,col,ele) */
+  array< array<double> > block;
+
+  /*! pivots of the element block LU factors, indexing: (ele_type)(row,ele) */
+  array< array<int> > pivot;
+};
+
+/*! Jacobian-free matrix-vector product for FGMRES */
+class CJacobianVectorProduct : public CMatrixVectorProduct
+{
+public:
+  CJacobianVectorProduct(implicit_solver* in_solver) : solver(in_solver) { }
+  ~CJacobianVectorProduct() { }
+  void operator()(const CSysVector & u, CSysVector & v) const { solver->apply_jacobian(u,v); }
+
+private:
+  implicit_solver* solver;
+};
+
+/*! element block Jacobi preconditioner for FGMRES */
+class CBlockJacobiPreconditioner : public CPreconditioner
+{
+public:
+  CBlockJacobiPreconditioner(implicit_solver* in_solver) : solver(in_solver) { }
+  ~CBlockJacobiPreconditioner() { }
+  void operator()(const CSysVector & u, CSysVector & v) const { solver->apply_preconditioner(u,v); }
+
+private:
+  implicit_solver* solver;
+};
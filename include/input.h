@@ -60,6 +60,9 @@ public:
   /*! Read in parameters from file */
   void read_input_file(string fileName, int rank);
 
+  /*! Read the options needed before MPI is initialized (the MPI thread support level) */
+  void read_mpi_options(char *fileNameC);
+
   /*! Apply non-dimensionalization and do misc. error checks */
   void setup_params(int rank);
 
@@ -101,6 +104,25 @@ public:
   string data_file_name;
   int restart_dump_freq;
   int adv_type;
+  int n_threads;
+  int mixed_precision; // keep the flux at the solution points in single precision and apply its operators in single precision, the RK state stays double
+
+  double implicit_cfl_max; // upper bound of the pseudo-time CFL of the implicit solver
+  double implicit_krylov_tol; // relative tolerance of the inner GMRES solve
+  int implicit_krylov_dim; // Krylov subspace dimension (restart length)
+  int implicit_jac_freq; // number of Newton steps between block-Jacobi updates
+
+  double rk_atol; // absolute tolerance of the adaptive RK error estimate
+  double rk_rtol; // relative tolerance of the adaptive RK error estimate
+  double rk_safety; // safety factor of the step size controller
+  double rk_min_fac; // smallest step size ratio between two steps
+  double rk_max_fac; // largest step size ratio between two steps
+
+  int pmg; // p-multigrid coarse grid correction after each RK step
+  int pmg_min_order; // order of the coarsest p-multigrid level
+  int pmg_n_smooth; // RK steps before and after the correction on each coarse level
+
+  int n_lts_levels; // local time stepping levels, level k advances with dt/2^k (1: off)
 
   int LES;
   int filter_type;
@@ -120,6 +142,7 @@ public:
   int restart_flag;
   int restart_iter;
   int n_restart_files;
+  int restart_bin;      // Binary restart files with an index by global element number (read on any number of ranks)
   int restart_mesh_out; // Print out separate restart file with X,Y,Z of all sol'n points?
 
   int ic_form;
@@ -151,6 +174,16 @@ public:
 
   int mesh_format;
   string mesh_file;
+  int mesh_cache; // read/write a per-rank cache of the preprocessed mesh
+
+  int mesh_gen;              // build a structured box mesh in memory instead of reading mesh_file
+  int gen_ele_type;          // element type of the generated mesh (0: tri, 1: quad, 2: tet, 3: prism, 4: hex)
+  array<int> gen_n_cells;    // no. of quads/hexas in each direction, split into tris, tets or prisms
+  array<double> gen_min;     // lower corner of the box
+  array<double> gen_max;     // upper corner of the box
+  array<double> gen_stretch; // tanh clustering of the points towards both ends of each direction (0: uniform)
+  double gen_curvature;      // amplitude of a sinusoidal distortion of the interior, relative to the box size
+  array<string> gen_bc;      // boundary conditions of the x_min, x_max, y_min, y_max, z_min and z_max sides
 
   double dx_cyclic;
   double dy_cyclic;
@@ -159,6 +192,11 @@ public:
 
   int p_res;
   int write_type;
+  int vtu_format;   // 0: ASCII, 1: base64 appended binary, 2: raw appended binary
+  int vtu_compress; // zlib-compress the binary .vtu data
+  int vtu_float64;  // write binary .vtu point data as Float64 instead of Float32
+  int output_async;      // write plot and restart files from solution snapshots on a background thread
+  int output_queue_size; // max. no. of snapshots waiting to be written before the solver blocks
 
   int upts_type_tri;
   int fpts_type_tri;
@@ -60,6 +60,9 @@ public:
   /*! calculate normal transformed continuous inviscid flux at the flux points */
   void calculate_common_invFlux(void);
 
+  /*! calculate normal transformed continuous inviscid flux at the flux points, in batches of flux points */
+  void calculate_common_invFlux_batch(void);
+
   /*! calculate normal transformed continuous viscous flux at the flux points */
   void calculate_common_viscFlux(void);
 
@@ -32,6 +32,9 @@
 #include "mpi.h"
 #endif
 
+/*! number of flux points gathered into contiguous buffers for the batched Riemann solvers */
+#define INTERS_BATCH_SIZE 128
+
 class inters
 {
 public:
@@ -60,6 +63,12 @@ public:
   /*! Compute common inviscid flux using Roe flux */
   void roe_flux(array<double> &u_l, array<double> &u_r, array<double> &v_g, array<double> &norm, array<double> &fn, int n_dims, int n_fields, double gamma);
 
+  /*! Compute common inviscid flux using Rusanov flux for a batch of flux points stored field by field */
+  void rusanov_flux_batch(int n_pts, double* u_l, double* u_r, double* v_g, double* norm, double* fn, int n_dims, int n_fields, double gamma);
+
+  /*! Compute common inviscid flux using Roe flux for a batch of flux points stored field by field */
+  void roe_flux_batch(int n_pts, double* u_l, double* u_r, double* v_g, double* norm, double* fn, int n_dims, int n_fields, double gamma);
+
   /*! Compute common inviscid flux using Lax-Friedrich flux (works only for wave equation) */
   void lax_friedrich(array<double> &u_l, array<double> &u_r, array<double> &norm, array<double> &fn, int n_dims, int n_fields, double lambda, array<double>& wave_speed);
 
@@ -133,8 +142,6 @@ public:
 
   array<int> lut;
 
-  array<double> v_l, v_r, um, du;
-
   // Dynamic grid variables:
   // Note: grid velocity is continuous across interfaces
   array<double*> ndA_dyn_fpts_l;
@@ -0,0 +1,88 @@
+/*!
+ * \file kdtree.h
+ * \brief _____________________________
+ * \author - Original code: SD++ developed by Patrice Castonguay, Antony Jameson,
+ *                          Peter Vincent, David Williams (alphabetical by surname).
+ *         - Current development: Aerospace Computing Laboratory (ACL)
+ *                                
+ * \version 0.1.0
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ * Copyright (C) 2014 Aerospace Computing Laboratory (ACL).
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "array.h"
+
+/*! max. no. of points in a leaf of the tree, searched by brute force */
+#define KDTREE_LEAF_SIZE 8
+
+/*!
+ * k-d tree over a fixed set of points for nearest-neighbour queries (used for
+ * wall distances). The tree is implicit: the points are reordered so that the
+ * median of each index range is the splitting point of that node.
+ */
+class kdtree
+{
+public:
+
+  // #### constructors ####
+
+  // default constructor
+
+  kdtree();
+
+  // default destructor
+
+  ~kdtree();
+
+  // #### methods ####
+
+  /*! build the tree over the points in_pts, indexing: (dim,point) */
+  void setup(array<double>& in_pts);
+
+  /*! no. of points in the tree */
+  int get_n_pts(void);
+
+  /*! coordinates of point in_pt of the tree */
+  double* get_pt(int in_pt);
+
+  /*! bounding box of the points, indexing: (dim) */
+  void get_bounds(array<double>& out_min, array<double>& out_max);
+
+  /*! point nearest to in_pos, if closer than sqrt(io_dist2) (-1 otherwise); io_dist2 becomes the squared distance to it */
+  int nearest(const double* in_pos, double& io_dist2);
+
+protected:
+
+  /*! build the subtree of the index range [in_lo,in_hi) of perm */
+  void build(int in_lo, int in_hi, array<double>& in_pts, int* perm);
+
+  /*! search the subtree of the index range [in_lo,in_hi) */
+  void search(int in_lo, int in_hi, const double* in_pos, int& io_pt, double& io_dist2);
+
+  // #### members ####
+
+  int n_dims;
+  int n_pts;
+
+  /*! points in tree order, indexing: (dim,point) */
+  array<double> pts;
+
+  /*! splitting dimension of the node whose median is the point (-1 in leaves), indexing: (point) */
+  array<int> split_dim;
+};
@@ -0,0 +1,103 @@
+/*!
+ * \file mesh_cache.h
+ * \brief _____________________________
+ * \author - Original code: SD++ developed by Patrice Castonguay, Antony Jameson,
+ *                          Peter Vincent, David Williams (alphabetical by surname).
+ *         - Current development: Aerospace Computing Laboratory (ACL)
+ *                                
+ * \version 0.1.0
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ * Copyright (C) 2014 Aerospace Computing Laboratory (ACL).
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <fstream>
+#include <string>
+
+#include "array.h"
+#include "solution.h"
+
+/*!
+ * Per-rank binary cache of the partitioned mesh connectivity. A run with
+ * mesh_cache=1 reads the cache if it was written for the same mesh file,
+ * no. of ranks and cyclic settings; otherwise it writes it. io() reads or
+ * writes a value depending on the mode, so the same sequence of calls
+ * serves both.
+ */
+class mesh_cache
+{
+public:
+
+  // #### constructors ####
+
+  // default constructor
+
+  mesh_cache();
+
+  // default destructor
+
+  ~mesh_cache();
+
+  // #### methods ####
+
+  /*! open the cache of this rank, returns 1 if it is valid and will be read, 0 if it will be written */
+  int open(struct solution* FlowSol);
+
+  /*! close the cache, marking a written cache as complete */
+  void close(void);
+
+  /*! read or write a value */
+  void io(int& inout_val);
+
+  /*! read or write an array with its dimensions */
+  template <typename T>
+  void io(array<T>& inout_array);
+
+  /*! read or write an array of arrays */
+  void io(array< array<int> >& inout_array);
+
+protected:
+
+  // #### members ####
+
+  fstream cache_file;
+
+  /*! 0: closed, 1: reading, 2: writing */
+  int mode;
+
+  /*! mesh file and settings the cache was built for, indexing: (value) */
+  array<double> header;
+};
+
+template <typename T>
+void mesh_cache::io(array<T>& inout_array)
+{
+  int dims[4];
+
+  if (mode==2) {
+    for (int i=0;i<4;i++)
+      dims[i] = inout_array.get_dim(i);
+    cache_file.write((char*)dims,4*sizeof(int));
+    cache_file.write((char*)inout_array.get_ptr_cpu(),(size_t)dims[0]*dims[1]*dims[2]*dims[3]*sizeof(T));
+  }
+  else if (mode==1) {
+    cache_file.read((char*)dims,4*sizeof(int));
+    inout_array.setup(dims[0],dims[1],dims[2],dims[3]);
+    cache_file.read((char*)inout_array.get_ptr_cpu(),(size_t)dims[0]*dims[1]*dims[2]*dims[3]*sizeof(T));
+  }
+}
@@ -72,6 +72,9 @@ public:
 
   void receive_sgsf_fpts();
 
+  /*! let MPI progress the messages in flight (MPI_Testsome), called between pieces of interior work */
+  void progress();
+
   void set_mpi(int in_inter, int in_ele_type_l, int in_ele_l, int in_local_inter_l, int rot_tag, struct solution* FlowSol);
 
   void calculate_common_invFlux(void);
@@ -91,6 +94,9 @@ protected:
   int rank;
   int Nmess;
 
+  /*! whether the solution, gradient and SGS flux messages have been sent but not yet received */
+  int solution_in_flight, grad_in_flight, sgsf_in_flight;
+
   array<double> out_buffer_disu, in_buffer_disu;
   array<int> Nout_proc;
 
@@ -110,6 +116,8 @@ protected:
 
   MPI_Status *mpi_instatus;
   MPI_Status *mpi_outstatus;
+
+  int *mpi_completed;
 #endif
 
   // Dynamic grid variables:
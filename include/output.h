@@ -47,15 +47,41 @@
 #include "util.h"
 #endif
 
+/*! kinds of files written by the background output thread */
+#define OUTPUT_PLOT 0
+#define OUTPUT_RESTART 1
+
 /*! write an output file in Tecplot ASCII format */
 void write_tec(int in_file_num, struct solution* FlowSol);
 
-/*! write an output file in VTK ASCII format */
+/*! write an output file in VTK ASCII format (or binary, see vtu_format) */
 void write_vtu(int in_file_num, struct solution* FlowSol);
 
+/*! write the .vtu file of this rank with binary appended data, one piece per element type */
+void write_vtu_bin(char* in_vtu, struct solution* FlowSol);
+
+/*! identifiers at the start of the binary restart files and of their index */
+#define RESTART_BIN_MAGIC "HFRSTBIN"
+#define RESTART_IDX_MAGIC "HFRSTIDX"
+
 /*! writing a restart file */
 void write_restart(int in_file_num, struct solution* FlowSol);
 
+/*! writing a binary restart file (one per rank) and the index of elements by global element number */
+void write_restart_bin(int in_file_num, struct solution* FlowSol);
+
+/*! write a Paraview or Tecplot file, depending on write_type */
+void write_plot(int in_file_num, struct solution* FlowSol);
+
+/*! start the background thread that writes plot and restart files from snapshots of the solution */
+void output_async_start(struct solution* FlowSol);
+
+/*! queue a plot or restart file (OUTPUT_PLOT, OUTPUT_RESTART), blocks only while all snapshots are waiting to be written */
+void output_async_submit(int in_type, int in_file_num, struct solution* FlowSol);
+
+/*! wait until the queued files are written and stop the background thread */
+void output_async_finish(struct solution* FlowSol);
+
 /*! compute forces on wall faces*/
 void CalcForces(int in_file_num, struct solution* FlowSol);
 
@@ -72,7 +98,7 @@ void compute_error(int in_file_num, struct solution* FlowSol);
 void CalcNormResidual(struct solution* FlowSol);
 
 /*! monitor convergence of residual */
-void HistoryOutput(int in_file_num, clock_t init, ofstream *write_hist, struct solution* FlowSol);
+void HistoryOutput(int in_file_num, double init, ofstream *write_hist, struct solution* FlowSol);
 
 /*! check if the solution is bounded !*/
 void check_stability(struct solution* FlowSol);
@@ -0,0 +1,111 @@
+/*!
+ * \file pmultigrid.h
+ * \brief _____________________________
+ * \author - Original code: SD++ developed by Patrice Castonguay, Antony Jameson,
+ *                          Peter Vincent, David Williams (alphabetical by surname).
+ *         - Current development: Aerospace Computing Laboratory (ACL)
+ *                                
+ * \version 0.1.0
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ * Copyright (C) 2014 Aerospace Computing Laboratory (ACL).
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "array.h"
+#include "solution.h"
+#include "mesh.h"
+
+/*!
+ * p-multigrid (full approximation scheme) convergence acceleration.
+ * Each coarse level is a full copy of the discretization at one order less,
+ * down to pmg_min_order. A cycle restricts the solution and the residual of
+ * the finer level by evaluating its polynomial at the coarse solution points,
+ * smooths with the explicit RK scheme of the run on the coarse level driven by
+ * the FAS forcing, and prolongates the coarse correction back.
+ */
+class p_multigrid
+{
+public:
+
+  // #### constructors ####
+
+  // default constructor
+
+  p_multigrid();
+
+  // default destructor
+
+  ~p_multigrid();
+
+  // #### methods ####
+
+  /*! build the coarse levels and the transfer operators */
+  void setup(struct solution* FlowSol);
+
+  /*! coarse grid correction of the fine solution (one V-cycle below the fine level) */
+  void cycle(int in_file_num);
+
+protected:
+
+  /*! RK steps on level in_level, with the FAS forcing on the coarse levels */
+  void smooth(int in_level, int in_n_steps);
+
+  /*! residual of level in_level, with its FAS forcing */
+  void calc_residual(int in_level);
+
+  /*! restrict the solution and the last residual of level in_level, and form the forcing of the next level */
+  void restrict_level(int in_level);
+
+  /*! add the prolongated correction of level in_level+1 to the solution of level in_level */
+  void prolong_correction(int in_level);
+
+  /*! V-cycle from the coarse level in_level down */
+  void coarse_cycle(int in_level);
+
+  /*! out = in_op*in + in_beta*out, applied element by element to all fields */
+  void apply_op(array<double>& in_op, double* in, double in_beta, double* out, int in_n_eles, int in_n_fields);
+
+  // #### members ####
+
+  /*! file number passed to CalcResidual */
+  int file_num;
+
+  /*! no. of levels, level 0 is the fine level */
+  int n_levels;
+
+  /*! flow solution of each level, indexing: (level) */
+  array<struct solution*> level_sol;
+
+  /*! mesh of each coarse level, indexing: (level) */
+  array<mesh*> level_mesh;
+
+  /*! solution and residual restriction from level l to l+1, indexing: (l,ele_type)(coarse upt,fine upt) */
+  array< array<double> > restrict_op;
+
+  /*! prolongation from level l+1 to l, indexing: (l,ele_type)(fine upt,coarse upt) */
+  array< array<double> > prolong_op;
+
+  /*! restricted solution the coarse levels started from, indexing: (level,ele_type)(upt,ele,field) */
+  array< array<double> > u0;
+
+  /*! FAS forcing of the coarse levels, indexing: (level,ele_type)(upt,ele,field) */
+  array< array<double> > forcing;
+
+  /*! scratch for residuals and corrections, indexing: (level,ele_type)(upt,ele,field) */
+  array< array<double> > work;
+};
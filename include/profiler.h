@@ -0,0 +1,99 @@
+/*!
+ * \file profiler.h
+ * \brief _____________________________
+ * \author - Original code: SD++ developed by Patrice Castonguay, Antony Jameson,
+ *                          Peter Vincent, David Williams (alphabetical by surname).
+ *         - Current development: Aerospace Computing Laboratory (ACL)
+ *
+ * \version 0.1.0
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ * Copyright (C) 2014 Aerospace Computing Laboratory (ACL).
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*!
+ * Wall clock profiler of the solver loop. Each stage is split by element
+ * type (0: tri, 1: quad, 2: tet, 3: pri, 4: hex) or interface type (0:
+ * edge, 1: tri, 2: quad face), and accumulates the wall time, the no. of
+ * calls and an estimate of the bytes moved and flops. A timer is a
+ * prof_timer object living for the duration of the stage; timers are only
+ * used outside OpenMP parallel regions. On the GPU the times are those of
+ * the host, the kernel launches are asynchronous.
+ */
+
+/*! stages timed by the profiler */
+enum {
+  PROF_EXTRAPOLATE_SOLUTION,
+  PROF_CALCULATE_GRADIENT,
+  PROF_EVALUATE_INVFLUX,
+  PROF_CORRECT_GRADIENT,
+  PROF_EXTRAPOLATE_GRADIENT,
+  PROF_EVALUATE_VISCFLUX,
+  PROF_EXTRAPOLATE_FLUX,
+  PROF_DIVERGENCE,
+  PROF_CORRECTED_DIVERGENCE,
+  PROF_INT_INVFLUX,
+  PROF_INT_VISCFLUX,
+  PROF_BDY_INVFLUX,
+  PROF_BDY_VISCFLUX,
+  PROF_MPI_INVFLUX,
+  PROF_MPI_VISCFLUX,
+  PROF_MPI_WAIT,
+  PROF_ADVANCE,
+  PROF_OUTPUT,
+  PROF_N_STAGES
+};
+
+/*! max. no. of types of a stage */
+#define PROF_N_TYPES 5
+
+/*! wall clock time in seconds */
+double prof_wall_time(void);
+
+/*! times a stage from construction to destruction */
+class prof_timer
+{
+public:
+
+  prof_timer(int in_stage, int in_type, double in_bytes=0., double in_flops=0.);
+
+  ~prof_timer();
+
+private:
+
+  int stage;
+  int type;
+  double bytes;
+  double flops;
+  double start;
+};
+
+/*! clear the profile and start the clock of the run */
+void prof_reset(void);
+
+/*! count updates of solution degrees of freedom (points times fields) */
+void prof_add_dof_updates(double in_n_dof_updates);
+
+/*! accumulated wall time, no. of calls, bytes and flops of a stage and type on this rank */
+void prof_get_entry(int in_stage, int in_type, double& out_time, double& out_calls, double& out_bytes, double& out_flops);
+
+/*! DOF updates per second over all ranks since the last call; called by all ranks, valid on rank 0 */
+double prof_dof_rate(void);
+
+/*! reduce the profile over all ranks and write it as a table and to profile.json; called by all ranks */
+void prof_write_summary(struct solution* FlowSol);
@@ -70,8 +70,19 @@ struct solution {
   int restart_dump_freq;
   int ini_iter;
 
+  /*! step size proposed by the error controller, last accepted error and initial step size (adaptive RK) */
+  double dt_next;
+  double rk_err_prev;
+  double dt_init;
+
+  /*! minimum element timestep of this rank and of all ranks (dt_type 1) */
+  double dt_min_loc;
+  double dt_min;
+
   int write_type;
 
+  /*! Elements are grouped by type and local time stepping level: mesh_eles(i) holds the
+   elements of type i%5 on level i/5, the first five point to the members below. */
   array<eles*> mesh_eles;
   eles_quads mesh_eles_quads;
   eles_tris mesh_eles_tris;
@@ -84,6 +95,13 @@ struct solution {
 
   array<int_inters> mesh_int_inters;
   array<bdy_inters> mesh_bdy_inters;
+
+  /*! local time stepping levels of the elements of each interface group, indexing: (inter_type, side) */
+  array<int> int_inters_level;
+  array<int> bdy_inters_level;
+
+  /*! local time stepping levels advanced by the current residual evaluation, indexing: (level) */
+  array<int> lts_active;
   
   int rank;
   
@@ -114,10 +132,9 @@ struct solution {
   array<int> error_states;
   
   int n_mpi_inters;
-    
-  /*! No-slip wall flux point coordinates for wall models. */
 
-	array< array<double> > loc_noslip_bdy_global;
+  /*! request of the non-blocking reduction of the global timestep */
+  MPI_Request dt_request;
 
 #endif
   
@@ -49,6 +49,28 @@
  */
 void CalcResidual(int in_file_num, int in_rk_stage, struct solution* FlowSol);
 
+/*!
+ * \brief Take one step of an embedded RK pair (adv_type 5 or 6), repeating it with a
+ * smaller step until the error estimate is within tolerance. Leaves the accepted step
+ * size in run_input.dt and proposes the next one through a PI controller.
+ * \param[in] FlowSol - Structure with the entire solution and mesh information.
+ */
+void AdvanceSolutionAdaptive(int in_file_num, struct solution* FlowSol);
+
+/*!
+ * \brief Take one step of run_input.dt with local time stepping: the elements of level k take
+ * 2^k steps of dt/2^k, and the coarser side of the faces between two levels is corrected by
+ * the flux integral of the finer side so that the scheme stays conservative.
+ * \param[in] FlowSol - Structure with the entire solution and mesh information.
+ */
+void AdvanceSolutionLTS(int in_file_num, struct solution* FlowSol);
+
+/*! start the reduction of the global minimum timestep (dt_type 1) from the solution at the start of the step */
+void start_global_dt(struct solution* FlowSol);
+
+/*! finish the reduction of the global minimum timestep and store it in run_input.dt */
+void finish_global_dt(struct solution* FlowSol);
+
 void set_rank_nproc(int in_rank, int in_nproc, struct solution* FlowSol);
 
 /*! get pointer to transformed discontinuous solution at a flux point */
@@ -105,6 +127,9 @@ void InitSolution(struct solution* FlowSol);
 /*! reading a restart file */
 void read_restart(int in_file_num, int in_n_files, struct solution* FlowSol);
 
+/*! reading binary restart files, only those holding elements of this rank (any number of ranks wrote them) */
+void read_restart_bin(int in_file_num, struct solution* FlowSol);
+
 
 
 
@@ -26,7 +26,7 @@
 
 #pragma once
 
-#ifdef MPI
+#ifdef _MPI
 #include <mpi.h>
 #endif
 #include <climits>
@@ -35,6 +35,9 @@
 #include "../include/solver.h"
 #include "../include/output.h"
 #include "../include/solution.h"
+#include "../include/implicit.h"
+#include "../include/pmultigrid.h"
+#include "../include/profiler.h"
 
 #ifdef _MPI
 #include "mpi.h"
@@ -44,6 +47,10 @@
 #include "util.h"
 #endif
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace std;
 
 int main(int argc, char *argv[]) {
@@ -53,10 +60,12 @@ int main(int argc, char *argv[]) {
   int i_steps = 0;                    /*!< Iteration index */
   int RKSteps;                        /*!< Number of RK steps */
   ifstream run_input_file;            /*!< Config input file */
-  clock_t init_time, final_time;                /*!< To control the time */
+  double init_time, final_time;                 /*!< Wall time of the run */
   struct solution FlowSol;            /*!< Main structure with the flow solution and geometry */
   ofstream write_hist;                /*!< Output files (forces, statistics, and history) */
   mesh Mesh;                          /*!< Store mesh details & perform mesh motion */
+  implicit_solver Implicit;           /*!< Newton-Krylov solver for steady problems (adv_type 4) */
+  p_multigrid Multigrid;              /*!< p-multigrid convergence acceleration */
   
   /*! Check the command line input. */
   
@@ -65,10 +74,17 @@ int main(int argc, char *argv[]) {
   /*! Initialize MPI. */
   
 #ifdef _MPI
-  MPI_Init(&argc, &argv);
+  /*! Only the background output thread (output_async) calls MPI concurrently with the solver;
+   otherwise MPI is called from the main thread outside the OpenMP regions. */
+  run_input.read_mpi_options(argv[1]);
+  int thread_required = run_input.output_async ? MPI_THREAD_MULTIPLE : MPI_THREAD_FUNNELED;
+  int thread_level;
+  MPI_Init_thread(&argc, &argv, thread_required, &thread_level);
   int nproc;
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
   MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+  if (thread_level < thread_required)
+    FatalError("The MPI library does not provide the required thread support level");
 #endif
   
   if (rank == 0) {
@@ -90,6 +106,14 @@ int main(int argc, char *argv[]) {
 
   run_input.setup(argv[1], rank);
   
+  /*! Set the number of threads used for the CPU residual (0 = OpenMP default). */
+  
+#ifdef _OPENMP
+  if (run_input.n_threads > 0)
+    omp_set_num_threads(run_input.n_threads);
+  if (rank == 0) cout << "Using " << omp_get_max_threads() << " OpenMP threads per process" << endl;
+#endif
+  
   /*! Set the input values in the FlowSol structure. */
   
   SetInput(&FlowSol);
@@ -99,8 +123,12 @@ int main(int argc, char *argv[]) {
   GeoPreprocess(&FlowSol, Mesh);
   
   InitSolution(&FlowSol);
+
+  if (FlowSol.adv_type == 4) Implicit.setup(&FlowSol);
+
+  if (run_input.pmg) Multigrid.setup(&FlowSol);
   
-  init_time = clock();
+  init_time = prof_wall_time();
   
   /////////////////////////////////////////////////
   /// Pre-processing
@@ -137,14 +165,21 @@ int main(int argc, char *argv[]) {
 
 #endif
 
+  /*! Start writing output files from snapshots of the solution on a background thread. */
+  
+  if (run_input.output_async) output_async_start(&FlowSol);
+  
   /*! Dump initial Paraview or tecplot file. */
   
-  if (FlowSol.write_type == 0) write_vtu(FlowSol.ini_iter+i_steps, &FlowSol);
-  else if (FlowSol.write_type == 1) write_tec(FlowSol.ini_iter+i_steps, &FlowSol);
-  else FatalError("ERROR: Trying to write unrecognized file format ... ");
+  if (run_input.output_async) output_async_submit(OUTPUT_PLOT, FlowSol.ini_iter+i_steps, &FlowSol);
+  else write_plot(FlowSol.ini_iter+i_steps, &FlowSol);
   
   if (FlowSol.rank == 0) cout << endl;
   
+  /*! Profile the solver loop only. */
+  
+  prof_reset();
+  
   /////////////////////////////////////////////////
   /// Flow solver
   /////////////////////////////////////////////////
@@ -155,7 +190,34 @@ int main(int argc, char *argv[]) {
     
     if (FlowSol.adv_type == 0) RKSteps = 1;
     if (FlowSol.adv_type == 3) RKSteps = 5;
+    if (FlowSol.adv_type == 4) RKSteps = 0;
+
+    /*! Pseudo-transient Newton step for steady problems */
+
+    if (FlowSol.adv_type == 4) Implicit.advance(FlowSol.ini_iter+i_steps);
+
+    /*! Error-controlled step of an embedded RK pair */
+
+    if (FlowSol.adv_type == 5 || FlowSol.adv_type == 6) {
+      RKSteps = 0;
+      AdvanceSolutionAdaptive(FlowSol.ini_iter+i_steps, &FlowSol);
+    }
+
+    /*! Step with local time stepping: each level with its own timestep */
+
+    if (run_input.n_lts_levels > 1) {
+      RKSteps = 0;
+      AdvanceSolutionLTS(FlowSol.ini_iter+i_steps, &FlowSol);
+    }
     
+    /*! On monitored steps the last RK update also reduces the residual norm */
+
+    bool fuse_res_norm = (RKSteps > 0 && !run_input.pmg &&
+                          (i_steps+1 == 1 || (i_steps+1)%run_input.monitor_res_freq == 0));
+
+    for(j=0; j<FlowSol.n_ele_types; j++)
+      FlowSol.mesh_eles(j)->set_fuse_res_norm(fuse_res_norm);
+
     for(i=0; i < RKSteps; i++) {
 
       /* If using moving mesh, need to advance the Geometric Conservation Law
@@ -168,9 +230,15 @@ int main(int argc, char *argv[]) {
 
       }
 
+      /*! Global minimum timestep, reduced while the first residual is computed. */
+
+      if (i == 0 && run_input.dt_type == 1) start_global_dt(&FlowSol);
+
       /*! Spatial integration. */
 
       CalcResidual(FlowSol.ini_iter+i_steps, i, &FlowSol);
+
+      if (i == 0 && run_input.dt_type == 1) finish_global_dt(&FlowSol);
       
       /*! Time integration usign a RK scheme */
       
@@ -182,9 +250,13 @@ int main(int argc, char *argv[]) {
       
     }
 
+    /*! Coarse grid correction */
+
+    if (run_input.pmg) Multigrid.cycle(FlowSol.ini_iter+i_steps);
+
     /*! Update total time, and increase the iteration index. */
     
-    FlowSol.time += run_input.dt;
+    if (FlowSol.adv_type != 4) FlowSol.time += run_input.dt;
     run_input.time = FlowSol.time;
     i_steps++;
     
@@ -200,10 +272,20 @@ int main(int argc, char *argv[]) {
 
 #endif
 
+    /*! Update the time-averaged quantities, every step (on the GPU when the solution has been copied). */
+
+#ifdef _GPU
+    if(i_steps == 1 || i_steps%FlowSol.plot_freq == 0 ||
+       i_steps%run_input.monitor_res_freq == 0 || i_steps%FlowSol.restart_dump_freq==0)
+#endif
+      CalcTimeAverageQuantities(&FlowSol);
+
     /*! Force, integral quantities, and residual computation and output. */
 
     if( i_steps == 1 || i_steps%run_input.monitor_res_freq == 0 ) {
 
+      prof_timer timer(PROF_OUTPUT,0);
+
       /*! Compute the value of the forces. */
       
       CalcForces(FlowSol.ini_iter+i_steps, &FlowSol);
@@ -212,10 +294,6 @@ int main(int argc, char *argv[]) {
       
       CalcIntegralQuantities(FlowSol.ini_iter+i_steps, &FlowSol);
       
-      /*! Compute time-averaged quantities. */
-      
-      CalcTimeAverageQuantities(&FlowSol);
-
       /*! Compute the norm of the residual. */
       
       CalcNormResidual(&FlowSol);
@@ -230,15 +308,17 @@ int main(int argc, char *argv[]) {
     /*! Dump Paraview or Tecplot file. */
     
     if(i_steps%FlowSol.plot_freq == 0) {
-      if(FlowSol.write_type == 0) write_vtu(FlowSol.ini_iter+i_steps, &FlowSol);
-      else if(FlowSol.write_type == 1) write_tec(FlowSol.ini_iter+i_steps, &FlowSol);
-      else FatalError("ERROR: Trying to write unrecognized file format ... ");
+      prof_timer timer(PROF_OUTPUT,0);
+      if (run_input.output_async) output_async_submit(OUTPUT_PLOT, FlowSol.ini_iter+i_steps, &FlowSol);
+      else write_plot(FlowSol.ini_iter+i_steps, &FlowSol);
     }
     
     /*! Dump restart file. */
     
     if(i_steps%FlowSol.restart_dump_freq==0) {
-      write_restart(FlowSol.ini_iter+i_steps, &FlowSol);
+      prof_timer timer(PROF_OUTPUT,0);
+      if (run_input.output_async) output_async_submit(OUTPUT_RESTART, FlowSol.ini_iter+i_steps, &FlowSol);
+      else write_restart(FlowSol.ini_iter+i_steps, &FlowSol);
     }
     
   }
@@ -247,6 +327,27 @@ int main(int argc, char *argv[]) {
   /// End simulation
   /////////////////////////////////////////////////
   
+  /*! Wait for the queued output files. */
+  
+  if (run_input.output_async) output_async_finish(&FlowSol);
+  
+  /*! Error of the final solution against the exact solution of the test case. */
+  
+  if (run_input.test_case != 0) {
+#ifdef _GPU
+    CopyGPUCPU(&FlowSol);
+#endif
+    compute_error(FlowSol.ini_iter+i_steps, &FlowSol);
+  }
+  
+  /*! Write the profile of the solver loop. */
+  
+  prof_write_summary(&FlowSol);
+  
+  /*! Free the elements of the local time stepping levels. */
+  
+  GeoRelease(&FlowSol);
+  
   /*! Close convergence history file. */
   
   if (rank == 0) {
@@ -254,8 +355,8 @@ int main(int argc, char *argv[]) {
   
   /*! Compute execution time. */
   
-  final_time = clock()-init_time;
-  printf("Execution time= %f s\n", (double) final_time/((double) CLOCKS_PER_SEC));
+  final_time = prof_wall_time()-init_time;
+  printf("Execution time= %f s\n", final_time);
     }
   /*! Finalize MPI. */
   
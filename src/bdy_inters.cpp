@@ -35,6 +35,7 @@
 #include "../include/output.h"
 #include "../include/flux.h"
 #include "../include/error.h"
+#include "../include/profiler.h"
 
 #ifdef _GPU
 #include "../include/cuda_kernels.h"
@@ -243,8 +244,14 @@ void bdy_inters::mv_all_cpu_gpu(void)
 /*! Calculate normal transformed continuous inviscid flux at the flux points on the boundaries.*/
 
 void bdy_inters::evaluate_boundaryConditions_invFlux(double time_bound) {
+  prof_timer timer(PROF_BDY_INVFLUX,inters_type,32.*n_inters*n_fpts_per_inter*n_fields);
 
 #ifdef _CPU
+#pragma omp parallel
+  {
+  // thread-private scratch (shadows the shared members of the same name)
+  array<double> temp_u_l(n_fields), temp_u_r(n_fields), temp_v(n_dims), temp_loc(n_dims);
+  array<double> temp_f_l(n_fields,n_dims), temp_f_r(n_fields,n_dims);
   array<double> norm(n_dims), fn(n_fields);
 
   //viscous
@@ -252,6 +259,7 @@ void bdy_inters::evaluate_boundaryConditions_invFlux(double time_bound) {
   array<double> u_c(n_fields);
 
 
+#pragma omp for schedule(static)
   for(int i=0;i<n_inters;i++)
   {
     for(int j=0;j<n_fpts_per_inter;j++)
@@ -379,6 +387,7 @@ void bdy_inters::evaluate_boundaryConditions_invFlux(double time_bound) {
 
         }
     }
+  } // end omp parallel
 
 #endif
 
@@ -901,11 +910,20 @@ void bdy_inters::set_inv_boundary_conditions(int bdy_type, double* u_l, double*
 /*! Calculate normal transformed continuous viscous flux at the flux points on the boundaries. */
 
 void bdy_inters::evaluate_boundaryConditions_viscFlux(double time_bound) {
+  prof_timer timer(PROF_BDY_VISCFLUX,inters_type,32.*n_inters*n_fpts_per_inter*n_fields*(1+n_dims));
 
 #ifdef _CPU
+#pragma omp parallel
+  {
+  // thread-private scratch (shadows the shared members of the same name)
+  array<double> temp_u_l(n_fields), temp_u_r(n_fields), temp_v(n_dims), temp_loc(n_dims);
+  array<double> temp_grad_u_l(n_fields,n_dims), temp_grad_u_r(n_fields,n_dims);
+  array<double> temp_f_l(n_fields,n_dims), temp_f_r(n_fields,n_dims);
+  array<double> temp_sgsf_l(n_fields,n_dims);
   int bdy_spec, flux_spec;
   array<double> norm(n_dims), fn(n_fields);
 
+#pragma omp for schedule(static)
   for(int i=0;i<n_inters;i++)
   {
     /*! boundary specification */
@@ -1036,6 +1054,7 @@ void bdy_inters::evaluate_boundaryConditions_viscFlux(double time_bound) {
           }
         }
     }
+  } // end omp parallel
 
 #endif
 
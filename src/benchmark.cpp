@@ -0,0 +1,426 @@
+/*!
+ * \file benchmark.cpp
+ * \brief _____________________________
+ * \author - Original code: SD++ developed by Patrice Castonguay, Antony Jameson,
+ *                          Peter Vincent, David Williams (alphabetical by surname).
+ *         - Current development: Aerospace Computing Laboratory (ACL)
+ *
+ * \version 0.1.0
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ * Copyright (C) 2014 Aerospace Computing Laboratory (ACL).
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include "../include/global.h"
+#include "../include/array.h"
+#include "../include/input.h"
+#include "../include/eles.h"
+#include "../include/eles_tris.h"
+#include "../include/eles_quads.h"
+#include "../include/eles_tets.h"
+#include "../include/eles_pris.h"
+#include "../include/eles_hexas.h"
+#include "../include/inters.h"
+#include "../include/profiler.h"
+#include "../include/error.h"
+
+#ifdef _MPI
+#include "mpi.h"
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+// Micro-benchmark of the element kernels and the Riemann solvers on synthetic
+// batches of elements, without a mesh file:
+//
+//   HiFiLES_bench <input file> [element types] [order] [no. of elements] [no. of repetitions]
+//
+// The equations, scheme and initial condition are those of the input file (its
+// mesh is not read). The element types are a comma separated list of tris, quads,
+// tets, pris and hexas (default: all of them). Each kernel is called repeatedly on
+// the whole batch; its GB/s and GFLOP/s use the byte and flop counts of the profiler.
+// The correction operators of the tris and tets are checked against stronger cubature first.
+
+static const char* ele_names[5] = {"tris", "quads", "tets", "pris", "hexas"};
+
+// no. of dimensions, vertices and faces of the linear elements
+
+static const int ele_n_dims[5] = {2, 2, 3, 3, 3};
+static const int ele_n_verts[5] = {3, 4, 4, 6, 8};
+static const int ele_n_faces[5] = {3, 4, 4, 5, 6};
+
+// vertices of the reference elements, in the shape node order of the eles classes
+
+static const double ref_verts[5][8][3] = {
+  {{-1,-1,0}, {1,-1,0}, {-1,1,0}},
+  {{-1,-1,0}, {1,-1,0}, {-1,1,0}, {1,1,0}},
+  {{-1,-1,-1}, {1,-1,-1}, {-1,1,-1}, {-1,-1,1}},
+  {{-1,-1,-1}, {1,-1,-1}, {-1,1,-1}, {-1,-1,1}, {1,-1,1}, {-1,1,1}},
+  {{-1,-1,-1}, {1,-1,-1}, {-1,1,-1}, {1,1,-1}, {-1,-1,1}, {1,-1,1}, {-1,1,1}, {1,1,1}}
+};
+
+// element kernels, in the order of CalcResidual
+
+enum {
+  BENCH_EXTRAPOLATE_SOLUTION,
+  BENCH_CALCULATE_GRADIENT,
+  BENCH_EVALUATE_INVFLUX,
+  BENCH_CORRECT_GRADIENT,
+  BENCH_EVALUATE_VISCFLUX,
+  BENCH_EXTRAPOLATE_TOTALFLUX,
+  BENCH_CALCULATE_DIVERGENCE,
+  BENCH_ADVANCE_SOLUTION,
+  BENCH_N_KERNELS
+};
+
+static const char* kernel_names[BENCH_N_KERNELS] = {
+  "extrapolate_solution",
+  "calculate_gradient",
+  "evaluate_invFlux",
+  "correct_gradient",
+  "evaluate_viscFlux",
+  "extrapolate_totalFlux",
+  "calculate_divergence",
+  "AdvanceSolution"
+};
+
+static const int kernel_stages[BENCH_N_KERNELS] = {
+  PROF_EXTRAPOLATE_SOLUTION,
+  PROF_CALCULATE_GRADIENT,
+  PROF_EVALUATE_INVFLUX,
+  PROF_CORRECT_GRADIENT,
+  PROF_EVALUATE_VISCFLUX,
+  PROF_EXTRAPOLATE_FLUX,
+  PROF_DIVERGENCE,
+  PROF_ADVANCE
+};
+
+// set up a batch of affine elements, each the reference element sheared and shifted a little
+
+static void setup_batch(eles* out_eles, int in_ele_type, int in_n_eles)
+{
+  int n_dims = ele_n_dims[in_ele_type];
+  int n_verts = ele_n_verts[in_ele_type];
+  double h = 0.5;
+
+  array<double> pos(n_dims);
+
+  out_eles->set_rank(0);
+  out_eles->setup(in_n_eles,n_verts);
+  out_eles->set_lts_level(0);
+
+  for (int i=0;i<in_n_eles;i++) {
+      out_eles->set_n_spts(i,n_verts);
+      out_eles->set_ele2global_ele(i,i);
+
+      // upper triangular shear, so the jacobian is h^n_dims in all elements
+      double s = 0.1*sin(1.+i);
+
+      for (int j=0;j<n_verts;j++) {
+          const double* ref = ref_verts[in_ele_type][j];
+
+          for (int m=0;m<n_dims;m++) {
+              pos(m) = h*ref[m];
+              for (int l=m+1;l<n_dims;l++)
+                pos(m) += h*s*ref[l];
+            }
+          pos(0) += 2.*h*i;
+
+          out_eles->set_shape_node(j,i,pos);
+        }
+
+      for (int j=0;j<ele_n_faces[in_ele_type];j++)
+        out_eles->set_bctype(i,j,0);
+    }
+
+  out_eles->setup_s_basis();
+  out_eles->store_nodal_s_basis_fpts();
+  out_eles->store_nodal_s_basis_upts();
+  out_eles->store_nodal_s_basis_ppts();
+  out_eles->store_d_nodal_s_basis_fpts();
+  out_eles->store_d_nodal_s_basis_upts();
+  out_eles->store_nodal_s_basis_inters_cubpts();
+  out_eles->store_d_nodal_s_basis_inters_cubpts();
+  out_eles->set_transforms();
+  out_eles->initialize_grid_vel(n_verts);
+  out_eles->set_transforms_inters_cubpts();
+
+  double time = 0.;
+  out_eles->set_ics(time);
+  out_eles->set_disu_upts_to_zero_other_levels();
+
+  // the interface terms are not computed, the common values equal the element ones
+  int n = out_eles->get_n_fpts_per_ele()*in_n_eles*out_eles->get_n_fields();
+
+  memset(out_eles->get_norm_tconf_fpts_ptr(0,0,0,0),0,n*sizeof(double));
+  if (run_input.viscous)
+    memset(out_eles->get_delta_disu_fpts_ptr(0,0,0,0),0,n*sizeof(double));
+}
+
+static void run_kernel(eles* in_eles, int in_kernel, int in_rep)
+{
+  switch (in_kernel)
+    {
+    case BENCH_EXTRAPOLATE_SOLUTION: in_eles->extrapolate_solution(0); break;
+    case BENCH_CALCULATE_GRADIENT: in_eles->calculate_gradient(0); break;
+    case BENCH_EVALUATE_INVFLUX: in_eles->evaluate_invFlux(0); break;
+    case BENCH_CORRECT_GRADIENT: in_eles->correct_gradient(); break;
+    case BENCH_EVALUATE_VISCFLUX: in_eles->evaluate_viscFlux(0); break;
+    case BENCH_EXTRAPOLATE_TOTALFLUX: in_eles->extrapolate_totalFlux(); break;
+    case BENCH_CALCULATE_DIVERGENCE: in_eles->calculate_divergence(0); break;
+    case BENCH_ADVANCE_SOLUTION:
+      {
+        // stages of the time integration, as in AdvanceSolution of the solver
+        int n_stages = 5;
+        if (run_input.adv_type == 0) n_stages = 1;
+        else if (run_input.adv_type == 5) n_stages = 4;
+        in_eles->AdvanceSolution(in_rep % n_stages,run_input.adv_type);
+        break;
+      }
+    }
+}
+
+static void print_header(void)
+{
+  cout << "  " << left << setw(22) << "kernel" << setw(7) << "type" << right << setw(8) << "calls"
+       << setw(12) << "ms/call" << setw(10) << "GB/s" << setw(10) << "GFLOP/s" << setw(12) << "MDOF/s" << endl;
+}
+
+static void print_rate(const char* in_name, const char* in_type, double in_time, double in_calls,
+                       double in_bytes, double in_flops, double in_n_dofs)
+{
+  if (in_calls == 0. || in_time <= 0.)
+    return;
+
+  cout << "  " << left << setw(22) << in_name << setw(7) << in_type << right << setw(8) << (long)in_calls
+       << fixed << setprecision(4) << setw(12) << 1.e3*in_time/in_calls << setprecision(2)
+       << setw(10) << 1.e-9*in_bytes/in_time << setw(10) << 1.e-9*in_flops/in_time
+       << setw(12) << 1.e-6*in_n_dofs*in_calls/in_time << endl;
+  cout.unsetf(ios::floatfield);
+}
+
+// time the element kernels of a batch
+
+static void bench_eles(eles* in_eles, int in_ele_type, int in_n_reps)
+{
+  double n_dofs = (double)in_eles->get_n_upts_per_ele()*in_eles->get_n_eles()*in_eles->get_n_fields();
+
+  for (int k=0;k<BENCH_N_KERNELS;k++) {
+      bool visc_kernel = (k == BENCH_CALCULATE_GRADIENT || k == BENCH_CORRECT_GRADIENT || k == BENCH_EVALUATE_VISCFLUX);
+
+      if (visc_kernel && !run_input.viscous)
+        continue;
+      if (k == BENCH_ADVANCE_SOLUTION && run_input.adv_type == 4)
+        continue;
+
+      // one untimed call to touch the data
+      run_kernel(in_eles,k,0);
+      prof_reset();
+
+      for (int r=0;r<in_n_reps;r++)
+        run_kernel(in_eles,k,r);
+
+      double time, calls, bytes, flops;
+      prof_get_entry(kernel_stages[k],in_ele_type,time,calls,bytes,flops);
+      print_rate(kernel_names[k],ele_names[in_ele_type],time,calls,bytes,flops,n_dofs);
+    }
+}
+
+// time the Riemann solvers on as many flux points as the interfaces of a batch. The
+// states of all the points are stored, batch after batch in the field-major layout of
+// the interface loops, and are walked through in batches of INTERS_BATCH_SIZE points,
+// so the data streams from memory as in the solver
+
+static void bench_riemann(eles* in_eles, int in_ele_type, int in_n_reps)
+{
+  int n_dims = in_eles->get_n_dims();
+  int n_fields = in_eles->get_n_fields();
+  int n_pts = in_eles->get_n_fpts_per_ele()*in_eles->get_n_eles()/2;
+  int n_batches = (n_pts+INTERS_BATCH_SIZE-1)/INTERS_BATCH_SIZE;
+
+  // indexing: (in_batch_fpt, in_field, in_batch) or (in_batch_fpt, in_dim, in_batch)
+  array<double> u_l(INTERS_BATCH_SIZE,n_fields,n_batches), u_r(INTERS_BATCH_SIZE,n_fields,n_batches);
+  array<double> norm(INTERS_BATCH_SIZE,n_dims,n_batches), fn(INTERS_BATCH_SIZE,n_fields,n_batches);
+  array<double> v_g(INTERS_BATCH_SIZE,n_dims);
+
+  // states at the solution points of the batch, perturbed differently on the two
+  // sides of each point, with unit normals
+  double* u_ele = in_eles->get_disu_upts_ptr_cpu();
+  int field_stride = in_eles->get_n_upts_per_ele()*in_eles->get_n_eles();
+
+  v_g.initialize_to_zero();
+  fn.initialize_to_zero();
+
+  for (int b=0;b<n_batches;b++) {
+      for (int p=0;p<INTERS_BATCH_SIZE;p++) {
+          int q = b*INTERS_BATCH_SIZE+p;
+          double eps_l = 0.01*sin(1.+q), eps_r = 0.01*cos(2.+q);
+
+          for (int k=0;k<n_fields;k++) {
+              double u = u_ele[k*field_stride+q%field_stride];
+              u_l(p,k,b) = u*(1.+eps_l);
+              u_r(p,k,b) = u*(1.+eps_r);
+            }
+          for (int m=0;m<n_dims;m++)
+            norm(p,m,b) = (m == q % n_dims) ? ((q/n_dims) % 2 ? -1. : 1.) : 0.;
+        }
+    }
+
+  inters riemann;
+  double bytes_pt = 8.*(3*n_fields+n_dims);
+
+  for (int s=0;s<2;s++) {
+      // Roe is only implemented for the 2D Euler/NS fields
+      if (s == 1 && (n_dims != 2 || n_fields != 4))
+        continue;
+
+      // approximate flop counts of one flux point
+      double flops_pt = (s == 0) ? 20.*n_dims+40.+6.*(n_fields-n_dims-2) : 150.;
+
+      double start = prof_wall_time();
+
+      for (int r=0;r<in_n_reps;r++) {
+          for (int b=0;b<n_batches;b++) {
+              int n_pts_batch = min(INTERS_BATCH_SIZE,n_pts-b*INTERS_BATCH_SIZE);
+
+              if (s == 0)
+                riemann.rusanov_flux_batch(n_pts_batch,u_l.get_ptr_cpu(0,0,b),u_r.get_ptr_cpu(0,0,b),v_g.get_ptr_cpu(),norm.get_ptr_cpu(0,0,b),fn.get_ptr_cpu(0,0,b),n_dims,n_fields,run_input.gamma);
+              else
+                riemann.roe_flux_batch(n_pts_batch,u_l.get_ptr_cpu(0,0,b),u_r.get_ptr_cpu(0,0,b),v_g.get_ptr_cpu(),norm.get_ptr_cpu(0,0,b),fn.get_ptr_cpu(0,0,b),n_dims,n_fields,run_input.gamma);
+            }
+        }
+
+      double time = prof_wall_time()-start;
+      print_rate((s == 0) ? "rusanov_flux" : "roe_flux",ele_names[in_ele_type],time,in_n_reps,
+                 in_n_reps*bytes_pt*n_pts,in_n_reps*flops_pt*n_pts,(double)n_pts*n_fields);
+    }
+}
+
+// the tri and tet correction operators of the residual use cubature rules exact for their integrands,
+// compare them with the operators built with stronger rules: both must agree to roundoff
+
+static void print_opp_3_check(double in_diff, int in_ele_type)
+{
+  cout << "  opp_3 cubature check, " << ele_names[in_ele_type] << ": relative difference "
+       << scientific << setprecision(3) << in_diff;
+  if (in_diff > 1.e-12)
+    cout << ", the rule is not exact at order " << run_input.order;
+  cout << endl;
+  cout.unsetf(ios::floatfield);
+}
+
+template <class ELES>
+static void check_opp_3(ELES&, int)
+{
+}
+
+static void check_opp_3(eles_tris& in_eles, int in_ele_type)
+{
+  print_opp_3_check(in_eles.check_opp_3_dg(),in_ele_type);
+}
+
+static void check_opp_3(eles_tets& in_eles, int in_ele_type)
+{
+  print_opp_3_check(in_eles.check_opp_3_dg(),in_ele_type);
+}
+
+template <class ELES>
+static void bench_type(int in_ele_type, int in_n_eles, int in_n_reps)
+{
+  ELES batch;
+
+  setup_batch(&batch,in_ele_type,in_n_eles);
+  check_opp_3(batch,in_ele_type);
+  bench_eles(&batch,in_ele_type,in_n_reps);
+  bench_riemann(&batch,in_ele_type,in_n_reps);
+}
+
+int main(int argc, char *argv[]) {
+
+  if (argc < 2) {
+      cout << "Usage: HiFiLES_bench <input file> [tris,quads,tets,pris,hexas] [order] [no. of elements] [no. of repetitions]" << endl;
+      return(0);
+    }
+
+#ifdef _MPI
+  MPI_Init(&argc, &argv);
+#endif
+
+#ifdef _GPU
+  FatalError("The benchmark times the CPU kernels only");
+#endif
+
+  run_input.setup(argv[1], 0);
+
+  const char* types = (argc > 2) ? argv[2] : "tris,quads,tets,pris,hexas";
+  if (argc > 3) run_input.set_order(atoi(argv[3]));
+  int n_eles = (argc > 4) ? atoi(argv[4]) : 10000;
+  int n_reps = (argc > 5) ? atoi(argv[5]) : 20;
+
+  if (n_eles < 1 || n_reps < 1)
+    FatalError("The no. of elements and repetitions must be positive");
+  if (run_input.motion)
+    FatalError("The benchmark does not support moving meshes");
+  if (run_input.turb_model != 0)
+    FatalError("The benchmark does not support turbulence models (no wall distance)");
+
+#ifdef _OPENMP
+  if (run_input.n_threads > 0)
+    omp_set_num_threads(run_input.n_threads);
+  cout << "Using " << omp_get_max_threads() << " OpenMP threads" << endl;
+#endif
+
+#if defined _MKL_BLAS
+  const char* blas = "MKL";
+#elif defined _STANDARD_BLAS
+  const char* blas = "standard";
+#elif defined _ACCELERATE_BLAS
+  const char* blas = "Accelerate";
+#else
+  const char* blas = "none";
+#endif
+
+  cout << "Order " << run_input.order << ", " << n_eles << " elements per batch, " << n_reps
+       << " repetitions, BLAS: " << blas << endl << endl;
+  print_header();
+
+  for (int t=0;t<5;t++) {
+      if (!strstr(types,ele_names[t]))
+        continue;
+
+      if (t == 0) bench_type<eles_tris>(t,n_eles,n_reps);
+      else if (t == 1) bench_type<eles_quads>(t,n_eles,n_reps);
+      else if (t == 2) bench_type<eles_tets>(t,n_eles,n_reps);
+      else if (t == 3) bench_type<eles_pris>(t,n_eles,n_reps);
+      else bench_type<eles_hexas>(t,n_eles,n_reps);
+    }
+
+#ifdef _MPI
+  MPI_Finalize();
+#endif
+
+  return(0);
+}
@@ -26,7 +26,7 @@
 #include <iostream>
 #include <cmath>
 #include <string>
-#include <sstream>
+#include <map>
 
 #include "../include/global.h"
 #include "../include/cubature_1d.h"
@@ -47,81 +47,16 @@ cubature_1d::cubature_1d()
 
 // constructor 1
 
-cubature_1d::cubature_1d(int in_order) // set by number of points
-{	
-  ifstream datfile;
-  char buf[BUFSIZ]={""};
-  char section_TXT[100], param_TXT[100];
-  char* f;
-  string filename, param_name, param, ord;
-  istringstream strbuf;
-  int n_pts_file;
-
+cubature_1d::cubature_1d(int in_order) // set by order
+{
   order=in_order;
   n_pts = (order+1)/2;
-  locs.setup(n_pts);
-  weights.setup(n_pts);
-  
-  if(n_pts < 13) {
-
-    // get env var specifying location of data directory?
-    //const char* HIFILES_DATADIR = getenv("HIFILES_DATA");
-    //filename = HIFILES_DATADIR;
-    //filename += "/cubature_1d_new.dat";
-    //cout << filename << endl;
-
-    if (HIFILES_DIR == NULL)
-      FatalError("environment variable HIFILES_HOME is undefined");
-
-    filename = HIFILES_DIR;
-    filename += "/data/cubature_1d.dat";
-    f = (char*)filename.c_str();
-    datfile.open(f, ifstream::in);
-    if (!datfile) FatalError("Unable to open cubature file");
-    
-    // read data from file to arrays
-    while(datfile.getline(buf,BUFSIZ))
-    {
-      sscanf(buf,"%s",section_TXT);
-      param_name.assign(section_TXT,0,99);
-      
-      if(!param_name.compare(0,5,"n_pts"))
-      {
-        // get no. of pts
-        ord = param_name.substr(6);
-        stringstream str(ord);
-        str >> n_pts_file;
-        
-        // if pts matches order, read locs and weights
-        if (n_pts_file == n_pts) {
-          
-          // skip next line
-          datfile.getline(buf,BUFSIZ);
-          
-          for(int i=0;i<n_pts;++i) {
-            datfile.getline(buf,BUFSIZ);
-            sscanf(buf,"%s",param_TXT);
-            param.assign(param_TXT,0,99);
-            strbuf.str(param);
-            locs(i) = atof(param.c_str());
-          }
-
-          // skip next line
-          datfile.getline(buf,BUFSIZ);
-
-          for(int i=0;i<n_pts;++i) {
-            datfile.getline(buf,BUFSIZ);
-            sscanf(buf,"%s",param_TXT);
-            param.assign(param_TXT,0,99);
-            strbuf.str(param);
-            weights(i) = atof(param.c_str());
-          }
-          break;
-        }
-      }
-    }
-  }
-  else { FatalError("cubature rule not implemented."); }
+
+  if (n_pts < 1)
+    FatalError("cubature rule not implemented.");
+
+  // Gauss-Legendre rule, exact to degree 2*n_pts-1
+  gauss_jacobi_rule(n_pts,0,locs,weights);
 }
 
 // copy constructor
@@ -182,3 +117,82 @@ double cubature_1d::get_weight(int in_pos)
   return weights(in_pos);
 }
 
+// Jacobi polynomial P_n^(alpha,0)(x) and its derivative, by the three term recurrence
+
+static void jacobi_poly(int in_n, int in_alpha, double in_x, double& out_p, double& out_dp)
+{
+  double a = in_alpha;
+  double p_prev = 1.;
+  double p = 0.5*((a+2.)*in_x + a);
+
+  if (in_n == 0) {
+    out_p = 1.;
+    out_dp = 0.;
+    return;
+  }
+
+  for (int k=2;k<=in_n;k++) {
+    double c = 2.*k+a;
+    double p_next = ((c-1.)*(c*(c-2.)*in_x + a*a)*p - 2.*(k+a-1.)*(k-1.)*c*p_prev)/(2.*k*(k+a)*(c-2.));
+    p_prev = p;
+    p = p_next;
+  }
+
+  // (2n+a)(1-x^2) P_n' = n (a - (2n+a) x) P_n + 2 (n+a) n P_(n-1)
+  double n = in_n;
+  out_p = p;
+  out_dp = (n*(a-(2.*n+a)*in_x)*p + 2.*(n+a)*n*p_prev)/((2.*n+a)*(1.-in_x*in_x));
+}
+
+// rules computed so far, by no. of points and alpha
+
+struct gauss_rule
+{
+  array<double> locs;
+  array<double> weights;
+};
+
+static map<pair<int,int>,gauss_rule> gauss_rules;
+
+void gauss_jacobi_rule(int in_n_pts, int in_alpha, array<double>& out_locs, array<double>& out_weights)
+{
+  pair<int,int> key(in_n_pts,in_alpha);
+  map<pair<int,int>,gauss_rule>::iterator it = gauss_rules.find(key);
+
+  if (it == gauss_rules.end()) {
+    gauss_rule rule;
+    rule.locs.setup(in_n_pts);
+    rule.weights.setup(in_n_pts);
+
+    // roots of P_n by Newton iterations, deflated by the roots already found, from
+    // the Chebyshev points (Karniadakis & Sherwin, Appendix B)
+    for (int k=0;k<in_n_pts;k++) {
+      double x = -cos((2.*k+1.)*pi/(2.*in_n_pts));
+      if (k > 0)
+        x = 0.5*(x+rule.locs(k-1));
+
+      for (int it=0;it<100;it++) {
+        double p, dp, s = 0.;
+        jacobi_poly(in_n_pts,in_alpha,x,p,dp);
+        for (int l=0;l<k;l++)
+          s += 1./(x-rule.locs(l));
+
+        double delta = -p/(dp-s*p);
+        x += delta;
+        if (fabs(delta) < 1.e-15)
+          break;
+      }
+      rule.locs(k) = x;
+
+      // w = 2^(a+1) / ((1-x^2) P_n'(x)^2)
+      double p, dp;
+      jacobi_poly(in_n_pts,in_alpha,x,p,dp);
+      rule.weights(k) = pow(2.,in_alpha+1)/((1.-x*x)*dp*dp);
+    }
+
+    it = gauss_rules.insert(make_pair(key,rule)).first;
+  }
+
+  out_locs = it->second.locs;
+  out_weights = it->second.weights;
+}
@@ -26,9 +26,9 @@
 #include <iostream>
 #include <cmath>
 #include <string>
-#include <sstream>
 
 #include "../include/global.h"
+#include "../include/cubature_1d.h"
 #include "../include/cubature_hexa.h"
 
 using namespace std;
@@ -48,96 +48,31 @@ cubature_hexa::cubature_hexa()
 // constructor 1
 
 cubature_hexa::cubature_hexa(int in_rule) // set by rule
-{	
-  ifstream datfile;
-  char buf[BUFSIZ]={""};
-  char section_TXT[100], param_TXT[100];
-  char* f;
-  string filename, param_name, param, ord;
-  istringstream strbuf;
-  int rule_file;
-
+{
   rule=in_rule;
   n_pts=rule*rule*rule;
+
+  if (rule < 1)
+    FatalError("cubature rule not implemented.");
+
   locs.setup(n_pts,3);
   weights.setup(n_pts);
 
-  if(rule < 13) {
-    
-    if (HIFILES_DIR == NULL)
-      FatalError("environment variable HIFILES_HOME is undefined");
-    
-    filename = HIFILES_DIR;
-    filename += "/data/cubature_hexa.dat";
-    f = (char*)filename.c_str();
-    datfile.open(f, ifstream::in);
-    if (!datfile) FatalError("Unable to open cubature file");
-
-    // read data from file to arrays
-    while(datfile.getline(buf,BUFSIZ))
-    {
-      sscanf(buf,"%s",section_TXT);
-      param_name.assign(section_TXT,0,99);
-      
-      if(!param_name.compare(0,4,"rule"))
-      {
-        // get no. of pts
-        ord = param_name.substr(5);
-        stringstream str(ord);
-        str >> rule_file;
-        
-        // if pts matches order, read locs and weights
-        if (rule_file == rule) {
-          
-          // skip next line
-          datfile.getline(buf,BUFSIZ);
-          
-          for(int i=0;i<n_pts;++i) {
-            datfile.getline(buf,BUFSIZ);
-            sscanf(buf,"%s",param_TXT);
-            param.assign(param_TXT,0,99);
-            strbuf.str(param);
-            locs(i,0) = atof(param.c_str());
-          }
-          
-          // skip next line
-          datfile.getline(buf,BUFSIZ);
-          
-          for(int i=0;i<n_pts;++i) {
-            datfile.getline(buf,BUFSIZ);
-            sscanf(buf,"%s",param_TXT);
-            param.assign(param_TXT,0,99);
-            strbuf.str(param);
-            locs(i,1) = atof(param.c_str());
-          }
-          
-          // skip next line
-          datfile.getline(buf,BUFSIZ);
-          
-          for(int i=0;i<n_pts;++i) {
-            datfile.getline(buf,BUFSIZ);
-            sscanf(buf,"%s",param_TXT);
-            param.assign(param_TXT,0,99);
-            strbuf.str(param);
-            locs(i,2) = atof(param.c_str());
-          }
-          
-          // skip next line
-          datfile.getline(buf,BUFSIZ);
-          
-          for(int i=0;i<n_pts;++i) {
-            datfile.getline(buf,BUFSIZ);
-            sscanf(buf,"%s",param_TXT);
-            param.assign(param_TXT,0,99);
-            strbuf.str(param);
-            weights(i) = atof(param.c_str());
-          }
-          break;
-        }
+  // tensor product of the Gauss-Legendre rule of rule points
+  array<double> locs_1d, weights_1d;
+  gauss_jacobi_rule(rule,0,locs_1d,weights_1d);
+
+  for(int k=0;k<rule;k++) {
+    for(int j=0;j<rule;j++) {
+      for(int i=0;i<rule;i++) {
+        int m = i+rule*(j+rule*k);
+        locs(m,0) = locs_1d(i);
+        locs(m,1) = locs_1d(j);
+        locs(m,2) = locs_1d(k);
+        weights(m) = weights_1d(i)*weights_1d(j)*weights_1d(k);
       }
     }
   }
-  else { FatalError("cubature rule not implemented."); }
 }
 
 // copy constructor
@@ -26,9 +26,9 @@
 #include <iostream>
 #include <cmath>
 #include <string>
-#include <sstream>
 
 #include "../include/global.h"
+#include "../include/cubature_1d.h"
 #include "../include/cubature_tet.h"
 
 using namespace std;
@@ -47,132 +47,36 @@ cubature_tet::cubature_tet()
 
 // constructor 1
 
-cubature_tet::cubature_tet(int in_rule) // set by rule
-{	
-  ifstream datfile;
-  char buf[BUFSIZ]={""};
-  char section_TXT[100], param_TXT[100];
-  char* f;
-  string filename, param_name, param, ord;
-  istringstream strbuf;
-  int rule_file;
-
+cubature_tet::cubature_tet(int in_rule) // set by order
+{
   rule=in_rule;
 
-  //Integration rules adapted from L. Zhang, T. Cui, H. Liu,
-  //"A Set of Symmetric Quadrature rules on Triangles and Tetrahedra,"
-  //Journal of Computational Mathematics, 2009
-
-  if (rule==2)
-    n_pts=4;
-  else if (rule==3)
-    n_pts=8;
-  else if (rule==4)
-    n_pts=14;
-  else if (rule==5)
-    n_pts=14;
-  else if (rule==6)
-    n_pts=24;
-  else if (rule==7)
-    n_pts=35;
-  else if (rule==8)
-    n_pts=46;
-  else if (rule==9)
-    n_pts=61;
-  else if (rule==10)
-    n_pts=81;
-  else if (rule==11)
-    n_pts=109;
-  else if (rule==12)
-    n_pts=140;
-  else if (rule==13)
-    n_pts=171;
-  else if (rule==14)
-    n_pts=236;
-  else {
-    rule=0;
-    n_pts=0;
-    locs.setup(0,0);
-    weights.setup(0);
-    
+  if (rule < 1)
     FatalError("ERROR: Cubature rule currently not implemented ....");
-  }
+
+  // Conical product rule: the tetrahedron is the cube [-1,1]^3 of (a,b,c) collapsed by
+  // r = (1+a)(1-b)(1-c)/4-1, s = (1+b)(1-c)/2-1, t = c, with dr ds dt = (1-b)/2 ((1-c)/2)^2 da db dc.
+  // With n_1d Gauss-Legendre points in a and Gauss-Jacobi points for the weights (1-b) in b and
+  // (1-c)^2 in c, the rule is exact for polynomials of degree 2*n_1d-1 in r,s,t.
+  int n_1d = rule/2+1;
+  n_pts = n_1d*n_1d*n_1d;
 
   locs.setup(n_pts,3);
   weights.setup(n_pts);
 
-  if(rule < 15) {
-    
-    if (HIFILES_DIR == NULL)
-      FatalError("environment variable HIFILES_HOME is undefined");
-    
-    filename = HIFILES_DIR;
-    filename += "/data/cubature_tet.dat";
-    f = (char*)filename.c_str();
-    datfile.open(f, ifstream::in);
-    if (!datfile) FatalError("Unable to open cubature file");
-
-    // read data from file to arrays
-    while(datfile.getline(buf,BUFSIZ))
-    {
-      sscanf(buf,"%s",section_TXT);
-      param_name.assign(section_TXT,0,99);
-      
-      if(!param_name.compare(0,4,"rule"))
-      {
-        // get no. of pts
-        ord = param_name.substr(5);
-        stringstream str(ord);
-        str >> rule_file;
-        
-        // if pts matches order, read locs and weights
-        if (rule_file == rule) {
-          
-          // skip next line
-          datfile.getline(buf,BUFSIZ);
-          
-          for(int i=0;i<n_pts;++i) {
-            datfile.getline(buf,BUFSIZ);
-            sscanf(buf,"%s",param_TXT);
-            param.assign(param_TXT,0,99);
-            strbuf.str(param);
-            locs(i,0) = atof(param.c_str());
-          }
-          
-          // skip next line
-          datfile.getline(buf,BUFSIZ);
-          
-          for(int i=0;i<n_pts;++i) {
-            datfile.getline(buf,BUFSIZ);
-            sscanf(buf,"%s",param_TXT);
-            param.assign(param_TXT,0,99);
-            strbuf.str(param);
-            locs(i,1) = atof(param.c_str());
-          }
-
-          // skip next line
-          datfile.getline(buf,BUFSIZ);
-          
-          for(int i=0;i<n_pts;++i) {
-            datfile.getline(buf,BUFSIZ);
-            sscanf(buf,"%s",param_TXT);
-            param.assign(param_TXT,0,99);
-            strbuf.str(param);
-            locs(i,2) = atof(param.c_str());
-          }
-
-          // skip next line
-          datfile.getline(buf,BUFSIZ);
-          
-          for(int i=0;i<n_pts;++i) {
-            datfile.getline(buf,BUFSIZ);
-            sscanf(buf,"%s",param_TXT);
-            param.assign(param_TXT,0,99);
-            strbuf.str(param);
-            weights(i) = atof(param.c_str());
-          }
-          break;
-        }
+  array<double> a, w_a, b, w_b, c, w_c;
+  gauss_jacobi_rule(n_1d,0,a,w_a);
+  gauss_jacobi_rule(n_1d,1,b,w_b);
+  gauss_jacobi_rule(n_1d,2,c,w_c);
+
+  for(int k=0;k<n_1d;k++) {
+    for(int j=0;j<n_1d;j++) {
+      for(int i=0;i<n_1d;i++) {
+        int m = i+n_1d*(j+n_1d*k);
+        locs(m,0) = 0.25*(1.+a(i))*(1.-b(j))*(1.-c(k))-1.;
+        locs(m,1) = 0.5*(1.+b(j))*(1.-c(k))-1.;
+        locs(m,2) = c(k);
+        weights(m) = 0.125*w_a(i)*w_b(j)*w_c(k);
       }
     }
   }
@@ -1774,7 +1774,7 @@ __global__ void calc_grid_vel_spts_kernel(int n_eles, int max_n_spts_per_ele, in
 }
 
 /* Interpolate the grid velocity at the shape points to the solution or flux points */
-__global__ void eval_grid_vel_pts_kernel(int n_dims, int n_eles, int n_pts_per_ele, int max_n_spts_per_ele, int* n_spts_per_ele, double* nodal_s_basis_pts, double* grid_vel_spts, double* grid_vel_pts)
+__global__ void eval_grid_vel_pts_kernel(int n_dims, int n_eles, int n_pts_per_ele, int max_n_spts_per_ele, int* n_spts_per_ele, int* s_basis_ele, double* nodal_s_basis_pts, double* grid_vel_spts, double* grid_vel_pts)
 {
   const int thread_id = blockIdx.x*blockDim.x+threadIdx.x;
   const int stride = n_eles*n_pts_per_ele;
@@ -1788,7 +1788,7 @@ __global__ void eval_grid_vel_pts_kernel(int n_dims, int n_eles, int n_pts_per_e
     for(k=0;k<n_dims;k++) {
       grid_vel_pts[thread_id+stride*k] = 0.0;
       for(j=0;j<n_spts;j++) {
-        grid_vel_pts[thread_id+stride*k] += nodal_s_basis_pts[j+max_n_spts_per_ele*(pt+n_pts_per_ele*ele)]*grid_vel_spts[k+n_dims*(j+max_n_spts_per_ele*ele)];
+        grid_vel_pts[thread_id+stride*k] += nodal_s_basis_pts[j+max_n_spts_per_ele*(pt+n_pts_per_ele*s_basis_ele[ele])]*grid_vel_spts[k+n_dims*(j+max_n_spts_per_ele*ele)];
       }
     }
   }
@@ -1919,7 +1919,7 @@ __global__ void perturb_shape_kernel(int n_dims, int n_eles, int max_n_spts_per_
  * \param[out] out_d_pos - array of size (n_dims,n_dims); (i,j) = dx_i / dX_j
  */
 template<int n_dims>
-__device__ void calc_d_pos_dyn_kernel(int n_pts_per_ele, int n_eles, int max_n_spts_per_ele, int* n_spts_per_ele, double* detjac_pts, double* JGinv_pts, double* d_nodal_s_basis_pts, double* shape_dyn, double *&out_d_pos)
+__device__ void calc_d_pos_dyn_kernel(int n_pts_per_ele, int n_eles, int max_n_spts_per_ele, int* n_spts_per_ele, int* s_basis_ele, double* detjac_pts, double* JGinv_pts, double* d_nodal_s_basis_pts, double* shape_dyn, double *&out_d_pos)
 {
   const int thread_id = blockIdx.x*blockDim.x+threadIdx.x;
 
@@ -1941,7 +1941,7 @@ __device__ void calc_d_pos_dyn_kernel(int n_pts_per_ele, int n_eles, int max_n_s
         dxdr[i][j] = 0.;
         #pragma unroll
         for(k=0; k<n_spts; k++) {
-          dxdr[i][j] += shape_dyn[i+(n_dims*(k+max_n_spts_per_ele*ele))]*d_nodal_s_basis_pts[j+(n_dims*(k+max_n_spts_per_ele*(pt+n_pts_per_ele*ele)))];
+          dxdr[i][j] += shape_dyn[i+(n_dims*(k+max_n_spts_per_ele*ele))]*d_nodal_s_basis_pts[j+(n_dims*(k+max_n_spts_per_ele*(pt+n_pts_per_ele*s_basis_ele[ele])))];
         }
       }
     }
@@ -1963,7 +1963,7 @@ __device__ void calc_d_pos_dyn_kernel(int n_pts_per_ele, int n_eles, int max_n_s
 
 /*! gpu kernel to update coordiante transformation variables for moving grids */
 template<int n_dims>
-__global__ void set_transforms_dynamic_upts_kernel(int n_upts_per_ele, int n_eles, int max_n_spts_per_ele, int* n_spts_per_ele, double* J_upts, double* J_dyn_upts, double* JGinv_upts, double* JGinv_dyn_upts, double* d_nodal_s_basis_upts, double* shape_dyn)
+__global__ void set_transforms_dynamic_upts_kernel(int n_upts_per_ele, int n_eles, int max_n_spts_per_ele, int* n_spts_per_ele, int* s_basis_ele, double* J_upts, double* J_dyn_upts, double* JGinv_upts, double* JGinv_dyn_upts, double* d_nodal_s_basis_upts, double* shape_dyn)
 {
   const int thread_id = blockIdx.x*blockDim.x+threadIdx.x;
 
@@ -1999,7 +1999,7 @@ __global__ void set_transforms_dynamic_upts_kernel(int n_upts_per_ele, int n_ele
         dxdr[i][j] = 0.;
 #pragma unroll
         for(k=0; k<n_spts; k++) {
-          dxdr[i][j] += shape_dyn[i+(n_dims*(k+max_n_spts_per_ele*ele))]*d_nodal_s_basis_upts[j+(n_dims*(k+max_n_spts_per_ele*(upt+n_upts_per_ele*ele)))];
+          dxdr[i][j] += shape_dyn[i+(n_dims*(k+max_n_spts_per_ele*ele))]*d_nodal_s_basis_upts[j+(n_dims*(k+max_n_spts_per_ele*(upt+n_upts_per_ele*s_basis_ele[ele])))];
         }
       }
     }
@@ -2071,7 +2071,7 @@ __global__ void set_transforms_dynamic_upts_kernel(int n_upts_per_ele, int n_ele
 
 /*! gpu kernel to update coordiante transformation variables for moving grids */
 template<int n_dims>
-__global__ void set_transforms_dynamic_fpts_kernel(int n_fpts_per_ele, int n_eles, int max_n_spts_per_ele, int* n_spts_per_ele, double* J_fpts, double* J_dyn_fpts, double* JGinv_fpts, double* JGinv_dyn_fpts, double* tdA_dyn_fpts, double* norm_fpts, double* norm_dyn_fpts, double* d_nodal_s_basis_fpts, double* shape_dyn)
+__global__ void set_transforms_dynamic_fpts_kernel(int n_fpts_per_ele, int n_eles, int max_n_spts_per_ele, int* n_spts_per_ele, int* s_basis_ele, double* J_fpts, double* J_dyn_fpts, double* JGinv_fpts, double* JGinv_dyn_fpts, double* tdA_dyn_fpts, double* norm_fpts, double* norm_dyn_fpts, double* d_nodal_s_basis_fpts, double* shape_dyn)
 {
   const int thread_id = blockIdx.x*blockDim.x+threadIdx.x;
 
@@ -2101,7 +2101,7 @@ __global__ void set_transforms_dynamic_fpts_kernel(int n_fpts_per_ele, int n_ele
         dxdr[i][j] = 0.;
 #pragma unroll
         for(k=0; k<n_spts; k++) {
-          dxdr[i][j] += shape_dyn[i+(n_dims*(k+max_n_spts_per_ele*ele))]*d_nodal_s_basis_fpts[j+(n_dims*(k+max_n_spts_per_ele*(fpt+n_fpts_per_ele*ele)))];
+          dxdr[i][j] += shape_dyn[i+(n_dims*(k+max_n_spts_per_ele*ele))]*d_nodal_s_basis_fpts[j+(n_dims*(k+max_n_spts_per_ele*(fpt+n_fpts_per_ele*s_basis_ele[ele])))];
         }
       }
     }
@@ -5602,20 +5602,20 @@ void calc_perturb_grid_vel_spts_kernel_wrapper(int n_dims, int n_eles, int max_n
 }
 
 /*! Wrapper for gpu kernel to interpolate the grid veloicty at the shape points to either the solution or flux points */
-void eval_grid_vel_pts_kernel_wrapper(int n_dims, int n_eles, int n_pts_per_ele, int max_n_spts_per_ele, int* n_spts_per_ele, double* nodal_s_basis_pts, double* grid_vel_spts, double* grid_vel_pts)
+void eval_grid_vel_pts_kernel_wrapper(int n_dims, int n_eles, int n_pts_per_ele, int max_n_spts_per_ele, int* n_spts_per_ele, int* s_basis_ele, double* nodal_s_basis_pts, double* grid_vel_spts, double* grid_vel_pts)
 {
   int block_size=256;
   int n_blocks=((n_eles*n_pts_per_ele-1)/block_size)+1;
 
   check_cuda_error("Before", __FILE__, __LINE__);
 
-  eval_grid_vel_pts_kernel <<< n_blocks,block_size >>> (n_dims, n_eles, n_pts_per_ele, max_n_spts_per_ele, n_spts_per_ele, nodal_s_basis_pts, grid_vel_spts, grid_vel_pts);
+  eval_grid_vel_pts_kernel <<< n_blocks,block_size >>> (n_dims, n_eles, n_pts_per_ele, max_n_spts_per_ele, n_spts_per_ele, s_basis_ele, nodal_s_basis_pts, grid_vel_spts, grid_vel_pts);
 
   check_cuda_error("After",__FILE__, __LINE__);
 }
 
 /*! wrapper for gpu kernel to update coordinate transformations for moving grids */
-void set_transforms_dynamic_upts_kernel_wrapper(int n_upts_per_ele, int n_eles, int n_dims, int max_n_spts_per_ele, int* n_spts_per_ele, double* J_upts_ptr, double* J_dyn_upts_ptr, double* JGinv_upts_ptr, double* JGinv_dyn_upts_ptr, double* d_nodal_s_basis_upts, double* shape_dyn)
+void set_transforms_dynamic_upts_kernel_wrapper(int n_upts_per_ele, int n_eles, int n_dims, int max_n_spts_per_ele, int* n_spts_per_ele, int* s_basis_ele, double* J_upts_ptr, double* J_dyn_upts_ptr, double* JGinv_upts_ptr, double* JGinv_dyn_upts_ptr, double* d_nodal_s_basis_upts, double* shape_dyn)
 {
   // HACK: fix 256 threads per block
   int block_size=256;
@@ -5625,10 +5625,10 @@ void set_transforms_dynamic_upts_kernel_wrapper(int n_upts_per_ele, int n_eles,
   check_cuda_error("Before", __FILE__, __LINE__);
 
   if(n_dims==2) {
-    set_transforms_dynamic_upts_kernel<2> <<< n_blocks,block_size >>> (n_upts_per_ele, n_eles, max_n_spts_per_ele, n_spts_per_ele, J_upts_ptr, J_dyn_upts_ptr, JGinv_upts_ptr, JGinv_dyn_upts_ptr, d_nodal_s_basis_upts, shape_dyn);
+    set_transforms_dynamic_upts_kernel<2> <<< n_blocks,block_size >>> (n_upts_per_ele, n_eles, max_n_spts_per_ele, n_spts_per_ele, s_basis_ele, J_upts_ptr, J_dyn_upts_ptr, JGinv_upts_ptr, JGinv_dyn_upts_ptr, d_nodal_s_basis_upts, shape_dyn);
   }
   else if(n_dims==3) {
-    set_transforms_dynamic_upts_kernel<3> <<< n_blocks,block_size >>> (n_upts_per_ele, n_eles, max_n_spts_per_ele, n_spts_per_ele, J_upts_ptr, J_dyn_upts_ptr, JGinv_upts_ptr, JGinv_dyn_upts_ptr, d_nodal_s_basis_upts, shape_dyn);
+    set_transforms_dynamic_upts_kernel<3> <<< n_blocks,block_size >>> (n_upts_per_ele, n_eles, max_n_spts_per_ele, n_spts_per_ele, s_basis_ele, J_upts_ptr, J_dyn_upts_ptr, JGinv_upts_ptr, JGinv_dyn_upts_ptr, d_nodal_s_basis_upts, shape_dyn);
   }
 
   if (err)
@@ -5638,7 +5638,7 @@ void set_transforms_dynamic_upts_kernel_wrapper(int n_upts_per_ele, int n_eles,
 }
 
 /*! wrapper for gpu kernel to update coordinate transformations for moving grids */
-void set_transforms_dynamic_fpts_kernel_wrapper(int n_fpts_per_ele, int n_eles, int n_dims, int max_n_spts_per_ele, int* n_spts_per_ele, double* J_fpts_ptr, double* J_dyn_fpts_ptr, double* JGinv_fpts_ptr, double* JGinv_dyn_fpts_ptr, double* tdA_dyn_fpts_ptr, double* norm_fpts_ptr, double* norm_dyn_fpts_ptr, double* d_nodal_s_basis_fpts, double* shape_dyn)
+void set_transforms_dynamic_fpts_kernel_wrapper(int n_fpts_per_ele, int n_eles, int n_dims, int max_n_spts_per_ele, int* n_spts_per_ele, int* s_basis_ele, double* J_fpts_ptr, double* J_dyn_fpts_ptr, double* JGinv_fpts_ptr, double* JGinv_dyn_fpts_ptr, double* tdA_dyn_fpts_ptr, double* norm_fpts_ptr, double* norm_dyn_fpts_ptr, double* d_nodal_s_basis_fpts, double* shape_dyn)
 {
   // HACK: fix 256 threads per block
   int block_size=256;
@@ -5648,10 +5648,10 @@ void set_transforms_dynamic_fpts_kernel_wrapper(int n_fpts_per_ele, int n_eles,
   check_cuda_error("Before", __FILE__, __LINE__);
 
   if(n_dims==2) {
-    set_transforms_dynamic_fpts_kernel<2> <<< n_blocks,block_size >>> (n_fpts_per_ele, n_eles, max_n_spts_per_ele, n_spts_per_ele, J_fpts_ptr, J_dyn_fpts_ptr, JGinv_fpts_ptr, JGinv_dyn_fpts_ptr, tdA_dyn_fpts_ptr, norm_fpts_ptr, norm_dyn_fpts_ptr, d_nodal_s_basis_fpts, shape_dyn);
+    set_transforms_dynamic_fpts_kernel<2> <<< n_blocks,block_size >>> (n_fpts_per_ele, n_eles, max_n_spts_per_ele, n_spts_per_ele, s_basis_ele, J_fpts_ptr, J_dyn_fpts_ptr, JGinv_fpts_ptr, JGinv_dyn_fpts_ptr, tdA_dyn_fpts_ptr, norm_fpts_ptr, norm_dyn_fpts_ptr, d_nodal_s_basis_fpts, shape_dyn);
   }
   else if(n_dims==3) {
-    set_transforms_dynamic_fpts_kernel<3> <<< n_blocks,block_size >>> (n_fpts_per_ele, n_eles, max_n_spts_per_ele, n_spts_per_ele, J_fpts_ptr, J_dyn_fpts_ptr, JGinv_fpts_ptr, JGinv_dyn_fpts_ptr, tdA_dyn_fpts_ptr, norm_fpts_ptr, norm_dyn_fpts_ptr, d_nodal_s_basis_fpts, shape_dyn);
+    set_transforms_dynamic_fpts_kernel<3> <<< n_blocks,block_size >>> (n_fpts_per_ele, n_eles, max_n_spts_per_ele, n_spts_per_ele, s_basis_ele, J_fpts_ptr, J_dyn_fpts_ptr, JGinv_fpts_ptr, JGinv_dyn_fpts_ptr, tdA_dyn_fpts_ptr, norm_fpts_ptr, norm_dyn_fpts_ptr, d_nodal_s_basis_fpts, shape_dyn);
   }
 
   /*if (*err)
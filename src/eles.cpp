@@ -25,6 +25,7 @@
 
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 #include <cmath>
 
 #if defined _ACCELERATE_BLAS
@@ -61,6 +62,7 @@ extern "C"
 #include "../include/flux.h"
 #include "../include/source.h"
 #include "../include/eles.h"
+#include "../include/profiler.h"
 #include "../include/funcs.h"
 
 using namespace std;
@@ -71,6 +73,8 @@ using namespace std;
 
 eles::eles()
 {
+  output_slot = -1;
+  n_halo_eles = 0;
 }
 
 // default destructor
@@ -109,11 +113,68 @@ void eles::setup(int in_n_eles, int in_max_n_spts_per_ele)
     RK_c(2) = 2526269341429/6820363962896;
     RK_c(3) = 2006345519317/3224310063776;
     RK_c(4) = 2802321613138/2924317926251;
+  }else if (run_input.adv_type==5 || run_input.adv_type==6) {
+    // Embedded low-storage 2R+ pairs of Kennedy, Carpenter & Lewis (2000):
+    // stage i+1 starts from the accumulated solution plus RK_a(i)*dt*f_i,
+    // RK_b are the weights of the solution and RK_bhat of the embedded one
+    int n_stages = (run_input.adv_type==5) ? 4 : 5;
+
+    RK_a.setup(n_stages);
+    RK_b.setup(n_stages);
+    RK_bhat.setup(n_stages);
+    RK_c.setup(n_stages);
+
+    if (run_input.adv_type==5) { // RK3(2)4[2R+]C
+      RK_a(0) = 11847461282814./36547543011857.;
+      RK_a(1) = 3943225443063./7078155732230.;
+      RK_a(2) = -346793006927./4029903576067.;
+      RK_a(3) = 0.0;
+
+      RK_b(0) = 1017324711453./9774461848756.;
+      RK_b(1) = 8237718856693./13685301971492.;
+      RK_b(2) = 57731312506979./19404895981398.;
+      RK_b(3) = -101169746363290./37734290219643.;
+
+      RK_bhat(0) = 15763415370699./46270243929542.;
+      RK_bhat(1) = 514528521746./5659431552419.;
+      RK_bhat(2) = 27030193851939./9429696342944.;
+      RK_bhat(3) = -69544964788955./30262026368149.;
+    }
+    else { // RK4(3)5[2R+]C
+      RK_a(0) = 970286171893./4311952581923.;
+      RK_a(1) = 6584761158862./12103376702013.;
+      RK_a(2) = 2251764453980./15575788980749.;
+      RK_a(3) = 26877169314380./34165994151039.;
+      RK_a(4) = 0.0;
+
+      RK_b(0) = 1153189308089./22510343858157.;
+      RK_b(1) = 1772645290293./4653164025191.;
+      RK_b(2) = -1672844663538./4480602732383.;
+      RK_b(3) = 2114624349019./3568978502595.;
+      RK_b(4) = 5198255086312./14908931495163.;
+
+      RK_bhat(0) = 1016888040809./7410784769900.;
+      RK_bhat(1) = 11231460423587./58533540763752.;
+      RK_bhat(2) = -1563879915014./6823010717585.;
+      RK_bhat(3) = 606302364029./971179775848.;
+      RK_bhat(4) = 1097981568119./3980877426909.;
+    }
+
+    RK_c(0) = 0.0;
+    for (int i=1;i<n_stages;i++) {
+      RK_c(i) = RK_a(i-1);
+      for (int j=0;j<i-1;j++)
+        RK_c(i) += RK_b(j);
+    }
   }
 
   first_time = true;
   n_eles=in_n_eles;
   max_n_spts_per_ele = in_max_n_spts_per_ele;
+  lts_level = 0;
+  n_lts_fpts = 0;
+  fuse_res_norm = false;
+  res_norm_valid = false;
   
   if (n_eles!=0)
   {
@@ -139,6 +200,20 @@ void eles::setup(int in_n_eles, int in_max_n_spts_per_ele)
     // Initialize the element specific static members
     (*this).setup_ele_type_specific();
 
+    // Kernels specialized for this element type and order; the flux one is
+    // for the Euler/NS equations on a static mesh only
+    select_eles_kernels(ele_type,order,n_upts_per_ele,kernels);
+    if (motion || run_input.equation != 0 || run_input.turb_model != 0) {
+      kernels.inv_flux = NULL;
+      kernels.inv_flux_sp = NULL;
+    }
+    if (motion)
+      kernels.transform_grad = NULL;
+
+    // Single precision copies of the flux operators
+    if (run_input.mixed_precision)
+      setup_opp_sp();
+
     if(run_input.adv_type==0)
     {
       n_adv_levels=1;
@@ -155,6 +230,17 @@ void eles::setup(int in_n_eles, int in_max_n_spts_per_ele)
     {
       n_adv_levels=2;
     }
+    else if(run_input.adv_type==4)
+    {
+      n_adv_levels=1;
+      color.setup(n_eles);
+      color.initialize_to_value(0);
+    }
+    else if(run_input.adv_type==5 || run_input.adv_type==6)
+    {
+      // stage solution, accumulated solution, error estimate, solution at the start of the step
+      n_adv_levels=4;
+    }
     else
     {
       cout << "ERROR: Type of time integration scheme not recongized ... " << endl;
@@ -167,24 +253,19 @@ void eles::setup(int in_n_eles, int in_max_n_spts_per_ele)
       disu_upts(i).setup(n_upts_per_ele,n_eles,n_fields);
     }
 
-    // Allocate storage for timestep
-    // If using global minimum, only one timestep
-    if (run_input.dt_type == 1)
-      dt_local.setup(1);
-    // If using local, one timestep per element
-    else
-      dt_local.setup(n_eles);
-    
-    // If in parallel and using global minumum timestep, allocate storage
-    // for minimum timesteps in each partition
-#ifdef _MPI
-    if (run_input.dt_type == 1)
-    {
-      MPI_Comm_size(MPI_COMM_WORLD,&nproc);
-      dt_local_mpi.setup(nproc);
-      dt_local_mpi.initialize_to_zero();
-    }
-#endif
+    // Allocate storage for the timestep of each element, the global one
+    // (given, or reduced over all element types and partitions by the
+    // solver) or the local one
+    dt_local.setup(n_eles);
+    dt_local.initialize_to_value(run_input.dt);
+
+    // No element is on an MPI interface until the interfaces are set up
+    halo_ele_flag.setup(n_eles);
+    halo_ele_flag.initialize_to_zero();
+    n_halo_eles = 0;
+
+    // Residual norm reduced by the update
+    res_norm_upts.setup(n_fields);
     
     // Initialize to zero
     for (int m=0;m<n_adv_levels;m++)
@@ -193,13 +274,25 @@ void eles::setup(int in_n_eles, int in_max_n_spts_per_ele)
     // Set no. of diagnostic fields
     n_diagnostic_fields = run_input.n_diagnostic_fields;
 
+    // Kernels of the diagnostic fields and integral quantities; the gradient is only computed for viscous flows
+    compile_diag_fields(run_input.diagnostic_fields,n_dims,n_fields,diag_fields_plan);
+    compile_integral_quantities(run_input.integral_quantities,n_dims,n_fields,integral_plan);
+    if ((diag_fields_plan.need_grad || integral_plan.need_grad) && !viscous)
+      FatalError("The diagnostic fields and integral quantities of velocity gradients need a viscous simulation");
+
     // Set no. of diagnostic fields
     n_average_fields = run_input.n_average_fields;
 
-    // Allocate storage for time-averaged velocity components    
+    // Allocate storage for time-averaged fields and the accumulators of their statistics
     if(n_average_fields > 0) {
       disu_average_upts.setup(n_upts_per_ele,n_eles,n_average_fields);
       disu_average_upts.initialize_to_zero();
+
+      compile_time_stats(run_input.average_fields,n_dims,stats);
+      stats_accum_upts.setup(n_upts_per_ele,n_eles,stats.n_accums);
+      stats_accum_upts.initialize_to_zero();
+      stats_weight = -1.;
+      stats_time = 0.;
     }
     
     // Allocate extra arrays for LES models
@@ -299,25 +392,9 @@ void eles::setup(int in_n_eles, int in_max_n_spts_per_ele)
     set_shape(in_max_n_spts_per_ele);
     ele2global_ele.setup(n_eles);
     bctype.setup(n_eles,n_inters_per_ele);
+    lts_fine_face.setup(n_eles,n_inters_per_ele);
+    lts_fine_face.initialize_to_zero();
 
-    // TODO: reduce unused allocation space (i.e. more spts alloc'd than needed)
-    nodal_s_basis_fpts.setup(in_max_n_spts_per_ele,n_fpts_per_ele,n_eles);
-    nodal_s_basis_upts.setup(in_max_n_spts_per_ele,n_upts_per_ele,n_eles);
-    nodal_s_basis_ppts.setup(in_max_n_spts_per_ele,n_ppts_per_ele,n_eles);
-    //d_nodal_s_basis_fpts.setup(n_fpts_per_ele,n_eles,n_dims,in_max_n_spts_per_ele);
-    //d_nodal_s_basis_upts.setup(n_upts_per_ele,n_eles,n_dims,in_max_n_spts_per_ele);
-    d_nodal_s_basis_upts.setup(n_dims,in_max_n_spts_per_ele,n_upts_per_ele,n_eles);
-    d_nodal_s_basis_fpts.setup(n_dims,in_max_n_spts_per_ele,n_fpts_per_ele,n_eles);
-
-    nodal_s_basis_vol_cubpts.setup(in_max_n_spts_per_ele,n_cubpts_per_ele,n_eles);
-    d_nodal_s_basis_vol_cubpts.setup(n_dims,in_max_n_spts_per_ele,n_cubpts_per_ele,n_eles);
-    nodal_s_basis_inters_cubpts.setup(n_inters_per_ele);
-    d_nodal_s_basis_inters_cubpts.setup(n_inters_per_ele);
-    for (int iface=0; iface<n_inters_per_ele; iface++) {
-      nodal_s_basis_inters_cubpts(iface).setup(in_max_n_spts_per_ele,n_cubpts_per_inter(iface),n_eles);
-      d_nodal_s_basis_inters_cubpts(iface).setup(n_dims,in_max_n_spts_per_ele,n_cubpts_per_inter(iface),n_eles);
-    }
-    
     // for mkl sparse blas
     matdescra[0]='G';
     matdescra[3]='F';
@@ -339,7 +416,11 @@ void eles::setup(int in_n_eles, int in_max_n_spts_per_ele)
       div_tconf_upts(m).initialize_to_zero();
     
     disu_fpts.setup(n_fpts_per_ele,n_eles,n_fields);
-    tdisf_upts.setup(n_upts_per_ele,n_eles,n_fields,n_dims);
+    // the transformed flux is a single precision working array in the mixed precision mode
+    if (run_input.mixed_precision)
+      tdisf_upts_sp.setup(n_upts_per_ele,n_eles,n_fields,n_dims);
+    else
+      tdisf_upts.setup(n_upts_per_ele,n_eles,n_fields,n_dims);
     norm_tdisf_fpts.setup(n_fpts_per_ele,n_eles,n_fields);
     norm_tconf_fpts.setup(n_fpts_per_ele,n_eles,n_fields);
     
@@ -596,24 +677,7 @@ void eles::set_ics(double& time)
   }
 
   // If required, calculate element reference lengths
-  if (run_input.dt_type > 0) {
-    // Allocate array
-    h_ref.setup(n_upts_per_ele,n_eles);
-    
-    // Call element specific function to obtain length
-    double h_ref_dumb;
-    for (int i=0;i<n_eles;i++) {
-      h_ref_dumb = (*this).calc_h_ref_specific(i);
-      for (int j=0;j<n_upts_per_ele;j++) {
-        // TODO: Make more memory efficient!!!
-        h_ref(j,i) = h_ref_dumb;
-      }
-    }
-  }
-  else {
-    h_ref.setup(1);
-  }
-  h_ref.cp_cpu_gpu();
+  set_h_ref();
 }
 
 
@@ -633,90 +697,71 @@ void eles::read_restart_data(ifstream& restart_file)
   else if (ele_type==3) ele_name="PRIS";
   else if (ele_type==4) ele_name="HEXAS";
   
-  // Move cursor to correct element type
-  while(1) {
-    getline(restart_file,str);
-    if (str==ele_name) break;
-    if (restart_file.eof()) return; // Restart file doesn't contain my elements
-  }
-  
-  // Move cursor to n_eles
-  while(1) {
-    getline(restart_file,str);
-    if (str=="n_eles") break;
-  }
-  
-  // Read number of elements to read
-  restart_file >> num_eles_to_read;
-  getline(restart_file,str);
-  
-  //Skip ele2global_ele lines
-  getline(restart_file,str);
-  getline(restart_file,str);
-  getline(restart_file,str);
+  // Elements of one type are split over several sections with local time stepping,
+  // so read every section of my element type from the start of the file
+  restart_file.clear();
+  restart_file.seekg(0);
   
   int ele,index;
   array<double> disu_upts_rest;
   disu_upts_rest.setup(n_upts_per_ele_rest,n_fields);
   
-  for (int i=0;i<num_eles_to_read;i++)
-  {
-    restart_file >> ele ;
-    index = index_locate_int(ele,ele2global_ele.get_ptr_cpu(),n_eles);
+  while(1) {
+    
+    // Move cursor to next section of my element type
+    while(getline(restart_file,str)) {
+      if (str==ele_name) break;
+    }
+    if (!restart_file) break; // No more sections of my elements
+    
+    // Move cursor to n_eles
+    while(1) {
+      getline(restart_file,str);
+      if (str=="n_eles") break;
+    }
+    
+    // Read number of elements to read
+    restart_file >> num_eles_to_read;
+    getline(restart_file,str);
+    
+    //Skip ele2global_ele lines
+    getline(restart_file,str);
+    getline(restart_file,str);
+    getline(restart_file,str);
     
-    if (index!=-1) // Ele belongs to processor
+    for (int i=0;i<num_eles_to_read;i++)
     {
-      for (int j=0;j<n_upts_per_ele_rest;j++)
-        for (int k=0;k<n_fields;k++)
-          restart_file >> disu_upts_rest(j,k);
+      restart_file >> ele ;
+      index = index_locate_int(ele,ele2global_ele.get_ptr_cpu(),n_eles);
       
-      // Now compute transformed solution at solution points using opp_r
-      for (int m=0;m<n_fields;m++)
+      if (index!=-1) // Ele belongs to processor
       {
-        for (int j=0;j<n_upts_per_ele;j++)
-        {
-          double value = 0.;
-          for (int k=0;k<n_upts_per_ele_rest;k++)
-            value += opp_r(j,k)*disu_upts_rest(k,m);
-          
-          disu_upts(0)(j,index,m) = value;
-        }
+        for (int j=0;j<n_upts_per_ele_rest;j++)
+          for (int k=0;k<n_fields;k++)
+            restart_file >> disu_upts_rest(j,k);
+        
+        set_disu_upts_restart(index,disu_upts_rest);
+        
       }
-      
-    }
-    else // Skip the data (doesn't belong to current processor)
-    {
-      // Skip rest of ele line
-      getline(restart_file,str);
-      for (int j=0;j<n_upts_per_ele_rest;j++)
+      else // Skip the data (doesn't belong to current processor)
+      {
+        // Skip rest of ele line
         getline(restart_file,str);
+        for (int j=0;j<n_upts_per_ele_rest;j++)
+          getline(restart_file,str);
+      }
     }
   }
   
   // If required, calculate element reference lengths
-  if (run_input.dt_type > 0) {
-    // Allocate array
-    h_ref.setup(n_upts_per_ele,n_eles);
-
-    // Call element specific function to obtain length
-    double h_ref_dumb;
-    for (int i=0;i<n_eles;i++) {
-      h_ref_dumb = (*this).calc_h_ref_specific(i);
-      for (int j=0;j<n_upts_per_ele;j++) {
-        // TODO: Make more memory efficient!!!
-        h_ref(j,i) = h_ref_dumb;
-      }
-    }
-  }
-  else {
-    h_ref.setup(1);
-  }
-  h_ref.cp_cpu_gpu();
+  set_h_ref();
 }
 
 
 void eles::write_restart_data(ofstream& restart_file)
 {
+  array<double>& disu_out = (output_slot<0) ? disu_upts(0) : disu_upts_out(output_slot);
+
   restart_file << "n_eles" << endl;
   restart_file << n_eles << endl;
   restart_file << "ele2global_ele array" << endl;
@@ -733,7 +778,7 @@ void eles::write_restart_data(ofstream& restart_file)
     {
       for (int k=0;k<n_fields;k++)
       {
-        restart_file << disu_upts(0)(j,i,k) << " ";
+        restart_file << disu_out(j,i,k) << " ";
       }
       restart_file << endl;
     }
@@ -770,6 +815,107 @@ void eles::write_restart_mesh(ofstream& restart_file)
   restart_file << endl;
 }
 
+// compute transformed solution at solution points of an element from solution at restart points, using opp_r
+
+void eles::set_disu_upts_restart(int in_ele, array<double>& in_disu_upts_rest)
+{
+  for (int m=0;m<n_fields;m++)
+  {
+    for (int j=0;j<n_upts_per_ele;j++)
+    {
+      double value = 0.;
+      for (int k=0;k<n_upts_per_ele_rest;k++)
+        value += opp_r(j,k)*in_disu_upts_rest(k,m);
+      
+      disu_upts(0)(j,in_ele,m) = value;
+    }
+  }
+}
+
+// calculate element reference lengths, if required by the timestep type
+
+void eles::set_h_ref(void)
+{
+  if (run_input.dt_type > 0 || run_input.adv_type == 4) {
+    // Allocate array
+    h_ref.setup(n_upts_per_ele,n_eles);
+    
+    // Call element specific function to obtain length
+    double h_ref_dumb;
+    for (int i=0;i<n_eles;i++) {
+      h_ref_dumb = (*this).calc_h_ref_specific(i);
+      for (int j=0;j<n_upts_per_ele;j++) {
+        // TODO: Make more memory efficient!!!
+        h_ref(j,i) = h_ref_dumb;
+      }
+    }
+  }
+  else {
+    h_ref.setup(1);
+  }
+  h_ref.cp_cpu_gpu();
+}
+
+// write element header of binary restart file: sizes, restart info (as text) and global element numbers
+
+void eles::write_restart_header_bin(ofstream& restart_file)
+{
+  ostringstream info;
+  info.precision(15);
+  write_restart_info(info);
+  
+  string info_str = info.str();
+  int info_len = info_str.size();
+  
+  restart_file.write((char*)&ele_type,sizeof(int));
+  restart_file.write((char*)&n_eles,sizeof(int));
+  restart_file.write((char*)&n_upts_per_ele,sizeof(int));
+  restart_file.write((char*)&n_fields,sizeof(int));
+  restart_file.write((char*)&info_len,sizeof(int));
+  restart_file.write(info_str.c_str(),info_len);
+  restart_file.write((char*)ele2global_ele.get_ptr_cpu(),n_eles*sizeof(int));
+}
+
+// write solution to binary restart file, one (n_upts_per_ele,n_fields) record per element
+
+void eles::write_restart_data_bin(ofstream& restart_file)
+{
+  array<double> disu_ele(n_upts_per_ele,n_fields);
+  array<double>& disu_out = (output_slot<0) ? disu_upts(0) : disu_upts_out(output_slot);
+  
+  for (int i=0;i<n_eles;i++)
+  {
+    for (int j=0;j<n_upts_per_ele;j++)
+      for (int k=0;k<n_fields;k++)
+        disu_ele(j,k) = disu_out(j,i,k);
+    
+    restart_file.write((char*)disu_ele.get_ptr_cpu(),n_upts_per_ele*n_fields*sizeof(double));
+  }
+}
+
+// read restart info stored in the header of a binary restart file
+
+int eles::read_restart_info_bin(string& in_info)
+{
+  istringstream info(in_info);
+  
+  return read_restart_info(info);
+}
+
+// read solution of one element at the current position of a binary restart file
+
+void eles::read_restart_ele_bin(ifstream& restart_file, int in_ele)
+{
+  array<double> disu_upts_rest(n_upts_per_ele_rest,n_fields);
+  
+  restart_file.read((char*)disu_upts_rest.get_ptr_cpu(),n_upts_per_ele_rest*n_fields*sizeof(double));
+  
+  if (restart_file.fail())
+    FatalError("Could not read element from binary restart file");
+  
+  set_disu_upts_restart(in_ele,disu_upts_rest);
+}
+
 // move all to from cpu to gpu
 
 void eles::mv_all_cpu_gpu(void)
@@ -846,6 +992,7 @@ void eles::mv_all_cpu_gpu(void)
           area_coord_upts.mv_cpu_gpu();
           area_coord_fpts.mv_cpu_gpu();
           n_spts_per_ele.mv_cpu_gpu();
+          s_basis_ele.cp_cpu_gpu();
           dt_local.cp_cpu_gpu();
           min_dt_local.cp_cpu_gpu();
         }
@@ -998,12 +1145,67 @@ void eles::rm_detjac_upts_cpu(void)
 #endif
 }
 
+// timestep of each element for the update: the global one, or the local ones (dt_type 2)
+// computed at the first stage
+
+void eles::set_dt_ele(int in_step)
+{
+  if (run_input.dt_type < 0 || run_input.dt_type > 2)
+    FatalError("ERROR: dt_type not recognized!");
+
+  if (run_input.dt_type == 2) {
+    if (in_step == 0) {
+#pragma omp parallel for schedule(static)
+      for (int ic=0; ic<n_eles; ic++)
+        dt_local(ic) = calc_dt_local(ic);
+    }
+  }
+  else {
+    for (int ic=0; ic<n_eles; ic++)
+      dt_local(ic) = run_input.dt;
+  }
+}
+
+// update the solution from the last residual, forward Euler or one stage of the low-storage RK
+// scheme, and at the last stage of a monitored step reduce the residual norm in the same pass
+
+void eles::update_upts(bool in_low_storage, double in_a, double in_b, bool in_last_stage)
+{
+  bool norm = in_last_stage && fuse_res_norm;
+  double field_norm[3];
+
+  for (int k=0;k<n_fields;k++)
+  {
+    double* u = disu_upts(0).get_ptr_cpu(0,0,k);
+    double* r = in_low_storage ? disu_upts(1).get_ptr_cpu(0,0,k) : NULL;
+    double* div = div_tconf_upts(0).get_ptr_cpu(0,0,k);
+    double* src = src_upts.get_ptr_cpu(0,0,k);
+
+    kernels.update[in_low_storage][norm](n_upts_per_ele,n_eles,u,r,div,src,inv_detjac_upts.get_ptr_cpu(),dt_local.get_ptr_cpu(),in_a,in_b,run_input.const_src,field_norm);
+
+    if (norm)
+      res_norm_upts(k) = field_norm[run_input.res_norm_type];
+  }
+
+  if (norm)
+    res_norm_valid = true;
+}
+
+// reduce the residual norm in the last update of the next step
+
+void eles::set_fuse_res_norm(bool in_fuse)
+{
+  fuse_res_norm = in_fuse;
+}
+
 // advance solution
 
 void eles::AdvanceSolution(int in_step, int adv_type) {
   
   if (n_eles!=0)
   {
+    prof_timer timer(PROF_ADVANCE,ele_type,8.*n_upts_per_ele*n_eles*n_fields*(n_adv_levels>1 ? 6 : 4),5.*n_upts_per_ele*n_eles*n_fields);
+    prof_add_dof_updates((double)n_upts_per_ele*n_eles*n_fields);
     
     /*! Time integration using a forwards Euler integration. */
     
@@ -1017,66 +1219,12 @@ void eles::AdvanceSolution(int in_step, int adv_type) {
        */
       
 #ifdef _CPU
-      // If using global minimum timestep based on CFL, determine
-      // global minimum
-      if (run_input.dt_type == 1)
-      {
-        // Find minimum timestep
-        dt_local(0) = 1e12; // Set to large value
-        
-        for (int ic=0; ic<n_eles; ic++)
-        {
-          dt_local_new = calc_dt_local(ic);
-          
-          if (dt_local_new < dt_local(0))
-            dt_local(0) = dt_local_new;
-        }
-        
-        // If running in parallel, gather minimum timestep values from
-        // each partition and find global minumum across partitions
-#ifdef _MPI
-        MPI_Barrier(MPI_COMM_WORLD);
-        MPI_Allgather(&dt_local(0),1,MPI_DOUBLE,dt_local_mpi.get_ptr_cpu(),
-                      1, MPI_DOUBLE, MPI_COMM_WORLD);
-        MPI_Barrier(MPI_COMM_WORLD);
-        
-        dt_local(0) = dt_local_mpi.get_min();
-#endif
-      }
-      
-      // If using local timestepping, just compute and store all local
-      // timesteps
-      if (run_input.dt_type == 2)
-      {
-        for (int ic=0; ic<n_eles; ic++)
-          dt_local(ic) = calc_dt_local(ic);
-      }
-      
-      for (int i=0;i<n_fields;i++)
-      {
-        for (int ic=0;ic<n_eles;ic++)
-        {
-          for (int inp=0;inp<n_upts_per_ele;inp++)
-          {
-            // User supplied timestep
-            if (run_input.dt_type != 0)
-            {
-              // Global minimum timestep
-              if (run_input.dt_type == 1)
-                run_input.dt = dt_local(0);
-            
-              // Element local timestep
-              else if (run_input.dt_type == 2)
-                run_input.dt = dt_local(ic);
+      set_dt_ele(in_step);
+      update_upts(false,0.,1.,true);
 
-              else
-                FatalError("ERROR: dt_type not recognized!")
-            }
-              
-            disu_upts(0)(inp,ic,i) -= run_input.dt*(div_tconf_upts(0)(inp,ic,i)/detjac_upts(inp,ic) - run_input.const_src - src_upts(inp,ic,i));
-          }
-        }
-      }
+      // Leave run_input.dt as the serial update did (used to advance the time)
+      if (run_input.dt_type == 2)
+        run_input.dt = dt_local(n_eles-1);
 
 #endif
       
@@ -1113,80 +1261,71 @@ void eles::AdvanceSolution(int in_step, int adv_type) {
       }
       
 #ifdef _CPU
-      // for first stage only, compute timestep
-      if (in_step == 0)
-      {
-        // For global timestepping, find minimum timestep
-        if (run_input.dt_type == 1)
-        {
-          dt_local(0) = 1e12;
-          
-          for (int ic=0; ic<n_eles; ic++)
-          {
-            dt_local_new = calc_dt_local(ic);
-            
-            if (dt_local_new < dt_local(0))
-            {
-              dt_local(0) = dt_local_new;
-            }
-          }
-          
-          
-          // If using MPI, find minimum across partitions
-#ifdef _MPI
-          MPI_Barrier(MPI_COMM_WORLD);
-          MPI_Allgather(&dt_local(0),1,MPI_DOUBLE,dt_local_mpi.get_ptr_cpu(),1,MPI_DOUBLE,MPI_COMM_WORLD);
-          MPI_Barrier(MPI_COMM_WORLD);
-          
-          dt_local(0) = dt_local_mpi.get_min();
+      set_dt_ele(in_step);
+      update_upts(true,rk4a,rk4b,in_step==4);
+
+      // Leave run_input.dt as the serial update did (used to advance the time)
+      if (run_input.dt_type == 2)
+        run_input.dt = dt_local(n_eles-1);
+      
+#endif
+      
+#ifdef _GPU
+      
+      RK45_update_kernel_wrapper(n_upts_per_ele,n_dims,n_fields,n_eles,disu_upts(0).get_ptr_gpu(),disu_upts(1).get_ptr_gpu(),div_tconf_upts(0).get_ptr_gpu(),detjac_upts.get_ptr_gpu(),src_upts.get_ptr_gpu(),h_ref.get_ptr_gpu(),rk4a,rk4b,run_input.dt,run_input.const_src,run_input.CFL,run_input.gamma,run_input.mu_inf,run_input.order,viscous,run_input.dt_type,in_step);
+      
 #endif
-        }
-        
-        // For local timestepping, find element local timesteps
-        if (run_input.dt_type == 2)
-        {
-          for (int ic=0; ic<n_eles; ic++)
-          {
-            dt_local(ic) = calc_dt_local(ic);
-          }
-        }
-      }
       
-      double res, rhs;
+    }
+    
+    /*! Time integration using an embedded low-storage RK pair, with a step
+     size run_input.dt set by the error controller. */
+
+    else if (adv_type == 5 || adv_type == 6) {
+
+#ifdef _CPU
+      int n_stages = RK_a.get_dim(0);
+      double a = RK_a(in_step)*run_input.dt;
+      double b = RK_b(in_step)*run_input.dt;
+      double e = (RK_b(in_step)-RK_bhat(in_step))*run_input.dt;
+      bool last = (in_step == n_stages-1);
+
+      // disu_upts(0): stage solution, (1): accumulated solution,
+      // (2): error estimate, (3): solution at the start of the step
+#pragma omp parallel for schedule(static)
       for (int ic=0;ic<n_eles;ic++)
       {
+        double rhs;
+
         for (int i=0;i<n_fields;i++)
         {
           for (int inp=0;inp<n_upts_per_ele;inp++)
           {
-            rhs = -div_tconf_upts(0)(inp,ic,i)/detjac_upts(inp,ic) + run_input.const_src + src_upts(inp,ic,i);
-            res = disu_upts(1)(inp,ic,i);
-            
-            if (run_input.dt_type != 0)
-            {
-              if (run_input.dt_type == 1)
-                run_input.dt = dt_local(0);
-              else if (run_input.dt_type == 2)
-                run_input.dt = dt_local(ic);
+            if (in_step == 0) {
+              disu_upts(1)(inp,ic,i) = disu_upts(0)(inp,ic,i);
+              disu_upts(3)(inp,ic,i) = disu_upts(0)(inp,ic,i);
+              disu_upts(2)(inp,ic,i) = 0.;
             }
-            
-            res = rk4a*res + run_input.dt*rhs;
-            disu_upts(1)(inp,ic,i) = res;
-            disu_upts(0)(inp,ic,i) += rk4b*res;
+
+            rhs = -div_tconf_upts(0)(inp,ic,i)/detjac_upts(inp,ic) + run_input.const_src + src_upts(inp,ic,i);
+
+            disu_upts(2)(inp,ic,i) += e*rhs;
+            if (!last)
+              disu_upts(0)(inp,ic,i) = disu_upts(1)(inp,ic,i) + a*rhs;
+            disu_upts(1)(inp,ic,i) += b*rhs;
+            if (last)
+              disu_upts(0)(inp,ic,i) = disu_upts(1)(inp,ic,i);
           }
         }
       }
-      
 #endif
-      
+
 #ifdef _GPU
-      
-      RK45_update_kernel_wrapper(n_upts_per_ele,n_dims,n_fields,n_eles,disu_upts(0).get_ptr_gpu(),disu_upts(1).get_ptr_gpu(),div_tconf_upts(0).get_ptr_gpu(),detjac_upts.get_ptr_gpu(),src_upts.get_ptr_gpu(),h_ref.get_ptr_gpu(),rk4a,rk4b,run_input.dt,run_input.const_src,run_input.CFL,run_input.gamma,run_input.mu_inf,run_input.order,viscous,run_input.dt_type,in_step);
-      
+      FatalError("Adaptive RK time stepping is not implemented on the GPU");
 #endif
-      
+
     }
-    
+
     /*! Time integration not implemented. */
     
     else {
@@ -1201,54 +1340,64 @@ double eles::calc_dt_local(int in_ele)
 {
   double lam_inv, lam_inv_new;
   double lam_visc, lam_visc_new;
-  double out_dt_local;
   double dt_inv, dt_visc;
-  
-  // 2-D Elements
-  if (n_dims == 2)
-  {
-    double u,v,p,c;
-    
-    lam_inv = 0;
-    lam_visc = 0;
-    
-    // Calculate maximum internal wavespeed per element
-    for (int i=0; i<n_upts_per_ele; i++)
-    {
-      u = disu_upts(0)(i,in_ele,1)/disu_upts(0)(i,in_ele,0);
-      v = disu_upts(0)(i,in_ele,2)/disu_upts(0)(i,in_ele,0);
-      p = (run_input.gamma - 1.0) * (disu_upts(0)(i,in_ele,3) - 0.5*disu_upts(0)(i,in_ele,0)*(u*u+v*v));
-      c = sqrt(run_input.gamma * p/disu_upts(0)(i,in_ele,0));
-      
-      lam_inv_new = sqrt(u*u + v*v) + c;
-      lam_visc_new = 4.0/3.0*run_input.mu_inf/disu_upts(0)(i,in_ele,0);
-      
-      if (lam_inv < lam_inv_new)
-        lam_inv = lam_inv_new;
+  double rho, vel, vel_sq, p, c;
 
-      if (lam_visc < lam_visc_new)
-        lam_visc = lam_visc_new;
-    }
+  lam_inv = 0;
+  lam_visc = 0;
 
-    if (viscous)
-    {
-      dt_visc = (run_input.CFL * 0.25 * h_ref(0,in_ele) * h_ref(0,in_ele))/(lam_visc) * 1.0/(2.0*run_input.order+1.0);
-      dt_inv = run_input.CFL*h_ref(0,in_ele)/lam_inv*1.0/(2.0*run_input.order + 1.0);
-    }
-    else
+  // Calculate maximum internal wavespeed per element (2-D and 3-D,
+  // the energy follows the momentum components)
+  for (int i=0; i<n_upts_per_ele; i++)
+  {
+    rho = disu_upts(0)(i,in_ele,0);
+
+    vel_sq = 0.;
+    for (int m=0; m<n_dims; m++)
     {
-      dt_visc = 1e16;
-      dt_inv = run_input.CFL*h_ref(0,in_ele)/lam_inv * 1.0/(2.0*run_input.order + 1.0);
+      vel = disu_upts(0)(i,in_ele,m+1)/rho;
+      vel_sq += vel*vel;
     }
-      out_dt_local = min(dt_visc,dt_inv);
+
+    p = (run_input.gamma - 1.0) * (disu_upts(0)(i,in_ele,n_dims+1) - 0.5*rho*vel_sq);
+    c = sqrt(run_input.gamma * p/rho);
+
+    lam_inv_new = sqrt(vel_sq) + c;
+    lam_visc_new = 4.0/3.0*run_input.mu_inf/rho;
+
+    if (lam_inv < lam_inv_new)
+      lam_inv = lam_inv_new;
+
+    if (lam_visc < lam_visc_new)
+      lam_visc = lam_visc_new;
   }
-  
-  else if (n_dims == 3)
+
+  dt_inv = run_input.CFL*h_ref(0,in_ele)/lam_inv * 1.0/(2.0*order + 1.0);
+
+  if (viscous)
+    dt_visc = (run_input.CFL * 0.25 * h_ref(0,in_ele) * h_ref(0,in_ele))/(lam_visc) * 1.0/(2.0*order+1.0);
+  else
+    dt_visc = 1e16;
+
+  return min(dt_visc,dt_inv);
+}
+
+// minimum element local timestep on this partition
+
+double eles::calc_dt_min(void)
+{
+  double dt_min = 1e16;
+
+#pragma omp parallel for schedule(static) reduction(min:dt_min)
+  for (int ic=0; ic<n_eles; ic++)
   {
-    FatalError("Timestep type is not implemented in 3D yet.");
+    double dt_ele = calc_dt_local(ic);
+
+    if (dt_ele < dt_min)
+      dt_min = dt_ele;
   }
-  
-  return out_dt_local;
+
+  return dt_min;
 }
 
 // calculate the discontinuous solution at the flux points
@@ -1256,6 +1405,7 @@ double eles::calc_dt_local(int in_ele)
 void eles::extrapolate_solution(int in_disu_upts_from)
 {
   if (n_eles!=0) {
+    prof_timer timer(PROF_EXTRAPOLATE_SOLUTION,ele_type,op_bytes(n_fpts_per_ele,n_upts_per_ele,1,n_fields*n_eles),op_flops(n_fpts_per_ele,n_upts_per_ele,1,n_fields*n_eles));
     
     /*!
      Performs C = (alpha*A*B) + (beta*C) where: \n
@@ -1303,6 +1453,10 @@ void eles::extrapolate_solution(int in_disu_upts_from)
       
 #endif
     }
+    else if(opp_0_sparse==2) // sum-factorized tensor product
+    {
+      tp_extrapolate(disu_upts(in_disu_upts_from).get_ptr_cpu(),disu_fpts.get_ptr_cpu(),-1,0);
+    }
     else { cout << "ERROR: Unknown storage for opp_0 ... " << endl; }
     
 #endif
@@ -1326,17 +1480,196 @@ void eles::extrapolate_solution(int in_disu_upts_from)
   
 }
 
+// mark an element as having a face on an MPI interface
+
+void eles::set_halo_ele(int in_ele)
+{
+  if (!halo_ele_flag(in_ele)) {
+    halo_ele_flag(in_ele) = 1;
+    n_halo_eles++;
+  }
+}
+
+// list the elements on MPI interfaces and allocate the gather/scatter buffers, once all the interfaces are set up
+
+void eles::setup_halo(void)
+{
+  if (n_eles!=0) {
+    int i,k;
+    int max_n_blocks = max(n_fields,n_fields*n_dims);
+
+    halo_eles.setup(n_halo_eles);
+    k = 0;
+    for (i=0;i<n_eles;i++)
+      if (halo_ele_flag(i))
+        halo_eles(k++) = i;
+
+    halo_upts_buf.setup(n_upts_per_ele,n_halo_eles*max_n_blocks);
+    halo_fpts_buf.setup(n_fpts_per_ele,n_halo_eles*max_n_blocks);
+  }
+}
+
+// apply an extrapolation operator to the elements on MPI interfaces only: gather their columns, one
+// matrix product, scatter. in_n_blocks is the number of (n_upts_per_ele,n_eles) blocks (fields, or fields*dims)
+
+void eles::extrapolate_halo(array<double>& in_opp, double* in_upts, double* out_fpts, int in_n_blocks)
+{
+  int i,k,b;
+
+  for (b=0;b<in_n_blocks;b++)
+    for (k=0;k<n_halo_eles;k++)
+      for (i=0;i<n_upts_per_ele;i++)
+        halo_upts_buf(i,k+n_halo_eles*b) = in_upts[i+n_upts_per_ele*(halo_eles(k)+n_eles*b)];
+
+#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
+  cblas_dgemm(CblasColMajor,CblasNoTrans,CblasNoTrans,n_fpts_per_ele,n_halo_eles*in_n_blocks,n_upts_per_ele,1.0,in_opp.get_ptr_cpu(),n_fpts_per_ele,halo_upts_buf.get_ptr_cpu(),n_upts_per_ele,0.0,halo_fpts_buf.get_ptr_cpu(),n_fpts_per_ele);
+
+#elif defined _NO_BLAS
+  dgemm(n_fpts_per_ele,n_halo_eles*in_n_blocks,n_upts_per_ele,1.0,0.0,in_opp.get_ptr_cpu(),halo_upts_buf.get_ptr_cpu(),halo_fpts_buf.get_ptr_cpu());
+
+#endif
+
+  for (b=0;b<in_n_blocks;b++)
+    for (k=0;k<n_halo_eles;k++)
+      for (i=0;i<n_fpts_per_ele;i++)
+        out_fpts[i+n_fpts_per_ele*(halo_eles(k)+n_eles*b)] = halo_fpts_buf(i,k+n_halo_eles*b);
+}
+
+// cost model of the dense operator products, for the profiler
+
+double eles::op_bytes(int in_rows, int in_cols, int in_n_mats, int in_n_cols)
+{
+  return 8.*in_n_mats*(double)in_n_cols*(in_rows+in_cols);
+}
+
+double eles::op_flops(int in_rows, int in_cols, int in_n_mats, int in_n_cols)
+{
+  return 2.*in_n_mats*(double)in_n_cols*in_rows*in_cols;
+}
+
+// single precision copy of a dense operator
+
+static void copy_opp_sp(array<double>& in_opp, array<float>& out_opp_sp)
+{
+  out_opp_sp.setup(in_opp.get_dim(0),in_opp.get_dim(1));
+  for (int j=0;j<in_opp.get_dim(1);j++)
+    for (int i=0;i<in_opp.get_dim(0);i++)
+      out_opp_sp(i,j) = (float)in_opp(i,j);
+}
+
+void eles::setup_opp_sp(void)
+{
+  if (opp_1_sparse!=0 || opp_2_sparse!=0)
+    FatalError("mixed_precision needs the dense flux operators (sparse_*=0)");
+
+  opp_1_sp.setup(n_dims);
+  opp_2_sp.setup(n_dims);
+  for (int i=0;i<n_dims;i++) {
+    copy_opp_sp(opp_1(i),opp_1_sp(i));
+    copy_opp_sp(opp_2(i),opp_2_sp(i));
+  }
+}
+
+// C = A*B + beta*C with the operator and the flux in single precision. The product of a block of
+// columns is formed in a thread-private buffer that stays in cache and accumulated into C in double
+
+void eles::apply_opp_sp(array<float>& in_opp_sp, int in_n_b_cols, float* in_b, double in_beta, double* inout_c)
+{
+  int n_rows = in_opp_sp.get_dim(0);
+  int n_cols = in_opp_sp.get_dim(1);
+  int n_block = max(1,8192/n_rows);
+  int n_blocks = (in_n_b_cols+n_block-1)/n_block;
+
+#pragma omp parallel
+  {
+    array<float> c_sp(n_rows,n_block);
+
+#pragma omp for schedule(static)
+    for (int k=0;k<n_blocks;k++)
+    {
+      int j_start = k*n_block;
+      int n_j = min(n_block,in_n_b_cols-j_start);
+      float* b = in_b + (long)j_start*n_cols;
+      double* c = inout_c + (long)j_start*n_rows;
+      float* cs = c_sp.get_ptr_cpu();
+
+#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
+      cblas_sgemm(CblasColMajor,CblasNoTrans,CblasNoTrans,n_rows,n_j,n_cols,1.0f,in_opp_sp.get_ptr_cpu(),n_rows,b,n_cols,0.0f,cs,n_rows);
+
+#elif defined _NO_BLAS
+      sgemm(n_rows,n_j,n_cols,1.0f,0.0f,in_opp_sp.get_ptr_cpu(),b,cs);
+
+#endif
+
+      if (in_beta == 0.) {
+        for (int i=0;i<n_rows*n_j;i++)
+          c[i] = cs[i];
+      }
+      else {
+        for (int i=0;i<n_rows*n_j;i++)
+          c[i] = in_beta*c[i] + cs[i];
+      }
+    }
+  }
+}
+
+// calculate the solution at the flux points of the elements on MPI interfaces, so that it can be sent
+// before the interior work. On the GPU all elements are extrapolated here.
+
+void eles::extrapolate_solution_halo(int in_disu_upts_from)
+{
+  if (n_eles!=0) {
+    prof_timer timer(PROF_EXTRAPOLATE_SOLUTION,ele_type,op_bytes(n_fpts_per_ele,n_upts_per_ele,1,n_fields*n_halo_eles),op_flops(n_fpts_per_ele,n_upts_per_ele,1,n_fields*n_halo_eles));
+#ifdef _CPU
+    if (n_halo_eles!=0)
+      extrapolate_halo(opp_0,disu_upts(in_disu_upts_from).get_ptr_cpu(),disu_fpts.get_ptr_cpu(),n_fields);
+#endif
+
+#ifdef _GPU
+    extrapolate_solution(in_disu_upts_from);
+#endif
+  }
+}
+
+// calculate the solution at the flux points of the remaining elements. On the CPU one product over
+// all elements is cheaper than splitting it, the few elements on MPI interfaces get the same values again.
+
+void eles::extrapolate_solution_interior(int in_disu_upts_from)
+{
+#ifdef _CPU
+  extrapolate_solution(in_disu_upts_from);
+#endif
+}
+
 // calculate the transformed discontinuous inviscid flux at the solution points
 
 void eles::evaluate_invFlux(int in_disu_upts_from)
 {
   if (n_eles!=0)
   {
+    prof_timer timer(PROF_EVALUATE_INVFLUX,ele_type,8.*n_upts_per_ele*n_eles*(n_fields*(1+n_dims)+n_dims*n_dims),(double)n_upts_per_ele*n_eles*n_fields*n_dims*(2*n_dims+2));
     
 #ifdef _CPU
     
+    if (kernels.inv_flux != NULL && run_input.mixed_precision)
+    {
+      kernels.inv_flux_sp(n_eles,disu_upts(in_disu_upts_from).get_ptr_cpu(),JGinv_upts.get_ptr_cpu(),tdisf_upts_sp.get_ptr_cpu(),run_input.gamma);
+    }
+    else if (kernels.inv_flux != NULL)
+    {
+      kernels.inv_flux(n_eles,disu_upts(in_disu_upts_from).get_ptr_cpu(),JGinv_upts.get_ptr_cpu(),tdisf_upts.get_ptr_cpu(),run_input.gamma);
+    }
+    else
+    {
+#pragma omp parallel
+    {
     int i,j,k,l,m;
+
+    // thread-private scratch (shadows the shared members of the same name)
+    array<double> temp_u(n_fields), temp_v(n_dims);
+    array<double> temp_f(n_fields,n_dims), temp_f_ref(n_fields,n_dims);
     
+#pragma omp for schedule(static)
     for(i=0;i<n_eles;i++)
     {
       for(j=0;j<n_upts_per_ele;j++)
@@ -1355,8 +1688,6 @@ void eles::evaluate_invFlux(int in_disu_upts_from)
           for (k=0; k<n_dims; k++) {
             temp_v(k) = grid_vel_upts(j,i,k);
           }
-          // Temporary flux vector for dynamic->static transformation
-          temp_f_ref.setup(n_fields,n_dims);
         }else{
           temp_v.initialize_to_zero();
         }
@@ -1400,14 +1731,20 @@ void eles::evaluate_invFlux(int in_disu_upts_from)
         // Transform from static physical space to computational space
         for(k=0;k<n_fields;k++) {
           for(l=0;l<n_dims;l++) {
-            tdisf_upts(j,i,k,l)=0.;
+            double tdisf = 0.;
             for(m=0;m<n_dims;m++) {
-              tdisf_upts(j,i,k,l) += JGinv_upts(l,m,j,i)*temp_f(k,m);//JGinv_upts(j,i,l,m)*temp_f(k,m);
+              tdisf += JGinv_upts(l,m,j,i)*temp_f(k,m);//JGinv_upts(j,i,l,m)*temp_f(k,m);
             }
+            if (run_input.mixed_precision)
+              tdisf_upts_sp(j,i,k,l) = (float)tdisf;
+            else
+              tdisf_upts(j,i,k,l) = tdisf;
           }
         }
       }
     }
+    } // end omp parallel
+    }
     
 #endif
     
@@ -1424,9 +1761,15 @@ void eles::extrapolate_totalFlux()
 {
   if (n_eles!=0)
   {
+    prof_timer timer(PROF_EXTRAPOLATE_FLUX,ele_type,op_bytes(n_fpts_per_ele,n_upts_per_ele,n_dims,n_fields*n_eles),op_flops(n_fpts_per_ele,n_upts_per_ele,n_dims,n_fields*n_eles));
 #ifdef _CPU
     
-    if(opp_1_sparse==0) // dense
+    if(opp_1_sparse==0 && run_input.mixed_precision) // dense, single precision
+    {
+      for (int i=0;i<n_dims;i++)
+        apply_opp_sp(opp_1_sp(i),n_fields*n_eles,tdisf_upts_sp.get_ptr_cpu(0,0,0,i),(i>0),norm_tdisf_fpts.get_ptr_cpu());
+    }
+    else if(opp_1_sparse==0) // dense
     {
 #if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
       
@@ -1456,6 +1799,11 @@ void eles::extrapolate_totalFlux()
       
 #endif
     }
+    else if(opp_1_sparse==2) // sum-factorized tensor product
+    {
+      for (int i=0;i<n_dims;i++)
+        tp_extrapolate(tdisf_upts.get_ptr_cpu(0,0,0,i),norm_tdisf_fpts.get_ptr_cpu(),i,(i>0));
+    }
     else
     {
       cout << "ERROR: Unknown storage for opp_1 ... " << endl;
@@ -1518,9 +1866,15 @@ void eles::calculate_divergence(int in_div_tconf_upts_to)
 {
   if (n_eles!=0)
   {
+    prof_timer timer(PROF_DIVERGENCE,ele_type,op_bytes(n_upts_per_ele,n_upts_per_ele,n_dims,n_fields*n_eles),op_flops(n_upts_per_ele,n_upts_per_ele,n_dims,n_fields*n_eles));
 #ifdef _CPU
     
-    if(opp_2_sparse==0) // dense
+    if(opp_2_sparse==0 && run_input.mixed_precision) // dense, single precision
+    {
+      for (int i=0;i<n_dims;i++)
+        apply_opp_sp(opp_2_sp(i),n_fields*n_eles,tdisf_upts_sp.get_ptr_cpu(0,0,0,i),(i>0),div_tconf_upts(in_div_tconf_upts_to).get_ptr_cpu());
+    }
+    else if(opp_2_sparse==0) // dense
     {
 #if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
       
@@ -1551,6 +1905,11 @@ void eles::calculate_divergence(int in_div_tconf_upts_to)
       
 #endif
     }
+    else if(opp_2_sparse==2) // sum-factorized tensor product
+    {
+      for (int i=0;i<n_dims;i++)
+        tp_derivative(tdisf_upts.get_ptr_cpu(0,0,0,i),div_tconf_upts(in_div_tconf_upts_to).get_ptr_cpu(),i,(i>0));
+    }
     else
     {
       cout << "ERROR: Unknown storage for opp_2 ... " << endl;
@@ -1593,8 +1952,12 @@ void eles::calculate_divergence(int in_div_tconf_upts_to)
 
 void eles::calculate_corrected_divergence(int in_div_tconf_upts_to)
 {
+  // a new residual, the norm of the previous one is out of date
+  res_norm_valid = false;
+  
   if (n_eles!=0)
   {
+    prof_timer timer(PROF_CORRECTED_DIVERGENCE,ele_type,op_bytes(n_upts_per_ele,n_fpts_per_ele,1,n_fields*n_eles),op_flops(n_upts_per_ele,n_fpts_per_ele,1,n_fields*n_eles));
 #ifdef _CPU
     
 #if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
@@ -1626,6 +1989,10 @@ void eles::calculate_corrected_divergence(int in_div_tconf_upts_to)
       
 #endif
     }
+    else if(opp_3_sparse==2) // sum-factorized tensor product
+    {
+      tp_correct(norm_tconf_fpts.get_ptr_cpu(),div_tconf_upts(in_div_tconf_upts_to).get_ptr_cpu(),-1);
+    }
     else
     {
       cout << "ERROR: Unknown storage for opp_3 ... " << endl;
@@ -1668,6 +2035,7 @@ void eles::calculate_gradient(int in_disu_upts_from)
 {
   if (n_eles!=0)
   {
+    prof_timer timer(PROF_CALCULATE_GRADIENT,ele_type,op_bytes(n_upts_per_ele,n_upts_per_ele,n_dims,n_fields*n_eles),op_flops(n_upts_per_ele,n_upts_per_ele,n_dims,n_fields*n_eles));
     
     /*!
      Performs C = (alpha*A*B) + (beta*C) where: \n
@@ -1722,6 +2090,11 @@ void eles::calculate_gradient(int in_disu_upts_from)
       
 #endif
     }
+    else if(opp_4_sparse==2) // sum-factorized tensor product
+    {
+      for (int i=0;i<n_dims;i++)
+        tp_derivative(disu_upts(in_disu_upts_from).get_ptr_cpu(),grad_disu_upts.get_ptr_cpu(0,0,0,i),i,0);
+    }
     else
     {
       cout << "ERROR: Unknown storage for opp_4 ... " << endl;
@@ -1771,6 +2144,7 @@ void eles::correct_gradient(void)
 {
   if (n_eles!=0)
   {
+    prof_timer timer(PROF_CORRECT_GRADIENT,ele_type,op_bytes(n_upts_per_ele,n_fpts_per_ele,n_dims,n_fields*n_eles),op_flops(n_upts_per_ele,n_fpts_per_ele,n_dims,n_fields*n_eles));
     Arows =  n_upts_per_ele;
     Acols = n_fpts_per_ele;
     
@@ -1807,6 +2181,11 @@ void eles::correct_gradient(void)
       
 #endif
     }
+    else if(opp_5_sparse==2) // sum-factorized tensor product
+    {
+      for (int i=0;i<n_dims;i++)
+        tp_correct(delta_disu_fpts.get_ptr_cpu(),grad_disu_upts.get_ptr_cpu(0,0,0,i),i);
+    }
     else
     {
       cout << "ERROR: Unknown storage for opp_5 ... " << endl;
@@ -1819,6 +2198,12 @@ void eles::correct_gradient(void)
     double Xx,Xy,Xz,Yx,Yy,Yz,Zx,Zy,Zz;
     double ur,us,ut,uX,uY,uZ;
     
+    if (kernels.transform_grad != NULL)
+    {
+      kernels.transform_grad(n_eles,n_fields,grad_disu_upts.get_ptr_cpu(),JGinv_upts.get_ptr_cpu(),inv_detjac_upts.get_ptr_cpu());
+    }
+    else
+    {
     for (int i=0;i<n_eles;i++)
     {
       for (int j=0;j<n_upts_per_ele;j++)
@@ -1910,6 +2295,7 @@ void eles::correct_gradient(void)
         }
       }
     }
+    }
     
 #endif
     
@@ -1974,6 +2360,7 @@ void eles::extrapolate_corrected_gradient(void)
 {
   if (n_eles!=0)
   {
+    prof_timer timer(PROF_EXTRAPOLATE_GRADIENT,ele_type,op_bytes(n_fpts_per_ele,n_upts_per_ele,n_dims,n_fields*n_eles),op_flops(n_fpts_per_ele,n_upts_per_ele,n_dims,n_fields*n_eles));
     Arows =  n_fpts_per_ele;
     Acols = n_upts_per_ele;
     
@@ -2009,6 +2396,11 @@ void eles::extrapolate_corrected_gradient(void)
       
 #endif
     }
+    else if(opp_6_sparse==2) // sum-factorized tensor product
+    {
+      for (int i=0;i<n_dims;i++)
+        tp_extrapolate(grad_disu_upts.get_ptr_cpu(0,0,0,i),grad_disu_fpts.get_ptr_cpu(0,0,0,i),-1,0);
+    }
     else
     {
       cout << "ERROR: Unknown storage for opp_6 ... " << endl;
@@ -2051,6 +2443,32 @@ void eles::extrapolate_corrected_gradient(void)
    */
 }
 
+// calculate the corrected gradient at the flux points of the elements on MPI interfaces (all elements on the GPU)
+
+void eles::extrapolate_corrected_gradient_halo(void)
+{
+  if (n_eles!=0) {
+    prof_timer timer(PROF_EXTRAPOLATE_GRADIENT,ele_type,op_bytes(n_fpts_per_ele,n_upts_per_ele,n_dims,n_fields*n_halo_eles),op_flops(n_fpts_per_ele,n_upts_per_ele,n_dims,n_fields*n_halo_eles));
+#ifdef _CPU
+    if (n_halo_eles!=0)
+      extrapolate_halo(opp_6,grad_disu_upts.get_ptr_cpu(),grad_disu_fpts.get_ptr_cpu(),n_fields*n_dims);
+#endif
+
+#ifdef _GPU
+    extrapolate_corrected_gradient();
+#endif
+  }
+}
+
+// calculate the corrected gradient at the flux points of the remaining elements
+
+void eles::extrapolate_corrected_gradient_interior(void)
+{
+#ifdef _CPU
+  extrapolate_corrected_gradient();
+#endif
+}
+
 /*! If at first RK step and using certain LES models, compute some model-related quantities.
  If using similarity or WALE-similarity (WSM) models, compute filtered solution and Leonard tensors.
  If using spectral vanishing viscosity (SVV) model, compute filtered solution. */
@@ -2322,11 +2740,20 @@ void eles::evaluate_viscFlux(int in_disu_upts_from)
 {
   if (n_eles!=0)
   {
+    prof_timer timer(PROF_EVALUATE_VISCFLUX,ele_type,8.*n_upts_per_ele*n_eles*(n_fields*(1+2*n_dims)+n_dims*n_dims));
 #ifdef _CPU
     
+#pragma omp parallel
+    {
     int i,j,k,l,m;
     double detjac;
 
+    // thread-private scratch (shadows the shared members of the same name)
+    array<double> temp_u(n_fields), temp_grad_u(n_fields,n_dims);
+    array<double> temp_f(n_fields,n_dims), temp_f_ref(n_fields,n_dims);
+    array<double> temp_sgsf(n_fields,n_dims), temp_sgsf_ref(n_fields,n_dims);
+
+#pragma omp for schedule(static)
     for(i=0;i<n_eles;i++) {
       
       // Calculate viscous flux
@@ -2433,14 +2860,25 @@ void eles::evaluate_viscFlux(int in_disu_upts_from)
         {
           for(l=0;l<n_dims;l++)
           {
-            for(m=0;m<n_dims;m++)
+            if (run_input.mixed_precision)
+            {
+              double tdisf = 0.;
+              for(m=0;m<n_dims;m++)
+                tdisf+=JGinv_upts(l,m,j,i)*temp_f(k,m);
+              tdisf_upts_sp(j,i,k,l) += (float)tdisf;
+            }
+            else
             {
-              tdisf_upts(j,i,k,l)+=JGinv_upts(l,m,j,i)*temp_f(k,m);
+              for(m=0;m<n_dims;m++)
+              {
+                tdisf_upts(j,i,k,l)+=JGinv_upts(l,m,j,i)*temp_f(k,m);
+              }
             }
           }
         }
       }
     }
+    } // end omp parallel
 #endif
     
 #ifdef _GPU
@@ -2785,8 +3223,14 @@ void eles::calc_src_upts_SA(int in_disu_upts_from)
   {
 #ifdef _CPU
 
-    int i,j,k,l,m;
+#pragma omp parallel
+    {
+    int i,j,k,m;
 
+    // thread-private scratch (shadows the shared members of the same name)
+    array<double> temp_u(n_fields), temp_grad_u(n_fields,n_dims);
+
+#pragma omp for schedule(static)
     for(i=0; i<n_eles; i++) {
       for(j=0; j<n_upts_per_ele; j++) {
 
@@ -2811,6 +3255,7 @@ void eles::calc_src_upts_SA(int in_disu_upts_from)
           cout << "ERROR: Invalid number of dimensions ... " << endl;
       }
     }
+    } // end omp parallel
 
 #endif
 
@@ -2823,217 +3268,52 @@ void eles::calc_src_upts_SA(int in_disu_upts_from)
 
 
 /*! If using a RANS or LES near-wall model, calculate distance
- of each solution point to nearest no-slip wall by a brute-force method */
+ of each solution point to nearest no-slip wall flux point using a k-d tree */
 
-void eles::calc_wall_distance(int n_seg_noslip_inters, int n_tri_noslip_inters, int n_quad_noslip_inters, array< array<double> > loc_noslip_bdy)
+void eles::calc_wall_distance(kdtree& in_wall_tree)
 {
   if(n_eles!=0)
   {
-    int i,j,k,m,n,p;
-    int n_fpts_per_inter_seg = order+1;
-    int n_fpts_per_inter_tri = (order+2)*(order+1)/2;
-    int n_fpts_per_inter_quad = (order+1)*(order+1);
-    double dist;
-    double distmin;
-    array<double> pos(n_dims);
-    array<double> pos_bdy(n_dims);
-    array<double> vec(n_dims);
-    array<double> vecmin(n_dims);
-    
-    // hold our breath and go round the brute-force loop...
-    for (i=0;i<n_eles;++i) {
-      for (j=0;j<n_upts_per_ele;++j) {
-        
+#pragma omp parallel for
+    for (int i=0;i<n_eles;++i) {
+      array<double> pos(n_dims);
+      array<double> vec(n_dims);
+
+      for (int j=0;j<n_upts_per_ele;++j) {
+
         // get coords of current solution point
         calc_pos_upt(j,i,pos);
-        
-        // initialize wall distance
-        distmin = 1e20;
-        
-        // line segment boundaries
-        for (k=0;k<n_seg_noslip_inters;++k) {
-          
-          for (m=0;m<n_fpts_per_inter_seg;++m) {
-            
-            dist = 0.0;
-            // get coords of boundary flux point
-            for (n=0;n<n_dims;++n) {
-              pos_bdy(n) = loc_noslip_bdy(0)(m,k,n);
-              vec(n) = pos(n) - pos_bdy(n);
-              dist += vec(n)*vec(n);
-            }
-            dist = sqrt(dist);
-            
-            // update shortest vector
-            if (dist < distmin) {
-              for (n=0;n<n_dims;++n) vecmin(n) = vec(n);
-              distmin = dist;
-            }
-          }
-        }
-        
-        // tri boundaries
-        for (k=0;k<n_tri_noslip_inters;++k) {
-          
-          for (m=0;m<n_fpts_per_inter_tri;++m) {
-            
-            dist = 0.0;
-            // get coords of boundary flux point
-            for (n=0;n<n_dims;++n) {
-              pos_bdy(n) = loc_noslip_bdy(1)(m,k,n);
-              vec(n) = pos(n) - pos_bdy(n);
-              dist += vec(n)*vec(n);
-            }
-            dist = sqrt(dist);
-            
-            // update shortest vector
-            if (dist < distmin) {
-              for (n=0;n<n_dims;++n) vecmin(n) = vec(n);
-              distmin = dist;
-            }
-          }
+
+        double dist2 = 1e40;
+        int pt = in_wall_tree.nearest(pos.get_ptr_cpu(),dist2);
+
+        if (pt<0) {
+          // no wall points at all
+          zero_array(vec);
+          dist2 = 1e40;
         }
-        
-        // quad boundaries
-        for (k=0;k<n_quad_noslip_inters;++k) {
-          
-          for (m=0;m<n_fpts_per_inter_quad;++m) {
-            
-            dist = 0.0;
-            // get coords of boundary flux point
-            for (n=0;n<n_dims;++n) {
-              pos_bdy(n) = loc_noslip_bdy(2)(m,k,n);
-              vec(n) = pos(n) - pos_bdy(n);
-              dist += vec(n)*vec(n);
-            }
-            dist = sqrt(dist);
-            
-            // update shortest vector
-            if (dist < distmin) {
-              for (n=0;n<n_dims;++n) vecmin(n) = vec(n);
-              distmin = dist;
-            }
-          }
+        else {
+          double* pos_bdy = in_wall_tree.get_pt(pt);
+          for (int n=0;n<n_dims;++n) vec(n) = pos(n) - pos_bdy[n];
         }
-        for (n=0;n<n_dims;++n) wall_distance(j,i,n) = vecmin(n);
 
-        if (run_input.turb_model > 0) {
-          wall_distance_mag(j,i) = distmin;
-        }
+        set_wall_distance(j,i,vec,sqrt(dist2));
       }
     }
   }
 }
 
-#ifdef _MPI
+// store the vector from the nearest wall point to a solution point
 
-void eles::calc_wall_distance_parallel(array<int> n_seg_inters_array, array<int> n_tri_inters_array, array<int> n_quad_inters_array, array< array<double> > loc_noslip_bdy_global, int nproc)
+void eles::set_wall_distance(int in_upt, int in_ele, array<double>& in_vec, double in_dist)
 {
-  if(n_eles!=0)
-  {
-    int i,j,k,m,n,p;
-    int n_fpts_per_inter_seg = order+1;
-    int n_fpts_per_inter_tri = (order+2)*(order+1)/2;
-    int n_fpts_per_inter_quad = (order+1)*(order+1);
-    double dist;
-    double distmin;
-    array<double> pos(n_dims);
-    array<double> pos_bdy(n_dims);
-    array<double> vec(n_dims);
-    array<double> vecmin(n_dims);
-    
-    // hold our breath and go round the brute-force loop...
-    for (i=0;i<n_eles;++i) {
-      for (j=0;j<n_upts_per_ele;++j) {
-        
-        // get coords of current solution point
-        calc_pos_upt(j,i,pos);
-        
-        // initialize wall distance
-        distmin = 1e20;
-        
-        // loop over all partitions
-        for (p=0;p<nproc;++p) {
-          
-          // line segment boundaries
-          for (k=0;k<n_seg_inters_array(p);++k) {
-            
-            for (m=0;m<n_fpts_per_inter_seg;++m) {
-              
-              dist = 0.0;
-              // get coords of boundary flux point
-              for (n=0;n<n_dims;++n) {
-                pos_bdy(n) = loc_noslip_bdy_global(0)(m,k,p*n_dims+n);
-                vec(n) = pos(n) - pos_bdy(n);
-                dist += vec(n)*vec(n);
-              }
-              dist = sqrt(dist);
-              
-              // update shortest vector
-              if (dist < distmin) {
-                for (n=0;n<n_dims;++n) vecmin(n) = vec(n);
-                distmin = dist;
-              }
-            }
-          }
-          
-          // tri boundaries
-          for (k=0;k<n_tri_inters_array(p);++k) {
-            
-            for (m=0;m<n_fpts_per_inter_tri;++m) {
-              
-              dist = 0.0;
-              // get coords of boundary flux point
-              for (n=0;n<n_dims;++n) {
-                pos_bdy(n) = loc_noslip_bdy_global(1)(m,k,p*n_dims+n);
-                vec(n) = pos(n) - pos_bdy(n);
-                dist += vec(n)*vec(n);
-              }
-              dist = sqrt(dist);
-              
-              // update shortest vector
-              if (dist < distmin) {
-                for (n=0;n<n_dims;++n) vecmin(n) = vec(n);
-                distmin = dist;
-              }
-            }
-          }
-          
-          // quad boundaries
-          for (k=0;k<n_quad_inters_array(p);++k) {
-            
-            for (m=0;m<n_fpts_per_inter_quad;++m) {
-              
-              dist = 0.0;
-              // get coords of boundary flux point
-              for (n=0;n<n_dims;++n) {
-                pos_bdy(n) = loc_noslip_bdy_global(2)(m,k,p*n_dims+n);
-                vec(n) = pos(n) - pos_bdy(n);
-                dist += vec(n)*vec(n);
-              }
-              dist = sqrt(dist);
-              
-              // update shortest vector
-              if (dist < distmin) {
-                for (n=0;n<n_dims;++n) vecmin(n) = vec(n);
-                distmin = dist;
-              }
-            }
-          }
-        }
-        
-        for (n=0;n<n_dims;++n) wall_distance(j,i,n) = vecmin(n);
+  for (int n=0;n<n_dims;++n) wall_distance(in_upt,in_ele,n) = in_vec(n);
 
-        if (run_input.turb_model > 0) {
-          wall_distance_mag(j,i) = distmin;
-        }
-      }
-    }
+  if (run_input.turb_model > 0) {
+    wall_distance_mag(in_upt,in_ele) = in_dist;
   }
 }
 
-#endif
-
 array<double> eles::calc_rotation_matrix(array<double>& norm)
 {
   array <double> mrot(n_dims,n_dims);
@@ -3341,6 +3621,11 @@ void eles::evaluate_sgsFlux(void)
       
 #endif
     }
+    else if(opp_0_sparse==2) // sum-factorized tensor product
+    {
+      for (int i=0;i<n_dims;i++)
+        tp_extrapolate(sgsf_upts.get_ptr_cpu(0,0,0,i),sgsf_fpts.get_ptr_cpu(0,0,0,i),-1,0);
+    }
     else { cout << "ERROR: Unknown storage for opp_0 ... " << endl; }
     
 #endif
@@ -3558,19 +3843,236 @@ int eles::get_n_fields(void)
   return n_fields;
 }
 
-// get number of solutions points per element
+// get CPU pointer to the solution at the solution points
 
-int eles::get_n_upts_per_ele(void)
+double* eles::get_disu_upts_ptr_cpu(void)
 {
-  return n_upts_per_ele;
+  return disu_upts(0).get_ptr_cpu();
 }
 
-// set the shape array
-void eles::set_shape(int in_max_n_spts_per_ele)
+// get du/dt at the solution points from the last residual
+
+void eles::get_dudt_upts(double* out_dudt)
 {
-  shape.setup(n_dims,in_max_n_spts_per_ele,n_eles);
-  shape_dyn.setup(n_dims,in_max_n_spts_per_ele,n_eles,5);
-  //shape_dyn_old.setup(n_dims,in_max_n_spts_per_ele,n_eles,4);
+  for (int i=0;i<n_fields;i++)
+  {
+#pragma omp parallel for schedule(static)
+    for (int ic=0;ic<n_eles;ic++)
+    {
+      for (int inp=0;inp<n_upts_per_ele;inp++)
+      {
+        out_dudt[inp+n_upts_per_ele*(ic+n_eles*i)] = -div_tconf_upts(0)(inp,ic,i)/detjac_upts(inp,ic) + run_input.const_src + src_upts(inp,ic,i);
+      }
+    }
+  }
+}
+
+// add a source to du/dt of the last residual (through the divergence, so both time integrators see it)
+
+void eles::add_dudt_forcing(double* in_forcing)
+{
+  for (int i=0;i<n_fields;i++)
+  {
+#pragma omp parallel for schedule(static)
+    for (int ic=0;ic<n_eles;ic++)
+    {
+      for (int inp=0;inp<n_upts_per_ele;inp++)
+      {
+        div_tconf_upts(0)(inp,ic,i) -= detjac_upts(inp,ic)*in_forcing[inp+n_upts_per_ele*(ic+n_eles*i)];
+      }
+    }
+  }
+}
+
+// sum over the solution points of the squared error estimate of the last
+// adaptive RK step, scaled by the tolerances
+
+void eles::calc_rk_error(double& out_sum, double& out_n_vals)
+{
+  if (n_eles!=0)
+  {
+    double sum = 0.;
+
+    for (int i=0;i<n_fields;i++)
+    {
+#pragma omp parallel for schedule(static) reduction(+:sum)
+      for (int ic=0;ic<n_eles;ic++)
+      {
+        for (int inp=0;inp<n_upts_per_ele;inp++)
+        {
+          double scale = run_input.rk_atol + run_input.rk_rtol*max(fabs(disu_upts(0)(inp,ic,i)),fabs(disu_upts(3)(inp,ic,i)));
+          double err = disu_upts(2)(inp,ic,i)/scale;
+          sum += err*err;
+        }
+      }
+    }
+
+    out_sum += sum;
+    out_n_vals += n_upts_per_ele*n_eles*n_fields;
+  }
+}
+
+// go back to the solution at the start of a rejected adaptive RK step
+
+void eles::reject_rk_step(void)
+{
+  if (n_eles!=0)
+  {
+    int n_vals = n_upts_per_ele*n_eles*n_fields;
+    double* u = disu_upts(0).get_ptr_cpu();
+    double* u_start = disu_upts(3).get_ptr_cpu();
+
+    for (int i=0;i<n_vals;i++)
+      u[i] = u_start[i];
+  }
+}
+
+// set the colour of an element
+
+void eles::set_color(int in_ele, int in_color)
+{
+  color(in_ele) = in_color;
+}
+
+// get the colour of an element
+
+int eles::get_color(int in_ele)
+{
+  return color(in_ele);
+}
+
+// set the local time stepping level of the elements
+
+void eles::set_lts_level(int in_level)
+{
+  lts_level = in_level;
+}
+
+// get the local time stepping level of the elements
+
+int eles::get_lts_level(void)
+{
+  return lts_level;
+}
+
+// flag a face whose neighbour is on the next finer local time stepping level
+
+void eles::set_lts_fine_face(int in_ele, int in_inter)
+{
+  lts_fine_face(in_ele,in_inter) = 1;
+}
+
+// list the flux points of the flagged faces and allocate their flux integrals
+
+void eles::setup_lts(void)
+{
+  n_lts_fpts = 0;
+  if (n_eles==0) return;
+
+  for (int i=0;i<n_eles;i++)
+    for (int j=0;j<n_inters_per_ele;j++)
+      if (lts_fine_face(i,j))
+        n_lts_fpts += n_fpts_per_inter(j);
+
+  if (n_lts_fpts==0) return;
+
+  lts_fpts.setup(2,n_lts_fpts);
+  lts_flux.setup(n_lts_fpts,n_fields,2);
+  lts_flux.initialize_to_zero();
+
+  int count = 0;
+  for (int i=0;i<n_eles;i++) {
+    int fpt = 0;
+    for (int j=0;j<n_inters_per_ele;j++) {
+      for (int k=0;k<n_fpts_per_inter(j);k++) {
+        if (lts_fine_face(i,j)) {
+          lts_fpts(0,count) = fpt;
+          lts_fpts(1,count) = i;
+          count++;
+        }
+        fpt++;
+      }
+    }
+  }
+}
+
+// weight of the residual of stage in_step in the solution after a step of one unit
+// (the low-storage register of stage s is a_s times the previous one plus the residual)
+
+double eles::get_rk_weight(int in_step, int adv_type)
+{
+  if (adv_type==0)
+    return 1.;
+
+  int n_stages = RK_a.get_dim(0);
+  double w = 0., a = 1.;
+  for (int s=in_step;s<n_stages;s++) {
+    if (s>in_step) a *= RK_a(s);
+    w += RK_b(s)*a;
+  }
+  return w;
+}
+
+// add in_weight times the common normal flux at the flagged faces to one of the flux integrals
+
+void eles::accumulate_lts_flux(int in_own, double in_weight)
+{
+#ifdef _CPU
+  for (int k=0;k<n_fields;k++)
+    for (int i=0;i<n_lts_fpts;i++) {
+      int fpt = lts_fpts(0,i);
+      int ele = lts_fpts(1,i);
+
+      // on its own level the corrected divergence has left the jump to the discontinuous flux
+      if (in_own)
+        lts_flux(i,k,0) += in_weight*(norm_tconf_fpts(fpt,ele,k) + norm_tdisf_fpts(fpt,ele,k));
+      else
+        lts_flux(i,k,1) += in_weight*norm_tconf_fpts(fpt,ele,k);
+    }
+#endif
+}
+
+// correct the solution by the difference between the flux integrals at the flagged faces,
+// through the same correction functions as the corrected divergence
+
+void eles::reflux_lts(void)
+{
+#ifdef _CPU
+  for (int k=0;k<n_fields;k++)
+    for (int i=0;i<n_lts_fpts;i++) {
+      int fpt = lts_fpts(0,i);
+      int ele = lts_fpts(1,i);
+      double diff = lts_flux(i,k,1) - lts_flux(i,k,0);
+
+      for (int j=0;j<n_upts_per_ele;j++)
+        disu_upts(0)(j,ele,k) -= opp_3(j,fpt)*diff/detjac_upts(j,ele);
+
+      lts_flux(i,k,0) = 0.;
+      lts_flux(i,k,1) = 0.;
+    }
+#endif
+}
+
+// get number of solutions points per element
+
+int eles::get_n_upts_per_ele(void)
+{
+  return n_upts_per_ele;
+}
+
+// get number of flux points per element
+
+int eles::get_n_fpts_per_ele(void)
+{
+  return n_fpts_per_ele;
+}
+
+// set the shape array
+void eles::set_shape(int in_max_n_spts_per_ele)
+{
+  shape.setup(n_dims,in_max_n_spts_per_ele,n_eles);
+  shape_dyn.setup(n_dims,in_max_n_spts_per_ele,n_eles,5);
+  //shape_dyn_old.setup(n_dims,in_max_n_spts_per_ele,n_eles,4);
   n_spts_per_ele.setup(n_eles);
 }
 
@@ -3628,6 +4130,13 @@ void eles::set_ele2global_ele(int in_ele, int in_global_ele)
   ele2global_ele(in_ele) = in_global_ele;
 }
 
+// get global element number
+
+int eles::get_ele2global_ele(int in_ele)
+{
+  return ele2global_ele(in_ele);
+}
+
 
 // set opp_0 (transformed discontinuous solution at solution points to transformed discontinuous solution at flux points)
 
@@ -3680,6 +4189,10 @@ void eles::set_opp_0(int in_sparse)
 #endif
     
   }
+  else if(in_sparse==2)
+  {
+    opp_0_sparse=2;
+  }
   else
   {
     cout << "ERROR: Invalid sparse matrix form ... " << endl;
@@ -3752,6 +4265,10 @@ void eles::set_opp_1(int in_sparse)
 #endif
     
   }
+  else if(in_sparse==2)
+  {
+    opp_1_sparse=2;
+  }
   else
   {
     cout << "ERROR: Invalid sparse matrix form ... " << endl;
@@ -3829,6 +4346,10 @@ void eles::set_opp_2(int in_sparse)
     }
 #endif
   }
+  else if(in_sparse==2)
+  {
+    opp_2_sparse=2;
+  }
   else
   {
     cout << "ERROR: Invalid sparse matrix form ... " << endl;
@@ -3870,6 +4391,13 @@ void eles::set_opp_3(int in_sparse)
     opp_3_ell_indices.cp_cpu_gpu();
 #endif
   }
+  else if(in_sparse==2)
+  {
+    opp_3_sparse=2;
+    
+    // the 1-D factors are built here, once opp_3 (and so the correction function) is known
+    set_opp_tensor_product();
+  }
   else
   {
     cout << "ERROR: Invalid sparse matrix form ... " << endl;
@@ -3935,6 +4463,10 @@ void eles::set_opp_4(int in_sparse)
     }
 #endif
   }
+  else if(in_sparse==2)
+  {
+    opp_4_sparse=2;
+  }
   else
   {
     cout << "ERROR: Invalid sparse matrix form ... " << endl;
@@ -4005,6 +4537,10 @@ void eles::set_opp_5(int in_sparse)
     }
 #endif
   }
+  else if(in_sparse==2)
+  {
+    opp_5_sparse=2;
+  }
   else
   {
     cout << "ERROR: Invalid sparse matrix form ... " << endl;
@@ -4059,12 +4595,244 @@ void eles::set_opp_6(int in_sparse)
 #endif
     
   }
+  else if(in_sparse==2)
+  {
+    opp_6_sparse=2;
+  }
   else
   {
     cout << "ERROR: Invalid sparse matrix form ... " << endl;
   }
 }
 
+// set the 1-D factors of the solution point operators for tensor-product elements (quads and hexas),
+// so that opp_0 to opp_6 can be applied line by line (sum factorization) rather than as dense matrices
+
+void eles::set_opp_tensor_product(void)
+{
+  int i,j,k,l,m;
+  int upt,idx;
+  double max_nrm;
+  
+#ifdef _GPU
+  FatalError("Tensor-product operators (sparse=2) are only implemented on the CPU");
+#endif
+  
+  if(ele_type!=1 && ele_type!=4)
+    FatalError("Tensor-product operators (sparse=2) are only available for quads and hexas");
+  
+  n_upts_1d = order+1;
+  
+  // 1-D solution points, recovered from the (x-fastest) tensor-product ordering of loc_upts
+  
+  loc_1d_upts_tp.setup(n_upts_1d);
+  for(i=0;i<n_upts_1d;i++)
+    loc_1d_upts_tp(i)=loc_upts(0,i);
+  
+  tp_upt_stride.setup(n_dims);
+  tp_upt_stride(0)=1;
+  for(i=1;i<n_dims;i++)
+    tp_upt_stride(i)=tp_upt_stride(i-1)*n_upts_1d;
+  
+  // index of each solution point along each reference direction, and the first point of its line
+  
+  tp_upt_idx.setup(n_upts_per_ele,n_dims);
+  tp_upt_base.setup(n_upts_per_ele,n_dims);
+  
+  for(i=0;i<n_upts_per_ele;i++)
+  {
+    for(j=0;j<n_dims;j++)
+    {
+      idx=(i/tp_upt_stride(j))%n_upts_1d;
+      
+      if(loc_upts(j,i)!=loc_1d_upts_tp(idx))
+        FatalError("Solution points are not a tensor product of 1-D points");
+      
+      tp_upt_idx(i,j)=idx;
+      tp_upt_base(i,j)=i-idx*tp_upt_stride(j);
+    }
+  }
+  
+  // each flux point lies at the end of the line of solution points normal to its face
+  
+  tp_fpt_side.setup(n_fpts_per_ele);
+  tp_fpt_base.setup(n_fpts_per_ele);
+  tp_fpt_stride.setup(n_fpts_per_ele);
+  
+  for(i=0;i<n_fpts_per_ele;i++)
+  {
+    m=0;
+    max_nrm=0.;
+    for(j=0;j<n_dims;j++)
+    {
+      if(fabs(tnorm_fpts(j,i))>max_nrm)
+      {
+        max_nrm=fabs(tnorm_fpts(j,i));
+        m=j;
+      }
+    }
+    
+    tp_fpt_side(i)=(tnorm_fpts(m,i)>0.) ? 1 : 0;
+    
+    upt=0;
+    for(j=0;j<n_dims;j++)
+    {
+      if(j==m)
+        continue;
+      
+      idx=-1;
+      for(k=0;k<n_upts_1d;k++)
+        if(tloc_fpts(j,i)==loc_1d_upts_tp(k))
+          idx=k;
+      
+      if(idx<0)
+        FatalError("Flux points are not aligned with the 1-D solution points");
+      
+      upt+=idx*tp_upt_stride(j);
+    }
+    
+    tp_fpt_base(i)=upt;
+    tp_fpt_stride(i)=tp_upt_stride(m);
+  }
+  
+  // values of the 1-D nodal basis at the ends of the standard interval, indexing: (in_upt_1d, in_side)
+  
+  opp_tp_interp.setup(n_upts_1d,2);
+  for(i=0;i<n_upts_1d;i++)
+  {
+    opp_tp_interp(i,0)=eval_lagrange(-1.0,i,loc_1d_upts_tp);
+    opp_tp_interp(i,1)=eval_lagrange( 1.0,i,loc_1d_upts_tp);
+  }
+  
+  // derivative of the 1-D nodal basis at the 1-D solution points, indexing: (in_upt_1d_from, in_upt_1d_to)
+  
+  opp_tp_grad.setup(n_upts_1d,n_upts_1d);
+  for(i=0;i<n_upts_1d;i++)
+    for(j=0;j<n_upts_1d;j++)
+      opp_tp_grad(j,i)=eval_d_lagrange(loc_1d_upts_tp(i),j,loc_1d_upts_tp);
+  
+  // the correction function depends on the scheme (VCJH, OFR, OESFR), so rather than re-deriving it
+  // the 1-D correction is read off the lines of opp_3, after checking opp_3 is zero elsewhere
+  
+  opp_tp_corr.setup(n_upts_1d,n_fpts_per_ele);
+  
+  for(i=0;i<n_fpts_per_ele;i++)
+  {
+    max_nrm=0.;
+    for(j=0;j<n_upts_per_ele;j++)
+      max_nrm+=fabs(opp_3(j,i));
+    
+    for(l=0;l<n_upts_1d;l++)
+    {
+      upt=tp_fpt_base(i)+l*tp_fpt_stride(i);
+      opp_tp_corr(l,i)=opp_3(upt,i);
+      max_nrm-=fabs(opp_3(upt,i));
+    }
+    
+    if(max_nrm>1.e-12)
+      FatalError("Correction operator is not of tensor-product form");
+  }
+}
+
+// apply the tensor-product form of opp_0/opp_1/opp_6 (solution points to flux points);
+// if in_dim>=0 the result is scaled by the in_dim component of the transformed normal (opp_1)
+
+void eles::tp_extrapolate(double* in_upts, double* out_fpts, int in_dim, int in_add)
+{
+  int n_cols = n_fields*n_eles;
+  
+#pragma omp parallel for schedule(static)
+  for(int c=0;c<n_cols;c++)
+  {
+    double* u = in_upts + c*n_upts_per_ele;
+    double* f = out_fpts + c*n_fpts_per_ele;
+    
+    for(int j=0;j<n_fpts_per_ele;j++)
+    {
+      double w = (in_dim<0) ? 1.0 : tnorm_fpts(in_dim,j);
+      double sum = 0.;
+      
+      if(w!=0.)
+      {
+        double* l = opp_tp_interp.get_ptr_cpu(0,tp_fpt_side(j));
+        int upt = tp_fpt_base(j);
+        int stride = tp_fpt_stride(j);
+        
+        for(int k=0;k<n_upts_1d;k++)
+          sum += l[k]*u[upt+k*stride];
+        
+        sum *= w;
+      }
+      
+      if(in_add)
+        f[j] += sum;
+      else
+        f[j] = sum;
+    }
+  }
+}
+
+// apply the tensor-product form of opp_2/opp_4 (derivative in reference direction in_dim at the solution points)
+
+void eles::tp_derivative(double* in_upts, double* out_upts, int in_dim, int in_add)
+{
+  int n_cols = n_fields*n_eles;
+  int stride = tp_upt_stride(in_dim);
+  
+#pragma omp parallel for schedule(static)
+  for(int c=0;c<n_cols;c++)
+  {
+    double* u = in_upts + c*n_upts_per_ele;
+    double* du = out_upts + c*n_upts_per_ele;
+    
+    for(int j=0;j<n_upts_per_ele;j++)
+    {
+      double* d = opp_tp_grad.get_ptr_cpu(0,tp_upt_idx(j,in_dim));
+      int upt = tp_upt_base(j,in_dim);
+      double sum = 0.;
+      
+      for(int k=0;k<n_upts_1d;k++)
+        sum += d[k]*u[upt+k*stride];
+      
+      if(in_add)
+        du[j] += sum;
+      else
+        du[j] = sum;
+    }
+  }
+}
+
+// apply the tensor-product form of opp_3/opp_5 (flux point corrections added to the solution points);
+// if in_dim>=0 the correction is scaled by the in_dim component of the transformed normal (opp_5)
+
+void eles::tp_correct(double* in_fpts, double* out_upts, int in_dim)
+{
+  int n_cols = n_fields*n_eles;
+  
+#pragma omp parallel for schedule(static)
+  for(int c=0;c<n_cols;c++)
+  {
+    double* f = in_fpts + c*n_fpts_per_ele;
+    double* u = out_upts + c*n_upts_per_ele;
+    
+    for(int j=0;j<n_fpts_per_ele;j++)
+    {
+      double w = (in_dim<0) ? 1.0 : tnorm_fpts(in_dim,j);
+      
+      if(w==0.)
+        continue;
+      
+      double val = w*f[j];
+      double* g = opp_tp_corr.get_ptr_cpu(0,j);
+      int upt = tp_fpt_base(j);
+      int stride = tp_fpt_stride(j);
+      
+      for(int k=0;k<n_upts_1d;k++)
+        u[upt+k*stride] += g[k]*val;
+    }
+  }
+}
+
 // set opp_p (solution at solution points to solution at plot points)
 
 void eles::set_opp_p(void)
@@ -4194,6 +4962,46 @@ void eles::calc_pos_ppts(int in_ele, array<double>& out_pos_ppts)
   }
 }
 
+// allocate snapshots of the fields read by the output routines
+
+void eles::setup_output_slots(int in_n_slots)
+{
+  disu_upts_out.setup(in_n_slots);
+  grad_disu_upts_out.setup(in_n_slots);
+  disu_average_upts_out.setup(in_n_slots);
+  epsilon_upts_out.setup(in_n_slots);
+  sensor_out.setup(in_n_slots);
+}
+
+// copy the fields read by the output routines into a snapshot
+
+void eles::stage_output(int in_slot)
+{
+  if (n_eles!=0)
+  {
+    disu_upts_out(in_slot) = disu_upts(0);
+
+    if (run_input.n_diagnostic_fields > 0)
+      grad_disu_upts_out(in_slot) = grad_disu_upts;
+
+    if (n_average_fields > 0)
+      disu_average_upts_out(in_slot) = disu_average_upts;
+
+    if (run_input.ArtifOn) {
+      sensor_out(in_slot) = sensor;
+      if (run_input.artif_type == 0)
+        epsilon_upts_out(in_slot) = epsilon_upts;
+    }
+  }
+}
+
+// select the snapshot read by the output routines
+
+void eles::set_output_slot(int in_slot)
+{
+  output_slot = in_slot;
+}
+
 // calculate solution at the plot points
 void eles::calc_disu_ppts(int in_ele, array<double>& out_disu_ppts)
 {
@@ -4202,6 +5010,8 @@ void eles::calc_disu_ppts(int in_ele, array<double>& out_disu_ppts)
     
     int i,j,k;
     
+    array<double>& disu_out = (output_slot<0) ? disu_upts(0) : disu_upts_out(output_slot);
+    
     array<double> disu_upts_plot(n_upts_per_ele,n_fields);
     
     for(i=0;i<n_fields;i++)
@@ -4209,11 +5019,11 @@ void eles::calc_disu_ppts(int in_ele, array<double>& out_disu_ppts)
       for(j=0;j<n_upts_per_ele;j++)
       {
         if (motion) {
-          disu_upts_plot(j,i)=disu_upts(0)(j,in_ele,i)/J_dyn_upts(j,in_ele);
+          disu_upts_plot(j,i)=disu_out(j,in_ele,i)/J_dyn_upts(j,in_ele);
           //disu_upts_plot(j,i)=1/J_dyn_upts(j,in_ele);
           //cout << in_ele << "," << j << "," << i << ": " << disu_upts(0)(j,in_ele,i) << ", " << J_dyn_upts(j,in_ele) << endl;
         }else{
-          disu_upts_plot(j,i)=disu_upts(0)(j,in_ele,i);
+          disu_upts_plot(j,i)=disu_out(j,in_ele,i);
         }
       }
     }
@@ -4256,6 +5066,7 @@ void eles::calc_grad_disu_ppts(int in_ele, array<double>& out_grad_disu_ppts)
     int i,j,k,l;
     
     array<double> grad_disu_upts_temp(n_upts_per_ele,n_fields,n_dims);
+    array<double>& grad_out = (output_slot<0) ? grad_disu_upts : grad_disu_upts_out(output_slot);
     
     for(i=0;i<n_fields;i++)
     {
@@ -4263,7 +5074,7 @@ void eles::calc_grad_disu_ppts(int in_ele, array<double>& out_grad_disu_ppts)
       {
         for(k=0;k<n_dims;k++)
         {
-          grad_disu_upts_temp(j,i,k)=grad_disu_upts(j,in_ele,i,k);
+          grad_disu_upts_temp(j,i,k)=grad_out(j,in_ele,i,k);
         }
       }
     }
@@ -4313,12 +5124,13 @@ void eles::calc_time_average_ppts(int in_ele, array<double>& out_disu_average_pp
     int i,j,k;
     
     array<double> disu_average_upts_plot(n_upts_per_ele,n_average_fields);
+    array<double>& average_out = (output_slot<0) ? disu_average_upts : disu_average_upts_out(output_slot);
     
     for(i=0;i<n_average_fields;i++)
     {
       for(j=0;j<n_upts_per_ele;j++)
       {
-        disu_average_upts_plot(j,i)=disu_average_upts(j,in_ele,i);
+        disu_average_upts_plot(j,i)=average_out(j,in_ele,i);
       }
     }
     
@@ -4345,202 +5157,242 @@ void eles::calc_time_average_ppts(int in_ele, array<double>& out_disu_average_pp
         }
       }
     }
-    
-#endif
-    
+    
+#endif
+    
+  }
+}
+
+// calculate the sensor values at plot points
+void eles::calc_sensor_ppts(int in_ele, array<double>& out_sensor_ppts)
+{
+    if (n_eles!=0)
+    {
+      array<double>& sensor_ele = (output_slot<0) ? sensor : sensor_out(output_slot);
+
+      for(int i=0;i<n_ppts_per_ele;i++)
+        out_sensor_ppts(i) = sensor_ele(in_ele);
+    }
+}
+
+// calculate solution at the plot points
+void eles::calc_epsilon_ppts(int in_ele, array<double>& out_epsilon_ppts)
+{
+  if (n_eles!=0)
+  {
+
+      int i,j,k;
+
+      array<double> epsilon_upts_plot(n_upts_per_ele);
+      array<double>& epsilon_out = (output_slot<0) ? epsilon_upts : epsilon_upts_out(output_slot);
+
+      for(j=0;j<n_upts_per_ele;j++)
+      {
+        epsilon_upts_plot(j)=epsilon_out(j,in_ele);
+      }
+
+
+#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
+
+      cblas_dgemm(CblasColMajor,CblasNoTrans,CblasNoTrans,n_ppts_per_ele,1,n_upts_per_ele,1.0,opp_p.get_ptr_cpu(),n_ppts_per_ele,epsilon_upts_plot.get_ptr_cpu(),n_upts_per_ele,0.0,out_epsilon_ppts.get_ptr_cpu(),n_ppts_per_ele);
+
+#else
+
+      //HACK (inefficient, but useful if cblas is unavailible)
+
+      for(i=0;i<n_ppts_per_ele;i++)
+      {
+        out_epsilon_ppts(i) = 0.;
+
+        for(j=0;j<n_upts_per_ele;j++)
+        {
+          out_epsilon_ppts(i) += opp_p(i,j)*epsilon_upts_plot(j);
+        }
+
+      }
+
+#endif
+
+  }
+}
+
+// apply opp_p to a block of solution point data with columns (upt,col), one matrix product for the whole block
+void eles::calc_ppts_batch(double* in_upts, int in_n_cols, double* out_ppts)
+{
+#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
+
+  cblas_dgemm(CblasColMajor,CblasNoTrans,CblasNoTrans,n_ppts_per_ele,in_n_cols,n_upts_per_ele,1.0,opp_p.get_ptr_cpu(),n_ppts_per_ele,in_upts,n_upts_per_ele,0.0,out_ppts,n_ppts_per_ele);
+
+#elif defined _NO_BLAS
+  dgemm(n_ppts_per_ele,in_n_cols,n_upts_per_ele,1.0,0.0,opp_p.get_ptr_cpu(),in_upts,out_ppts);
+
+#else
+
+  //HACK (inefficient, but useful if cblas is unavailible)
+
+  int i,j,k;
+
+#pragma omp parallel for private(i,j)
+  for(k=0;k<in_n_cols;k++)
+  {
+    for(i=0;i<n_ppts_per_ele;i++)
+    {
+      out_ppts[i+n_ppts_per_ele*k] = 0.;
+
+      for(j=0;j<n_upts_per_ele;j++)
+      {
+        out_ppts[i+n_ppts_per_ele*k] += opp_p(i,j)*in_upts[j+n_upts_per_ele*k];
+      }
+    }
   }
-}
 
-// calculate the sensor values at plot points
-void eles::calc_sensor_ppts(int in_ele, array<double>& out_sensor_ppts)
-{
-    if (n_eles!=0)
-    {
-      for(int i=0;i<n_ppts_per_ele;i++)
-        out_sensor_ppts(i) = sensor(in_ele);
-    }
+#endif
 }
 
-// calculate solution at the plot points
-void eles::calc_epsilon_ppts(int in_ele, array<double>& out_epsilon_ppts)
+// apply opp_volume_cubpts to contiguous columns of solution point data
+void eles::calc_cubpts_batch(double* in_upts, int in_n_cols, double* out_cubpts)
 {
-  if (n_eles!=0)
-  {
+#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
 
-      int i,j,k;
+  cblas_dgemm(CblasColMajor,CblasNoTrans,CblasNoTrans,n_cubpts_per_ele,in_n_cols,n_upts_per_ele,1.0,opp_volume_cubpts.get_ptr_cpu(),n_cubpts_per_ele,in_upts,n_upts_per_ele,0.0,out_cubpts,n_cubpts_per_ele);
 
-      array<double> epsilon_upts_plot(n_upts_per_ele);
+#elif defined _NO_BLAS
+  dgemm(n_cubpts_per_ele,in_n_cols,n_upts_per_ele,1.0,0.0,opp_volume_cubpts.get_ptr_cpu(),in_upts,out_cubpts);
+
+#else
+
+  int i,j,k;
+
+#pragma omp parallel for private(i,j)
+  for(k=0;k<in_n_cols;k++)
+  {
+    for(i=0;i<n_cubpts_per_ele;i++)
+    {
+      out_cubpts[i+n_cubpts_per_ele*k] = 0.;
 
       for(j=0;j<n_upts_per_ele;j++)
       {
-        epsilon_upts_plot(j)=epsilon_upts(j,in_ele);
+        out_cubpts[i+n_cubpts_per_ele*k] += opp_volume_cubpts(i,j)*in_upts[j+n_upts_per_ele*k];
       }
+    }
+  }
 
+#endif
+}
 
-#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-
-      cblas_dgemm(CblasColMajor,CblasNoTrans,CblasNoTrans,n_ppts_per_ele,1,n_upts_per_ele,1.0,opp_p.get_ptr_cpu(),n_ppts_per_ele,epsilon_upts_plot.get_ptr_cpu(),n_upts_per_ele,0.0,out_epsilon_ppts.get_ptr_cpu(),n_ppts_per_ele);
+// calculate solution at the plot points of all elements
+void eles::calc_disu_ppts_all(array<double>& out_disu_ppts)
+{
+  if (n_eles!=0)
+  {
+    array<double>& disu_out = (output_slot<0) ? disu_upts(0) : disu_upts_out(output_slot);
 
-#else
+    out_disu_ppts.setup(n_ppts_per_ele,n_eles,n_fields);
 
-      //HACK (inefficient, but useful if cblas is unavailible)
+    if (motion) {
+      array<double> disu_upts_plot(n_upts_per_ele,n_eles,n_fields);
 
-      for(i=0;i<n_ppts_per_ele;i++)
-      {
-        out_epsilon_ppts(i) = 0.;
+      for(int i=0;i<n_fields;i++)
+        for(int k=0;k<n_eles;k++)
+          for(int j=0;j<n_upts_per_ele;j++)
+            disu_upts_plot(j,k,i)=disu_out(j,k,i)/J_dyn_upts(j,k);
 
-        for(j=0;j<n_upts_per_ele;j++)
-        {
-          out_epsilon_ppts(i) += opp_p(i,j)*epsilon_upts_plot(j);
-        }
+      calc_ppts_batch(disu_upts_plot.get_ptr_cpu(),n_eles*n_fields,out_disu_ppts.get_ptr_cpu());
+    }
+    else {
+      calc_ppts_batch(disu_out.get_ptr_cpu(),n_eles*n_fields,out_disu_ppts.get_ptr_cpu());
+    }
+  }
+}
 
-      }
+// calculate gradient of solution at the plot points of all elements
+void eles::calc_grad_disu_ppts_all(array<double>& out_grad_disu_ppts)
+{
+  if (n_eles!=0)
+  {
+    out_grad_disu_ppts.setup(n_ppts_per_ele,n_eles,n_fields,n_dims);
+    array<double>& grad_out = (output_slot<0) ? grad_disu_upts : grad_disu_upts_out(output_slot);
+    calc_ppts_batch(grad_out.get_ptr_cpu(),n_eles*n_fields*n_dims,out_grad_disu_ppts.get_ptr_cpu());
+  }
+}
 
-#endif
+// calculate the AV-co-efficients at the plot points of all elements
+void eles::calc_epsilon_ppts_all(array<double>& out_epsilon_ppts)
+{
+  if (n_eles!=0)
+  {
+    out_epsilon_ppts.setup(n_ppts_per_ele,n_eles);
+    array<double>& epsilon_out = (output_slot<0) ? epsilon_upts : epsilon_upts_out(output_slot);
+    calc_ppts_batch(epsilon_out.get_ptr_cpu(),n_eles,out_epsilon_ppts.get_ptr_cpu());
+  }
+}
 
+// calculate the time averaged field values at the plot points of all elements
+void eles::calc_time_average_ppts_all(array<double>& out_disu_average_ppts)
+{
+  if (n_eles!=0)
+  {
+    out_disu_average_ppts.setup(n_ppts_per_ele,n_eles,n_average_fields);
+    array<double>& average_out = (output_slot<0) ? disu_average_upts : disu_average_upts_out(output_slot);
+    calc_ppts_batch(average_out.get_ptr_cpu(),n_eles*n_average_fields,out_disu_average_ppts.get_ptr_cpu());
   }
 }
 
 // calculate diagnostic fields at the plot points
-void eles::calc_diagnostic_fields_ppts(int in_ele, array<double>& in_disu_ppts, array<double>& in_grad_disu_ppts, array<double>& in_sensor_ppts, array<double>& in_epsilon_ppts, array<double>& out_diag_field_ppts, double& time)
-{
-  int i,j,k,m;
-  double diagfield_upt;
-  double u,v,w;
-  double irho,pressure,v_sq;
-  double wx,wy,wz;
-  double dudx, dudy, dudz;
-  double dvdx, dvdy, dvdz;
-  double dwdx, dwdy, dwdz;
-  
-  for(j=0;j<n_ppts_per_ele;j++)
-  {
-    // Compute velocity square
-    v_sq = 0.;
-    for (m=0;m<n_dims;m++)
-      v_sq += (in_disu_ppts(j,m+1)*in_disu_ppts(j,m+1));
-    v_sq /= in_disu_ppts(j,0)*in_disu_ppts(j,0);
-    
-    // Compute pressure
-    pressure = (run_input.gamma-1.0)*( in_disu_ppts(j,n_dims+1) - 0.5*in_disu_ppts(j,0)*v_sq);
-    
-    // compute diagnostic fields
-    for (k=0;k<n_diagnostic_fields;k++)
-    {
-      irho = 1./in_disu_ppts(j,0);
-      
-      if (run_input.diagnostic_fields(k)=="u")
-        diagfield_upt = in_disu_ppts(j,1)*irho;
-      else if (run_input.diagnostic_fields(k)=="v")
-        diagfield_upt = in_disu_ppts(j,2)*irho;
-      else if (run_input.diagnostic_fields(k)=="w")
-      {
-        if (n_dims==2)
-          diagfield_upt = 0.;
-        else if (n_dims==3)
-          diagfield_upt = in_disu_ppts(j,3)*irho;
-      }
-      else if (run_input.diagnostic_fields(k)=="energy")
-      {
-        if (n_dims==2)
-          diagfield_upt = in_disu_ppts(j,3);
-        else if (n_dims==3)
-          diagfield_upt = in_disu_ppts(j,4);
-      }
-      // flow properties
-      else if (run_input.diagnostic_fields(k)=="mach")
-      {
-        diagfield_upt = sqrt( v_sq / (run_input.gamma*pressure/in_disu_ppts(j,0)) );
-      }
-      else if (run_input.diagnostic_fields(k)=="pressure")
-      {
-        diagfield_upt = pressure;
-      }
-      // turbulence metrics
-      else if (run_input.diagnostic_fields(k)=="vorticity" || run_input.diagnostic_fields(k)=="q_criterion")
-      {
-        u = in_disu_ppts(j,1)*irho;
-        v = in_disu_ppts(j,2)*irho;
-        
-        dudx = irho*(in_grad_disu_ppts(j,1,0) - u*in_grad_disu_ppts(j,0,0));
-        dudy = irho*(in_grad_disu_ppts(j,1,1) - u*in_grad_disu_ppts(j,0,1));
-        dvdx = irho*(in_grad_disu_ppts(j,2,0) - v*in_grad_disu_ppts(j,0,0));
-        dvdy = irho*(in_grad_disu_ppts(j,2,1) - v*in_grad_disu_ppts(j,0,1));
-        
-        if (n_dims==2)
-        {
-          if (run_input.diagnostic_fields(k) == "vorticity")
-          {
-            diagfield_upt = abs(dvdx-dudy);
-          }
-          else if (run_input.diagnostic_fields(k) == "q_criterion")
-          {
-            FatalError("Not implemented in 2D");
-          }
-        }
-        else if (n_dims==3)
-        {
-          w = in_disu_ppts(j,3)*irho;
-          
-          dudz = irho*(in_grad_disu_ppts(j,1,2) - u*in_grad_disu_ppts(j,0,2));
-          dvdz = irho*(in_grad_disu_ppts(j,2,2) - v*in_grad_disu_ppts(j,0,2));
-          
-          dwdx = irho*(in_grad_disu_ppts(j,3,0) - w*in_grad_disu_ppts(j,0,0));
-          dwdy = irho*(in_grad_disu_ppts(j,3,1) - w*in_grad_disu_ppts(j,0,1));
-          dwdz = irho*(in_grad_disu_ppts(j,3,2) - w*in_grad_disu_ppts(j,0,2));
-          
-          wx = dwdy - dvdz;
-          wy = dudz - dwdx;
-          wz = dvdx - dudy;
-          
-          if (run_input.diagnostic_fields(k) == "vorticity")
-          {
-            diagfield_upt = sqrt(wx*wx+wy*wy+wz*wz);
-          }
-          else if (run_input.diagnostic_fields(k) == "q_criterion")
-          {
-            
-            wx *= 0.5;
-            wy *= 0.5;
-            wz *= 0.5;
-            
-            double Sxx,Syy,Szz,Sxy,Sxz,Syz,SS,OO;
-            Sxx = dudx;
-            Syy = dvdy;
-            Szz = dwdz;
-            Sxy = 0.5*(dudy+dvdx);
-            Sxz = 0.5*(dudz+dwdx);
-            Syz = 0.5*(dvdz+dwdy);
-            
-            SS = Sxx*Sxx + Syy*Syy + Szz*Szz + 2*Sxy*Sxy + 2*Sxz*Sxz + 2*Syz*Syz;
-            OO = 2*wx*wx + 2*wy*wy + 2*wz*wz;
-            
-            diagfield_upt = 0.5*(OO-SS);
-            
-          }
-        }
-      }
-      // Artificial Viscosity diagnostics
-      else if (run_input.diagnostic_fields(k)=="sensor")
-      {
-        diagfield_upt = in_sensor_ppts(j);
-      }
-      else if (run_input.diagnostic_fields(k)=="epsilon")
-      {
-        diagfield_upt = in_epsilon_ppts(j);
-      }
+void eles::calc_diagnostic_fields_ppts(int in_ele, array<double>& in_disu_ppts, array<double>& in_grad_disu_ppts, array<double>& in_sensor_ppts, array<double>& in_epsilon_ppts, array<double>& out_diag_field_ppts)
+{
+  eval_diag(diag_fields_plan,n_ppts_per_ele,run_input.gamma,in_disu_ppts.get_ptr_cpu(),in_grad_disu_ppts.get_ptr_cpu(),
+            in_sensor_ppts.get_ptr_cpu(),in_epsilon_ppts.get_ptr_cpu(),out_diag_field_ppts.get_ptr_cpu());
 
-      else {
-        cout << "plot_quantity = " << run_input.diagnostic_fields(k) << ": " << flush;
-        FatalError("plot_quantity not recognized");
-      }
-      if (isnan(diagfield_upt)) {
+  for (int k=0;k<n_diagnostic_fields;k++) {
+    for (int j=0;j<n_ppts_per_ele;j++) {
+      if (isnan(out_diag_field_ppts(j,k))) {
         cout << "In calculation of plot_quantitiy " << run_input.diagnostic_fields(k) << ": " << flush;
         FatalError("NaN");
       }
-      
-      // set array with solution point value
-      out_diag_field_ppts(j,k) = diagfield_upt;
+    }
+  }
+}
+
+// calculate diagnostic fields at the plot points of all elements
+void eles::calc_diagnostic_fields_ppts_all(array<double>& in_disu_ppts, array<double>& out_diag_field_ppts)
+{
+  if (n_eles!=0)
+  {
+    int n_pts = n_ppts_per_ele*n_eles;
+    array<double> grad_disu_ppts, sensor_ppts, epsilon_ppts;
+
+    out_diag_field_ppts.setup(n_ppts_per_ele,n_eles,n_diagnostic_fields);
+
+    // only the inputs the fields need
+    if (diag_fields_plan.need_grad)
+      calc_grad_disu_ppts_all(grad_disu_ppts);
+
+    if (diag_fields_plan.need_sensor) {
+      array<double>& sensor_ele = (output_slot<0) ? sensor : sensor_out(output_slot);
+      sensor_ppts.setup(n_ppts_per_ele,n_eles);
+      for (int i=0;i<n_eles;i++)
+        for (int j=0;j<n_ppts_per_ele;j++)
+          sensor_ppts(j,i) = sensor_ele(i);
+    }
+
+    if (diag_fields_plan.need_epsilon)
+      calc_epsilon_ppts_all(epsilon_ppts);
+
+    eval_diag(diag_fields_plan,n_pts,run_input.gamma,in_disu_ppts.get_ptr_cpu(),
+              diag_fields_plan.need_grad ? grad_disu_ppts.get_ptr_cpu() : NULL,
+              diag_fields_plan.need_sensor ? sensor_ppts.get_ptr_cpu() : NULL,
+              diag_fields_plan.need_epsilon ? epsilon_ppts.get_ptr_cpu() : NULL,
+              out_diag_field_ppts.get_ptr_cpu());
+
+    for (int k=0;k<n_diagnostic_fields;k++) {
+      double* values = out_diag_field_ppts.get_ptr_cpu(0,0,k);
+      for (int j=0;j<n_pts;j++) {
+        if (isnan(values[j])) {
+          cout << "In calculation of plot_quantitiy " << run_input.diagnostic_fields(k) << ": " << flush;
+          FatalError("NaN");
+        }
+      }
     }
   }
 }
@@ -4693,6 +5545,12 @@ void eles::set_transforms(void)
       }
     }
     
+    // Inverse of the determinant, for the update of the solution
+    inv_detjac_upts.setup(n_upts_per_ele,n_eles);
+    for(i=0;i<n_eles;i++)
+      for(j=0;j<n_upts_per_ele;j++)
+        inv_detjac_upts(j,i) = 1./detjac_upts(j,i);
+    
 #ifdef _GPU
     detjac_upts.cp_cpu_gpu(); // Copy since need in write_tec
     JGinv_upts.cp_cpu_gpu(); // Copy since needed for calc_d_pos_dyn
@@ -5116,8 +5974,8 @@ void eles::set_transforms_dynamic(void)
     if (first_time) cp_transforms_cpu_gpu();
 
     if (rank == 0 && first_time) cout << "Setting dynamic transformations ... " << flush;
-    set_transforms_dynamic_fpts_kernel_wrapper(n_fpts_per_ele,n_eles,n_dims,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),detjac_fpts.get_ptr_gpu(),J_dyn_fpts.get_ptr_gpu(),JGinv_fpts.get_ptr_gpu(),JGinv_dyn_fpts.get_ptr_gpu(),ndA_dyn_fpts.get_ptr_gpu(),norm_fpts.get_ptr_gpu(),norm_dyn_fpts.get_ptr_gpu(),d_nodal_s_basis_fpts.get_ptr_gpu(),shape_dyn.get_ptr_gpu());
-    set_transforms_dynamic_upts_kernel_wrapper(n_upts_per_ele,n_eles,n_dims,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),detjac_upts.get_ptr_gpu(),J_dyn_upts.get_ptr_gpu(),JGinv_upts.get_ptr_gpu(),JGinv_dyn_upts.get_ptr_gpu(),d_nodal_s_basis_upts.get_ptr_gpu(),shape_dyn.get_ptr_gpu());
+    set_transforms_dynamic_fpts_kernel_wrapper(n_fpts_per_ele,n_eles,n_dims,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),s_basis_ele.get_ptr_gpu(),detjac_fpts.get_ptr_gpu(),J_dyn_fpts.get_ptr_gpu(),JGinv_fpts.get_ptr_gpu(),JGinv_dyn_fpts.get_ptr_gpu(),ndA_dyn_fpts.get_ptr_gpu(),norm_fpts.get_ptr_gpu(),norm_dyn_fpts.get_ptr_gpu(),d_nodal_s_basis_fpts.get_ptr_gpu(),shape_dyn.get_ptr_gpu());
+    set_transforms_dynamic_upts_kernel_wrapper(n_upts_per_ele,n_eles,n_dims,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),s_basis_ele.get_ptr_gpu(),detjac_upts.get_ptr_gpu(),J_dyn_upts.get_ptr_gpu(),JGinv_upts.get_ptr_gpu(),JGinv_dyn_upts.get_ptr_gpu(),d_nodal_s_basis_upts.get_ptr_gpu(),shape_dyn.get_ptr_gpu());
     if (rank == 0 && first_time) cout << "done." << endl;
   }
 
@@ -5154,6 +6012,7 @@ void eles::cp_transforms_cpu_gpu(void)
   dyn_pos_fpts.cp_cpu_gpu();
 
   n_spts_per_ele.cp_cpu_gpu();
+  s_basis_ele.cp_cpu_gpu();
   shape.cp_cpu_gpu();
   shape_dyn.cp_cpu_gpu();
 
@@ -5793,7 +6652,7 @@ void eles::calc_pos_dyn_fpt(int in_fpt, int in_ele, array<double>& out_pos)
     out_pos.initialize_to_zero();
     for(i=0;i<n_dims;i++) {
         for(j=0;j<n_spts_per_ele(in_ele);j++) {
-            out_pos(i)+=nodal_s_basis_fpts(j,in_fpt,in_ele)*shape_dyn(i,j,in_ele);
+            out_pos(i)+=nodal_s_basis_fpts(j,in_fpt,s_basis_ele(in_ele))*shape_dyn(i,j,in_ele);
         }
     }
 }
@@ -5806,7 +6665,7 @@ void eles::calc_pos_dyn_upt(int in_upt, int in_ele, array<double>& out_pos)
     out_pos.initialize_to_zero();
     for(i=0;i<n_dims;i++) {
         for(j=0;j<n_spts_per_ele(in_ele);j++) {
-            out_pos(i)+=nodal_s_basis_fpts(j,in_upt,in_ele)*shape_dyn(i,j,in_ele);
+            out_pos(i)+=nodal_s_basis_upts(j,in_upt,s_basis_ele(in_ele))*shape_dyn(i,j,in_ele);
         }
     }
 }
@@ -5819,7 +6678,7 @@ void eles::calc_pos_dyn_ppt(int in_ppt, int in_ele, array<double>& out_pos)
     out_pos.initialize_to_zero();
     for(i=0;i<n_dims;i++) {
         for(j=0;j<n_spts_per_ele(in_ele);j++) {
-            out_pos(i)+=nodal_s_basis_ppts(j,in_ppt,in_ele)*shape_dyn(i,j,in_ele);
+            out_pos(i)+=nodal_s_basis_ppts(j,in_ppt,s_basis_ele(in_ele))*shape_dyn(i,j,in_ele);
         }
     }
 }
@@ -5832,7 +6691,7 @@ void eles::calc_pos_dyn_vol_cubpt(int in_ppt, int in_ele, array<double>& out_pos
     out_pos.initialize_to_zero();
     for(i=0;i<n_dims;i++) {
         for(j=0;j<n_spts_per_ele(in_ele);j++) {
-            out_pos(i)+=nodal_s_basis_vol_cubpts(j,in_ppt,in_ele)*shape_dyn(i,j,in_ele);
+            out_pos(i)+=nodal_s_basis_vol_cubpts(j,in_ppt,s_basis_ele(in_ele))*shape_dyn(i,j,in_ele);
         }
     }
 }
@@ -5845,7 +6704,7 @@ void eles::calc_pos_dyn_inters_cubpt(int in_cubpt, int in_face, int in_ele, arra
     out_pos.initialize_to_zero();
     for(i=0;i<n_dims;i++) {
         for(j=0;j<n_spts_per_ele(in_ele);j++) {
-            out_pos(i)+=nodal_s_basis_inters_cubpts(in_face)(j,in_cubpt,in_ele)*shape_dyn(i,j,in_ele);
+            out_pos(i)+=nodal_s_basis_inters_cubpts(in_face)(j,in_cubpt,s_basis_ele(in_ele))*shape_dyn(i,j,in_ele);
         }
     }
 }
@@ -5884,7 +6743,7 @@ void eles::calc_d_pos_upt(int in_upt, int in_ele, array<double>& out_d_pos)
   for(j=0;j<n_dims;j++) {
     for(k=0;k<n_dims;k++) {
       for(i=0;i<n_spts_per_ele(in_ele);i++) {
-        out_d_pos(j,k)+=d_nodal_s_basis_upts(k,i,in_upt,in_ele)*shape(j,i,in_ele);
+        out_d_pos(j,k)+=d_nodal_s_basis_upts(k,i,in_upt,s_basis_ele(in_ele))*shape(j,i,in_ele);
         //out_d_pos(j,k)+=d_nodal_s_basis_upts(in_upt,in_ele,k,i)*shape(j,i,in_ele);
       }
     }
@@ -5907,7 +6766,7 @@ void eles::calc_d_pos_fpt(int in_fpt, int in_ele, array<double>& out_d_pos)
   for(j=0;j<n_dims;j++) {
     for(k=0;k<n_dims;k++) {
       for(i=0;i<n_spts_per_ele(in_ele);i++) {
-        out_d_pos(j,k)+=d_nodal_s_basis_fpts(k,i,in_fpt,in_ele)*shape(j,i,in_ele);
+        out_d_pos(j,k)+=d_nodal_s_basis_fpts(k,i,in_fpt,s_basis_ele(in_ele))*shape(j,i,in_ele);
         //out_d_pos(j,k)+=d_nodal_s_basis_fpts(in_fpt,in_ele,k,i)*shape(j,i,in_ele);
       }
     }
@@ -5964,7 +6823,7 @@ void eles::calc_d_pos_dyn_fpt(int in_fpt, int in_ele, array<double>& out_d_pos)
     for(i=0; i<n_dims; i++) {
       for(j=0; j<n_dims; j++) {
         for(k=0; k<n_spts_per_ele(in_ele); k++) {
-          dxdr(i,j) += shape_dyn(i,k,in_ele)*d_nodal_s_basis_fpts(j,k,in_fpt,in_ele);
+          dxdr(i,j) += shape_dyn(i,k,in_ele)*d_nodal_s_basis_fpts(j,k,in_fpt,s_basis_ele(in_ele));
           //dxdr(i,j) += shape_dyn(i,k,in_ele)*d_nodal_s_basis_fpts(in_fpt,in_ele,j,k);
         }
       }
@@ -6009,7 +6868,7 @@ void eles::calc_d_pos_dyn_upt(int in_upt, int in_ele, array<double>& out_d_pos)
     for(i=0; i<n_dims; i++) {
       for(j=0; j<n_dims; j++) {
         for(k=0; k<n_spts_per_ele(in_ele); k++) {
-          dxdr(i,j) += shape_dyn(i,k,in_ele)*d_nodal_s_basis_upts(j,k,in_upt,in_ele);
+          dxdr(i,j) += shape_dyn(i,k,in_ele)*d_nodal_s_basis_upts(j,k,in_upt,s_basis_ele(in_ele));
           //dxdr(i,j) += shape_dyn(i,k,in_ele)*d_nodal_s_basis_upts(in_upt,in_ele,j,k);
         }
       }
@@ -6044,7 +6903,7 @@ void eles::calc_d_pos_dyn_vol_cubpt(int in_cubpt, int in_ele, array<double>& out
   for(i=0; i<n_dims; i++) {
     for(j=0; j<n_dims; j++) {
       for(k=0; k<n_spts_per_ele(in_ele); k++) {
-        dxdr(i,j) += d_nodal_s_basis_vol_cubpts(j,k,in_cubpt,in_ele)*shape_dyn(i,k,in_ele);
+        dxdr(i,j) += d_nodal_s_basis_vol_cubpts(j,k,in_cubpt,s_basis_ele(in_ele))*shape_dyn(i,k,in_ele);
       }
     }
   }
@@ -6079,7 +6938,7 @@ void eles::calc_d_pos_dyn_inters_cubpt(int in_cubpt, int in_face, int in_ele, ar
   for(i=0; i<n_dims; i++) {
     for(j=0; j<n_dims; j++) {
       for(k=0; k<n_spts_per_ele(in_ele); k++) {
-        dxdr(i,j) += d_nodal_s_basis_inters_cubpts(in_face)(j,k,in_cubpt,in_ele)*shape_dyn(i,k,in_ele);
+        dxdr(i,j) += d_nodal_s_basis_inters_cubpts(in_face)(j,k,in_cubpt,s_basis_ele(in_ele))*shape_dyn(i,k,in_ele);
       }
     }
   }
@@ -6103,6 +6962,10 @@ double eles::compute_res_upts(int in_norm_type, int in_field) {
   double sum = 0.;
   double cell_sum = 0.;
   
+  // the norm reduced by the last update, if it is from the last residual
+  if (res_norm_valid && in_norm_type == run_input.res_norm_type)
+    return res_norm_upts(in_field);
+  
   // NOTE: div_tconf_upts must be on CPU
   
   for (i=0; i<n_eles; i++) {
@@ -6134,7 +6997,7 @@ array<double> eles::compute_error(int in_norm_type, double& time)
   array<double> disu_cubpt(n_fields);
   array<double> grad_disu_cubpt(n_fields,n_dims);
   double detjac;
-  array<double> pos(n_dims);
+  array<double> pos(n_dims), loc(n_dims);
   
   array<double> error(2,n_fields);  //storage
   array<double> error_sum(2,n_fields);  //output
@@ -6152,6 +7015,11 @@ array<double> eles::compute_error(int in_norm_type, double& time)
       // Get jacobian determinant at cubpts
       detjac = vol_detjac_vol_cubpts(j)(i);
       
+      // Get the position of the cubature point, where the exact solution is evaluated
+      for (int k=0;k<n_dims;k++)
+        loc(k) = loc_volume_cubpts(k,j);
+      calc_pos(loc,i,pos);
+      
       // Get the solution at cubature point
       for (int m=0;m<n_fields;m++)
       {
@@ -6436,11 +7304,9 @@ void eles::evaluate_body_force(int in_file_num)
     else
       mdot_old = mass_flux;
 
-    // get timestep
-    if (run_input.dt_type == 0)
+    // get timestep (the global minimum of dt_type 1 is in run_input.dt)
+    if (run_input.dt_type == 0 || run_input.dt_type == 1)
       dt = run_input.dt;
-    else if (run_input.dt_type == 1)
-      dt = dt_local(0);
     else if (run_input.dt_type == 2)
       FatalError("Not sure what value of timestep to use in body force term when using local timestepping.");
 
@@ -6516,230 +7382,64 @@ void eles::evaluate_body_force(int in_file_num)
 // Compute integral quantities
 void eles::CalcIntegralQuantities(int n_integral_quantities, array <double>& integral_quantities)
 {
-  array<double> disu_cubpt(n_fields);
-  array<double> grad_disu_cubpt(n_fields,n_dims);
-  array<double> S(n_dims,n_dims);
-  double wx, wy, wz;
-  double dudx, dudy, dudz;
-  double dvdx, dvdy, dvdz;
-  double dwdx, dwdy, dwdz;
-  double diagnostic, tke, pressure, diag, irho, detjac;
-  
-  // Sum over elements
+  if (n_integral_quantities == 0)
+    return;
+
+  int n_pts = n_cubpts_per_ele*n_eles;
+  array<double> disu_cubpts(n_cubpts_per_ele,n_eles,n_fields);
+  array<double> grad_disu_cubpts;
+  array<double> integrand(n_cubpts_per_ele,n_eles,n_integral_quantities);
+  array<double> weight(n_cubpts_per_ele,n_eles);
+
+  // Solution and gradient at the cubature points of all elements
+  calc_cubpts_batch(disu_upts(0).get_ptr_cpu(),n_eles*n_fields,disu_cubpts.get_ptr_cpu());
+
+  if (integral_plan.need_grad) {
+    grad_disu_cubpts.setup(n_cubpts_per_ele,n_eles,n_fields,n_dims);
+    calc_cubpts_batch(grad_disu_upts.get_ptr_cpu(),n_eles*n_fields*n_dims,grad_disu_cubpts.get_ptr_cpu());
+  }
+
+  eval_diag(integral_plan,n_pts,run_input.gamma,disu_cubpts.get_ptr_cpu(),
+            integral_plan.need_grad ? grad_disu_cubpts.get_ptr_cpu() : NULL,NULL,NULL,integrand.get_ptr_cpu());
+
+  // Cubature weights times jacobian determinants
   for (int i=0;i<n_eles;i++)
-  {
     for (int j=0;j<n_cubpts_per_ele;j++)
-    {
-      // Get jacobian determinant at cubpts
-      detjac = vol_detjac_vol_cubpts(j)(i);
-      
-      // Get the solution at cubature point
-      for (int m=0;m<n_fields;m++)
-      {
-        disu_cubpt(m) = 0.;
-        for (int k=0;k<n_upts_per_ele;k++)
-        {
-          disu_cubpt(m) += opp_volume_cubpts(j,k)*disu_upts(0)(k,i,m);
-        }
-      }
-      // Get the solution gradient at cubature point
-      for (int m=0;m<n_fields;m++)
-      {
-        for (int n=0;n<n_dims;n++)
-        {
-          grad_disu_cubpt(m,n)=0.;
-          for (int k=0;k<n_upts_per_ele;k++)
-          {
-            grad_disu_cubpt(m,n) += opp_volume_cubpts(j,k)*grad_disu_upts(k,i,m,n);
-          }
-        }
-      }
-      irho = 1./disu_cubpt(0);
-      dudx = irho*(grad_disu_cubpt(1,0) - disu_cubpt(1)*irho*grad_disu_cubpt(0,0));
-      dudy = irho*(grad_disu_cubpt(1,1) - disu_cubpt(1)*irho*grad_disu_cubpt(0,1));
-      dvdx = irho*(grad_disu_cubpt(2,0) - disu_cubpt(2)*irho*grad_disu_cubpt(0,0));
-      dvdy = irho*(grad_disu_cubpt(2,1) - disu_cubpt(2)*irho*grad_disu_cubpt(0,1));
-      
-      if (n_dims==3)
-      {
-        dudz = irho*(grad_disu_cubpt(1,2) - disu_cubpt(1)*irho*grad_disu_cubpt(0,2));
-        dvdz = irho*(grad_disu_cubpt(2,2) - disu_cubpt(2)*irho*grad_disu_cubpt(0,2));
-        dwdx = irho*(grad_disu_cubpt(3,0) - disu_cubpt(3)*irho*grad_disu_cubpt(0,0));
-        dwdy = irho*(grad_disu_cubpt(3,1) - disu_cubpt(3)*irho*grad_disu_cubpt(0,1));
-        dwdz = irho*(grad_disu_cubpt(3,2) - disu_cubpt(3)*irho*grad_disu_cubpt(0,2));
-      }
-      
-      // Now calculate integral quantities
-      for (int m=0;m<n_integral_quantities;++m)
-      {
-        diagnostic = 0.0;
-        if (run_input.integral_quantities(m)=="kineticenergy")
-        {
-          // Compute kinetic energy
-          tke = 0.0;
-          for (int n=1;n<n_fields-1;n++)
-            tke += 0.5*disu_cubpt(n)*disu_cubpt(n);
-          
-          diagnostic = irho*tke;
-        }
-        else if (run_input.integral_quantities(m)=="vorticity")
-        {
-          // Compute vorticity squared
-          wz = dvdx - dudy;
-          diagnostic = wz*wz;
-          if (n_dims==3)
-          {
-            wx = dwdy - dvdz;
-            wy = dudz - dwdx;
-            diagnostic += wx*wx+wy*wy;
-          }
-          diagnostic *= 0.5/irho;
-        }
-        else if (run_input.integral_quantities(m)=="pressuredilatation")
-        {
-          // Kinetic energy
-          tke = 0.0;
-          for (int n=1;n<n_fields-1;n++)
-            tke += 0.5*disu_cubpt(n)*disu_cubpt(n);
-          
-          // Compute pressure
-          pressure = (run_input.gamma-1.0)*(disu_cubpt(n_fields-1) - irho*tke);
-          
-          // Multiply pressure by divergence of velocity
-          if (n_dims==2) {
-            diagnostic = pressure*(dudx+dvdy);
-          }
-          else if (n_dims==3) {
-            diagnostic = pressure*(dudx+dvdy+dwdz);
-          }
-        }
-        else if (run_input.integral_quantities(m)=="straincolonproduct" || run_input.integral_quantities(m)=="devstraincolonproduct")
-        {
-          // Rate of strain tensor
-          S(0,0) = dudx;
-          S(0,1) = (dudy+dvdx)/2.0;
-          S(1,0) = S(0,1);
-          S(1,1) = dvdy;
-          diag = (S(0,0)+S(1,1))/3.0;
-          
-          if (n_dims==3)
-          {
-            S(0,2) = (dudz+dwdx)/2.0;
-            S(1,2) = (dvdz+dwdy)/2.0;
-            S(2,0) = S(0,2);
-            S(2,1) = S(1,2);
-            S(2,2) = dwdz;
-            diag += S(2,2)/3.0;
-          }
-          
-          // Subtract diag if deviatoric strain
-          if (run_input.integral_quantities(m)=="devstraincolonproduct") {
-            for (int i=0;i<n_dims;i++)
-              S(i,i) -= diag;
-          }
-          
-          for (int i=0;i<n_dims;i++)
-            for (int j=0;j<n_dims;j++)
-              diagnostic += S(i,j)*S(i,j);
-          
-        }
-        else
-        {
-          FatalError("integral diagnostic quantity not recognized");
-        }
-        // Add contribution to global integral
-        integral_quantities(m) += diagnostic*weight_volume_cubpts(j)*detjac;
-      }
-    }
+      weight(j,i) = weight_volume_cubpts(j)*vol_detjac_vol_cubpts(j)(i);
+
+  // Add contribution to global integrals
+  for (int m=0;m<n_integral_quantities;m++) {
+    double* f = integrand.get_ptr_cpu(0,0,m);
+    double* w = weight.get_ptr_cpu();
+    double sum = 0.;
+
+    for (int j=0;j<n_pts;j++)
+      sum += f[j]*w[j];
+
+    integral_quantities(m) += sum;
   }
 }
 
 // Compute time-averaged quantities
 void eles::CalcTimeAverageQuantities(double& time)
 {
-  double current_value, average_value;
-  double a, b, dt;
-  double spinup_time = run_input.spinup_time;
-  double rho;
-  int i, j, k;
-
-  for(j=0;j<n_upts_per_ele;j++) {
-    for(k=0;k<n_eles;k++) {
-      for(i=0;i<n_average_fields;++i) {
+  if (n_average_fields == 0)
+    return;
 
-        rho = disu_upts(0)(j,k,0);
+  // the statistics restart from the solution until the spinup time, and on the
+  // first sample (they are not in the restart files); then each sample is weighted
+  // by the time elapsed since the previous one
+  bool reset = (stats_weight < 0. || time-run_input.spinup_time < 1.0e-12);
+  double dt = time-stats_time;
 
-        if(run_input.average_fields(i)=="rho_average") {
-          current_value = rho;
-          average_value = disu_average_upts(j,k,0);
-        }
-        else if(run_input.average_fields(i)=="u_average") {
-          current_value = disu_upts(0)(j,k,1)/rho;
-          average_value = disu_average_upts(j,k,1);
-        }
-        else if(run_input.average_fields(i)=="v_average") {
-          current_value = disu_upts(0)(j,k,2)/rho;
-          average_value = disu_average_upts(j,k,2);
-        }
-        else if(run_input.average_fields(i)=="w_average") {
-          current_value = disu_upts(0)(j,k,3)/rho;
-          average_value = disu_average_upts(j,k,3);
-        }
-        else if(run_input.average_fields(i)=="e_average") {
-          if(n_dims==2) {
-            current_value = disu_upts(0)(j,k,3)/rho;
-            average_value = disu_average_upts(j,k,3);
-          }
-          else {
-            current_value = disu_upts(0)(j,k,4)/rho;
-            average_value = disu_average_upts(j,k,4);
-          }
-        }
+  if (!reset && dt <= 0.)
+    return;
 
-        // get timestep
-        if (run_input.dt_type == 0)
-          dt = run_input.dt;
-        else if (run_input.dt_type == 1)
-          dt = dt_local(0);
-        else if (run_input.dt_type == 2)
-          FatalError("Not sure what value of timestep to use in time average calculation when using local timestepping.");
-
-        // set average value to current value if before spinup time
-        // and prevent division by a very small number if time = spinup time
-        if(time-spinup_time < 1.0e-12) {
-          a = 0.0;
-          b = 1.0;
-        }
-        // calculate running average
-        else {
-          a = (time-spinup_time-dt)/(time-spinup_time);
-          b = dt/(time-spinup_time);
-        }
+  update_time_stats(stats,n_upts_per_ele*n_eles,disu_upts(0).get_ptr_cpu(),run_input.gamma,reset,stats_weight,dt,
+                    stats_accum_upts.get_ptr_cpu(),disu_average_upts.get_ptr_cpu());
 
-        // Set new average value for next timestep
-        if(run_input.average_fields(i)=="rho_average") {
-          disu_average_upts(j,k,0) = a*average_value + b*current_value;
-        }
-        else if(run_input.average_fields(i)=="u_average") {
-          disu_average_upts(j,k,1) = a*average_value + b*current_value;
-        }
-        else if(run_input.average_fields(i)=="v_average") {
-          disu_average_upts(j,k,2) = a*average_value + b*current_value;
-        }
-        else if(run_input.average_fields(i)=="w_average") {
-          disu_average_upts(j,k,3) = a*average_value + b*current_value;
-        }
-        else if(run_input.average_fields(i)=="e_average") {
-          if(n_dims==2) {
-            disu_average_upts(j,k,3) = a*average_value + b*current_value;
-          }
-          else {
-            disu_average_upts(j,k,4) = a*average_value + b*current_value;
-          }
-        }
-      }
-    }
-  }
+  stats_weight = reset ? 0. : stats_weight+dt;
+  stats_time = time;
 }
 
 void eles::compute_wall_forces( array<double>& inv_force, array<double>& vis_force,  double& temp_cl, double& temp_cd, ofstream& coeff_file, bool write_forces)
@@ -7028,19 +7728,57 @@ void eles::set_grid_vel_spt(int in_ele, int in_spt, array<double> in_vel)
     vel_spts(i,in_spt,in_ele) = in_vel(i);
 }
 
+/*! The shape basis depends only on the element type and its no. of shape
+ *  points, so elements with the same count share one table */
+void eles::setup_s_basis(void)
+{
+  int ic,is;
+
+  n_s_bases = 0;
+  n_spts_s_basis.setup(n_eles);
+  s_basis_ele.setup(n_eles);
+
+  for (ic=0; ic<n_eles; ic++) {
+    for (is=0; is<n_s_bases; is++)
+      if (n_spts_s_basis(is)==n_spts_per_ele(ic))
+        break;
+
+    if (is==n_s_bases) {
+      n_spts_s_basis(is) = n_spts_per_ele(ic);
+      n_s_bases++;
+    }
+    s_basis_ele(ic) = is;
+  }
+
+  nodal_s_basis_fpts.setup(max_n_spts_per_ele,n_fpts_per_ele,n_s_bases);
+  nodal_s_basis_upts.setup(max_n_spts_per_ele,n_upts_per_ele,n_s_bases);
+  nodal_s_basis_ppts.setup(max_n_spts_per_ele,n_ppts_per_ele,n_s_bases);
+  d_nodal_s_basis_upts.setup(n_dims,max_n_spts_per_ele,n_upts_per_ele,n_s_bases);
+  d_nodal_s_basis_fpts.setup(n_dims,max_n_spts_per_ele,n_fpts_per_ele,n_s_bases);
+
+  nodal_s_basis_vol_cubpts.setup(max_n_spts_per_ele,n_cubpts_per_ele,n_s_bases);
+  d_nodal_s_basis_vol_cubpts.setup(n_dims,max_n_spts_per_ele,n_cubpts_per_ele,n_s_bases);
+  nodal_s_basis_inters_cubpts.setup(n_inters_per_ele);
+  d_nodal_s_basis_inters_cubpts.setup(n_inters_per_ele);
+  for (int iface=0; iface<n_inters_per_ele; iface++) {
+    nodal_s_basis_inters_cubpts(iface).setup(max_n_spts_per_ele,n_cubpts_per_inter(iface),n_s_bases);
+    d_nodal_s_basis_inters_cubpts(iface).setup(n_dims,max_n_spts_per_ele,n_cubpts_per_inter(iface),n_s_bases);
+  }
+}
+
 /*! Store nodal basis at flux points to avoid re-calculating every time
  *  TODO: CUDA (mv to GPU) */
 void eles::store_nodal_s_basis_fpts(void)
 {
-  int ic,fpt,j,k;
+  int is,fpt,j,k;
   array<double> loc(n_dims);
-  for (ic=0; ic<n_eles; ic++) {
+  for (is=0; is<n_s_bases; is++) {
     for (fpt=0; fpt<n_fpts_per_ele; fpt++) {
       for(k=0;k<n_dims;k++) {
         loc(k) = tloc_fpts(k,fpt);
       }
-      for(j=0;j<n_spts_per_ele(ic);j++) {
-        nodal_s_basis_fpts(j,fpt,ic) = eval_nodal_s_basis(j,loc,n_spts_per_ele(ic));
+      for(j=0;j<n_spts_s_basis(is);j++) {
+        nodal_s_basis_fpts(j,fpt,is) = eval_nodal_s_basis(j,loc,n_spts_s_basis(is));
       }
     }
   }
@@ -7051,15 +7789,15 @@ void eles::store_nodal_s_basis_fpts(void)
 
 void eles::store_nodal_s_basis_upts(void)
 {
-  int ic,upt,j,k;
+  int is,upt,j,k;
   array<double> loc(n_dims);
-  for (ic=0; ic<n_eles; ic++) {
+  for (is=0; is<n_s_bases; is++) {
     for (upt=0; upt<n_upts_per_ele; upt++) {
       for(k=0;k<n_dims;k++) {
         loc(k) = loc_upts(k,upt);
       }
-      for(j=0;j<n_spts_per_ele(ic);j++) {
-        nodal_s_basis_upts(j,upt,ic) = eval_nodal_s_basis(j,loc,n_spts_per_ele(ic));
+      for(j=0;j<n_spts_s_basis(is);j++) {
+        nodal_s_basis_upts(j,upt,is) = eval_nodal_s_basis(j,loc,n_spts_s_basis(is));
       }
     }
   }
@@ -7070,16 +7808,16 @@ void eles::store_nodal_s_basis_upts(void)
 
 void eles::store_nodal_s_basis_ppts(void)
 {
-  int ic,ppt,j,k;
+  int is,ppt,j,k;
 
   array<double> loc(n_dims);
-  for(ic=0; ic<n_eles; ic++) {
+  for(is=0; is<n_s_bases; is++) {
     for(ppt=0; ppt<n_ppts_per_ele; ppt++) {
       for(k=0; k<n_dims; k++) {
         loc(k)=loc_ppts(k,ppt);
       }
-      for (j=0; j<n_spts_per_ele(ic); j++) {
-        nodal_s_basis_ppts(j,ppt,ic) = eval_nodal_s_basis(j,loc,n_spts_per_ele(ic));
+      for (j=0; j<n_spts_s_basis(is); j++) {
+        nodal_s_basis_ppts(j,ppt,is) = eval_nodal_s_basis(j,loc,n_spts_s_basis(is));
       }
     }
   }
@@ -7087,16 +7825,16 @@ void eles::store_nodal_s_basis_ppts(void)
 
 void eles::store_nodal_s_basis_vol_cubpts(void)
 {
-  int ic,cubpt,j,k;
+  int is,cubpt,j,k;
 
   array<double> loc(n_dims);
-  for(ic=0; ic<n_eles; ic++) {
+  for(is=0; is<n_s_bases; is++) {
     for(cubpt=0; cubpt<n_cubpts_per_ele; cubpt++) {
       for(k=0; k<n_dims; k++) {
         loc(k)=loc_volume_cubpts(k,cubpt);
       }
-      for (j=0; j<n_spts_per_ele(ic); j++) {
-        nodal_s_basis_vol_cubpts(j,cubpt,ic) = eval_nodal_s_basis(j,loc,n_spts_per_ele(ic));
+      for (j=0; j<n_spts_s_basis(is); j++) {
+        nodal_s_basis_vol_cubpts(j,cubpt,is) = eval_nodal_s_basis(j,loc,n_spts_s_basis(is));
       }
     }
   }
@@ -7104,17 +7842,17 @@ void eles::store_nodal_s_basis_vol_cubpts(void)
 
 void eles::store_nodal_s_basis_inters_cubpts()
 {
-  int ic,iface,cubpt,j,k;
+  int is,iface,cubpt,j,k;
 
   array<double> loc(n_dims);
-  for(ic=0; ic<n_eles; ic++) {
+  for(is=0; is<n_s_bases; is++) {
     for(iface=0; iface<n_inters_per_ele; iface++) {
       for(cubpt=0; cubpt<n_cubpts_per_inter(iface); cubpt++) {
         for(k=0; k<n_dims; k++) {
           loc(k)=loc_inters_cubpts(iface)(k,cubpt);
         }
-        for (j=0; j<n_spts_per_ele(ic); j++) {
-          nodal_s_basis_inters_cubpts(iface)(j,cubpt,ic) = eval_nodal_s_basis(j,loc,n_spts_per_ele(ic));
+        for (j=0; j<n_spts_s_basis(is); j++) {
+          nodal_s_basis_inters_cubpts(iface)(j,cubpt,is) = eval_nodal_s_basis(j,loc,n_spts_s_basis(is));
         }
       }
     }
@@ -7124,20 +7862,20 @@ void eles::store_nodal_s_basis_inters_cubpts()
 
 void eles::store_d_nodal_s_basis_fpts(void)
 {
-  int ic,fpt,j,k;
+  int is,fpt,j,k;
   array<double> loc(n_dims);
   array<double> d_nodal_basis;
 
-  for (ic=0; ic<n_eles; ic++) {
+  for (is=0; is<n_s_bases; is++) {
     for (fpt=0; fpt<n_fpts_per_ele; fpt++) {
       for(k=0;k<n_dims;k++) {
         loc(k) = tloc_fpts(k,fpt);
       }
-      d_nodal_basis.setup(n_spts_per_ele(ic),n_dims);
-      eval_d_nodal_s_basis(d_nodal_basis,loc,n_spts_per_ele(ic));
-      for (j=0; j<n_spts_per_ele(ic); j++) {
+      d_nodal_basis.setup(n_spts_s_basis(is),n_dims);
+      eval_d_nodal_s_basis(d_nodal_basis,loc,n_spts_s_basis(is));
+      for (j=0; j<n_spts_s_basis(is); j++) {
         for (k=0; k<n_dims; k++) {
-          d_nodal_s_basis_fpts(k,j,fpt,ic) = d_nodal_basis(j,k);
+          d_nodal_s_basis_fpts(k,j,fpt,is) = d_nodal_basis(j,k);
           //d_nodal_s_basis_fpts(fpt,ic,k,j) = d_nodal_basis(j,k);
         }
       }
@@ -7151,21 +7889,21 @@ void eles::store_d_nodal_s_basis_fpts(void)
 
 void eles::store_d_nodal_s_basis_upts(void)
 {
-  int ic,upt,j,k;
+  int is,upt,j,k;
   array<double> loc(n_dims);
   array<double> d_nodal_basis;
 
-  for (ic=0; ic<n_eles; ic++) {
+  for (is=0; is<n_s_bases; is++) {
     for (upt=0; upt<n_upts_per_ele; upt++) {
       for(k=0;k<n_dims;k++) {
         loc(k) = loc_upts(k,upt);
       }
-      d_nodal_basis.setup(n_spts_per_ele(ic),n_dims);
-      eval_d_nodal_s_basis(d_nodal_basis,loc,n_spts_per_ele(ic));
-      for (j=0; j<n_spts_per_ele(ic); j++) {
+      d_nodal_basis.setup(n_spts_s_basis(is),n_dims);
+      eval_d_nodal_s_basis(d_nodal_basis,loc,n_spts_s_basis(is));
+      for (j=0; j<n_spts_s_basis(is); j++) {
         for (k=0; k<n_dims; k++) {
           //d_nodal_s_basis_upts(upt,ic,k,j) = d_nodal_basis(j,k);
-          d_nodal_s_basis_upts(k,j,upt,ic) = d_nodal_basis(j,k);
+          d_nodal_s_basis_upts(k,j,upt,is) = d_nodal_basis(j,k);
         }
       }
     }
@@ -7177,20 +7915,20 @@ void eles::store_d_nodal_s_basis_upts(void)
 
 void eles::store_d_nodal_s_basis_vol_cubpts(void)
 {
-  int ic,cubpt,j,k;
+  int is,cubpt,j,k;
   array<double> loc(n_dims);
   array<double> d_nodal_basis;
 
-  for (ic=0; ic<n_eles; ic++) {
+  for (is=0; is<n_s_bases; is++) {
     for (cubpt=0; cubpt<n_cubpts_per_ele; cubpt++) {
       for(k=0;k<n_dims;k++) {
         loc(k) = loc_volume_cubpts(k,cubpt);
       }
-      d_nodal_basis.setup(n_spts_per_ele(ic),n_dims);
-      eval_d_nodal_s_basis(d_nodal_basis,loc,n_spts_per_ele(ic));
-      for (j=0; j<n_spts_per_ele(ic); j++) {
+      d_nodal_basis.setup(n_spts_s_basis(is),n_dims);
+      eval_d_nodal_s_basis(d_nodal_basis,loc,n_spts_s_basis(is));
+      for (j=0; j<n_spts_s_basis(is); j++) {
         for (k=0; k<n_dims; k++) {
-          d_nodal_s_basis_vol_cubpts(k,j,cubpt,ic) = d_nodal_basis(j,k);
+          d_nodal_s_basis_vol_cubpts(k,j,cubpt,is) = d_nodal_basis(j,k);
         }
       }
     }
@@ -7199,21 +7937,21 @@ void eles::store_d_nodal_s_basis_vol_cubpts(void)
 
 void eles::store_d_nodal_s_basis_inters_cubpts(void)
 {
-  int ic,iface,cubpt,j,k;
+  int is,iface,cubpt,j,k;
   array<double> loc(n_dims);
   array<double> d_nodal_basis;
 
-  for (ic=0; ic<n_eles; ic++) {
+  for (is=0; is<n_s_bases; is++) {
     for (iface=0; iface<n_inters_per_ele; iface++) {
       for (cubpt=0; cubpt<n_cubpts_per_inter(iface); cubpt++) {
         for(k=0;k<n_dims;k++) {
           loc(k) = loc_inters_cubpts(iface)(k,cubpt);
         }
-        d_nodal_basis.setup(n_spts_per_ele(ic),n_dims);
-        eval_d_nodal_s_basis(d_nodal_basis,loc,n_spts_per_ele(ic));
-        for (j=0; j<n_spts_per_ele(ic); j++) {
+        d_nodal_basis.setup(n_spts_s_basis(is),n_dims);
+        eval_d_nodal_s_basis(d_nodal_basis,loc,n_spts_s_basis(is));
+        for (j=0; j<n_spts_s_basis(is); j++) {
           for (k=0; k<n_dims; k++) {
-            d_nodal_s_basis_inters_cubpts(iface)(k,j,cubpt,ic) = d_nodal_basis(j,k);
+            d_nodal_s_basis_inters_cubpts(iface)(k,j,cubpt,is) = d_nodal_basis(j,k);
           }
         }
       }
@@ -7270,7 +8008,7 @@ void eles::set_grid_vel_fpts(int in_rk_step)
         for(k=0;k<n_dims;k++) {
           grid_vel_fpts(fpt,ic,k) = 0.0;
           for(j=0;j<n_spts_per_ele(ic);j++) {
-            grid_vel_fpts(fpt,ic,k)+=nodal_s_basis_fpts(j,fpt,ic)*vel_spts(k,j,ic);
+            grid_vel_fpts(fpt,ic,k)+=nodal_s_basis_fpts(j,fpt,s_basis_ele(ic))*vel_spts(k,j,ic);
           }
         }
       }
@@ -7278,7 +8016,7 @@ void eles::set_grid_vel_fpts(int in_rk_step)
 //  }
 #ifdef _GPU
   //grid_vel_fpts.cp_cpu_gpu();
-  eval_grid_vel_pts_kernel_wrapper(n_dims,n_eles,n_fpts_per_ele,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),nodal_s_basis_fpts.get_ptr_gpu(),vel_spts.get_ptr_gpu(),grid_vel_fpts.get_ptr_gpu());
+  eval_grid_vel_pts_kernel_wrapper(n_dims,n_eles,n_fpts_per_ele,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),s_basis_ele.get_ptr_gpu(),nodal_s_basis_fpts.get_ptr_gpu(),vel_spts.get_ptr_gpu(),grid_vel_fpts.get_ptr_gpu());
 #endif
 }
 
@@ -7305,7 +8043,7 @@ void eles::set_grid_vel_upts(int in_rk_step)
         for(k=0;k<n_dims;k++) {
           grid_vel_upts(upt,ic,k) = 0.0;
           for(j=0;j<n_spts_per_ele(ic);j++) {
-            grid_vel_upts(upt,ic,k)+=nodal_s_basis_upts(j,upt,ic)*vel_spts(k,j,ic);
+            grid_vel_upts(upt,ic,k)+=nodal_s_basis_upts(j,upt,s_basis_ele(ic))*vel_spts(k,j,ic);
           }
         }
       }
@@ -7313,7 +8051,7 @@ void eles::set_grid_vel_upts(int in_rk_step)
 //  }
 #ifdef _GPU
   //grid_vel_upts.cp_cpu_gpu();
-  eval_grid_vel_pts_kernel_wrapper(n_dims,n_eles,n_upts_per_ele,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),nodal_s_basis_upts.get_ptr_gpu(),vel_spts.get_ptr_gpu(),grid_vel_upts.get_ptr_gpu());
+  eval_grid_vel_pts_kernel_wrapper(n_dims,n_eles,n_upts_per_ele,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),s_basis_ele.get_ptr_gpu(),nodal_s_basis_upts.get_ptr_gpu(),vel_spts.get_ptr_gpu(),grid_vel_upts.get_ptr_gpu());
 #endif
 }
 
@@ -7328,7 +8066,7 @@ void eles::set_grid_vel_ppts(void)
       for(k=0;k<n_dims;k++) {
         vel_ppts(k,ppt,ic) = 0.0;
         for(j=0;j<n_spts_per_ele(ic);j++) {
-          vel_ppts(k,ppt,ic)+=nodal_s_basis_ppts(j,ppt,ic)*vel_spts(k,j,ic);
+          vel_ppts(k,ppt,ic)+=nodal_s_basis_ppts(j,ppt,s_basis_ele(ic))*vel_spts(k,j,ic);
         }
       }
     }
@@ -7360,8 +8098,8 @@ void eles::rigid_grid_velocity(double rk_time)
 {
   if (n_eles!=0) {
     calc_rigid_grid_vel_spts_kernel_wrapper(n_dims,n_eles,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),run_input.bound_vel_simple(0).get_ptr_gpu(),vel_spts.get_ptr_gpu(),rk_time);
-    eval_grid_vel_pts_kernel_wrapper(n_dims,n_eles,n_upts_per_ele,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),nodal_s_basis_upts.get_ptr_gpu(),vel_spts.get_ptr_gpu(),grid_vel_upts.get_ptr_gpu());
-    eval_grid_vel_pts_kernel_wrapper(n_dims,n_eles,n_fpts_per_ele,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),nodal_s_basis_fpts.get_ptr_gpu(),vel_spts.get_ptr_gpu(),grid_vel_fpts.get_ptr_gpu());
+    eval_grid_vel_pts_kernel_wrapper(n_dims,n_eles,n_upts_per_ele,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),s_basis_ele.get_ptr_gpu(),nodal_s_basis_upts.get_ptr_gpu(),vel_spts.get_ptr_gpu(),grid_vel_upts.get_ptr_gpu());
+    eval_grid_vel_pts_kernel_wrapper(n_dims,n_eles,n_fpts_per_ele,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),s_basis_ele.get_ptr_gpu(),nodal_s_basis_fpts.get_ptr_gpu(),vel_spts.get_ptr_gpu(),grid_vel_fpts.get_ptr_gpu());
   }
 }
 
@@ -7369,8 +8107,8 @@ void eles::perturb_grid_velocity(double rk_time)
 {
   if (n_eles!=0) {
     calc_perturb_grid_vel_spts_kernel_wrapper(n_dims,n_eles,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),shape.get_ptr_gpu(),vel_spts.get_ptr_gpu(),rk_time);
-    eval_grid_vel_pts_kernel_wrapper(n_dims,n_eles,n_upts_per_ele,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),nodal_s_basis_upts.get_ptr_gpu(),vel_spts.get_ptr_gpu(),grid_vel_upts.get_ptr_gpu());
-    eval_grid_vel_pts_kernel_wrapper(n_dims,n_eles,n_fpts_per_ele,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),nodal_s_basis_fpts.get_ptr_gpu(),vel_spts.get_ptr_gpu(),grid_vel_fpts.get_ptr_gpu());
+    eval_grid_vel_pts_kernel_wrapper(n_dims,n_eles,n_upts_per_ele,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),s_basis_ele.get_ptr_gpu(),nodal_s_basis_upts.get_ptr_gpu(),vel_spts.get_ptr_gpu(),grid_vel_upts.get_ptr_gpu());
+    eval_grid_vel_pts_kernel_wrapper(n_dims,n_eles,n_fpts_per_ele,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),s_basis_ele.get_ptr_gpu(),nodal_s_basis_fpts.get_ptr_gpu(),vel_spts.get_ptr_gpu(),grid_vel_fpts.get_ptr_gpu());
   }
 }
 
@@ -7378,8 +8116,8 @@ void eles::calc_grid_velocity(void)
 {
   if (n_eles!=0) {
     calc_grid_vel_spts_kernel_wrapper(n_dims,n_eles,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),shape_dyn.get_ptr_gpu(),vel_spts.get_ptr_gpu(),run_input.dt);
-    eval_grid_vel_pts_kernel_wrapper(n_dims,n_eles,n_upts_per_ele,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),nodal_s_basis_upts.get_ptr_gpu(),vel_spts.get_ptr_gpu(),grid_vel_upts.get_ptr_gpu());
-    eval_grid_vel_pts_kernel_wrapper(n_dims,n_eles,n_fpts_per_ele,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),nodal_s_basis_fpts.get_ptr_gpu(),vel_spts.get_ptr_gpu(),grid_vel_fpts.get_ptr_gpu());
+    eval_grid_vel_pts_kernel_wrapper(n_dims,n_eles,n_upts_per_ele,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),s_basis_ele.get_ptr_gpu(),nodal_s_basis_upts.get_ptr_gpu(),vel_spts.get_ptr_gpu(),grid_vel_upts.get_ptr_gpu());
+    eval_grid_vel_pts_kernel_wrapper(n_dims,n_eles,n_fpts_per_ele,max_n_spts_per_ele,n_spts_per_ele.get_ptr_gpu(),s_basis_ele.get_ptr_gpu(),nodal_s_basis_fpts.get_ptr_gpu(),vel_spts.get_ptr_gpu(),grid_vel_fpts.get_ptr_gpu());
   }
 }
 #endif
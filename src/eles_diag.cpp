@@ -0,0 +1,257 @@
+/*!
+ * \file eles_diag.cpp
+ * \brief _____________________________
+ * \author - Original code: SD++ developed by Patrice Castonguay, Antony Jameson,
+ *                          Peter Vincent, David Williams (alphabetical by surname).
+ *         - Current development: Aerospace Computing Laboratory (ACL)
+ *
+ * \version 0.1.0
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ * Copyright (C) 2014 Aerospace Computing Laboratory (ACL).
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cmath>
+#include <string>
+
+#include "../include/eles_diag.h"
+#include "../include/error.h"
+
+using namespace std;
+
+// diagnostic fields
+
+static double diag_u(const diag_state& s) { return s.vel[0]; }
+static double diag_v(const diag_state& s) { return s.vel[1]; }
+static double diag_w(const diag_state& s) { return s.vel[2]; }
+static double diag_energy(const diag_state& s) { return s.ene; }
+static double diag_pressure(const diag_state& s) { return s.pressure; }
+static double diag_sensor(const diag_state& s) { return s.sensor; }
+static double diag_epsilon(const diag_state& s) { return s.epsilon; }
+
+static double diag_mach(const diag_state& s)
+{
+  return sqrt(s.v_sq/(s.gamma*s.pressure/s.rho));
+}
+
+static double vorticity_sq(const diag_state& s)
+{
+  double wx = s.dvel[2][1] - s.dvel[1][2];
+  double wy = s.dvel[0][2] - s.dvel[2][0];
+  double wz = s.dvel[1][0] - s.dvel[0][1];
+  return wx*wx + wy*wy + wz*wz;
+}
+
+static double diag_vorticity(const diag_state& s)
+{
+  return sqrt(vorticity_sq(s));
+}
+
+// Q = (|Omega|^2 - |S|^2)/2 with the rate of rotation and strain tensors
+
+static double diag_q_criterion(const diag_state& s)
+{
+  double SS = 0., OO = 0.;
+  for (int i=0;i<3;i++) {
+    for (int j=0;j<3;j++) {
+      double Sij = 0.5*(s.dvel[i][j]+s.dvel[j][i]);
+      double Oij = 0.5*(s.dvel[i][j]-s.dvel[j][i]);
+      SS += Sij*Sij;
+      OO += Oij*Oij;
+    }
+  }
+  return 0.5*(OO-SS);
+}
+
+// integrands of the integral quantities
+
+static double integral_kinetic_energy(const diag_state& s)
+{
+  return 0.5*s.rho*s.v_sq;
+}
+
+static double integral_enstrophy(const diag_state& s)
+{
+  return 0.5*s.rho*vorticity_sq(s);
+}
+
+static double integral_pressure_dilatation(const diag_state& s)
+{
+  double div = 0.;
+  for (int i=0;i<s.n_dims;i++)
+    div += s.dvel[i][i];
+  return s.pressure*div;
+}
+
+// S:S, with the trace of S (over 3) removed from its diagonal for the deviatoric strain
+
+static double strain_colon_product(const diag_state& s, bool in_deviatoric)
+{
+  double trace = 0., SS = 0.;
+  for (int i=0;i<s.n_dims;i++)
+    trace += s.dvel[i][i];
+
+  for (int i=0;i<s.n_dims;i++) {
+    for (int j=0;j<s.n_dims;j++) {
+      double Sij = 0.5*(s.dvel[i][j]+s.dvel[j][i]);
+      if (in_deviatoric && i == j)
+        Sij -= trace/3.0;
+      SS += Sij*Sij;
+    }
+  }
+  return SS;
+}
+
+static double integral_strain_colon_product(const diag_state& s) { return strain_colon_product(s,false); }
+static double integral_dev_strain_colon_product(const diag_state& s) { return strain_colon_product(s,true); }
+
+// kernel tables: name, kernel, inputs needed (1: gradient, 2: sensor, 3: epsilon), dimensions (0: any)
+
+struct diag_entry
+{
+  const char* name;
+  diag_kernel kernel;
+  int input;
+  int n_dims;
+};
+
+static const diag_entry diag_field_table[] = {
+  {"u", diag_u, 0, 0},
+  {"v", diag_v, 0, 0},
+  {"w", diag_w, 0, 0},
+  {"energy", diag_energy, 0, 0},
+  {"mach", diag_mach, 0, 0},
+  {"pressure", diag_pressure, 0, 0},
+  {"vorticity", diag_vorticity, 1, 0},
+  {"q_criterion", diag_q_criterion, 1, 3},
+  {"sensor", diag_sensor, 2, 0},
+  {"epsilon", diag_epsilon, 3, 0},
+  {NULL, NULL, 0, 0}
+};
+
+static const diag_entry integral_table[] = {
+  {"kineticenergy", integral_kinetic_energy, 0, 0},
+  {"vorticity", integral_enstrophy, 1, 0},
+  {"enstrophy", integral_enstrophy, 1, 0},
+  {"pressuredilatation", integral_pressure_dilatation, 1, 0},
+  {"straincolonproduct", integral_strain_colon_product, 1, 0},
+  {"devstraincolonproduct", integral_dev_strain_colon_product, 1, 0},
+  {NULL, NULL, 0, 0}
+};
+
+// index of a name in a table, -1 if it is not there
+
+static int find_entry(const diag_entry* in_table, const string& in_name)
+{
+  for (int i=0;in_table[i].name!=NULL;i++)
+    if (in_name == in_table[i].name)
+      return i;
+  return -1;
+}
+
+static void compile_plan(const diag_entry* in_table, array<string>& in_names, int in_n_dims, int in_n_fields, diag_plan& out_plan)
+{
+  out_plan.n_dims = in_n_dims;
+  out_plan.n_fields = in_n_fields;
+  out_plan.n_quantities = in_names.get_dim(0);
+  out_plan.kernels.setup(out_plan.n_quantities);
+  out_plan.need_grad = false;
+  out_plan.need_sensor = false;
+  out_plan.need_epsilon = false;
+
+  for (int k=0;k<out_plan.n_quantities;k++)
+  {
+    int i = find_entry(in_table,in_names(k));
+
+    if (i < 0) {
+      if (in_table == diag_field_table) {
+        cout << "plot_quantity = " << in_names(k) << ": " << flush;
+        FatalError("plot_quantity not recognized");
+      }
+      else
+        FatalError("integral diagnostic quantity not recognized");
+    }
+    if (in_table[i].n_dims != 0 && in_table[i].n_dims != in_n_dims)
+      FatalError("Not implemented in 2D");
+
+    out_plan.kernels(k) = in_table[i].kernel;
+    out_plan.need_grad = out_plan.need_grad || (in_table[i].input == 1);
+    out_plan.need_sensor = out_plan.need_sensor || (in_table[i].input == 2);
+    out_plan.need_epsilon = out_plan.need_epsilon || (in_table[i].input == 3);
+  }
+}
+
+void compile_diag_fields(array<string>& in_names, int in_n_dims, int in_n_fields, diag_plan& out_plan)
+{
+  compile_plan(diag_field_table,in_names,in_n_dims,in_n_fields,out_plan);
+}
+
+void compile_integral_quantities(array<string>& in_names, int in_n_dims, int in_n_fields, diag_plan& out_plan)
+{
+  compile_plan(integral_table,in_names,in_n_dims,in_n_fields,out_plan);
+}
+
+void eval_diag(diag_plan& in_plan, int in_n_pts, double in_gamma, const double* in_disu, const double* in_grad_disu,
+               const double* in_sensor, const double* in_epsilon, double* out_values)
+{
+  const int n = in_n_pts;
+  const int n_quantities = in_plan.n_quantities;
+  const diag_kernel* kernels = in_plan.kernels.get_ptr_cpu();
+  const bool need_grad = in_plan.need_grad;
+  const bool need_sensor = in_plan.need_sensor;
+  const bool need_epsilon = in_plan.need_epsilon;
+
+  const int n_dims = in_plan.n_dims;
+  const int n_fields = in_plan.n_fields;
+
+#pragma omp parallel for schedule(static)
+  for (int p=0;p<n;p++)
+  {
+    diag_state s;
+
+    s.n_dims = n_dims;
+    s.gamma = in_gamma;
+    s.rho = in_disu[p];
+    s.ene = in_disu[p+(n_dims+1)*n];
+    s.v_sq = 0.;
+
+    double irho = 1./s.rho;
+
+    for (int i=0;i<3;i++) {
+      s.vel[i] = (i < n_dims) ? in_disu[p+(i+1)*n]*irho : 0.;
+      s.v_sq += s.vel[i]*s.vel[i];
+    }
+    s.pressure = (in_gamma-1.0)*(s.ene-0.5*s.rho*s.v_sq);
+
+    // velocity gradient from the gradient of the conservative variables
+    for (int i=0;i<3;i++) {
+      for (int j=0;j<3;j++) {
+        s.dvel[i][j] = 0.;
+        if (need_grad && i < n_dims && j < n_dims) {
+          const double* grad_j = in_grad_disu + p + j*n_fields*n;
+          s.dvel[i][j] = irho*(grad_j[(i+1)*n] - s.vel[i]*grad_j[0]);
+        }
+      }
+    }
+
+    s.sensor = need_sensor ? in_sensor[p] : 0.;
+    s.epsilon = need_epsilon ? in_epsilon[p] : 0.;
+
+    for (int k=0;k<n_quantities;k++)
+      out_values[p+k*n] = kernels[k](s);
+  }
+}
@@ -848,7 +848,7 @@ void eles_hexas::compute_filter_upts(void)
 //#### helper methods ####
 
 
-int eles_hexas::read_restart_info(ifstream& restart_file)
+int eles_hexas::read_restart_info(istream& restart_file)
 {
 
   string str;
@@ -879,7 +879,7 @@ int eles_hexas::read_restart_info(ifstream& restart_file)
 }
 
 // write restart info
-void eles_hexas::write_restart_info(ofstream& restart_file)        
+void eles_hexas::write_restart_info(ostream& restart_file)        
 {
   restart_file << "HEXAS" << endl;
 
@@ -1254,5 +1254,42 @@ double eles_hexas::calc_ele_vol(double& detjac)
 /*! Calculate element reference length for timestep calculation */
 double eles_hexas::calc_h_ref_specific(int in_ele)
   {
-    FatalError("Reference length calculation not implemented for this element!")
+    int n_spts = n_spts_per_ele(in_ele);
+    int vert[8];
+    double out_h_ref, length, dx;
+
+    // Shape points of the vertices (tensor product or 20 node hexes)
+    if (is_perfect_cube(n_spts))
+      {
+        int n_spts_1d = round(pow(n_spts,1./3.));
+        for (int v=0;v<8;v++)
+          {
+            int i = ((v+1)/2)%2; // x: 0,1,1,0
+            int j = (v/2)%2;     // y: 0,0,1,1
+            int k = v/4;         // z
+            vert[v] = (i + n_spts_1d*j + n_spts_1d*n_spts_1d*k)*(n_spts_1d-1);
+          }
+      }
+    else
+      {
+        for (int v=0;v<8;v++)
+          vert[v] = v;
+      }
+
+    // Minimum edge length (as for quads)
+    static const int edge[12][2] = {{0,1},{1,2},{2,3},{3,0},{4,5},{5,6},{6,7},{7,4},{0,4},{1,5},{2,6},{3,7}};
+
+    out_h_ref = 1e16;
+    for (int e=0;e<12;e++)
+      {
+        length = 0.;
+        for (int m=0;m<3;m++)
+          {
+            dx = shape(m,vert[edge[e][0]],in_ele) - shape(m,vert[edge[e][1]],in_ele);
+            length += dx*dx;
+          }
+        out_h_ref = min(out_h_ref,sqrt(length));
+      }
+
+    return out_h_ref;
   }
@@ -0,0 +1,243 @@
+/*!
+ * \file eles_kernels.cpp
+ * \brief _____________________________
+ * \author - Original code: SD++ developed by Patrice Castonguay, Antony Jameson,
+ *                          Peter Vincent, David Williams (alphabetical by surname).
+ *         - Current development: Aerospace Computing Laboratory (ACL)
+ *
+ * \version 0.1.0
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ * Copyright (C) 2014 Aerospace Computing Laboratory (ACL).
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cstddef>
+
+#include "../include/eles_kernels.h"
+
+using namespace std;
+
+// no. of dimensions and solution points of each element type (0: tri, 1: quad, 2: tet, 3: pri, 4: hex)
+
+template <int ELE_TYPE, int ORDER> struct ele_traits;
+
+template <int ORDER> struct ele_traits<0,ORDER> { enum { n_dims = 2, n_upts = (ORDER+2)*(ORDER+1)/2 }; };
+template <int ORDER> struct ele_traits<1,ORDER> { enum { n_dims = 2, n_upts = (ORDER+1)*(ORDER+1) }; };
+template <int ORDER> struct ele_traits<2,ORDER> { enum { n_dims = 3, n_upts = (ORDER+3)*(ORDER+2)*(ORDER+1)/6 }; };
+template <int ORDER> struct ele_traits<3,ORDER> { enum { n_dims = 3, n_upts = (ORDER+2)*(ORDER+1)*(ORDER+1)/2 }; };
+template <int ORDER> struct ele_traits<4,ORDER> { enum { n_dims = 3, n_upts = (ORDER+1)*(ORDER+1)*(ORDER+1) }; };
+
+// Euler/NS flux in the physical domain, transformed to the computational one:
+// f_l = sum_m JGinv(l,m)*f_m, with V_l = sum_m JGinv(l,m)*v_m this is
+// (rho*V_l, rho*v_d*V_l + p*JGinv(l,d), (E+p)*V_l). The flux is formed in double and
+// stored as T (float in the mixed precision mode)
+
+template <int N_UPTS, int N_DIMS, typename T>
+static void inv_flux(int in_n_eles, const double* in_disu_upts, const double* in_JGinv_upts,
+                     T* out_tdisf_upts, double in_gamma)
+{
+  const int n_fields = N_DIMS+2;
+  const int field_stride = N_UPTS*in_n_eles;
+  const int dim_stride = n_fields*field_stride;
+
+#pragma omp parallel for schedule(static)
+  for (int i=0;i<in_n_eles;i++)
+  {
+    const double* u = in_disu_upts + i*N_UPTS;
+    const double* JGinv = in_JGinv_upts + i*N_UPTS*N_DIMS*N_DIMS;
+    T* f = out_tdisf_upts + i*N_UPTS;
+
+    for (int j=0;j<N_UPTS;j++)
+    {
+      const double* G = JGinv + j*N_DIMS*N_DIMS;
+      double rho = u[j];
+      double ene = u[j+(N_DIMS+1)*field_stride];
+      double mom[N_DIMS], vel[N_DIMS];
+      double ke = 0.;
+
+      for (int d=0;d<N_DIMS;d++) {
+        mom[d] = u[j+(d+1)*field_stride];
+        vel[d] = mom[d]/rho;
+        ke += mom[d]*vel[d];
+      }
+
+      double p = (in_gamma-1.0)*(ene-0.5*ke);
+
+      for (int l=0;l<N_DIMS;l++)
+      {
+        double V = 0.;
+        for (int m=0;m<N_DIMS;m++)
+          V += G[l+N_DIMS*m]*vel[m];
+
+        T* f_l = f + j + l*dim_stride;
+        f_l[0] = rho*V;
+        for (int d=0;d<N_DIMS;d++)
+          f_l[(d+1)*field_stride] = mom[d]*V + p*G[l+N_DIMS*d];
+        f_l[(N_DIMS+1)*field_stride] = (ene+p)*V;
+      }
+    }
+  }
+}
+
+// physical gradient grad_m = sum_l grad_l*JGinv(l,m)/J
+
+template <int N_UPTS, int N_DIMS>
+static void transform_grad(int in_n_eles, int in_n_fields, double* inout_grad_disu_upts,
+                           const double* in_JGinv_upts, const double* in_inv_detjac_upts)
+{
+  const int field_stride = N_UPTS*in_n_eles;
+  const int dim_stride = in_n_fields*field_stride;
+
+#pragma omp parallel for schedule(static)
+  for (int i=0;i<in_n_eles;i++)
+  {
+    const double* JGinv = in_JGinv_upts + i*N_UPTS*N_DIMS*N_DIMS;
+    const double* inv_detjac = in_inv_detjac_upts + i*N_UPTS;
+
+    for (int k=0;k<in_n_fields;k++)
+    {
+      double* grad = inout_grad_disu_upts + i*N_UPTS + k*field_stride;
+
+      for (int j=0;j<N_UPTS;j++)
+      {
+        const double* G = JGinv + j*N_DIMS*N_DIMS;
+        double grad_ref[N_DIMS];
+
+        for (int l=0;l<N_DIMS;l++)
+          grad_ref[l] = grad[j+l*dim_stride];
+
+        for (int m=0;m<N_DIMS;m++) {
+          double sum = 0.;
+          for (int l=0;l<N_DIMS;l++)
+            sum += grad_ref[l]*G[l+N_DIMS*m];
+          grad[j+m*dim_stride] = sum*inv_detjac[j];
+        }
+      }
+    }
+  }
+}
+
+// Streaming update of one field over all elements, in memory order. With the residual
+// rhs = src + const_src - div/J: forward Euler u += dt*rhs, or low-storage RK r = a*r + dt*rhs,
+// u += b*r. With NORM the residual is also reduced to its infinity, 1- and squared 2-norm.
+// N_UPTS = 0 takes the no. of points at run time.
+
+template <int N_UPTS, bool LOW_STORAGE, bool NORM>
+static void update(int in_n_upts_per_ele, int in_n_eles, double* inout_u, double* inout_r, const double* in_div,
+                   const double* in_src, const double* in_inv_detjac, const double* in_dt, double in_a, double in_b,
+                   double in_const_src, double* out_norm)
+{
+  const int n_upts = (N_UPTS > 0) ? N_UPTS : in_n_upts_per_ele;
+  double norm_inf = 0., norm_1 = 0., norm_2 = 0.;
+
+#pragma omp parallel for schedule(static) reduction(+:norm_1,norm_2) reduction(max:norm_inf)
+  for (int i=0;i<in_n_eles;i++)
+  {
+    double dt_ele = in_dt[i];
+    double* u = inout_u + i*n_upts;
+    double* r = LOW_STORAGE ? inout_r + i*n_upts : NULL;
+    const double* div = in_div + i*n_upts;
+    const double* src = in_src + i*n_upts;
+    const double* inv_detjac = in_inv_detjac + i*n_upts;
+
+    for (int j=0;j<n_upts;j++)
+    {
+      double rhs = src[j] + in_const_src - div[j]*inv_detjac[j];
+
+      if (LOW_STORAGE) {
+        double res = in_a*r[j] + dt_ele*rhs;
+        r[j] = res;
+        u[j] += in_b*res;
+      }
+      else {
+        u[j] += dt_ele*rhs;
+      }
+
+      if (NORM) {
+        double abs_rhs = fabs(rhs);
+        if (abs_rhs > norm_inf) norm_inf = abs_rhs;
+        norm_1 += abs_rhs;
+        norm_2 += rhs*rhs;
+      }
+    }
+  }
+
+  if (NORM) {
+    out_norm[0] = norm_inf;
+    out_norm[1] = norm_1;
+    out_norm[2] = norm_2;
+  }
+}
+
+template <int N_UPTS>
+static void set_update_kernels(eles_kernels& out_kernels)
+{
+  out_kernels.update[0][0] = update<N_UPTS,false,false>;
+  out_kernels.update[0][1] = update<N_UPTS,false,true>;
+  out_kernels.update[1][0] = update<N_UPTS,true,false>;
+  out_kernels.update[1][1] = update<N_UPTS,true,true>;
+}
+
+template <int ELE_TYPE, int ORDER>
+static int set_kernels(int in_n_upts_per_ele, eles_kernels& out_kernels)
+{
+  typedef ele_traits<ELE_TYPE,ORDER> traits;
+
+  if (traits::n_upts != in_n_upts_per_ele)
+    return 0;
+
+  out_kernels.inv_flux = inv_flux<traits::n_upts,traits::n_dims,double>;
+  out_kernels.inv_flux_sp = inv_flux<traits::n_upts,traits::n_dims,float>;
+  out_kernels.transform_grad = transform_grad<traits::n_upts,traits::n_dims>;
+  set_update_kernels<traits::n_upts>(out_kernels);
+
+  return 1;
+}
+
+template <int ELE_TYPE>
+static int select_order(int in_order, int in_n_upts_per_ele, eles_kernels& out_kernels)
+{
+  switch (in_order)
+  {
+  case 1: return set_kernels<ELE_TYPE,1>(in_n_upts_per_ele,out_kernels);
+  case 2: return set_kernels<ELE_TYPE,2>(in_n_upts_per_ele,out_kernels);
+  case 3: return set_kernels<ELE_TYPE,3>(in_n_upts_per_ele,out_kernels);
+  case 4: return set_kernels<ELE_TYPE,4>(in_n_upts_per_ele,out_kernels);
+  case 5: return set_kernels<ELE_TYPE,5>(in_n_upts_per_ele,out_kernels);
+  case 6: return set_kernels<ELE_TYPE,6>(in_n_upts_per_ele,out_kernels);
+  default: return 0;
+  }
+}
+
+int select_eles_kernels(int in_ele_type, int in_order, int in_n_upts_per_ele, eles_kernels& out_kernels)
+{
+  // generic kernels, used if there is no specialization
+  out_kernels.inv_flux = NULL;
+  out_kernels.inv_flux_sp = NULL;
+  out_kernels.transform_grad = NULL;
+  set_update_kernels<0>(out_kernels);
+
+  switch (in_ele_type)
+  {
+  case 0: return select_order<0>(in_order,in_n_upts_per_ele,out_kernels);
+  case 1: return select_order<1>(in_order,in_n_upts_per_ele,out_kernels);
+  case 2: return select_order<2>(in_order,in_n_upts_per_ele,out_kernels);
+  case 3: return select_order<3>(in_order,in_n_upts_per_ele,out_kernels);
+  case 4: return select_order<4>(in_order,in_n_upts_per_ele,out_kernels);
+  default: return 0;
+  }
+}
@@ -652,7 +652,7 @@ void eles_pris::set_vandermonde_tri_restart()
   inv_vandermonde_tri_rest = inv_array(vandermonde_tri_rest);
 }
 
-int eles_pris::read_restart_info(ifstream& restart_file)
+int eles_pris::read_restart_info(istream& restart_file)
 {
 
   string str;
@@ -697,7 +697,7 @@ int eles_pris::read_restart_info(ifstream& restart_file)
 
 }
 
-void eles_pris::write_restart_info(ofstream& restart_file)        
+void eles_pris::write_restart_info(ostream& restart_file)        
 {
   restart_file << "PRIS" << endl;
 
@@ -1140,7 +1140,7 @@ double eles_pris::eval_div_vcjh_basis(int in_index, array<double>& loc)
       int edge = 0;
 
       if ( face_fpt/(order+1)==upt_1d)
-        div_vcjh_basis = eval_div_dg_tri(loc,edge,edge_fpt,order,loc_upts_pri_1d);
+        div_vcjh_basis = eval_div_dg_tri(loc,edge,edge_fpt,order,loc_upts_pri_1d,get_opp_3_dg_cub_order(order));
       else
         div_vcjh_basis = 0.;
     }
@@ -1152,7 +1152,7 @@ double eles_pris::eval_div_vcjh_basis(int in_index, array<double>& loc)
       int edge = 1;
 
       if (face_fpt/(order+1) == upt_1d)
-        div_vcjh_basis = eval_div_dg_tri(loc,edge,edge_fpt,order,loc_upts_pri_1d);
+        div_vcjh_basis = eval_div_dg_tri(loc,edge,edge_fpt,order,loc_upts_pri_1d,get_opp_3_dg_cub_order(order));
       else
         div_vcjh_basis = 0.;
     }
@@ -1164,7 +1164,7 @@ double eles_pris::eval_div_vcjh_basis(int in_index, array<double>& loc)
       int edge = 2;
 
       if (face_fpt/(order+1) == upt_1d)
-        div_vcjh_basis = eval_div_dg_tri(loc,edge,edge_fpt,order,loc_upts_pri_1d);
+        div_vcjh_basis = eval_div_dg_tri(loc,edge,edge_fpt,order,loc_upts_pri_1d,get_opp_3_dg_cub_order(order));
       else
         div_vcjh_basis = 0.;
     }
@@ -1201,7 +1201,39 @@ double eles_pris::calc_ele_vol(double& detjac)
 /*! Calculate element reference length for timestep calculation */
 double eles_pris::calc_h_ref_specific(int in_ele)
   {
-    FatalError("Reference length calculation not implemented for this element!")
+    double out_h_ref, length[3], dx, s;
+
+    // Smaller of the incircle radius of the triangular faces (vertices 0-2
+    // and 3-5, as for tris) and the length of the edges joining them
+    out_h_ref = 1e16;
+    for (int t=0;t<2;t++)
+      {
+        for (int k=0;k<3;k++)
+          {
+            length[k] = 0.;
+            for (int m=0;m<3;m++)
+              {
+                dx = shape(m,3*t+k,in_ele) - shape(m,3*t+(k+1)%3,in_ele);
+                length[k] += dx*dx;
+              }
+            length[k] = sqrt(length[k]);
+          }
+        s = 0.5*(length[0]+length[1]+length[2]);
+        out_h_ref = min(out_h_ref,sqrt(((s-length[0])*(s-length[1])*(s-length[2]))/s));
+      }
+
+    for (int k=0;k<3;k++)
+      {
+        length[k] = 0.;
+        for (int m=0;m<3;m++)
+          {
+            dx = shape(m,k+3,in_ele) - shape(m,k,in_ele);
+            length[k] += dx*dx;
+          }
+        out_h_ref = min(out_h_ref,sqrt(length[k]));
+      }
+
+    return out_h_ref;
   }
 
 
@@ -0,0 +1,272 @@
+/*!
+ * \file eles_stats.cpp
+ * \brief _____________________________
+ * \author - Original code: SD++ developed by Patrice Castonguay, Antony Jameson,
+ *                          Peter Vincent, David Williams (alphabetical by surname).
+ *         - Current development: Aerospace Computing Laboratory (ACL)
+ *
+ * \version 0.1.0
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ * Copyright (C) 2014 Aerospace Computing Laboratory (ACL).
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <string>
+#include <algorithm>
+
+#include "../include/eles_stats.h"
+#include "../include/error.h"
+
+using namespace std;
+
+static const char* stat_var_names[STAT_N_VARS] = {"rho", "u", "v", "w", "p", "e"};
+
+// sampled variable of a name, -1 if it is not one
+
+static int stat_var(const string& in_name, int in_n_dims)
+{
+  for (int v=0;v<STAT_N_VARS;v++) {
+    if (in_name == stat_var_names[v]) {
+      if (v == STAT_W && in_n_dims == 2)
+        FatalError("average field of w in 2D");
+      return v;
+    }
+  }
+  return -1;
+}
+
+// statistic and variable(s) of an average field <var>_<statistic> or <var1><var2>_covariance
+
+static void parse_average_field(const string& in_name, int in_n_dims, int& out_stat, int& out_a, int& out_b)
+{
+  size_t sep = in_name.rfind('_');
+  if (sep == string::npos)
+    FatalError("average field not recognized");
+
+  string vars = in_name.substr(0,sep);
+  string stat = in_name.substr(sep+1);
+
+  out_a = out_b = -1;
+
+  if (stat == "covariance") {
+    out_stat = STAT_COVARIANCE;
+    for (int v=0;v<STAT_N_VARS && out_b<0;v++) {
+      string name = stat_var_names[v];
+      if (vars.compare(0,name.size(),name) == 0) {
+        out_a = stat_var(name,in_n_dims);
+        out_b = stat_var(vars.substr(name.size()),in_n_dims);
+      }
+    }
+    if (out_b < 0)
+      FatalError("average field not recognized");
+
+    // the covariance of a variable with itself is its variance
+    if (out_a == out_b)
+      out_stat = STAT_VARIANCE;
+    return;
+  }
+
+  if (stat == "average") out_stat = STAT_MEAN;
+  else if (stat == "variance") out_stat = STAT_VARIANCE;
+  else if (stat == "skewness") out_stat = STAT_SKEWNESS;
+  else if (stat == "kurtosis") out_stat = STAT_KURTOSIS;
+  else FatalError("average field not recognized");
+
+  out_a = stat_var(vars,in_n_dims);
+  if (out_a < 0)
+    FatalError("average field not recognized");
+}
+
+void compile_time_stats(array<string>& in_names, int in_n_dims, time_stats& out_stats)
+{
+  int var_index[STAT_N_VARS];
+  for (int v=0;v<STAT_N_VARS;v++)
+    var_index[v] = -1;
+
+  out_stats.n_dims = in_n_dims;
+  out_stats.n_vars = 0;
+  out_stats.n_covs = 0;
+  out_stats.n_fields = in_names.get_dim(0);
+  out_stats.field_stat.setup(out_stats.n_fields);
+  out_stats.field_accum.setup(out_stats.n_fields);
+
+  // index of the sampled variable (or of the covariance) of each field
+  array<int> field_index(out_stats.n_fields);
+
+  for (int f=0;f<out_stats.n_fields;f++)
+  {
+    int stat, a, b;
+    parse_average_field(in_names(f),in_n_dims,stat,a,b);
+
+    // the moment of a field is the highest one needed of its variable
+    int vars[2] = {a, b};
+    int order = (stat == STAT_COVARIANCE) ? 1 : stat+1;
+
+    for (int i=0;i<2 && vars[i]>=0;i++) {
+      int v = vars[i];
+      if (var_index[v] < 0) {
+        var_index[v] = out_stats.n_vars++;
+        out_stats.var[var_index[v]] = v;
+        out_stats.order[var_index[v]] = 1;
+      }
+      if (order > out_stats.order[var_index[v]])
+        out_stats.order[var_index[v]] = order;
+    }
+
+    out_stats.field_stat(f) = stat;
+    field_index(f) = var_index[a];
+
+    if (stat == STAT_COVARIANCE) {
+      int ia = min(var_index[a],var_index[b]);
+      int ib = max(var_index[a],var_index[b]);
+      int c = 0;
+
+      while (c < out_stats.n_covs && (out_stats.cov_a[c] != ia || out_stats.cov_b[c] != ib))
+        c++;
+      if (c == out_stats.n_covs) {
+        out_stats.cov_a[c] = ia;
+        out_stats.cov_b[c] = ib;
+        out_stats.n_covs++;
+      }
+      field_index(f) = c;
+    }
+  }
+
+  // accumulators: the mean and central moments of each variable, then the covariances
+  out_stats.n_accums = 0;
+  for (int v=0;v<out_stats.n_vars;v++) {
+    out_stats.accum[v] = out_stats.n_accums;
+    out_stats.n_accums += out_stats.order[v];
+  }
+  for (int c=0;c<out_stats.n_covs;c++)
+    out_stats.cov_accum[c] = out_stats.n_accums++;
+
+  for (int f=0;f<out_stats.n_fields;f++) {
+    if (out_stats.field_stat(f) == STAT_COVARIANCE)
+      out_stats.field_accum(f) = out_stats.cov_accum[field_index(f)];
+    else
+      out_stats.field_accum(f) = out_stats.accum[field_index(f)];
+  }
+}
+
+// The sample x with weight w is merged into the statistics of weight W: with the deviation
+// d = x - mean, mean += d*w/(W+w) and, for the sums of the powers of the deviations
+// M2 += d^2*W*w/(W+w)
+// M3 += d^3*W*w*(W-w)/(W+w)^2 - 3*d*M2*w/(W+w)
+// M4 += d^4*W*w*(W^2-W*w+w^2)/(W+w)^3 + 6*d^2*M2*(w/(W+w))^2 - 4*d*M3*w/(W+w)
+// C_ab += d_a*d_b*W*w/(W+w)
+// with the old M2, M3 on the right hand sides.
+
+void update_time_stats(time_stats& in_stats, int in_n_pts, const double* in_disu_upts, double in_gamma,
+                       bool in_reset, double in_weight, double in_dt, double* inout_accum_upts, double* out_average_upts)
+{
+  const int n = in_n_pts;
+  const int n_dims = in_stats.n_dims;
+  const int n_vars = in_stats.n_vars;
+  const int n_covs = in_stats.n_covs;
+  const int n_fields = in_stats.n_fields;
+  const int* field_stat = in_stats.field_stat.get_ptr_cpu();
+  const int* field_accum = in_stats.field_accum.get_ptr_cpu();
+
+  const double W = in_reset ? 0. : in_weight;
+  const double w = in_reset ? 0. : in_dt;
+  const double weight = W+w;
+  const double r = (weight > 0.) ? w/weight : 1.;
+  const double inv_weight = (weight > 0.) ? 1./weight : 0.;
+  const double c3 = W*r*(W-w)*inv_weight;
+  const double c4 = W*r*(W*W-W*w+w*w)*inv_weight*inv_weight;
+
+#pragma omp parallel for schedule(static)
+  for (int p=0;p<n;p++)
+  {
+    // sampled variables
+    double q[STAT_N_VARS];
+    double rho = in_disu_upts[p];
+    double ene = in_disu_upts[p+(n_dims+1)*n];
+    double ke = 0.;
+
+    q[STAT_RHO] = rho;
+    q[STAT_W] = 0.;
+    for (int d=0;d<n_dims;d++) {
+      double mom = in_disu_upts[p+(d+1)*n];
+      q[STAT_U+d] = mom/rho;
+      ke += mom*q[STAT_U+d];
+    }
+    q[STAT_P] = (in_gamma-1.0)*(ene-0.5*ke);
+    q[STAT_E] = ene/rho;
+
+    // means and central moments
+    double delta[STAT_N_VARS];
+
+    for (int v=0;v<n_vars;v++)
+    {
+      double* m = inout_accum_upts + p + in_stats.accum[v]*n;
+      int order = in_stats.order[v];
+      double x = q[in_stats.var[v]];
+
+      if (in_reset) {
+        delta[v] = 0.;
+        m[0] = x;
+        for (int k=1;k<order;k++)
+          m[k*n] = 0.;
+        continue;
+      }
+
+      double d = x - m[0];
+      delta[v] = d;
+      m[0] += r*d;
+
+      if (order > 1) {
+        double M2 = m[n];
+        double d2 = d*d;
+        m[n] = M2 + d2*W*r;
+
+        if (order > 2) {
+          double M3 = m[2*n];
+          m[2*n] = M3 + d2*d*c3 - 3.*d*M2*r;
+
+          if (order > 3)
+            m[3*n] += d2*d2*c4 + 6.*d2*M2*r*r - 4.*d*M3*r;
+        }
+      }
+    }
+
+    for (int c=0;c<n_covs;c++) {
+      double* C = inout_accum_upts + p + in_stats.cov_accum[c]*n;
+      *C = in_reset ? 0. : *C + delta[in_stats.cov_a[c]]*delta[in_stats.cov_b[c]]*W*r;
+    }
+
+    // average fields
+    for (int f=0;f<n_fields;f++)
+    {
+      const double* m = inout_accum_upts + p + field_accum[f]*n;
+      double M2 = (field_stat[f] == STAT_MEAN || field_stat[f] == STAT_COVARIANCE) ? 0. : m[n];
+      double value;
+
+      switch (field_stat[f])
+      {
+      case STAT_MEAN: value = m[0]; break;
+      case STAT_VARIANCE: value = M2*inv_weight; break;
+      case STAT_SKEWNESS: value = (M2 > 0.) ? sqrt(weight)*m[2*n]/(M2*sqrt(M2)) : 0.; break;
+      case STAT_KURTOSIS: value = (M2 > 0.) ? weight*m[3*n]/(M2*M2) : 0.; break;
+      default: value = m[0]*inv_weight; break;
+      }
+
+      out_average_upts[p+f*n] = value;
+    }
+  }
+}
@@ -746,7 +746,7 @@ void eles_tets::set_vandermonde_restart()
   inv_vandermonde_rest = inv_array(vandermonde);
 }
 
-int eles_tets::read_restart_info(ifstream& restart_file)
+int eles_tets::read_restart_info(istream& restart_file)
 {
   string str;
   // Move to triangle element
@@ -779,7 +779,7 @@ int eles_tets::read_restart_info(ifstream& restart_file)
 }
 
 // write restart info
-void eles_tets::write_restart_info(ofstream& restart_file)
+void eles_tets::write_restart_info(ostream& restart_file)
 {
   restart_file << "TETS" << endl;
 
@@ -978,7 +978,7 @@ void eles_tets::fill_opp_3(array<double>& opp_3)
 
   compute_filt_matrix_tet(Filt,run_input.vcjh_scheme_tet, run_input.c_tet);
 
-  get_opp_3_dg_tet(opp_3_dg);
+  get_opp_3_dg_tet(opp_3_dg,get_opp_3_dg_cub_order(order));
 
   //cout << "opp_3_dg" << endl;
   //opp_3_dg.print();
@@ -993,7 +993,7 @@ void eles_tets::fill_opp_3(array<double>& opp_3)
 }
 
 
-void eles_tets::get_opp_3_dg_tet(array<double>& opp_3_dg)
+void eles_tets::get_opp_3_dg_tet(array<double>& opp_3_dg, int in_cub_order)
 {
   int i,j,k;
   array<double> loc(n_dims);
@@ -1007,15 +1007,36 @@ void eles_tets::get_opp_3_dg_tet(array<double>& opp_3_dg)
               loc(k)=loc_upts(k,j);
             }
 
-          opp_3_dg(j,i)=eval_div_dg_tet(i,loc);
+          opp_3_dg(j,i)=eval_div_dg_tet(i,loc,in_cub_order);
         }
     }
 }
 
 
+// the face integrands are of degree 2*order, the reference rule is two orders stronger than the one of the residual
+
+double eles_tets::check_opp_3_dg(void)
+{
+  double max_opp = 0., max_diff = 0.;
+
+  array<double> opp_3_dg(n_upts_per_ele,n_fpts_per_ele);
+  array<double> opp_3_dg_exact(n_upts_per_ele,n_fpts_per_ele);
+
+  get_opp_3_dg_tet(opp_3_dg,get_opp_3_dg_cub_order(order));
+  get_opp_3_dg_tet(opp_3_dg_exact,get_opp_3_dg_cub_order(order)+2);
+
+  for (int i=0;i<n_fpts_per_ele;i++)
+    for (int j=0;j<n_upts_per_ele;j++) {
+        max_opp = max(max_opp,fabs(opp_3_dg_exact(j,i)));
+        max_diff = max(max_diff,fabs(opp_3_dg(j,i)-opp_3_dg_exact(j,i)));
+      }
+
+  return max_diff/max_opp;
+}
+
 // evaluate divergence of dg basis
 
-double eles_tets::eval_div_dg_tet(int in_index, array<double>& loc)
+double eles_tets::eval_div_dg_tet(int in_index, array<double>& loc, int in_cub_order)
 {
   int face, face_fpt;
   double r,s,t;
@@ -1078,7 +1099,7 @@ double eles_tets::eval_div_dg_tet(int in_index, array<double>& loc)
   // 2. Perform the edge integrals to obtain coefficients sigma_i
   for (int i=0;i<n_upts_per_ele;i++)
     {
-      cubature_tri cub2d(12); //TODO: Check if strong enough
+      cubature_tri cub2d(in_cub_order);
       integral = 0.;
 
       for (int j=0;j<cub2d.get_n_pts();j++)
@@ -1425,5 +1446,34 @@ double eles_tets::calc_ele_vol(double& detjac)
 /*! Calculate element reference length for timestep calculation */
 double eles_tets::calc_h_ref_specific(int in_ele)
   {
-    FatalError("Reference length calculation not implemented for this element!")
+    double e[3][3], n[3];
+    double vol, area;
+
+    // Radius of the inscribed sphere, 3*volume/surface (as the incircle for tris)
+    for (int k=0;k<3;k++)
+      for (int m=0;m<3;m++)
+        e[k][m] = shape(m,k+1,in_ele) - shape(m,0,in_ele);
+
+    vol = fabs(e[0][0]*(e[1][1]*e[2][2]-e[1][2]*e[2][1])
+              -e[0][1]*(e[1][0]*e[2][2]-e[1][2]*e[2][0])
+              +e[0][2]*(e[1][0]*e[2][1]-e[1][1]*e[2][0]))/6.;
+
+    static const int face[4][3] = {{0,1,2},{0,1,3},{0,2,3},{1,2,3}};
+
+    area = 0.;
+    for (int f=0;f<4;f++)
+      {
+        double a[3], b[3];
+        for (int m=0;m<3;m++)
+          {
+            a[m] = shape(m,face[f][1],in_ele) - shape(m,face[f][0],in_ele);
+            b[m] = shape(m,face[f][2],in_ele) - shape(m,face[f][0],in_ele);
+          }
+        n[0] = a[1]*b[2]-a[2]*b[1];
+        n[1] = a[2]*b[0]-a[0]*b[2];
+        n[2] = a[0]*b[1]-a[1]*b[0];
+        area += 0.5*sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
+      }
+
+    return 3.*vol/area;
   }
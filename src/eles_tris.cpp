@@ -508,7 +508,7 @@ void eles_tris::set_vandermonde_restart()
 }
 
 /*! read restart info */
-int eles_tris::read_restart_info(ifstream& restart_file)
+int eles_tris::read_restart_info(istream& restart_file)
 {
 
   string str;
@@ -543,7 +543,7 @@ int eles_tris::read_restart_info(ifstream& restart_file)
 }
 
 // write restart info
-void eles_tris::write_restart_info(ofstream& restart_file)
+void eles_tris::write_restart_info(ostream& restart_file)
 {
   restart_file << "TRIS" << endl;
 
@@ -646,6 +646,27 @@ void eles_tris::fill_opp_3(array<double>& opp_3)
   get_opp_3_tri(opp_3,loc_upts,loc_1d_fpts,vandermonde,inv_vandermonde,n_upts_per_ele, order, run_input.c_tri, run_input.vcjh_scheme_tri);
 }
 
+// the edge integrands are of degree 2*order, the reference rule is two orders stronger than the one of the residual
+
+double eles_tris::check_opp_3_dg(void)
+{
+  double max_opp = 0., max_diff = 0.;
+
+  array<double> opp_3_dg(n_upts_per_ele,n_fpts_per_ele);
+  array<double> opp_3_dg_exact(n_upts_per_ele,n_fpts_per_ele);
+
+  get_opp_3_dg(opp_3_dg,loc_upts,loc_1d_fpts,n_upts_per_ele,order,get_opp_3_dg_cub_order(order));
+  get_opp_3_dg(opp_3_dg_exact,loc_upts,loc_1d_fpts,n_upts_per_ele,order,get_opp_3_dg_cub_order(order)+2);
+
+  for (int i=0;i<n_fpts_per_ele;i++)
+    for (int j=0;j<n_upts_per_ele;j++) {
+        max_opp = max(max_opp,fabs(opp_3_dg_exact(j,i)));
+        max_diff = max(max_diff,fabs(opp_3_dg(j,i)-opp_3_dg_exact(j,i)));
+      }
+
+  return max_diff/max_opp;
+}
+
 // Filtering operators for use in subgrid-scale modelling
 void eles_tris::compute_filter_upts(void)
 {
@@ -377,12 +377,19 @@ void get_opp_3_tri(array<double>& opp_3, array<double>& loc_upts_tri, array<doub
 
   compute_filt_matrix_tri(Filt,vandermonde_tri,inv_vandermonde_tri,n_upts_per_tri,order,c_tri,vcjh_scheme_tri,loc_upts_tri);
 
-  get_opp_3_dg(opp_3_dg, loc_upts_tri, loc_1d_fpts, n_upts_per_tri, order);
+  get_opp_3_dg(opp_3_dg, loc_upts_tri, loc_1d_fpts, n_upts_per_tri, order, get_opp_3_dg_cub_order(order));
   m_temp = mult_arrays(Filt,opp_3_dg);
   opp_3 = array<double> (m_temp);
 }
 
-void get_opp_3_dg(array<double>& opp_3_dg, array<double>& loc_upts_tri, array<double>& loc_1d_fpts, int n_upts_per_tri, int order)
+// a Gauss rule of strength n has (n+1)/2 points, i.e. it is exact to degree 2*((n+1)/2)-1
+
+int get_opp_3_dg_cub_order(int in_order)
+{
+  return max(10,2*in_order)+2;
+}
+
+void get_opp_3_dg(array<double>& opp_3_dg, array<double>& loc_upts_tri, array<double>& loc_1d_fpts, int n_upts_per_tri, int order, int in_cub_order)
 {
 
   int i,j,k;
@@ -400,7 +407,7 @@ void get_opp_3_dg(array<double>& opp_3_dg, array<double>& loc_upts_tri, array<do
           int edge = i/ (order+1);
           int edge_fpt = i%(order+1);
 
-          opp_3_dg(j,i)=eval_div_dg_tri(loc,edge,edge_fpt,order,loc_1d_fpts);
+          opp_3_dg(j,i)=eval_div_dg_tri(loc,edge,edge_fpt,order,loc_1d_fpts,in_cub_order);
         }
     }
 }
@@ -803,7 +810,7 @@ void compute_filt_matrix_tri(array<double>& Filt, array<double>& vandermonde_tri
 }
 
 
-double eval_div_dg_tri(array<double> &in_loc , int in_edge, int in_edge_fpt, int in_order, array<double> &in_loc_fpts_1d)
+double eval_div_dg_tri(array<double> &in_loc , int in_edge, int in_edge_fpt, int in_order, array<double> &in_loc_fpts_1d, int in_cub_order)
 {
   int n_upts_tri = (in_order+1)*(in_order+2)/2;
 
@@ -816,7 +823,7 @@ double eval_div_dg_tri(array<double> &in_loc , int in_edge, int in_edge_fpt, int
   array<double> coeff_gdotn((in_order+1),1);
   array<double> coeff_divg(n_upts_tri,1);
 
-  cubature_1d cub1d(10);  // TODO: CHECK STRENGTH
+  cubature_1d cub1d(in_cub_order);
 
   if (in_edge==0)
     edge_length=2.;
@@ -26,6 +26,8 @@
 #include <iostream>
 #include <sstream>
 #include <cmath>
+#include <vector>
+#include <algorithm>
 
 #include "../include/global.h"
 #include "../include/array.h"
@@ -36,6 +38,8 @@
 #include "../include/funcs.h"
 #include "../include/error.h"
 #include "../include/solution.h"
+#include "../include/gmsh4_file.h"
+#include "../include/mesh_cache.h"
 
 #ifdef _TECIO
 #include "TECIO.h"
@@ -69,6 +73,9 @@ void SetInput(struct solution* FlowSol) {
   FlowSol->restart_dump_freq  = run_input.restart_dump_freq;
   FlowSol->write_type         = run_input.write_type;
   FlowSol->ini_iter           = 0;
+  FlowSol->dt_next            = run_input.dt;
+  FlowSol->rk_err_prev        = 1.;
+  FlowSol->dt_init            = run_input.dt;
 
   /*! Number of edges/faces for different type of cells. */
   FlowSol->num_f_per_c.setup(5);
@@ -118,6 +125,150 @@ void SetInput(struct solution* FlowSol) {
 
 }
 
+void color_elements(array<int>& in_f2c, array<int>& in_ctype, array<int>& in_local_c, struct solution* FlowSol)
+{
+  int n_eles = FlowSol->num_eles;
+  int ic0, ic1, col;
+
+  // Face neighbours of each cell in compressed rows (cyclic faces are already matched)
+  array<int> nb_sta(n_eles+1);
+  nb_sta.initialize_to_value(0);
+
+  for (int i=0;i<FlowSol->num_inters;i++) {
+      if (in_f2c(i,1)!=-1) {
+          nb_sta(in_f2c(i,0)+1)++;
+          nb_sta(in_f2c(i,1)+1)++;
+        }
+    }
+  for (int ic=0;ic<n_eles;ic++)
+    nb_sta(ic+1) += nb_sta(ic);
+
+  array<int> nb(max(nb_sta(n_eles),1));
+  array<int> fill(n_eles);
+  fill.initialize_to_value(0);
+
+  for (int i=0;i<FlowSol->num_inters;i++) {
+      ic0 = in_f2c(i,0);
+      ic1 = in_f2c(i,1);
+      if (ic1!=-1) {
+          nb(nb_sta(ic0)+fill(ic0)++) = ic1;
+          nb(nb_sta(ic1)+fill(ic1)++) = ic0;
+        }
+    }
+
+  // Greedy colouring: the residual of a cell depends on its face neighbours, and through
+  // the gradients of the viscous flux also on their neighbours, so cells that are
+  // perturbed together must be distance 1 (inviscid) or distance 2 (viscous) apart
+  array<int> color(n_eles);
+  color.initialize_to_value(-1);
+  vector<int> stamp;
+
+  for (int ic=0;ic<n_eles;ic++) {
+      for (int j=nb_sta(ic);j<nb_sta(ic+1);j++) {
+          ic0 = nb(j);
+          if (color(ic0)!=-1)
+            stamp[color(ic0)] = ic;
+
+          if (FlowSol->viscous) {
+              for (int k=nb_sta(ic0);k<nb_sta(ic0+1);k++) {
+                  ic1 = nb(k);
+                  if (ic1!=ic && color(ic1)!=-1)
+                    stamp[color(ic1)] = ic;
+                }
+            }
+        }
+
+      col = 0;
+      while (col<(int)stamp.size() && stamp[col]==ic)
+        col++;
+      if (col==(int)stamp.size())
+        stamp.push_back(-1);
+
+      color(ic) = col;
+      FlowSol->mesh_eles(in_ctype(ic))->set_color(in_local_c(ic),col);
+    }
+}
+
+void assign_lts_levels(array<double>& in_xv, array<int>& in_c2v, array<int>& in_c2n_v, array<int>& in_f2c, array<int>& in_f2loc_f, array<int>& in_bctype_c, array<int>& out_level, struct solution* FlowSol)
+{
+  int n_eles = FlowSol->num_eles;
+  int n_levels = run_input.n_lts_levels;
+  int ic0, ic1;
+  double d, h_max = 0.;
+
+  // Size of each cell: smallest distance between two of its shape nodes
+  array<double> h(n_eles);
+
+  for (int ic=0;ic<n_eles;ic++) {
+      h(ic) = 1.e16;
+      for (int j=0;j<in_c2n_v(ic);j++)
+        for (int k=0;k<j;k++) {
+            d = 0.;
+            for (int m=0;m<FlowSol->n_dims;m++)
+              d += pow(in_xv(in_c2v(ic,j),m)-in_xv(in_c2v(ic,k),m),2);
+            h(ic) = min(h(ic),sqrt(d));
+          }
+      h_max = max(h_max,h(ic));
+    }
+
+#ifdef _MPI
+  MPI_Allreduce(MPI_IN_PLACE,&h_max,1,MPI_DOUBLE,MPI_MAX,MPI_COMM_WORLD);
+#endif
+
+  // The stable timestep scales with the cell size, level k advances with dt/2^k
+  for (int ic=0;ic<n_eles;ic++)
+    out_level(ic) = min(n_levels-1,(int)floor(log(h_max/h(ic))/log(2.)));
+
+  // Cells on MPI and cyclic faces are on the finest level, so that only the finest level
+  // exchanges with other partitions and the cyclic faces need not be matched yet
+  for (int i=0;i<FlowSol->num_inters;i++) {
+      int bctype_f = in_bctype_c(in_f2c(i,0),in_f2loc_f(i,0));
+      if (in_f2c(i,1)==-1 && (bctype_f==0 || bctype_f==9))
+        out_level(in_f2c(i,0)) = n_levels-1;
+    }
+
+  // Face neighbours differ by one level at most
+  bool changed = true;
+  while (changed) {
+      changed = false;
+      for (int i=0;i<FlowSol->num_inters;i++) {
+          ic0 = in_f2c(i,0);
+          ic1 = in_f2c(i,1);
+          if (ic1==-1) continue;
+
+          if (out_level(ic0) < out_level(ic1)-1) {
+              out_level(ic0) = out_level(ic1)-1;
+              changed = true;
+            }
+          if (out_level(ic1) < out_level(ic0)-1) {
+              out_level(ic1) = out_level(ic0)-1;
+              changed = true;
+            }
+        }
+    }
+
+  array<int> n_level(n_levels);
+  n_level.initialize_to_value(0);
+  for (int ic=0;ic<n_eles;ic++)
+    n_level(out_level(ic))++;
+
+#ifdef _MPI
+  MPI_Allreduce(MPI_IN_PLACE,n_level.get_ptr_cpu(),n_levels,MPI_INT,MPI_SUM,MPI_COMM_WORLD);
+#endif
+
+  if (FlowSol->rank==0)
+    for (int l=0;l<n_levels;l++)
+      cout << "local time stepping level " << l << " (dt/" << (1<<l) << "): " << n_level(l) << " cells" << endl;
+}
+
+// interface group of an interior face: face type of its no. of vertices, lower level of its
+// elements and whether their levels differ
+
+static int get_int_inter_type(int in_n_v, int in_level_l, int in_level_r)
+{
+  return (in_n_v-2) + 3*(2*min(in_level_l,in_level_r) + (in_level_l!=in_level_r));
+}
+
 int get_bc_number(string& bcname) {
 
   int bcflag;
@@ -152,56 +303,95 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
   array<double> xv;
   array<int> c2v,c2n_v,ctype,bctype_c,ic2icg,iv2ivg;
 
-  /*! Reading vertices and cells. */
-  ReadMesh(run_input.mesh_file, xv, c2v, c2n_v, ctype, ic2icg, iv2ivg, FlowSol->num_eles, FlowSol->num_verts, Mesh.n_verts_global, FlowSol);
-
-  // ** TODO: clean up duplicate/redundant data between Mesh and FlowSol **
-  Mesh.setup(FlowSol,xv,c2v,c2n_v,iv2ivg,ctype);
-
-  /////////////////////////////////////////////////
-  /// Set connectivity
-  /////////////////////////////////////////////////
-
   array<int> f2c,f2loc_f,c2f,c2e,f2v,f2nv;
   array<int> rot_tag,unmatched_inters;
   int n_unmatched_inters;
 
-  // cannot have more than num_eles*6 faces
-  int max_inters = FlowSol->num_eles*MAX_F_PER_C;
+  // a valid preprocessed mesh cache replaces reading and connectivity
+  mesh_cache cache;
+  int cached = 0;
+  if (run_input.mesh_cache)
+    cached = cache.open(FlowSol);
 
-  f2c.setup(max_inters,2);
-  f2v.setup(max_inters,MAX_V_PER_F); // each edge/face cannot have more than 4 vertices
-  f2nv.setup(max_inters);
-  f2loc_f.setup(max_inters,2);
-  c2f.setup(FlowSol->num_eles,MAX_F_PER_C); // one cell cannot have more than 8 faces
-  c2e.setup(FlowSol->num_eles,MAX_E_PER_C); // one cell cannot have more than 8 faces
-  rot_tag.setup(max_inters);
-  unmatched_inters.setup(max_inters);
+  if (!cached) {
 
-  Mesh.v2e.setup(Mesh.n_verts);
-  Mesh.v2n_e.setup(Mesh.n_verts);
-  Mesh.v2n_e.initialize_to_zero();
+    /*! Reading vertices and cells. */
+    ReadMesh(run_input.mesh_file, xv, c2v, c2n_v, ctype, ic2icg, iv2ivg, FlowSol->num_eles, FlowSol->num_verts, Mesh.n_verts_global, FlowSol);
 
-  // Initialize arrays to -1
-  f2c.initialize_to_value(-1);
-  f2loc_f.initialize_to_value(-1);
-  c2f.initialize_to_value(-1);
+    /////////////////////////////////////////////////
+    /// Set connectivity
+    /////////////////////////////////////////////////
+
+    // cannot have more than num_eles*6 faces
+    int max_inters = FlowSol->num_eles*MAX_F_PER_C;
+
+    f2c.setup(max_inters,2);
+    f2v.setup(max_inters,MAX_V_PER_F); // each edge/face cannot have more than 4 vertices
+    f2nv.setup(max_inters);
+    f2loc_f.setup(max_inters,2);
+    c2f.setup(FlowSol->num_eles,MAX_F_PER_C); // one cell cannot have more than 8 faces
+    c2e.setup(FlowSol->num_eles,MAX_E_PER_C); // one cell cannot have more than 8 faces
+    rot_tag.setup(max_inters);
+    unmatched_inters.setup(max_inters);
+
+    Mesh.v2e.setup(FlowSol->num_verts);
+    Mesh.v2n_e.setup(FlowSol->num_verts);
+    Mesh.v2n_e.initialize_to_zero();
 
-  array<int> icvsta, icvert;
+    // Initialize arrays to -1
+    f2c.initialize_to_value(-1);
+    f2loc_f.initialize_to_value(-1);
+    c2f.initialize_to_value(-1);
 
-  // Compute connectivity
-  if (FlowSol->rank==0) cout << "Setting up mesh connectivity" << endl;
+    array<int> icvsta, icvert;
 
-  //CompConnectivity(c2v, c2n_v, ctype, c2f, c2e, f2c, f2loc_f, f2v, f2nv, rot_tag, unmatched_inters, n_unmatched_inters, icvsta, icvert, FlowSol->num_inters, FlowSol->num_edges, FlowSol);
-  CompConnectivity(c2v, c2n_v, ctype, c2f, c2e, f2c, f2loc_f, f2v, f2nv, Mesh.e2v, Mesh.v2n_e, Mesh.v2e, rot_tag,
-                   unmatched_inters, n_unmatched_inters, icvsta, icvert, FlowSol->num_inters, FlowSol->num_edges, FlowSol);
+    // Compute connectivity
+    if (FlowSol->rank==0) cout << "Setting up mesh connectivity" << endl;
 
-  if (FlowSol->rank==0) cout << "Done setting up mesh connectivity" << endl;
+    //CompConnectivity(c2v, c2n_v, ctype, c2f, c2e, f2c, f2loc_f, f2v, f2nv, rot_tag, unmatched_inters, n_unmatched_inters, icvsta, icvert, FlowSol->num_inters, FlowSol->num_edges, FlowSol);
+    CompConnectivity(c2v, c2n_v, ctype, c2f, c2e, f2c, f2loc_f, f2v, f2nv, Mesh.e2v, Mesh.v2n_e, Mesh.v2e, rot_tag,
+                     unmatched_inters, n_unmatched_inters, icvsta, icvert, FlowSol->num_inters, FlowSol->num_edges, FlowSol);
 
-  // Reading boundaries
-  //ReadBound(run_input.mesh_file,c2v,c2n_v,ctype,bctype_c,ic2icg,icvsta,icvert,iv2ivg,FlowSol->num_eles,FlowSol->num_verts, FlowSol);
-  ReadBound(run_input.mesh_file,c2v,c2n_v,c2f,f2v,f2nv,ctype,bctype_c,Mesh.boundPts,Mesh.bc_list,Mesh.bound_flags,ic2icg,
-            icvsta,icvert,iv2ivg,FlowSol->num_eles,FlowSol->num_verts,FlowSol);
+    if (FlowSol->rank==0) cout << "Done setting up mesh connectivity" << endl;
+
+    // Reading boundaries
+    //ReadBound(run_input.mesh_file,c2v,c2n_v,ctype,bctype_c,ic2icg,icvsta,icvert,iv2ivg,FlowSol->num_eles,FlowSol->num_verts, FlowSol);
+    ReadBound(run_input.mesh_file,c2v,c2n_v,c2f,f2v,f2nv,ctype,bctype_c,Mesh.boundPts,Mesh.bc_list,Mesh.bound_flags,ic2icg,
+              icvsta,icvert,iv2ivg,FlowSol->num_eles,FlowSol->num_verts,FlowSol);
+  }
+
+  // Read or write the cache, before the cyclic faces are split
+  cache.io(FlowSol->n_dims);
+  cache.io(FlowSol->num_eles);
+  cache.io(FlowSol->num_verts);
+  cache.io(Mesh.n_verts_global);
+  cache.io(FlowSol->num_inters);
+  cache.io(FlowSol->num_edges);
+  cache.io(n_unmatched_inters);
+  cache.io(xv);
+  cache.io(c2v);
+  cache.io(c2n_v);
+  cache.io(ctype);
+  cache.io(ic2icg);
+  cache.io(iv2ivg);
+  cache.io(bctype_c);
+  cache.io(f2c);
+  cache.io(f2loc_f);
+  cache.io(c2f);
+  cache.io(c2e);
+  cache.io(f2v);
+  cache.io(f2nv);
+  cache.io(rot_tag);
+  cache.io(unmatched_inters);
+  cache.io(Mesh.e2v);
+  cache.io(Mesh.v2n_e);
+  cache.io(Mesh.v2e);
+  cache.io(Mesh.boundPts);
+  cache.io(Mesh.bc_list);
+  cache.io(Mesh.bound_flags);
+
+  // ** TODO: clean up duplicate/redundant data between Mesh and FlowSol **
+  Mesh.setup(FlowSol,xv,c2v,c2n_v,iv2ivg,ctype);
 
   // ** TODO: clean up duplicate/redundant data **
   Mesh.c2f = c2f;
@@ -219,6 +409,17 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
   /// Initializing Elements
   /////////////////////////////////////////////////
 
+  // Local time stepping level of each cell, and its element slot: type + 5*level
+  int n_levels = run_input.n_lts_levels;
+  array<int> lts_level(FlowSol->num_eles), ele_slot(FlowSol->num_eles);
+  lts_level.initialize_to_value(0);
+
+  if (n_levels>1)
+    assign_lts_levels(xv,c2v,c2n_v,f2c,f2loc_f,bctype_c,lts_level,FlowSol);
+
+  for (int i=0;i<FlowSol->num_eles;i++)
+    ele_slot(i) = ctype(i) + 5*lts_level(i);
+
   // Count the number of elements of each type
   int num_tris = 0;
   int num_quads= 0;
@@ -242,28 +443,8 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
       FatalError("Error in mesh reader, n_dims=3 and 2d elements exists");
     }
 
-  // For each element type, count the maximum number of shape points per element
-  int max_n_spts_per_tri = 0;
-  int max_n_spts_per_quad= 0;
-  int max_n_spts_per_tet = 0;
-  int max_n_spts_per_pri = 0;
-  int max_n_spts_per_hexa = 0;
-
-  for (int i=0;i<FlowSol->num_eles;i++) {
-      if (ctype(i)==0 && c2n_v(i) > max_n_spts_per_tri ) // triangle
-        max_n_spts_per_tri = c2n_v(i);
-      else if (ctype(i)==1 && c2n_v(i) > max_n_spts_per_quad ) // quad
-        max_n_spts_per_quad = c2n_v(i);
-      else if (ctype(i)==2 && c2n_v(i) > max_n_spts_per_tet) // tet
-        max_n_spts_per_tet = c2n_v(i);
-      else if (ctype(i)==3 && c2n_v(i) > max_n_spts_per_pri) // pri
-        max_n_spts_per_pri = c2n_v(i);
-      else if (ctype(i)==4 && c2n_v(i) > max_n_spts_per_hexa) // hexa
-        max_n_spts_per_hexa = c2n_v(i);
-    }
-
-  // Initialize the mesh_eles
-  FlowSol->n_ele_types=5;
+  // Initialize the mesh_eles, the slots of the finer levels are allocated here
+  FlowSol->n_ele_types=5*n_levels;
   FlowSol->mesh_eles.setup(FlowSol->n_ele_types);
 
   FlowSol->mesh_eles(0) = &FlowSol->mesh_eles_tris;
@@ -272,12 +453,26 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
   FlowSol->mesh_eles(3) = &FlowSol->mesh_eles_pris;
   FlowSol->mesh_eles(4) = &FlowSol->mesh_eles_hexas;
 
+  for (int l=1;l<n_levels;l++)
+    {
+      FlowSol->mesh_eles(5*l) = new eles_tris;
+      FlowSol->mesh_eles(5*l+1) = new eles_quads;
+      FlowSol->mesh_eles(5*l+2) = new eles_tets;
+      FlowSol->mesh_eles(5*l+3) = new eles_pris;
+      FlowSol->mesh_eles(5*l+4) = new eles_hexas;
+    }
+
+  // For each slot, count the elements and the maximum number of shape points per element
+  array<int> n_eles_slot(FlowSol->n_ele_types);
   array<int> max_n_spts(FlowSol->n_ele_types);
-  max_n_spts(0) = max_n_spts_per_tri;
-  max_n_spts(1) = max_n_spts_per_quad;
-  max_n_spts(2) = max_n_spts_per_tet;
-  max_n_spts(3) = max_n_spts_per_pri;
-  max_n_spts(4) = max_n_spts_per_hexa;
+  n_eles_slot.initialize_to_value(0);
+  max_n_spts.initialize_to_value(0);
+
+  for (int i=0;i<FlowSol->num_eles;i++) {
+      n_eles_slot(ele_slot(i))++;
+      if (c2n_v(i) > max_n_spts(ele_slot(i)))
+        max_n_spts(ele_slot(i)) = c2n_v(i);
+    }
 
   for (int i=0;i<FlowSol->n_ele_types;i++)
     {
@@ -287,125 +482,45 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
   if (FlowSol->rank==0)
     cout << endl << "---------------- Flux Reconstruction Preprocessing ----------------" << endl;
 
+  const char* ele_names[5] = {"tris","quads","tets","pris","hexas"};
+
   if (FlowSol->rank==0) cout << "initializing elements" << endl;
-  if (FlowSol->rank==0) cout << "tris" << endl;
-  FlowSol->mesh_eles_tris.setup(num_tris,max_n_spts_per_tri);
-  if (FlowSol->rank==0) cout << "quads" << endl;
-  FlowSol->mesh_eles_quads.setup(num_quads,max_n_spts_per_quad);
-  if (FlowSol->rank==0) cout << "tets" << endl;
-  FlowSol->mesh_eles_tets.setup(num_tets,max_n_spts_per_tet);
-  if (FlowSol->rank==0) cout << "pris" << endl;
-  FlowSol->mesh_eles_pris.setup(num_pris,max_n_spts_per_pri);
-  if (FlowSol->rank==0) cout << "hexas" << endl;
-  FlowSol->mesh_eles_hexas.setup(num_hexas,max_n_spts_per_hexa);
+  for (int i=0;i<FlowSol->n_ele_types;i++)
+    {
+      if (FlowSol->rank==0) {
+          cout << ele_names[i%5];
+          if (n_levels>1) cout << " (level " << i/5 << ")";
+          cout << endl;
+        }
+      FlowSol->mesh_eles(i)->setup(n_eles_slot(i),max_n_spts(i));
+      FlowSol->mesh_eles(i)->set_lts_level(i/5);
+    }
   if (FlowSol->rank==0) cout << "done initializing elements" << endl;
 
   // Set shape for each cell
   array<int> local_c(FlowSol->num_eles);
-
-  int tris_count = 0;
-  int quads_count = 0;
-  int tets_count = 0;
-  int pris_count = 0;
-  int hexas_count = 0;
+  array<int> n_set(FlowSol->n_ele_types);
+  n_set.initialize_to_value(0);
 
   array<double> pos(FlowSol->n_dims);
 
   if (FlowSol->rank==0) cout << "setting elements shape ... ";
   for (int i=0;i<FlowSol->num_eles;i++) {
-      if (ctype(i) == 0) //tri
-        {
-          local_c(i) = tris_count;
-          FlowSol->mesh_eles_tris.set_n_spts(tris_count,c2n_v(i));
-          FlowSol->mesh_eles_tris.set_ele2global_ele(tris_count,ic2icg(i));
-
-          for (int j=0;j<c2n_v(i);j++)
-            {
-              pos(0) = xv(c2v(i,j),0);
-              pos(1) = xv(c2v(i,j),1);
-              FlowSol->mesh_eles_tris.set_shape_node(j,tris_count,pos);
-            }
-
-          for (int j=0;j<3;j++) {
-              FlowSol->mesh_eles_tris.set_bctype(tris_count,j,bctype_c(i,j));
-            }
+      eles* mesh_eles = FlowSol->mesh_eles(ele_slot(i));
 
-          tris_count++;
-        }
-      else if (ctype(i) == 1) // quad
-        {
-          local_c(i) = quads_count;
-          FlowSol->mesh_eles_quads.set_n_spts(quads_count,c2n_v(i));
-          FlowSol->mesh_eles_quads.set_ele2global_ele(quads_count,ic2icg(i));
-          for (int j=0;j<c2n_v(i);j++)
-            {
-              pos(0) = xv(c2v(i,j),0);
-              pos(1) = xv(c2v(i,j),1);
-              FlowSol->mesh_eles_quads.set_shape_node(j,quads_count,pos);
-            }
+      local_c(i) = n_set(ele_slot(i))++;
+      mesh_eles->set_n_spts(local_c(i),c2n_v(i));
+      mesh_eles->set_ele2global_ele(local_c(i),ic2icg(i));
 
-          for (int j=0;j<4;j++) {
-              FlowSol->mesh_eles_quads.set_bctype(quads_count,j,bctype_c(i,j));
-            }
-
-          quads_count++;
-        }
-      else if (ctype(i) == 2) //tet
+      for (int j=0;j<c2n_v(i);j++)
         {
-          local_c(i) = tets_count;
-          FlowSol->mesh_eles_tets.set_n_spts(tets_count,c2n_v(i));
-          FlowSol->mesh_eles_tets.set_ele2global_ele(tets_count,ic2icg(i));
-          for (int j=0;j<c2n_v(i);j++)
-            {
-              pos(0) = xv(c2v(i,j),0);
-              pos(1) = xv(c2v(i,j),1);
-              pos(2) = xv(c2v(i,j),2);
-              FlowSol->mesh_eles_tets.set_shape_node(j,tets_count,pos);
-            }
-
-          for (int j=0;j<4;j++) {
-              FlowSol->mesh_eles_tets.set_bctype(tets_count,j,bctype_c(i,j));
-            }
-
-          tets_count++;
-        }
-      else if (ctype(i) == 3) //pri
-        {
-          local_c(i) = pris_count;
-          FlowSol->mesh_eles_pris.set_n_spts(pris_count,c2n_v(i));
-          FlowSol->mesh_eles_pris.set_ele2global_ele(pris_count,ic2icg(i));
-          for (int j=0;j<c2n_v(i);j++)
-            {
-              pos(0) = xv(c2v(i,j),0);
-              pos(1) = xv(c2v(i,j),1);
-              pos(2) = xv(c2v(i,j),2);
-              FlowSol->mesh_eles_pris.set_shape_node(j,pris_count,pos);
-            }
-
-          for (int j=0;j<5;j++) {
-              FlowSol->mesh_eles_pris.set_bctype(pris_count,j,bctype_c(i,j));
-            }
-
-          pris_count++;
+          for (int m=0;m<FlowSol->n_dims;m++)
+            pos(m) = xv(c2v(i,j),m);
+          mesh_eles->set_shape_node(j,local_c(i),pos);
         }
-      else if (ctype(i) == 4) //hex
-        {
-          local_c(i) = hexas_count;
-          FlowSol->mesh_eles_hexas.set_n_spts(hexas_count,c2n_v(i));
-          FlowSol->mesh_eles_hexas.set_ele2global_ele(hexas_count,ic2icg(i));
-          for (int j=0;j<c2n_v(i);j++)
-            {
-              pos(0) = xv(c2v(i,j),0);
-              pos(1) = xv(c2v(i,j),1);
-              pos(2) = xv(c2v(i,j),2);
-              FlowSol->mesh_eles_hexas.set_shape_node(j,hexas_count,pos);
-            }
-
-          for (int j=0;j<6;j++) {
-              FlowSol->mesh_eles_hexas.set_bctype(hexas_count,j,bctype_c(i,j));
-            }
 
-          hexas_count++;
+      for (int j=0;j<FlowSol->num_f_per_c(ctype(i));j++) {
+          mesh_eles->set_bctype(local_c(i),j,bctype_c(i,j));
         }
     }
   if (FlowSol->rank==0) cout << "done." << endl;
@@ -414,6 +529,7 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
   if (FlowSol->rank==0) cout << "pre-computing nodal shape-basis functions ... " << flush;
   for(int i=0;i<FlowSol->n_ele_types;i++) {
     if (FlowSol->mesh_eles(i)->get_n_eles()!=0) {
+      FlowSol->mesh_eles(i)->setup_s_basis();
       FlowSol->mesh_eles(i)->store_nodal_s_basis_fpts();
       FlowSol->mesh_eles(i)->store_nodal_s_basis_upts();
       FlowSol->mesh_eles(i)->store_nodal_s_basis_ppts();
@@ -503,6 +619,25 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
   int bctype_f, found, rtag;
   int ic_l,ic_r;
 
+  // Sort the centroids of the unmatched faces so that cyclic partners are found by binary search
+  array<double> center_unmatched(FlowSol->n_dims,n_unmatched_inters);
+  array<double> key_unmatched;
+  array<int> order_unmatched;
+  vector<int> candidates;
+
+  for (int j=0;j<n_unmatched_inters;j++) {
+      int i2 = unmatched_inters(j);
+
+      for (int m=0;m<FlowSol->n_dims;m++)
+        center_unmatched(m,j) = 0.;
+
+      for (int k=0;k<f2nv(i2);k++)
+        for (int m=0;m<FlowSol->n_dims;m++)
+          center_unmatched(m,j) += xv(f2v(i2,k),m)/f2nv(i2);
+    }
+
+  sort_face_centers(center_unmatched,n_unmatched_inters,tol,key_unmatched,order_unmatched);
+
   for(int i=0;i<FlowSol->num_inters;i++)
     {
       bctype_f = bctype_c( f2c(i,0),f2loc_f(i,0));
@@ -515,17 +650,16 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
             for (int m=0;m<FlowSol->n_dims;m++)
               loc_center_inter_0(m) += xv(f2v(i,k),m)/f2nv(i);
 
+          find_cyclic_face_centers(key_unmatched,order_unmatched,n_unmatched_inters,loc_center_inter_0,delta_cyclic,tol,candidates);
+
           found = 0;
-          for (int j=0;j<n_unmatched_inters;j++) {
+          for (size_t c=0;c<candidates.size();c++) {
 
+              int j = candidates[c];
               int i2 = unmatched_inters(j);
 
               for (int m=0;m<FlowSol->n_dims;m++)
-                loc_center_inter_1(m) = 0.;
-
-              for (int k=0;k<f2nv(i2);k++)
-                for (int m=0;m<FlowSol->n_dims;m++)
-                  loc_center_inter_1(m) += xv(f2v(i2,k),m)/f2nv(i2);
+                loc_center_inter_1(m) = center_unmatched(m,j);
 
               if (check_cyclic(delta_cyclic,loc_center_inter_0,loc_center_inter_1,tol,FlowSol))
                 {
@@ -562,6 +696,10 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
         }
     }
 
+  // Colour the elements for the finite-difference block-Jacobi of the implicit solver
+  if (run_input.adv_type==4)
+    color_elements(f2c,ele_slot,local_c,FlowSol);
+
 #ifdef _MPI
 
 
@@ -569,7 +707,7 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
   //  Initialize MPI faces
   //  --------------------------------
 
-  array<int> f_mpi2f(max_inters);
+  array<int> f_mpi2f(FlowSol->num_inters);
   FlowSol->n_mpi_inters = 0;
   int n_seg_mpi_inters=0;
   int n_tri_mpi_inters=0;
@@ -614,10 +752,17 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
   // that contains the number of faces to send to each processor
   // the new array f_mpi2f is in good order i.e. proc1,proc2,....
 
-  match_mpifaces(f2v,f2nv,xv,f_mpi2f,mpifaces_part,delta_cyclic,FlowSol->n_mpi_inters,tol,FlowSol);
-
   array<int> rot_tag_mpi(FlowSol->n_mpi_inters);
-  find_rot_mpifaces(f2v,f2nv,xv,f_mpi2f,rot_tag_mpi,mpifaces_part,delta_cyclic,FlowSol->n_mpi_inters,tol,FlowSol);
+
+  if (!cached) {
+    match_mpifaces(f2v,f2nv,xv,f_mpi2f,mpifaces_part,delta_cyclic,FlowSol->n_mpi_inters,tol,FlowSol);
+    find_rot_mpifaces(f2v,f2nv,xv,f_mpi2f,rot_tag_mpi,mpifaces_part,delta_cyclic,FlowSol->n_mpi_inters,tol,FlowSol);
+  }
+
+  // the matched order of the MPI faces completes the cache
+  cache.io(f_mpi2f);
+  cache.io(mpifaces_part);
+  cache.io(rot_tag_mpi);
 
   //Initialize the mpi faces
 
@@ -632,19 +777,23 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
       ic_l = f2c(i,0);
 
       if (f2nv(i)==2) {
-          FlowSol->mesh_mpi_inters(0).set_mpi(i_seg_mpi,ctype(ic_l),local_c(ic_l),f2loc_f(i,0),rot_tag_mpi(i_mpi),FlowSol);
+          FlowSol->mesh_mpi_inters(0).set_mpi(i_seg_mpi,ele_slot(ic_l),local_c(ic_l),f2loc_f(i,0),rot_tag_mpi(i_mpi),FlowSol);
           i_seg_mpi++;
         }
       else if (f2nv(i)==3) {
-          FlowSol->mesh_mpi_inters(1).set_mpi(i_tri_mpi,ctype(ic_l),local_c(ic_l),f2loc_f(i,0),rot_tag_mpi(i_mpi),FlowSol);
+          FlowSol->mesh_mpi_inters(1).set_mpi(i_tri_mpi,ele_slot(ic_l),local_c(ic_l),f2loc_f(i,0),rot_tag_mpi(i_mpi),FlowSol);
           i_tri_mpi++;
         }
       else if (f2nv(i)==4) {
-          FlowSol->mesh_mpi_inters(2).set_mpi(i_quad_mpi,ctype(ic_l),local_c(ic_l),f2loc_f(i,0),rot_tag_mpi(i_mpi),FlowSol);
+          FlowSol->mesh_mpi_inters(2).set_mpi(i_quad_mpi,ele_slot(ic_l),local_c(ic_l),f2loc_f(i,0),rot_tag_mpi(i_mpi),FlowSol);
           i_quad_mpi++;
         }
     }
 
+  // the elements on MPI interfaces are now all flagged
+  for (int i=0;i<FlowSol->n_ele_types;i++)
+    FlowSol->mesh_eles(i)->setup_halo();
+
   // Initialize Nout_proc
   int icount = 0;
 
@@ -694,24 +843,42 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
 
 #endif
 
+  cache.close();
+
   // ---------------------------------------
   // Initializing internal and bdy faces
   // ---------------------------------------
 
-  // TODO: Need to count quad and triangle faces
+  // Interfaces are grouped by face type (0: seg, 1: tri, 2: quad) and by the local time stepping
+  // levels of their elements: interior ones by lower level and whether the levels differ
+  int n_int_groups = 2*n_levels-1;
 
-  // Count the number of int_inters and bdy_inters
-  int n_seg_int_inters = 0;
-  int n_tri_int_inters = 0;
-  int n_quad_int_inters = 0;
+  FlowSol->n_int_inter_types=3*n_int_groups;
+  FlowSol->int_inters_level.setup(FlowSol->n_int_inter_types,2);
+  for (int i=0;i<FlowSol->n_int_inter_types;i++)
+    {
+      FlowSol->int_inters_level(i,0) = (i/3)/2;
+      FlowSol->int_inters_level(i,1) = (i/3)/2 + (i/3)%2;
+    }
+
+  FlowSol->n_bdy_inter_types=3*n_levels;
+  FlowSol->bdy_inters_level.setup(FlowSol->n_bdy_inter_types);
+  for (int i=0;i<FlowSol->n_bdy_inter_types;i++)
+    FlowSol->bdy_inters_level(i) = i/3;
 
-  int n_seg_bdy_inters = 0;
-  int n_tri_bdy_inters = 0;
-  int n_quad_bdy_inters = 0;
+  FlowSol->lts_active.setup(n_levels);
+  FlowSol->lts_active.initialize_to_value(1);
+
+  // Count the number of int_inters and bdy_inters of each group
+  array<int> n_int_inters_type(FlowSol->n_int_inter_types);
+  array<int> n_bdy_inters_type(FlowSol->n_bdy_inter_types);
+  n_int_inters_type.initialize_to_value(0);
+  n_bdy_inters_type.initialize_to_value(0);
 
   for (int i=0; i<FlowSol->num_inters; i++)
     {
       bctype_f = bctype_c( f2c(i,0),f2loc_f(i,0));
+      ic_l = f2c(i,0);
       ic_r = f2c(i,1);
 
       if (bctype_f!=10)
@@ -723,42 +890,31 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
                   FatalError("Error: Interior interface has i_cell_right=-1. Should not be here, exiting");
                 }
               n_int_inters++;
-              if (f2nv(i)==2) n_seg_int_inters++;
-              if (f2nv(i)==3) n_tri_int_inters++;
-              if (f2nv(i)==4) n_quad_int_inters++;
+              n_int_inters_type(get_int_inter_type(f2nv(i),lts_level(ic_l),lts_level(ic_r)))++;
             }
           else // boundary interface
             {
               if (bctype_f!=99) //  Not a deleted cyclic interface
                 {
                   n_bdy_inters++;
-                  if (f2nv(i)==2) n_seg_bdy_inters++;
-                  if (f2nv(i)==3) n_tri_bdy_inters++;
-                  if (f2nv(i)==4) n_quad_bdy_inters++;
+                  n_bdy_inters_type(f2nv(i)-2+3*lts_level(ic_l))++;
                 }
             }
         }
     }
 
-  FlowSol->n_int_inter_types=3;
   FlowSol->mesh_int_inters.setup(FlowSol->n_int_inter_types);
-  FlowSol->mesh_int_inters(0).setup(n_seg_int_inters,0);
-  FlowSol->mesh_int_inters(1).setup(n_tri_int_inters,1);
-  FlowSol->mesh_int_inters(2).setup(n_quad_int_inters,2);
+  for (int i=0;i<FlowSol->n_int_inter_types;i++)
+    FlowSol->mesh_int_inters(i).setup(n_int_inters_type(i),i%3);
 
-  FlowSol->n_bdy_inter_types=3;
   FlowSol->mesh_bdy_inters.setup(FlowSol->n_bdy_inter_types);
-  FlowSol->mesh_bdy_inters(0).setup(n_seg_bdy_inters,0);
-  FlowSol->mesh_bdy_inters(1).setup(n_tri_bdy_inters,1);
-  FlowSol->mesh_bdy_inters(2).setup(n_quad_bdy_inters,2);
+  for (int i=0;i<FlowSol->n_bdy_inter_types;i++)
+    FlowSol->mesh_bdy_inters(i).setup(n_bdy_inters_type(i),i%3);
 
-  int i_seg_int=0;
-  int i_tri_int=0;
-  int i_quad_int=0;
-
-  int i_seg_bdy=0;
-  int i_tri_bdy=0;
-  int i_quad_bdy=0;
+  array<int> i_int_type(FlowSol->n_int_inter_types);
+  array<int> i_bdy_type(FlowSol->n_bdy_inter_types);
+  i_int_type.initialize_to_value(0);
+  i_bdy_type.initialize_to_value(0);
 
   for(int i=0;i<FlowSol->num_inters;i++)
     {
@@ -770,40 +926,33 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
         {
           if(bctype_f==0)
             {
-              if (f2nv(i)==2) {
-                  FlowSol->mesh_int_inters(0).set_interior(i_seg_int,ctype(ic_l),ctype(ic_r),local_c(ic_l),local_c(ic_r),f2loc_f(i,0),f2loc_f(i,1),rot_tag(i),FlowSol);
-                  i_seg_int++;
-                }
-              if (f2nv(i)==3) {
-                  FlowSol->mesh_int_inters(1).set_interior(i_tri_int,ctype(ic_l),ctype(ic_r),local_c(ic_l),local_c(ic_r),f2loc_f(i,0),f2loc_f(i,1),rot_tag(i),FlowSol);
-                  i_tri_int++;
-                }
-              if (f2nv(i)==4) {
-                  FlowSol->mesh_int_inters(2).set_interior(i_quad_int,ctype(ic_l),ctype(ic_r),local_c(ic_l),local_c(ic_r),f2loc_f(i,0),f2loc_f(i,1),rot_tag(i),FlowSol);
-                  i_quad_int++;
+              int t = get_int_inter_type(f2nv(i),lts_level(ic_l),lts_level(ic_r));
+              FlowSol->mesh_int_inters(t).set_interior(i_int_type(t),ele_slot(ic_l),ele_slot(ic_r),local_c(ic_l),local_c(ic_r),f2loc_f(i,0),f2loc_f(i,1),rot_tag(i),FlowSol);
+              i_int_type(t)++;
+
+              // the side on the coarser level is corrected by the flux of the finer one
+              if (lts_level(ic_l)!=lts_level(ic_r)) {
+                  int side = (lts_level(ic_l)<lts_level(ic_r)) ? 0 : 1;
+                  int ic = f2c(i,side);
+                  FlowSol->mesh_eles(ele_slot(ic))->set_lts_fine_face(local_c(ic),f2loc_f(i,side));
                 }
             }
           else // boundary face other than cyclic face
             {
               if (bctype_f!=99) //  Not a deleted cyclic face
                 {
-                  if (f2nv(i)==2){
-                      FlowSol->mesh_bdy_inters(0).set_boundary(i_seg_bdy,bctype_f,ctype(ic_l),local_c(ic_l),f2loc_f(i,0),FlowSol);
-                      i_seg_bdy++;
-                    }
-                  else if (f2nv(i)==3){
-                      FlowSol->mesh_bdy_inters(1).set_boundary(i_tri_bdy,bctype_f,ctype(ic_l),local_c(ic_l),f2loc_f(i,0),FlowSol);
-                      i_tri_bdy++;
-                    }
-                  else if (f2nv(i)==4){
-                      FlowSol->mesh_bdy_inters(2).set_boundary(i_quad_bdy,bctype_f,ctype(ic_l),local_c(ic_l),f2loc_f(i,0),FlowSol);
-                      i_quad_bdy++;
-                    }
+                  int t = f2nv(i)-2+3*lts_level(ic_l);
+                  FlowSol->mesh_bdy_inters(t).set_boundary(i_bdy_type(t),bctype_f,ele_slot(ic_l),local_c(ic_l),f2loc_f(i,0),FlowSol);
+                  i_bdy_type(t)++;
                 }
             }
         }
     }
 
+  if (n_levels>1)
+    for (int i=0;i<FlowSol->n_ele_types;i++)
+      FlowSol->mesh_eles(i)->setup_lts();
+
   if (run_input.motion)
     Mesh.ic2loc_c = local_c;
 
@@ -838,44 +987,6 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
       }
     }
 
-#ifdef _MPI
-
-    /*! Code paraphrased from SU2 */
-
-    array<int> n_seg_inters_array(FlowSol->nproc);
-    array<int> n_tri_inters_array(FlowSol->nproc);
-    array<int> n_quad_inters_array(FlowSol->nproc);
-    int n_global_seg_noslip_inters = 0;
-    int n_global_tri_noslip_inters = 0;
-    int n_global_quad_noslip_inters = 0;
-    int max_seg_noslip_inters = 0;
-    int max_tri_noslip_inters = 0;
-    int max_quad_noslip_inters = 0;
-    int buf;
-
-    /*! Communicate to all processors the total number of no-slip boundary
-    inters, the maximum number of no-slip boundary inters on any single
-    partition, and the number of no-slip inters on each partition. */
-
-    MPI_Allreduce(&n_seg_noslip_inters, &n_global_seg_noslip_inters, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
-    MPI_Allreduce(&n_tri_noslip_inters, &n_global_tri_noslip_inters, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
-    MPI_Allreduce(&n_quad_noslip_inters, &n_global_quad_noslip_inters, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
-
-    MPI_Allreduce(&n_seg_noslip_inters, &max_seg_noslip_inters, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
-    MPI_Allreduce(&n_tri_noslip_inters, &max_tri_noslip_inters, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
-    MPI_Allreduce(&n_quad_noslip_inters, &max_quad_noslip_inters, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
-
-    MPI_Allgather(&n_seg_noslip_inters, 1, MPI_INT, n_seg_inters_array.get_ptr_cpu(), 1, MPI_INT, MPI_COMM_WORLD);
-    MPI_Allgather(&n_tri_noslip_inters, 1, MPI_INT, n_tri_inters_array.get_ptr_cpu(), 1, MPI_INT, MPI_COMM_WORLD);
-    MPI_Allgather(&n_quad_noslip_inters, 1, MPI_INT, n_quad_inters_array.get_ptr_cpu(), 1, MPI_INT, MPI_COMM_WORLD);
-
-    // Set loop counters to max. inters on any partition
-    n_seg_noslip_inters = max_seg_noslip_inters;
-    n_tri_noslip_inters = max_tri_noslip_inters;
-    n_quad_noslip_inters = max_quad_noslip_inters;
-
-#endif
-
     // Allocate arrays for coordinates of points on no-slip boundaries
     FlowSol->loc_noslip_bdy.setup(FlowSol->n_bdy_inter_types);
     FlowSol->loc_noslip_bdy(0).setup(n_fpts_per_inter_seg,n_seg_noslip_inters,FlowSol->n_dims);
@@ -901,7 +1012,7 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
             for(int k=0;k<FlowSol->n_dims;k++) {
 
               // find coordinates
-              FlowSol->loc_noslip_bdy(0)(j,n_seg_noslip_inters,k) = *get_loc_fpts_ptr_cpu(ctype(ic_l), local_c(ic_l), f2loc_f(i,0), j, k, FlowSol);
+              FlowSol->loc_noslip_bdy(0)(j,n_seg_noslip_inters,k) = *get_loc_fpts_ptr_cpu(ele_slot(ic_l), local_c(ic_l), f2loc_f(i,0), j, k, FlowSol);
             }
           }
           n_seg_noslip_inters++;
@@ -911,7 +1022,7 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
           for(int j=0;j<n_fpts_per_inter_tri;j++) {
             for(int k=0;k<FlowSol->n_dims;k++) {
 
-              FlowSol->loc_noslip_bdy(1)(j,n_tri_noslip_inters,k) = *get_loc_fpts_ptr_cpu(ctype(ic_l), local_c(ic_l), f2loc_f(i,0), j, k, FlowSol);
+              FlowSol->loc_noslip_bdy(1)(j,n_tri_noslip_inters,k) = *get_loc_fpts_ptr_cpu(ele_slot(ic_l), local_c(ic_l), f2loc_f(i,0), j, k, FlowSol);
 
             }
           }
@@ -922,7 +1033,7 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
           for(int j=0;j<n_fpts_per_inter_quad;j++) {
             for(int k=0;k<FlowSol->n_dims;k++) {
 
-              FlowSol->loc_noslip_bdy(2)(j,n_quad_noslip_inters,k) = *get_loc_fpts_ptr_cpu(ctype(ic_l), local_c(ic_l), f2loc_f(i,0), j, k, FlowSol);
+              FlowSol->loc_noslip_bdy(2)(j,n_quad_noslip_inters,k) = *get_loc_fpts_ptr_cpu(ele_slot(ic_l), local_c(ic_l), f2loc_f(i,0), j, k, FlowSol);
 
             }
           }
@@ -932,40 +1043,34 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
       }
     }
 
-#ifdef _MPI
-
-    // Allocate global arrays for coordinates of points on no-slip boundaries
-    FlowSol->loc_noslip_bdy_global.setup(FlowSol->n_bdy_inter_types);
-
-    FlowSol->loc_noslip_bdy_global(0).setup(n_fpts_per_inter_seg,max_seg_noslip_inters,FlowSol->nproc*FlowSol->n_dims);
-
-    FlowSol->loc_noslip_bdy_global(1).setup(n_fpts_per_inter_tri,max_tri_noslip_inters,FlowSol->nproc*FlowSol->n_dims);
-
-    FlowSol->loc_noslip_bdy_global(2).setup(n_fpts_per_inter_quad,max_quad_noslip_inters,FlowSol->nproc*FlowSol->n_dims);
-
-    // Broadcast coordinates of interface points to all partitions
-
-    buf = max_seg_noslip_inters*n_fpts_per_inter_seg*FlowSol->n_dims;
-
-    MPI_Allgather(FlowSol->loc_noslip_bdy(0).get_ptr_cpu(), buf, MPI_DOUBLE, FlowSol->loc_noslip_bdy_global(0).get_ptr_cpu(), buf, MPI_DOUBLE, MPI_COMM_WORLD);
-
-    buf = max_tri_noslip_inters*n_fpts_per_inter_tri*FlowSol->n_dims;
-
-    MPI_Allgather(FlowSol->loc_noslip_bdy(1).get_ptr_cpu(), buf, MPI_DOUBLE, FlowSol->loc_noslip_bdy_global(1).get_ptr_cpu(), buf, MPI_DOUBLE, MPI_COMM_WORLD);
+    // Build a k-d tree over the no-slip wall flux points of this partition
+    int n_wall_pts = n_seg_noslip_inters*n_fpts_per_inter_seg + n_tri_noslip_inters*n_fpts_per_inter_tri + n_quad_noslip_inters*n_fpts_per_inter_quad;
+    array<double> wall_pts(FlowSol->n_dims,n_wall_pts);
+    int n_pts = 0;
+
+    for(int t=0;t<3;t++) {
+      for(int l=0;l<FlowSol->loc_noslip_bdy(t).get_dim(1);l++) {
+        for(int j=0;j<FlowSol->loc_noslip_bdy(t).get_dim(0);j++) {
+          for(int k=0;k<FlowSol->n_dims;k++)
+            wall_pts(k,n_pts) = FlowSol->loc_noslip_bdy(t)(j,l,k);
+          n_pts++;
+        }
+      }
+    }
 
-    buf = max_quad_noslip_inters*n_fpts_per_inter_quad*FlowSol->n_dims;
+    kdtree wall_tree;
+    wall_tree.setup(wall_pts);
 
-    MPI_Allgather(FlowSol->loc_noslip_bdy(2).get_ptr_cpu(), buf, MPI_DOUBLE, FlowSol->loc_noslip_bdy_global(2).get_ptr_cpu(), buf, MPI_DOUBLE, MPI_COMM_WORLD);
+#ifdef _MPI
 
-    // Calculate distance of every solution point to nearest point on no-slip boundary for every partition
-    for(int i=0;i<FlowSol->n_ele_types;i++)
-      FlowSol->mesh_eles(i)->calc_wall_distance_parallel(n_seg_inters_array,n_tri_inters_array,n_quad_inters_array,FlowSol->loc_noslip_bdy_global,FlowSol->nproc);
+    // Calculate distance of every solution point to nearest point on no-slip boundary of any partition
+    calc_wall_distance_parallel(wall_tree,FlowSol);
 
 #else // serial
 
     // Calculate distance of every solution point to nearest point on no-slip boundary
     for(int i=0;i<FlowSol->n_ele_types;i++)
-      FlowSol->mesh_eles(i)->calc_wall_distance(n_seg_noslip_inters,n_tri_noslip_inters,n_quad_noslip_inters,FlowSol->loc_noslip_bdy);
+      FlowSol->mesh_eles(i)->calc_wall_distance(wall_tree);
 
 #endif
   }
@@ -989,6 +1094,18 @@ void GeoPreprocess(struct solution* FlowSol, mesh &Mesh) {
 
 }
 
+void GeoRelease(struct solution* FlowSol)
+{
+  // the element slots of the finer local time stepping levels were allocated in GeoPreprocess
+  for (int i=5;i<FlowSol->n_ele_types;i++)
+    {
+      delete FlowSol->mesh_eles(i);
+      FlowSol->mesh_eles(i) = NULL;
+    }
+
+  FlowSol->n_ele_types = 5;
+}
+
 void ReadMesh(string& in_file_name, array<double>& out_xv, array<int>& out_c2v, array<int>& out_c2n_v, array<int>& out_ctype, array<int>& out_ic2icg,
               array<int>& out_iv2ivg, int& out_n_cells, int& out_n_verts, int& out_n_verts_global, struct solution* FlowSol)
 {
@@ -996,11 +1113,17 @@ void ReadMesh(string& in_file_name, array<double>& out_xv, array<int>& out_c2v,
     cout << endl << "----------------------- Mesh Preprocessing ------------------------" << endl;
 
   if (FlowSol->rank==0) cout << "reading connectivity ... " << endl;
-  if (run_input.mesh_format==0) { // Gambit
+  if (run_input.mesh_format==2) { // Generated box, partitioned as it is built
+    generate_connectivity_box(out_n_cells, out_c2v, out_c2n_v, out_ctype, out_ic2icg, FlowSol);
+  }
+  else if (run_input.mesh_format==0) { // Gambit
     read_connectivity_gambit(in_file_name, out_n_cells, out_c2v, out_c2n_v, out_ctype, out_ic2icg, FlowSol);
   }
   else if (run_input.mesh_format==1) { // Gmsh
-    read_connectivity_gmsh(in_file_name, out_n_cells, out_c2v, out_c2n_v, out_ctype, out_ic2icg, FlowSol);
+    if (get_gmsh_version(in_file_name)<4.)
+      read_connectivity_gmsh(in_file_name, out_n_cells, out_c2v, out_c2n_v, out_ctype, out_ic2icg, FlowSol);
+    else
+      read_connectivity_gmsh4(in_file_name, out_n_cells, out_c2v, out_c2n_v, out_ctype, out_ic2icg, FlowSol);
   }
   else {
     FatalError("Mesh format not recognized");
@@ -1009,7 +1132,7 @@ void ReadMesh(string& in_file_name, array<double>& out_xv, array<int>& out_c2v,
 
 #ifdef _MPI
   // Call method to repartition the mesh
-  if (FlowSol->nproc != 1)
+  if (FlowSol->nproc != 1 && run_input.mesh_format != 2)
     repartition_mesh(out_n_cells, out_c2v, out_c2n_v, out_ctype, out_ic2icg,FlowSol);
 #endif
 
@@ -1024,8 +1147,12 @@ void ReadMesh(string& in_file_name, array<double>& out_xv, array<int>& out_c2v,
   // Now read position of vertices in mesh file
   out_xv.setup(n_verts,FlowSol->n_dims);
 
-  if (run_input.mesh_format==0) { read_vertices_gambit(in_file_name, n_verts, out_n_verts_global, out_iv2ivg, out_xv, FlowSol); }
-  else if (run_input.mesh_format==1) { read_vertices_gmsh(in_file_name, n_verts, out_n_verts_global, out_iv2ivg, out_xv, FlowSol); }
+  if (run_input.mesh_format==2) { generate_vertices_box(n_verts, out_n_verts_global, out_iv2ivg, out_xv, FlowSol); }
+  else if (run_input.mesh_format==0) { read_vertices_gambit(in_file_name, n_verts, out_n_verts_global, out_iv2ivg, out_xv, FlowSol); }
+  else if (run_input.mesh_format==1) {
+    if (get_gmsh_version(in_file_name)<4.) read_vertices_gmsh(in_file_name, n_verts, out_n_verts_global, out_iv2ivg, out_xv, FlowSol);
+    else read_vertices_gmsh4(in_file_name, n_verts, out_n_verts_global, out_iv2ivg, out_xv, FlowSol);
+  }
   else { FatalError("Mesh format not recognized"); }
 
   out_n_verts = n_verts;
@@ -1047,15 +1174,21 @@ void ReadBound(string& in_file_name, array<int>& in_c2v, array<int>& in_c2n_v, a
   // initialize to 0 (as interior edges)
   out_bctype.initialize_to_zero();
 
-  if (run_input.mesh_format==0) {
+  if (run_input.mesh_format==0 || run_input.mesh_format==2) {
     array<array<int> > bccells;
     array<array<int> > bcfaces;
-    read_boundary_gambit(in_file_name, in_n_cells, in_ic2icg, out_bctype, out_bc_list, bccells, bcfaces);
+    if (run_input.mesh_format==0)
+      read_boundary_gambit(in_file_name, in_n_cells, in_ic2icg, out_bctype, out_bc_list, bccells, bcfaces);
+    else
+      generate_boundary_box(in_n_cells, in_ctype, in_c2f, in_f2v, in_f2nv, in_iv2ivg, out_bctype, out_bc_list, bccells, bcfaces, FlowSol);
     if (run_input.motion != 0)
       create_boundpts(out_boundpts, out_bc_list, out_bound_flag, bccells, bcfaces, in_c2f, in_f2v, in_f2nv);
   }
   else if (run_input.mesh_format==1) {
-    read_boundary_gmsh(in_file_name, in_n_cells, in_ic2icg, in_c2v, in_c2n_v, out_bctype, out_bc_list, out_bound_flag, out_boundpts, in_iv2ivg, in_n_verts, in_ctype, in_icvsta, in_icvert, FlowSol);
+    if (get_gmsh_version(in_file_name)<4.)
+      read_boundary_gmsh(in_file_name, in_c2v, in_c2n_v, out_bctype, out_bc_list, out_bound_flag, out_boundpts, in_iv2ivg, in_n_verts, in_ctype, in_icvsta, in_icvert, FlowSol);
+    else
+      read_boundary_gmsh4(in_file_name, in_c2v, in_c2n_v, out_bctype, out_bc_list, out_bound_flag, out_boundpts, in_iv2ivg, in_n_verts, in_ctype, in_icvsta, in_icvert, FlowSol);
   }
   else {
     FatalError("Mesh format not recognized");
@@ -1064,18 +1197,14 @@ void ReadBound(string& in_file_name, array<int>& in_c2v, array<int>& in_c2n_v, a
   if (FlowSol->rank==0) cout << "done reading boundary conditions" << endl;
 }
 
-void create_boundpts(array<array<int> >& out_boundpts, array<int>& in_bclist, array<int>& out_bound_flag, array<array<int> >& in_bccells,
-                     array<array<int> >& in_bcfaces, array<int>& in_c2f, array<int>& in_f2v, array<int>& in_f2nv)
+void set_moving_bound_flags(array<int>& in_bclist, array<int>& out_bound_flag)
 {
-  int iv, ivg, ic, k, loc_k, nv;
-  int n_faces, bcflag;
-
+  int bcflag;
   int n_bcs = in_bclist.get_dim(0);
 
   out_bound_flag.setup(n_bcs);
   out_bound_flag.initialize_to_zero();
 
-  /** Find boundaries which are moving */
   for (int i=0; i<run_input.n_moving_bnds; i++) {
     if (run_input.boundary_flags(i).compare("FLUID"))  // if NOT 'FLUID'
     {
@@ -1088,14 +1217,24 @@ void create_boundpts(array<array<int> >& out_boundpts, array<int>& in_bclist, ar
       }
     }
   }
+}
+
+void create_boundpts(array<array<int> >& out_boundpts, array<int>& in_bclist, array<int>& out_bound_flag, array<array<int> >& in_bccells,
+                     array<array<int> >& in_bcfaces, array<int>& in_c2f, array<int>& in_f2v, array<int>& in_f2nv)
+{
+  int iv, ic, k, loc_k;
+  int n_faces;
+
+  int n_bcs = in_bclist.get_dim(0);
+
+  /** Find boundaries which are moving */
+  set_moving_bound_flags(in_bclist,out_bound_flag);
 
   /** --- CREATE BOUNDARY->POINTS STRUCTURE ---
     want: iv = boundpts(bcflag,ivert); */
   out_boundpts.setup(n_bcs);
   array<set<int> > Bounds(n_bcs);
   for (int i=0; i<n_bcs; i++) {
-    nv = 0;
-    bcflag = in_bclist(i);
     n_faces = in_bcfaces(i).get_dim(0);
     for (int j=0; j<n_faces; j++) {
       // find (semi-)global face index
@@ -1306,7 +1445,7 @@ void read_boundary_gambit(string& in_file_name, int &in_n_cells, array<int>& in_
   mesh_file.close();
 }
 
-void read_boundary_gmsh(string& in_file_name, int &in_n_cells, array<int>& in_ic2icg, array<int>& in_c2v, array<int>& in_c2n_v, array<int>& out_bctype,
+void read_boundary_gmsh(string& in_file_name, array<int>& in_c2v, array<int>& in_c2n_v, array<int>& out_bctype,
                         array<int> &out_bclist, array<int> &out_bound_flag, array<array<int> >& out_boundpts, array<int>& in_iv2ivg,
                         int in_n_verts, array<int>& in_ctype, array<int>& in_icvsta, array<int>& in_icvert, struct solution* FlowSol)
 {
@@ -1358,187 +1497,729 @@ void read_boundary_gmsh(string& in_file_name, int &in_n_cells, array<int>& in_ic
   mesh_file   >> n_entities;   // num cells in mesh
   mesh_file.getline(buf,BUFSIZ);  // clear rest of line
 
-  array<int> vlist_bound(9), vlist_cell(9);
-  array<int> vlist_local(9);
+  array<int> vlist_bound(9);
+  array<int> nodes(MAX_V_PER_C);
 
-  int found, num_v_per_f;
   int num_face_vert;
 
   string bcname;
   int bdy_count=0;
 
-  int sta_ind,end_ind;
+  // --- setup vertex->bcflag array ---
+  out_boundpts.setup(n_bcs);
+  array<set<int> > Bounds;
+  Bounds.setup(n_bcs);
+
+  //--- overwrite bc_list with bcflag (previously held gmsh bcid) ---
+  for (int i=0; i<n_bcs; i++) {
+    bcname.assign(bcTXT[out_bclist(i)],0,14);
+    bcname.erase(bcname.find_last_not_of(" \n\r\t")+1);
+    bcname.erase(bcname.find_last_not_of("\"")+1);
+    // ignore FLUID region as a "boundary"
+    if (bcname.compare("FLUID")==0) {
+      out_bclist(i) = -1;
+    }else{
+      bcflag = get_bc_number(bcname);
+      out_bclist(i) = bcflag;
+    }
+  }
+
+  //--- Find boundaries which are moving ---//
+  set_moving_bound_flags(out_bclist,out_bound_flag);
+
+  for (int i=0;i<n_entities;i++)
+    {
+      mesh_file >> id >> elmtype >> ntags;
+      mesh_file >> bcid;
+      for (int tag=0; tag<ntags-1; tag++)
+        mesh_file >> dummy;
+
+      if (strstr(bcTXT[bcid],"FLUID"))
+        {
+          mesh_file.getline(buf,BUFSIZ);  // skip line
+          continue;
+        }
+      else
+        {
+          bcname.assign(bcTXT[bcid],0,14);
+          bcname.erase(bcname.find_last_not_of(" \n\r\t")+1);
+          bcname.erase(bcname.find_last_not_of("\"")+1);
+          bcflag = get_bc_number(bcname);
+        }
+
+      bdy_count++;
+
+      for (int k=0;k<gmsh4_file::get_n_nodes(elmtype);k++)
+        mesh_file >> nodes(k);
+
+      mesh_file.getline(buf,BUFSIZ);  // Get rest of line
+
+      num_face_vert = get_boundary_face_gmsh(elmtype,nodes.get_ptr_cpu(),vlist_bound);
+      set_boundary_face(vlist_bound,num_face_vert,bcflag,Bounds(bcid-1),out_bctype,in_iv2ivg,in_n_verts,in_c2v,in_c2n_v,in_ctype,in_icvsta,in_icvert,FlowSol);
+
+    } // Loop over entities
+
+  set<int>::iterator it;
+  for (int i=0; i<n_bcs; i++) {
+    out_boundpts(i).setup(Bounds(i).size());
+    int j=0;
+    for (it=Bounds(i).begin(); it!=Bounds(i).end(); it++) {
+      out_boundpts(i)(j) = (*it);
+      j++;
+    }
+  }
+
+  mesh_file.close();
+
+  //cout << "  Number of Boundary Faces: " << bdy_count << endl;
+}
+
+double get_gmsh_version(string& in_file_name)
+{
+  string str;
+  double version;
+  ifstream mesh_file;
+
+  mesh_file.open(&in_file_name[0]);
+  if (!mesh_file)
+    FatalError("Unable to open mesh file");
+
+  while(1) {
+      getline(mesh_file,str);
+      if (str.find("$MeshFormat")!=string::npos) break;
+      if(mesh_file.eof()) FatalError("$MeshFormat tag not found!");
+    }
+
+  mesh_file >> version;
+  mesh_file.close();
+
+  return version;
+}
+
+// ctype is the element type:  for HiFiLES: 0=tri, 1=quad, 2=tet, 3=prism, 4=hex
+// For Gmsh node ordering, see: http://geuz.org/gmsh/doc/texinfo/gmsh.html#Node-ordering
+
+void set_cell_gmsh(int in_elmtype, int* in_nodes, int in_cell, array<int> &out_c2v, array<int> &out_c2n_v, array<int> &out_ctype)
+{
+  // position in c2v of each node, in the order of the mesh file
+  static const int tri_3[3] = {0,1,2};
+  static const int tri_6[6] = {0,1,2,3,4,5};
+  static const int quad_4[4] = {0,1,3,2};
+  static const int quad_8[8] = {0,1,2,3,4,5,6,7};
+  static const int quad_9[9] = {0,2,8,6,1,5,7,3,4}; // not sure this is correct
+  static const int tet_4[4] = {0,1,2,3};
+  static const int tet_10[10] = {0,5,4,2,8,1,7,3,9,6};
+  static const int hexa_8[8] = {0,1,3,2,4,5,7,6};
+
+  const int* perm = NULL;
+  int i = in_cell;
+
+  if (in_elmtype==2 || in_elmtype==9 || in_elmtype==21) // Triangle
+    {
+      out_ctype(i) = 0;
+      if (in_elmtype==2) { out_c2n_v(i) = 3; perm = tri_3; } // linear triangle
+      else if (in_elmtype==9) { out_c2n_v(i) = 6; perm = tri_6; } // quadratic triangle
+      else FatalError("Cubic triangle not implemented");
+    }
+  else if (in_elmtype==3 || in_elmtype==16 || in_elmtype==10) // Quad
+    {
+      out_ctype(i) = 1;
+      if (in_elmtype==3) { out_c2n_v(i) = 4; perm = quad_4; } // linear quadrangle
+      else if (in_elmtype==16) { out_c2n_v(i) = 8; perm = quad_8; } // quadratic quadrangle
+      else { out_c2n_v(i) = 9; perm = quad_9; } // quadratic quadrangle
+    }
+  else if (in_elmtype==4 || in_elmtype==11) // Tetrahedron
+    {
+      out_ctype(i) = 2;
+      if (in_elmtype==4) { out_c2n_v(i) = 4; perm = tet_4; } // Linear tet
+      else { out_c2n_v(i) = 10; perm = tet_10; } // Quadratic tet
+    }
+  else if (in_elmtype==5 || in_elmtype==12) // Hexahedron
+    {
+      out_ctype(i) = 4;
+      if (in_elmtype==5) { out_c2n_v(i) = 8; perm = hexa_8; } // linear hexahedron
+      else out_c2n_v(i) = 27; // 27-node quadratic hexahedron: vertices, edges, faces, volume
+    }
+  else
+    {
+      cout << "elmtype=" << in_elmtype << endl;
+      FatalError("element type not recognized");
+    }
+
+  for (int k=0;k<out_c2n_v(i);k++)
+    out_c2v(i,perm ? perm[k] : k) = in_nodes[k];
+
+  // Shift every values of c2v by -1
+  for(int k=0;k<out_c2n_v(i);k++)
+    {
+      if(out_c2v(i,k)!=0)
+        {
+          out_c2v(i,k)--;
+        }
+    }
+}
+
+int get_boundary_face_gmsh(int in_elmtype, int* in_nodes, array<int>& out_vlist_bound)
+{
+  static const int edge[2] = {0,1};
+  static const int tri[3] = {0,1,2};
+  static const int quad_4[4] = {0,1,3,2};
+  static const int quad_9[9] = {0,2,8,6,1,5,7,3,4};
+
+  const int* perm;
+  int num_face_vert;
+
+  if (in_elmtype==1 || in_elmtype==8) { num_face_vert = 2; perm = edge; } // Edge
+  else if (in_elmtype==3) { num_face_vert = 4; perm = quad_4; } // Quad face
+  else if (in_elmtype==2 || in_elmtype==9) { num_face_vert = 3; perm = tri; } // Linear or quadratic tri face
+  else if (in_elmtype==10) { num_face_vert = 9; perm = quad_9; } // Quadratic quad face
+  else
+    {
+      cout << "Gmsh boundary element type: " << in_elmtype << endl;
+      FatalError("Boundary elmtype not recognized");
+    }
+
+  // Shift by -1 (1-indexed -> 0-indexed)
+  for (int j=0;j<num_face_vert;j++)
+    out_vlist_bound(perm[j]) = in_nodes[j]-1;
+
+  return num_face_vert;
+}
+
+void set_boundary_face(array<int>& in_vlist_bound, int in_num_face_vert, int in_bcflag, set<int>& out_bound, array<int>& out_bctype, array<int>& in_iv2ivg,
+                       int in_n_verts, array<int>& in_c2v, array<int>& in_c2n_v, array<int>& in_ctype, array<int>& in_icvsta, array<int>& in_icvert, struct solution* FlowSol)
+{
+  array<int> vlist_local(9), vlist_cell(9);
+  int found, num_v_per_f;
+  int sta_ind,end_ind;
+
+  // Check if all vertices belong to processor
+  bool belong_to_proc = true;
+  for (int j=0;j<in_num_face_vert;j++)
+    {
+      vlist_local(j) = index_locate_int(in_vlist_bound(j),in_iv2ivg.get_ptr_cpu(),in_n_verts);
+      if (vlist_local(j) == -1)
+        belong_to_proc = false;
+
+      out_bound.insert(vlist_local(j));
+    }
+
+  if (belong_to_proc)
+    {
+      // All vertices on face belong to processor
+      // Try to find the cell that they belong to
+      found=0;
+
+      // Loop over cells touching that vertex
+      sta_ind = in_icvsta(vlist_local(0));
+      end_ind = in_icvsta(vlist_local(0)+1)-1;
+
+      for (int ind=sta_ind;ind<=end_ind;ind++)
+        {
+          int ic=in_icvert(ind);
+          for (int k=0;k<FlowSol->num_f_per_c(in_ctype(ic));k++)
+            {
+              // Get local vertices of local face k of cell ic
+              get_vlist_loc_face(in_ctype(ic),in_c2n_v(ic),k,vlist_cell,num_v_per_f);
+
+              if (num_v_per_f != in_num_face_vert)
+                continue;
+
+              for (int j=0;j<num_v_per_f;j++)
+              {
+                vlist_cell(j) = in_c2v(ic,vlist_cell(j));
+              }
+
+              compare_faces_boundary(vlist_local,vlist_cell,num_v_per_f,found);
+
+              if (found==1)
+              {
+                out_bctype(ic,k)=in_bcflag;
+                break;
+              }
+            }
+          if (found==1)
+            break;
+        }
+      if (found==0)
+      {
+        cout << "vlist_bound(2)=" << in_vlist_bound(2) << " vlist_bound(3)=" << in_vlist_bound(3) << endl;
+        FatalError("All nodes of boundary face belong to processor but could not find the coresponding faces");
+      }
+
+    } // If all vertices belong to processor
+}
+
+// Gmsh 4.1 physical groups whose name contains FLUID hold the cells
+static bool is_fluid_gmsh4(gmsh4_file& msh, int in_dim, int in_tag)
+{
+  int phys = msh.get_physical(in_dim,in_tag);
+  return phys!=0 && msh.get_physical_name(phys).find("FLUID")!=string::npos;
+}
+
+void read_connectivity_gmsh4(string& in_file_name, int &out_n_cells, array<int> &out_c2v, array<int> &out_c2n_v, array<int> &out_ctype, array<int> &out_ic2icg, struct solution* FlowSol)
+{
+  gmsh4_file msh;
+  int n_cells_global = 0;
+  int dim, tag, elmtype, n_nodes;
+  size_t n_blocks, n;
+
+  msh.open(in_file_name);
+
+  for (int i=0;i<msh.get_n_physicals();i++) {
+    int phys = msh.get_physical_tag(i);
+    if (msh.get_physical_name(phys).find("FLUID")!=string::npos)
+      FlowSol->n_dims = msh.get_physical_dim(phys);
+  }
+  if (FlowSol->n_dims != 2 && FlowSol->n_dims != 3) {
+    FatalError("Invalid mesh dimensionality. Expected 2D or 3D.");
+  }
+  if (run_input.turb_model==1 && FlowSol->n_dims == 3) {
+    FatalError("ERROR: 3D geometry not supported with RANS equation yet ... ");
+  }
+
+  // Count the FLUID cells from the element block headers
+  if (!msh.find_section("Elements"))
+    FatalError("$Elements tag not found!");
+
+  n_blocks = msh.read_size();
+  msh.skip_sizes(3);
+
+  for (size_t b=0;b<n_blocks;b++) {
+    dim = msh.read_int();
+    tag = msh.read_int();
+    elmtype = msh.read_int();
+    n = msh.read_size();
+
+    if (is_fluid_gmsh4(msh,dim,tag))
+      n_cells_global += n;
+
+    msh.skip_sizes(n*(1+gmsh4_file::get_n_nodes(elmtype)));
+  }
+
+  // Now assign kstart to each processor
+  int kstart;
+#ifdef _MPI
+  // Assign a number of cells for each processor
+  out_n_cells = (int) ( (double)(n_cells_global)/(double)FlowSol->nproc);
+  kstart = FlowSol->rank*out_n_cells;
+
+  // Last processor has more cells
+  if (FlowSol->rank==(FlowSol->nproc-1))
+    out_n_cells += (n_cells_global-FlowSol->nproc*out_n_cells);
+#else
+  kstart = 0;
+  out_n_cells = n_cells_global;
+#endif
+
+  // Allocate memory
+  out_c2v.setup(out_n_cells,MAX_V_PER_C);
+  out_c2n_v.setup(out_n_cells);
+  out_ctype.setup(out_n_cells);
+  out_ic2icg.setup(out_n_cells);
+
+  // Initialize arrays to -1
+  out_c2v.initialize_to_value(-1);
+  out_c2n_v.initialize_to_value(-1);
+  out_ctype.initialize_to_value(-1);
+  out_ic2icg.initialize_to_value(-1);
+
+  // Read the cells of this processor, skipping whole blocks read by other processors
+  msh.open(in_file_name);
+  msh.find_section("Elements");
+
+  n_blocks = msh.read_size();
+  msh.skip_sizes(3);
+
+  array<size_t> tags(MAX_V_PER_C);
+  array<int> nodes(MAX_V_PER_C);
+  int icount = 0;
+  int i = 0;
+
+  for (size_t b=0;b<n_blocks;b++) {
+    dim = msh.read_int();
+    tag = msh.read_int();
+    elmtype = msh.read_int();
+    n = msh.read_size();
+    n_nodes = gmsh4_file::get_n_nodes(elmtype);
+
+    if (!is_fluid_gmsh4(msh,dim,tag)) {
+      msh.skip_sizes(n*(1+n_nodes));
+      continue;
+    }
+
+    if (icount+(int)n<=kstart || i>=out_n_cells) {
+      msh.skip_sizes(n*(1+n_nodes));
+      icount += n;
+      continue;
+    }
+
+    for (size_t e=0;e<n;e++) {
+      if (icount>=kstart && i<out_n_cells) // Read this cell
+        {
+          msh.skip_sizes(1);
+          msh.read_sizes(tags.get_ptr_cpu(),n_nodes);
+          for (int k=0;k<n_nodes;k++)
+            nodes(k) = (int)tags(k);
+
+          out_ic2icg(i) = icount;
+          set_cell_gmsh(elmtype,nodes.get_ptr_cpu(),i,out_c2v,out_c2n_v,out_ctype);
+          i++;
+        }
+      else
+        msh.skip_sizes(1+n_nodes);
+
+      icount++;
+    }
+  }
+
+  msh.close();
+}
+
+void read_vertices_gmsh4(string& in_file_name, int in_n_verts, int& out_n_verts_global, array<int> &in_iv2ivg, array<double> &out_xv, struct solution* FlowSol)
+{
+  gmsh4_file msh;
+  vector<size_t> tags;
+  vector<double> xyz;
+
+  msh.open(in_file_name);
+
+  if (!msh.find_section("Nodes"))
+    FatalError("$Nodes tag not found!");
+
+  size_t n_blocks = msh.read_size();
+  out_n_verts_global = msh.read_size(); // num vertices in mesh
+  msh.skip_sizes(2);
+
+  for (size_t b=0;b<n_blocks;b++) {
+    int dim = msh.read_int();
+    msh.read_int();
+    int parametric = msh.read_int();
+    size_t n = msh.read_size();
+    int n_coords = 3 + (parametric ? dim : 0);
+
+    if (n==0)
+      continue;
+
+    tags.resize(n);
+    xyz.resize(n*n_coords);
+    msh.read_sizes(&tags[0],n);
+    msh.read_doubles(&xyz[0],n*n_coords);
+
+    for (size_t j=0;j<n;j++) {
+      int index = index_locate_int((int)tags[j]-1,in_iv2ivg.get_ptr_cpu(),in_n_verts);
+
+      if (index!=-1) // Vertex belongs to this processor
+        for (int m=0;m<FlowSol->n_dims;m++)
+          out_xv(index,m) = xyz[j*n_coords+m];
+    }
+  }
+
+  msh.close();
+}
+
+void read_boundary_gmsh4(string& in_file_name, array<int>& in_c2v, array<int>& in_c2n_v, array<int>& out_bctype,
+                         array<int> &out_bclist, array<int> &out_bound_flag, array<array<int> >& out_boundpts, array<int>& in_iv2ivg,
+                         int in_n_verts, array<int>& in_ctype, array<int>& in_icvsta, array<int>& in_icvert, struct solution* FlowSol)
+{
+  gmsh4_file msh;
+  string bcname;
+  map<int,int> phys2bc;
+
+  msh.open(in_file_name);
+
+  //--- bc_list holds the bcflag of each physical group (-1 for the FLUID region) ---
+  int n_bcs = msh.get_n_physicals();
+  out_bclist.setup(n_bcs);
+
+  for (int i=0; i<n_bcs; i++) {
+    int phys = msh.get_physical_tag(i);
+    phys2bc[phys] = i;
+
+    bcname = msh.get_physical_name(phys);
+    if (bcname.find("FLUID")!=string::npos)
+      out_bclist(i) = -1;
+    else
+      out_bclist(i) = get_bc_number(bcname);
+  }
+
+  //--- Find boundaries which are moving ---//
+  set_moving_bound_flags(out_bclist,out_bound_flag);
+
+  // --- setup vertex->bcflag array ---
+  out_boundpts.setup(n_bcs);
+  array<set<int> > Bounds(n_bcs);
+
+  if (!msh.find_section("Elements"))
+    FatalError("$Elements tag not found!");
+
+  size_t n_blocks = msh.read_size();
+  msh.skip_sizes(3);
+
+  array<size_t> tags(MAX_V_PER_C);
+  array<int> nodes(MAX_V_PER_C);
+  array<int> vlist_bound(9);
+
+  for (size_t b=0;b<n_blocks;b++) {
+    int dim = msh.read_int();
+    int tag = msh.read_int();
+    int elmtype = msh.read_int();
+    size_t n = msh.read_size();
+    int n_nodes = gmsh4_file::get_n_nodes(elmtype);
+    int phys = msh.get_physical(dim,tag);
+
+    if (phys==0 || is_fluid_gmsh4(msh,dim,tag)) {
+      msh.skip_sizes(n*(1+n_nodes));
+      continue;
+    }
+
+    int bcflag = out_bclist(phys2bc[phys]);
+
+    for (size_t e=0;e<n;e++) {
+      msh.skip_sizes(1);
+      msh.read_sizes(tags.get_ptr_cpu(),n_nodes);
+      for (int k=0;k<n_nodes;k++)
+        nodes(k) = (int)tags(k);
+
+      int num_face_vert = get_boundary_face_gmsh(elmtype,nodes.get_ptr_cpu(),vlist_bound);
+      set_boundary_face(vlist_bound,num_face_vert,bcflag,Bounds(phys2bc[phys]),out_bctype,in_iv2ivg,in_n_verts,in_c2v,in_c2n_v,in_ctype,in_icvsta,in_icvert,FlowSol);
+    }
+  }
+
+  set<int>::iterator it;
+  for (int i=0; i<n_bcs; i++) {
+    out_boundpts(i).setup(Bounds(i).size());
+    int j=0;
+    for (it=Bounds(i).begin(); it!=Bounds(i).end(); it++) {
+      out_boundpts(i)(j) = (*it);
+      j++;
+    }
+  }
+
+  msh.close();
+}
+
+// Generated structured box meshes (mesh_gen=1)
+//
+// The box is a grid of gen_n_cells quads/hexas, each split into 2 tris, 6 tets (along the
+// diagonal from its lowest to its highest corner, so the faces of neighbours match) or 2
+// prisms. The global vertex (i,j,k) of the grid has index i+(nx+1)*(j+(ny+1)*k). The ranks
+// form a grid of blocks, each rank generates only the cells of its own block.
+
+// corners of a quad/hex (index: dx+2*dy+4*dz) of the vertices of each sub-cell, positively oriented
+
+static const int box_quad_corners[1][4] = {{0,1,2,3}};
+static const int box_tri_corners[2][3] = {{0,1,2}, {3,2,1}};
+static const int box_hex_corners[1][8] = {{0,1,2,3,4,5,6,7}};
+static const int box_tet_corners[6][4] = {{0,1,3,7}, {0,2,6,7}, {0,4,5,7}, {0,5,1,7}, {0,6,4,7}, {0,3,2,7}};
+static const int box_pri_corners[2][6] = {{0,1,2,4,5,6}, {3,2,1,7,6,5}};
+
+// no. of sub-cells of a quad/hex and vertices of a sub-cell, for each element type
+
+static const int box_n_sub[5] = {2, 1, 6, 2, 1};
+static const int box_n_v[5] = {3, 4, 4, 6, 8};
+
+static int box_corner(int in_ctype, int in_sub, int in_v)
+{
+  if (in_ctype==TRI) return box_tri_corners[in_sub][in_v];
+  else if (in_ctype==QUAD) return box_quad_corners[in_sub][in_v];
+  else if (in_ctype==TET) return box_tet_corners[in_sub][in_v];
+  else if (in_ctype==PRISM) return box_pri_corners[in_sub][in_v];
+  else return box_hex_corners[in_sub][in_v];
+}
+
+// grid of ranks with the fewest cell faces between the blocks, and the cells of this rank's block
+
+static void box_partition(int in_n_dims, array<int>& out_lo, array<int>& out_hi, struct solution* FlowSol)
+{
+  int nproc = 1;
+#ifdef _MPI
+  nproc = FlowSol->nproc;
+#endif
+
+  array<int>& n = run_input.gen_n_cells;
+  int best_p[3] = {0,0,0};
+  double best_cost = -1.;
+
+  for (int px=1;px<=nproc;px++) {
+      if (nproc%px != 0 || px > n(0)) continue;
+      for (int py=1;py<=nproc/px;py++) {
+          if ((nproc/px)%py != 0 || py > n(1)) continue;
+          int pz = nproc/(px*py);
+          if (pz > n(2)) continue;
+
+          double cost = (px-1.)*n(1)*n(2) + (py-1.)*n(0)*n(2) + (pz-1.)*n(0)*n(1);
+          if (best_cost < 0. || cost < best_cost) {
+              best_cost = cost;
+              best_p[0] = px;
+              best_p[1] = py;
+              best_p[2] = pz;
+            }
+        }
+    }
 
-  // --- setup vertex->bcflag array ---
-  out_boundpts.setup(n_bcs);
-  array<set<int> > Bounds;
-  Bounds.setup(n_bcs);
+  if (best_cost < 0.)
+    FatalError("The generated mesh has too few cells in each direction for the no. of ranks");
 
-  //--- overwrite bc_list with bcflag (previously held gmsh bcid) ---
-  for (int i=0; i<n_bcs; i++) {
-    bcname.assign(bcTXT[out_bclist(i)],0,14);
-    bcname.erase(bcname.find_last_not_of(" \n\r\t")+1);
-    bcname.erase(bcname.find_last_not_of("\"")+1);
-    // ignore FLUID region as a "boundary"
-    if (bcname.compare("FLUID")==0) {
-      out_bclist(i) = -1;
-    }else{
-      bcflag = get_bc_number(bcname);
-      out_bclist(i) = bcflag;
+  int r[3];
+  r[0] = FlowSol->rank%best_p[0];
+  r[1] = (FlowSol->rank/best_p[0])%best_p[1];
+  r[2] = FlowSol->rank/(best_p[0]*best_p[1]);
+
+  out_lo.setup(3);
+  out_hi.setup(3);
+  for (int d=0;d<3;d++) {
+      out_lo(d) = (int)((double)n(d)*r[d]/best_p[d]);
+      out_hi(d) = (int)((double)n(d)*(r[d]+1)/best_p[d]);
     }
-  }
 
-  //--- Find boundaries which are moving ---//
-  out_bound_flag.setup(n_bcs);
-  out_bound_flag.initialize_to_zero();
-  for (int i=0; i<run_input.n_moving_bnds; i++) {
-    if (run_input.boundary_flags(i).compare("FLUID"))  // if NOT 'FLUID'
-    {
-      bcflag = get_bc_number(run_input.boundary_flags(i));
-      for (int j=0; j<n_bcs; j++) {
-        if (out_bclist(j)==bcflag) {
-          out_bound_flag(j) = 1;
-          break;
-        }
-      }
+  if (FlowSol->rank==0) {
+      cout << "generated mesh split among " << best_p[0] << "x" << best_p[1];
+      if (in_n_dims==3) cout << "x" << best_p[2];
+      cout << " ranks" << endl;
     }
-  }
+}
 
-  for (int i=0;i<n_entities;i++)
-    {
-      mesh_file >> id >> elmtype >> ntags;
-      mesh_file >> bcid;
-      for (int tag=0; tag<ntags-1; tag++)
-        mesh_file >> dummy;
+// grid index (i,j,k) of a global vertex
 
-      if (strstr(bcTXT[bcid],"FLUID"))
-        {
-          mesh_file.getline(buf,BUFSIZ);  // skip line
-          continue;
-        }
-      else
-        {
-          bcname.assign(bcTXT[bcid],0,14);
-          bcname.erase(bcname.find_last_not_of(" \n\r\t")+1);
-          bcname.erase(bcname.find_last_not_of("\"")+1);
-          bcflag = get_bc_number(bcname);
-        }
+static void box_vertex_index(int in_ivg, int* out_index)
+{
+  array<int>& n = run_input.gen_n_cells;
 
-      bdy_count++;
+  out_index[0] = in_ivg%(n(0)+1);
+  out_index[1] = (in_ivg/(n(0)+1))%(n(1)+1);
+  out_index[2] = in_ivg/((n(0)+1)*(n(1)+1));
+}
 
-      if (elmtype==1 || elmtype==8) // Edge
-      {
-        num_face_vert = 2;
-        // Read the two vertices
-        mesh_file >> vlist_bound(0) >> vlist_bound(1);
-      }
-      else if (elmtype==3) // Quad face
-      {
-        num_face_vert = 4;
-        mesh_file >> vlist_bound(0) >> vlist_bound(1) >> vlist_bound(3) >> vlist_bound(2);
-      }
-      else if (elmtype==2) // Linear tri face
-      {
-        num_face_vert = 3;
-        mesh_file >> vlist_bound(0) >> vlist_bound(1) >> vlist_bound(2);
-      }
-      else if (elmtype == 9) // Quadratic Tri Face
-      {
-        num_face_vert = 3;
-        mesh_file >> vlist_bound(0) >> vlist_bound(1) >> vlist_bound(2);
-        mesh_file >> vlist_bound(3) >> vlist_bound(4) >> vlist_bound(5);
-      }
-      else if (elmtype==10) // Quadratic quad face
-      {
-        num_face_vert = 9;
-        mesh_file >> vlist_bound(0) >> vlist_bound(2) >> vlist_bound(8) >> vlist_bound(6);
-        mesh_file >> vlist_bound(1) >> vlist_bound(5) >> vlist_bound(7) >> vlist_bound(3) >> vlist_bound(4);
-      }
-      else 
-      {
-        cout << "Gmsh boundary element type: " << elmtype << endl;
-        FatalError("Boundary elmtype not recognized");
-      }
+void generate_connectivity_box(int &out_n_cells, array<int> &out_c2v, array<int> &out_c2n_v, array<int> &out_ctype, array<int> &out_ic2icg, struct solution* FlowSol)
+{
+  int ctype = run_input.gen_ele_type;
+  int n_sub = box_n_sub[ctype];
+  int n_v = box_n_v[ctype];
+  array<int>& n = run_input.gen_n_cells;
 
-      // Shift by -1 (1-indexed -> 0-indexed)
-      for (int j=0;j<num_face_vert;j++)
-      {
-        vlist_bound(j)--;
-      }
+  FlowSol->n_dims = (ctype==TRI || ctype==QUAD) ? 2 : 3;
+  FlowSol->num_cells_global = n(0)*n(1)*n(2)*n_sub;
 
-      mesh_file.getline(buf,BUFSIZ);  // Get rest of line
+  array<int> lo, hi;
+  box_partition(FlowSol->n_dims,lo,hi,FlowSol);
 
-      // Check if all vertices belong to processor
-      bool belong_to_proc = true;
-      for (int j=0;j<num_face_vert;j++)
-        {
-          vlist_local(j) = index_locate_int(vlist_bound(j),in_iv2ivg.get_ptr_cpu(),in_n_verts);
-          if (vlist_local(j) == -1)
-            belong_to_proc = false;
+  out_n_cells = (hi(0)-lo(0))*(hi(1)-lo(1))*(hi(2)-lo(2))*n_sub;
 
-          Bounds(bcid-1).insert(vlist_local(j));
+  out_c2v.setup(out_n_cells,MAX_V_PER_C);
+  out_c2n_v.setup(out_n_cells);
+  out_ctype.setup(out_n_cells);
+  out_ic2icg.setup(out_n_cells);
+  out_c2v.initialize_to_value(-1);
+
+  int ic = 0;
+  for (int k=lo(2);k<hi(2);k++) {
+      for (int j=lo(1);j<hi(1);j++) {
+          for (int i=lo(0);i<hi(0);i++) {
+              for (int s=0;s<n_sub;s++) {
+                  out_c2n_v(ic) = n_v;
+                  out_ctype(ic) = ctype;
+                  out_ic2icg(ic) = (i+n(0)*(j+n(1)*k))*n_sub+s;
+
+                  for (int v=0;v<n_v;v++) {
+                      int c = box_corner(ctype,s,v);
+                      int iv = i+(c&1);
+                      int jv = j+((c>>1)&1);
+                      int kv = k+((c>>2)&1);
+                      out_c2v(ic,v) = iv+(n(0)+1)*(jv+(n(1)+1)*kv);
+                    }
+                  ic++;
+                }
+            }
         }
+    }
+}
 
-      if (belong_to_proc)
-        {
-          // All vertices on face belong to processor
-          // Try to find the cell that they belong to
-          found=0;
+void generate_vertices_box(int in_n_verts, int& out_n_verts_global, array<int> &in_iv2ivg, array<double> &out_xv, struct solution* FlowSol)
+{
+  array<int>& n = run_input.gen_n_cells;
+  int n_dims = FlowSol->n_dims;
+  int index[3];
+  double s[3];
+
+  out_n_verts_global = (n(0)+1)*(n(1)+1)*(n_dims==3 ? n(2)+1 : 1);
+
+  for (int iv=0;iv<in_n_verts;iv++) {
+      box_vertex_index(in_iv2ivg(iv),index);
+
+      // parametric coordinates, clustered towards both ends by tanh stretching
+      for (int d=0;d<n_dims;d++) {
+          s[d] = (double)index[d]/n(d);
+          double beta = run_input.gen_stretch(d);
+          if (beta > 0.)
+            s[d] = 0.5*(1.+tanh(beta*(2.*s[d]-1.))/tanh(beta));
+        }
 
-          // Loop over cells touching that vertex
-          sta_ind = in_icvsta(vlist_local(0));
-          end_ind = in_icvsta(vlist_local(0)+1)-1;
+      // sinusoidal distortion vanishing on the sides of the box, so cyclic sides still match
+      for (int d=0;d<n_dims;d++) {
+          double dist = run_input.gen_curvature*sin(pi*s[d]);
+          for (int e=0;e<n_dims;e++)
+            if (e != d)
+              dist *= sin(2.*pi*s[e]);
 
-          for (int ind=sta_ind;ind<=end_ind;ind++)
-            {
-              int ic=in_icvert(ind);
-              for (int k=0;k<FlowSol->num_f_per_c(in_ctype(ic));k++)
-                {
-                  // Get local vertices of local face k of cell ic
-                  get_vlist_loc_face(in_ctype(ic),in_c2n_v(ic),k,vlist_cell,num_v_per_f);
+          out_xv(iv,d) = run_input.gen_min(d)+(run_input.gen_max(d)-run_input.gen_min(d))*(s[d]+dist);
+        }
+    }
+}
 
-                  if (num_v_per_f != num_face_vert)
-                    continue;
+void generate_boundary_box(int in_n_cells, array<int>& in_ctype, array<int>& in_c2f, array<int>& in_f2v, array<int>& in_f2nv,
+                           array<int>& in_iv2ivg, array<int>& out_bctype, array<int> &out_bclist, array<array<int> > &out_bccells,
+                           array<array<int> > &out_bcfaces, struct solution* FlowSol)
+{
+  array<int>& n = run_input.gen_n_cells;
+  int n_sides = 2*FlowSol->n_dims;
+  int index[3];
 
-                  for (int j=0;j<num_v_per_f;j++)
-                  {
-                    vlist_cell(j) = in_c2v(ic,vlist_cell(j));
-                  }
+  // one boundary group per side of the box
+  vector<vector<int> > cells(n_sides), faces(n_sides);
+  out_bclist.setup(n_sides);
 
-                  compare_faces_boundary(vlist_local,vlist_cell,num_v_per_f,found);
+  for (int b=0;b<n_sides;b++) {
+      string bcname = run_input.gen_bc(b);
+      out_bclist(b) = get_bc_number(bcname);
+    }
 
-                  if (found==1)
-                  {
-                    out_bctype(ic,k)=bcflag;
-                    break;
-                  }
-                }
-              if (found==1)
-                break;
-            }
-          if (found==0)
-          {
-            cout << "vlist_bound(2)=" << vlist_bound(2) << " vlist_bound(3)=" << vlist_bound(3) << endl;
-            FatalError("All nodes of boundary face belong to processor but could not find the coresponding faces");
-          }
+  // a face is on a side if all its vertices are
+  for (int ic=0;ic<in_n_cells;ic++) {
+      for (int k=0;k<FlowSol->num_f_per_c(in_ctype(ic));k++) {
+          int f = in_c2f(ic,k);
 
-        } // If all vertices belong to processor
+          for (int b=0;b<n_sides;b++) {
+              int d = b/2;
+              int end = (b%2==0) ? 0 : n(d);
+              bool on_side = true;
 
-    } // Loop over entities
+              for (int m=0;m<in_f2nv(f) && on_side;m++) {
+                  box_vertex_index(in_iv2ivg(in_f2v(f,m)),index);
+                  on_side = (index[d]==end);
+                }
 
-  set<int>::iterator it;
-  for (int i=0; i<n_bcs; i++) {
-    out_boundpts(i).setup(Bounds(i).size());
-    int j=0;
-    for (it=Bounds(i).begin(); it!=Bounds(i).end(); it++) {
-      out_boundpts(i)(j) = (*it);
-      j++;
+              if (on_side) {
+                  out_bctype(ic,k) = out_bclist(b);
+                  cells[b].push_back(ic);
+                  faces[b].push_back(k);
+                  break;
+                }
+            }
+        }
     }
-  }
 
-  mesh_file.close();
+  out_bccells.setup(n_sides);
+  out_bcfaces.setup(n_sides);
 
-  //cout << "  Number of Boundary Faces: " << bdy_count << endl;
+  for (int b=0;b<n_sides;b++) {
+      out_bccells(b).setup(cells[b].size());
+      out_bcfaces(b).setup(faces[b].size());
+      for (size_t i=0;i<cells[b].size();i++) {
+          out_bccells(b)(i) = cells[b][i];
+          out_bcfaces(b)(i) = faces[b][i];
+        }
+    }
 }
 
 void read_vertices_gambit(string& in_file_name, int in_n_verts, int &out_n_verts_global, array<int> &in_iv2ivg, array<double> &out_xv, solution *FlowSol)
@@ -2003,6 +2684,7 @@ void read_connectivity_gmsh(string& in_file_name, int &out_n_cells, array<int> &
   // Skip elements being read by other processors
   icount=0;
   int i=0;
+  array<int> nodes(MAX_V_PER_C);
 
   // ctype is the element type:  for HiFiLES: 0=tri, 1=quad, 2=tet, 3=prism, 4=hex
   // For Gmsh node ordering, see: http://geuz.org/gmsh/doc/texinfo/gmsh.html#Node-ordering
@@ -2019,98 +2701,11 @@ void read_connectivity_gmsh(string& in_file_name, int &out_n_cells, array<int> &
           if (icount>=kstart && i< out_n_cells) // Read this cell
             {
               out_ic2icg(i) = icount;
-              if (elmtype ==2 || elmtype==9 || elmtype==21) // Triangle
-                {
-                  out_ctype(i) = 0;
-                  if (elmtype==2) // linear triangle
-                    {
-                      out_c2n_v(i) =3;
-                      mesh_file >> out_c2v(i,0) >> out_c2v(i,1) >> out_c2v(i,2);
-                    }
-                  else if (elmtype==9) // quadratic triangle
-                    {
-                      out_c2n_v(i) =6;
-                      mesh_file >> out_c2v(i,0) >> out_c2v(i,1) >> out_c2v(i,2) >> out_c2v(i,3) >> out_c2v(i,4) >> out_c2v(i,5) ;
-                    }
-                  else if (elmtype==21) // cubic triangle
-                    {
-                      FatalError("Cubic triangle not implemented");
-                    }
-                }
-              else if (elmtype==3 || elmtype==16 || elmtype==10) // Quad
-                {
-                  out_ctype(i) = 1;
-                  if (elmtype==3) // linear quadrangle
-                    {
-                      out_c2n_v(i) = 4;
-                      mesh_file >> out_c2v(i,0) >> out_c2v(i,1) >> out_c2v(i,3) >> out_c2v(i,2);
-                    }
-                  else if (elmtype==16) // quadratic quadrangle
-                    {
-                      out_c2n_v(i) = 8;
-                      mesh_file >> out_c2v(i,0) >> out_c2v(i,1) >> out_c2v(i,2) >> out_c2v(i,3) >> out_c2v(i,4) >> out_c2v(i,5) >> out_c2v(i,6) >> out_c2v(i,7);
-                    }
-                  else if (elmtype==10) // quadratic quadrangle
-                    {
-                      out_c2n_v(i) = 9;
-                      // not sure this is correct
-                      mesh_file >> out_c2v(i,0) >> out_c2v(i,2) >> out_c2v(i,8) >> out_c2v(i,6) >> out_c2v(i,1) >> out_c2v(i,5) >> out_c2v(i,7) >> out_c2v(i,3) >> out_c2v(i,4);
-                    }
-                }
-              else if (elmtype==4 || elmtype==11) // Tetrahedron
-              {
-                out_ctype(i) = 2;
-                if (elmtype==4) // Linear tet
-                {
-                  out_c2n_v(i) = 4;
-                  mesh_file >> out_c2v(i,0) >> out_c2v(i,1) >> out_c2v(i,2) >> out_c2v(i,3);
-                }
-                else if (elmtype==11) // Quadratic tet
-                {
-                  out_c2n_v(i) = 10;                  
-                  //mesh_file >> out_c2v(i,0) >> out_c2v(i,8) >> out_c2v(i,5) >> out_c2v(i,2) >> out_c2v(i,3);
-                  //mesh_file >> out_c2v(i,6) >> out_c2v(i,7) >> out_c2v(i,4) >> out_c2v(i,9) >> out_c2v(i,1);
-                  mesh_file >> out_c2v(i,0) >> out_c2v(i,5) >> out_c2v(i,4) >> out_c2v(i,2) >> out_c2v(i,8);
-                  mesh_file >> out_c2v(i,1) >> out_c2v(i,7) >> out_c2v(i,3) >> out_c2v(i,9) >> out_c2v(i,6);
-                }
-              }
-              else if (elmtype==5 || elmtype==12) // Hexahedron
-                {
-                  out_ctype(i) = 4;
-                  if (elmtype==5) // linear quadrangle
-                    {
-                      out_c2n_v(i) = 8;
-                      mesh_file >> out_c2v(i,0) >> out_c2v(i,1) >> out_c2v(i,3) >> out_c2v(i,2);
-                      mesh_file >> out_c2v(i,4) >> out_c2v(i,5) >> out_c2v(i,7) >> out_c2v(i,6);
-                    }
-                  else if (elmtype==12) // 27-node quadratic hexahedron
-                    {
-                      out_c2n_v(i) = 27;
-                      // vertices
-                      mesh_file >> out_c2v(i,0) >> out_c2v(i,1) >> out_c2v(i,2) >> out_c2v(i,3) >> out_c2v(i,4) >> out_c2v(i,5) >> out_c2v(i,6) >> out_c2v(i,7);
-                      // edges
-                      mesh_file >> out_c2v(i,8) >> out_c2v(i,9) >> out_c2v(i,10) >> out_c2v(i,11) >> out_c2v(i,12) >> out_c2v(i,13);
-                      mesh_file >> out_c2v(i,14) >> out_c2v(i,15) >> out_c2v(i,16) >> out_c2v(i,17) >> out_c2v(i,18) >> out_c2v(i,19);
-                      // faces
-                      mesh_file >> out_c2v(i,20) >> out_c2v(i,21) >> out_c2v(i,22) >> out_c2v(i,23) >> out_c2v(i,24) >> out_c2v(i,25);
-                      // volume
-                      mesh_file >> out_c2v(i,26);
-                    }
-                }
-              else
-                {
-                  cout << "elmtype=" << elmtype << endl;
-                  FatalError("element type not recognized");
-                }
 
-              // Shift every values of c2v by -1
-              for(int k=0;k<out_c2n_v(i);k++)
-                {
-                  if(out_c2v(i,k)!=0)
-                    {
-                      out_c2v(i,k)--;
-                    }
-                }
+              for (int k=0;k<gmsh4_file::get_n_nodes(elmtype);k++)
+                mesh_file >> nodes(k);
+
+              set_cell_gmsh(elmtype,nodes.get_ptr_cpu(),i,out_c2v,out_c2n_v,out_ctype);
 
               i++;
               mesh_file.getline(buf,BUFSIZ); // skip end of line
@@ -3663,14 +4258,103 @@ bool check_cyclic(array<double> &delta_cyclic, array<double> &loc_center_inter_0
   return output;
 }
 
+// orders faces lexicographically by their quantized centroid
+struct face_key_compare {
+  array<double>* key;
+
+  bool operator()(int a, int b) const
+  {
+    for (int m=0;m<key->get_dim(0);m++) {
+        if ((*key)(m,a)<(*key)(m,b)) return true;
+        if ((*key)(m,a)>(*key)(m,b)) return false;
+      }
+    return false;
+  }
+};
+
+void sort_face_centers(array<double>& in_centers, int in_n_faces, double tol, array<double>& out_key, array<int>& out_order)
+{
+  int n_dims = in_centers.get_dim(0);
+
+  // Cells of size 2*tol: a centroid within tol of a point lies in at most 2 cells per direction
+  out_key.setup(n_dims,in_n_faces);
+  out_order.setup(in_n_faces);
+
+  for (int i=0;i<in_n_faces;i++) {
+      for (int m=0;m<n_dims;m++)
+        out_key(m,i) = floor(in_centers(m,i)/(2.*tol));
+      out_order(i) = i;
+    }
+
+  face_key_compare comp;
+  comp.key = &out_key;
+  sort(out_order.get_ptr_cpu(),out_order.get_ptr_cpu()+in_n_faces,comp);
+}
+
+void find_cyclic_face_centers(array<double>& in_key, array<int>& in_order, int in_n_faces, array<double>& in_center, array<double>& delta_cyclic, double tol, vector<int>& out_faces)
+{
+  int n_dims = in_key.get_dim(0);
+  int n_cells;
+  double h = 2.*tol;
+  array<double> pos(n_dims), key(n_dims), key_lo(n_dims), key_hi(n_dims);
+
+  out_faces.clear();
+
+  // Unshifted centroid, then the centroid shifted by -delta and +delta in each direction
+  for (int s=0;s<2*n_dims+1;s++) {
+      for (int m=0;m<n_dims;m++)
+        pos(m) = in_center(m);
+
+      if (s>0)
+        pos((s-1)/2) += (s%2 ? -1. : 1.)*delta_cyclic((s-1)/2);
+
+      n_cells = 1;
+      for (int m=0;m<n_dims;m++) {
+          key_lo(m) = floor((pos(m)-tol)/h);
+          key_hi(m) = floor((pos(m)+tol)/h);
+          n_cells *= (int)(key_hi(m)-key_lo(m))+1;
+        }
+
+      for (int c=0;c<n_cells;c++) {
+          int r = c;
+          for (int m=0;m<n_dims;m++) {
+              int n = (int)(key_hi(m)-key_lo(m))+1;
+              key(m) = key_lo(m)+r%n;
+              r /= n;
+            }
+
+          // binary search for the first face in this cell
+          int lo = 0, hi = in_n_faces;
+          while (lo<hi) {
+              int mid = (lo+hi)/2, cmp = 0;
+              for (int m=0;m<n_dims && cmp==0;m++) {
+                  if (in_key(m,in_order(mid))<key(m)) cmp = -1;
+                  else if (in_key(m,in_order(mid))>key(m)) cmp = 1;
+                }
+              if (cmp<0) lo = mid+1;
+              else hi = mid;
+            }
+
+          for (;lo<in_n_faces;lo++) {
+              bool same = true;
+              for (int m=0;m<n_dims;m++)
+                if (in_key(m,in_order(lo))!=key(m)) same = false;
+              if (!same) break;
+              out_faces.push_back(in_order(lo));
+            }
+        }
+    }
+
+  // Candidates in their original order, so that the first match is the same as a linear search
+  sort(out_faces.begin(),out_faces.end());
+  out_faces.erase(unique(out_faces.begin(),out_faces.end()),out_faces.end());
+}
+
 #ifdef _MPI
 
 void match_mpifaces(array<int> &in_f2v, array<int> &in_f2nv, array<double>& in_xv, array<int>& inout_f_mpi2f, array<int>& out_mpifaces_part, array<double> &delta_cyclic, int n_mpi_faces, double tol, struct solution* FlowSol)
 {
 
-  // TODO: THIS IS NOT OPTIMAL: GOES AS N^2 operations, try sorting and searching instead (cost will be 2*N*log(N)
-  // TODO: TIDY UP
-
   int i,iglob, k,v0,v1,v2,v3;
   int icount,p,p2,rtag;
   int iloc,irem;
@@ -3722,6 +4406,13 @@ void match_mpifaces(array<int> &in_f2v, array<int> &in_f2nv, array<double>& in_x
   array<double> loc_center_1(FlowSol->n_dims);
   array<double> loc_center_2(FlowSol->n_dims);
 
+  // Centroids sorted by quantized coordinates, so that matching faces are found by binary search
+  array<double> key_local, key_remote;
+  array<int> order_local, order_remote;
+  vector<int> candidates;
+
+  sort_face_centers(loc_center_inter,n_mpi_faces,tol,key_local,order_local);
+
   // Begin the exchange
   icount = 0;
   for(p=0;p<FlowSol->nproc;p++) {
@@ -3743,17 +4434,23 @@ void match_mpifaces(array<int> &in_f2v, array<int> &in_f2nv, array<double>& in_x
 
           if (p<FlowSol->rank)
             {
+              sort_face_centers(in_loc_center_inter,mpifaces_from(p),tol,key_remote,order_remote);
+
               // Loop over local mpi_edges
               for (iloc=0;iloc<n_mpi_faces;iloc++) {
                   if (!matched(iloc)) // if local edge hasn't been matched yet
                     {
-                      // Loop over remote edges just received
-                      for(irem=0;irem<mpifaces_from(p);irem++)
+                      for (int m=0;m<FlowSol->n_dims;m++)
+                        loc_center_2(m) = loc_center_inter(m,iloc);
+
+                      // Loop over remote edges just received near the local edge
+                      find_cyclic_face_centers(key_remote,order_remote,mpifaces_from(p),loc_center_2,delta_cyclic,tol,candidates);
+
+                      for(size_t c=0;c<candidates.size();c++)
                         {
-                          for (int m=0;m<FlowSol->n_dims;m++) {
-                              loc_center_1(m) = in_loc_center_inter(m,irem);
-                              loc_center_2(m) = loc_center_inter(m,iloc);
-                            }
+                          irem = candidates[c];
+                          for (int m=0;m<FlowSol->n_dims;m++)
+                            loc_center_1(m) = in_loc_center_inter(m,irem);
 
                           if (check_cyclic(delta_cyclic,loc_center_1,loc_center_2,tol,FlowSol) ||
                               check_cyclic(delta_zero  ,loc_center_1,loc_center_2,tol,FlowSol) )
@@ -3775,14 +4472,20 @@ void match_mpifaces(array<int> &in_f2v, array<int> &in_f2nv, array<double>& in_x
               // Loop over remote edges
               for (irem=0;irem<mpifaces_from(p);irem++)
                 {
-                  for (iloc=0;iloc<n_mpi_faces;iloc++)
+                  for (int m=0;m<FlowSol->n_dims;m++)
+                    loc_center_1(m) = in_loc_center_inter(m,irem);
+
+                  // Loop over local edges near the remote edge
+                  find_cyclic_face_centers(key_local,order_local,n_mpi_faces,loc_center_1,delta_cyclic,tol,candidates);
+
+                  for (size_t c=0;c<candidates.size();c++)
                     {
+                      iloc = candidates[c];
                       if (!matched(iloc)) // if local edge hasn't been matched yet
                         {
-                          for (int m=0;m<FlowSol->n_dims;m++) {
-                              loc_center_1(m) = in_loc_center_inter(m,irem);
-                              loc_center_2(m) = loc_center_inter(m,iloc);
-                            }
+                          for (int m=0;m<FlowSol->n_dims;m++)
+                            loc_center_2(m) = loc_center_inter(m,iloc);
+
                           // Check if it matches vertex iloc
                           if (check_cyclic(delta_cyclic,loc_center_1,loc_center_2,tol,FlowSol) ||
                               check_cyclic(delta_zero  ,loc_center_1,loc_center_2,tol,FlowSol))
@@ -4074,5 +4777,192 @@ void compare_mpi_faces(array<double> &xvert1, array<double> &xvert2, int& num_v_
 
 }
 
-#endif
+void calc_wall_distance_parallel(kdtree& in_wall_tree, struct solution* FlowSol)
+{
+  int n_dims = FlowSol->n_dims;
+  int nproc = FlowSol->nproc;
+  int n_sample_max = 256;
+
+  // Bounding box of the no-slip wall points on every partition (empty partitions have min > max)
+  array<double> box_min, box_max;
+  array<double> box(n_dims,2);
+  array<double> boxes(n_dims,2,nproc);
+
+  in_wall_tree.get_bounds(box_min,box_max);
+  for(int k=0;k<n_dims;k++) {
+    box(k,0) = box_min(k);
+    box(k,1) = box_max(k);
+  }
+
+  MPI_Allgather(box.get_ptr_cpu(), 2*n_dims, MPI_DOUBLE, boxes.get_ptr_cpu(), 2*n_dims, MPI_DOUBLE, MPI_COMM_WORLD);
+
+  // Gather a small strided sample of the wall points of every partition; the
+  // nearest sample point gives every solution point an upper bound on its wall distance
+  int n_wall_pts = in_wall_tree.get_n_pts();
+  int n_sample = min(n_wall_pts,n_sample_max);
+  int n_sample_global = 0;
+  array<double> sample(n_dims,n_sample);
+  array<int> sample_count(nproc), sample_displ(nproc);
+
+  for(int i=0;i<n_sample;i++)
+    for(int k=0;k<n_dims;k++)
+      sample(k,i) = in_wall_tree.get_pt((int)((long)i*n_wall_pts/n_sample))[k];
+
+  n_sample *= n_dims;
+  MPI_Allgather(&n_sample, 1, MPI_INT, sample_count.get_ptr_cpu(), 1, MPI_INT, MPI_COMM_WORLD);
+
+  for(int p=0;p<nproc;p++) {
+    sample_displ(p) = n_sample_global;
+    n_sample_global += sample_count(p);
+  }
+
+  array<double> sample_global(n_dims,n_sample_global/n_dims);
+  MPI_Allgatherv(sample.get_ptr_cpu(), n_sample, MPI_DOUBLE, sample_global.get_ptr_cpu(), sample_count.get_ptr_cpu(), sample_displ.get_ptr_cpu(), MPI_DOUBLE, MPI_COMM_WORLD);
+
+  kdtree sample_tree;
+  sample_tree.setup(sample_global);
+
+  // Nearest wall point of every solution point among the local and sampled wall points
+  int n_queries = 0;
+  for(int i=0;i<FlowSol->n_ele_types;i++)
+    n_queries += FlowSol->mesh_eles(i)->get_n_eles()*FlowSol->mesh_eles(i)->get_n_upts_per_ele();
+
+  array<double> pos(n_dims,n_queries);
+  array<double> pos_wall(n_dims,n_queries);
+  array<double> dist2(n_queries);
+  array<double> pos_upt(n_dims);
+  int q = 0;
+
+  for(int i=0;i<FlowSol->n_ele_types;i++) {
+    for(int j=0;j<FlowSol->mesh_eles(i)->get_n_eles();j++) {
+      for(int u=0;u<FlowSol->mesh_eles(i)->get_n_upts_per_ele();u++) {
+        FlowSol->mesh_eles(i)->calc_pos_upt(u,j,pos_upt);
+
+        dist2(q) = 1e40;
+        for(int k=0;k<n_dims;k++) {
+          pos(k,q) = pos_upt(k);
+          pos_wall(k,q) = 0.;
+        }
+
+        int pt = in_wall_tree.nearest(pos.get_ptr_cpu(0,q),dist2(q));
+        if (pt>=0)
+          for(int k=0;k<n_dims;k++)
+            pos_wall(k,q) = in_wall_tree.get_pt(pt)[k];
+
+        pt = sample_tree.nearest(pos.get_ptr_cpu(0,q),dist2(q));
+        if (pt>=0)
+          for(int k=0;k<n_dims;k++)
+            pos_wall(k,q) = sample_tree.get_pt(pt)[k];
+
+        q++;
+      }
+    }
+  }
+
+  // Send each solution point to the other partitions whose wall bounding box is closer than its current bound
+  int n_msg = n_dims+1;
+  array<int> send_count(nproc), recv_count(nproc), send_displ(nproc), recv_displ(nproc);
+  array<int> send_query;
+  int n_send = 0, n_recv = 0;
+
+  for(int p=0;p<nproc;p++)
+    send_count(p) = 0;
+
+  for(int pass=0;pass<2;pass++) {
+
+    if (pass==1) {
+      send_query.setup(n_send);
+      n_send = 0;
+    }
+
+    for(int p=0;p<nproc;p++) {
+      if (pass==1)
+        send_displ(p) = n_send;
+
+      if (p==FlowSol->rank || sample_count(p)==0)
+        continue;
+
+      for(q=0;q<n_queries;q++) {
+        double box_dist2 = 0.;
+        for(int k=0;k<n_dims;k++) {
+          double d = max(0.,max(boxes(k,0,p)-pos(k,q),pos(k,q)-boxes(k,1,p)));
+          box_dist2 += d*d;
+        }
 
+        if (box_dist2<dist2(q)) {
+          if (pass==0)
+            send_count(p)++;
+          else
+            send_query(n_send) = q;
+          n_send++;
+        }
+      }
+    }
+  }
+
+  MPI_Alltoall(send_count.get_ptr_cpu(), 1, MPI_INT, recv_count.get_ptr_cpu(), 1, MPI_INT, MPI_COMM_WORLD);
+
+  for(int p=0;p<nproc;p++) {
+    recv_displ(p) = n_recv;
+    n_recv += recv_count(p);
+  }
+
+  array<double> send_buf(n_msg,n_send), recv_buf(n_msg,n_recv);
+
+  for(int i=0;i<n_send;i++) {
+    for(int k=0;k<n_dims;k++)
+      send_buf(k,i) = pos(k,send_query(i));
+    send_buf(n_dims,i) = dist2(send_query(i));
+  }
+
+  // counts and displacements in doubles
+  for(int p=0;p<nproc;p++) {
+    send_count(p) *= n_msg; send_displ(p) *= n_msg;
+    recv_count(p) *= n_msg; recv_displ(p) *= n_msg;
+  }
+
+  MPI_Alltoallv(send_buf.get_ptr_cpu(), send_count.get_ptr_cpu(), send_displ.get_ptr_cpu(), MPI_DOUBLE, recv_buf.get_ptr_cpu(), recv_count.get_ptr_cpu(), recv_displ.get_ptr_cpu(), MPI_DOUBLE, MPI_COMM_WORLD);
+
+  // Answer with the nearest local wall point within the bound (squared distance -1 if none)
+  for(int i=0;i<n_recv;i++) {
+    double d2 = recv_buf(n_dims,i);
+    int pt = in_wall_tree.nearest(recv_buf.get_ptr_cpu(0,i),d2);
+
+    if (pt>=0) {
+      for(int k=0;k<n_dims;k++)
+        recv_buf(k,i) = in_wall_tree.get_pt(pt)[k];
+      recv_buf(n_dims,i) = d2;
+    }
+    else
+      recv_buf(n_dims,i) = -1.;
+  }
+
+  MPI_Alltoallv(recv_buf.get_ptr_cpu(), recv_count.get_ptr_cpu(), recv_displ.get_ptr_cpu(), MPI_DOUBLE, send_buf.get_ptr_cpu(), send_count.get_ptr_cpu(), send_displ.get_ptr_cpu(), MPI_DOUBLE, MPI_COMM_WORLD);
+
+  for(int i=0;i<n_send;i++) {
+    q = send_query(i);
+    if (send_buf(n_dims,i)>=0. && send_buf(n_dims,i)<dist2(q)) {
+      dist2(q) = send_buf(n_dims,i);
+      for(int k=0;k<n_dims;k++)
+        pos_wall(k,q) = send_buf(k,i);
+    }
+  }
+
+  // Store the wall distance vectors
+  array<double> vec(n_dims);
+  q = 0;
+
+  for(int i=0;i<FlowSol->n_ele_types;i++) {
+    for(int j=0;j<FlowSol->mesh_eles(i)->get_n_eles();j++) {
+      for(int u=0;u<FlowSol->mesh_eles(i)->get_n_upts_per_ele();u++) {
+        for(int k=0;k<n_dims;k++)
+          vec(k) = (dist2(q)<1e40) ? pos(k,q)-pos_wall(k,q) : 0.;
+
+        FlowSol->mesh_eles(i)->set_wall_distance(u,j,vec,sqrt(dist2(q)));
+        q++;
+      }
+    }
+  }
+}
+
+#endif
@@ -32,8 +32,6 @@ using namespace std;
 input run_input;
 const double pi=4*atan(1);
 
-const char* HIFILES_DIR = getenv("HIFILES_HOME");
-
 /*! Routine to multiply matrices similar to BLAS's dgemm */
 int dgemm(int Arows, int Bcols, int Acols, double alpha, double beta, double* a, double* b, double* c)
 {
@@ -101,6 +99,50 @@ int dgemm(int Arows, int Bcols, int Acols, double alpha, double beta, double* a,
   return 0;
 }
 
+/*! Single precision version of dgemm above */
+int sgemm(int Arows, int Bcols, int Acols, float alpha, float beta, float* a, float* b, float* c)
+{
+  #define A(I,J) a[(I) + (J)*Arows]
+  #define B(I,J) b[(I) + (J)*Acols]
+  #define C(I,J) c[(I) + (J)*Arows]
+
+  int i,j,l;
+  float temp;
+
+  if (Arows == 0 || Bcols == 0 || ((alpha == 0.f || Acols == 0) && beta == 1.f))  {
+      return 0;
+  }
+
+  for (j = 0; j < Bcols; j++) {
+
+    if (beta == 0.f) {
+      for (i = 0; i < Arows; i++)
+        C(i,j) = 0.f;
+    }
+
+    else if (beta != 1.f) {
+      for (i = 0; i < Arows; i++)
+              C(i,j) = beta * C(i,j);
+    }
+
+    if (alpha == 0.f)
+      continue;
+
+    for (l = 0; l < Acols; l++) {
+        temp = alpha*B(l,j);
+
+        for (i = 0; i < Arows; i++)
+          C(i,j) += temp * A(i,l);
+    }
+  }
+
+  #undef A
+  #undef B
+  #undef C
+
+  return 0;
+}
+
 /*! Routing to compute alpha*x + y for vectors x and y - similar to BLAS's daxpy */
 int daxpy(int n, double alpha, double *x, double *y)
 {
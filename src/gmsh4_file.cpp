@@ -0,0 +1,311 @@
+/*!
+ * \file gmsh4_file.cpp
+ * \brief _____________________________
+ * \author - Original code: SD++ developed by Patrice Castonguay, Antony Jameson,
+ *                          Peter Vincent, David Williams (alphabetical by surname).
+ *         - Current development: Aerospace Computing Laboratory (ACL)
+ *                                
+ * \version 0.1.0
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ * Copyright (C) 2014 Aerospace Computing Laboratory (ACL).
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../include/gmsh4_file.h"
+#include "../include/error.h"
+
+using namespace std;
+
+// #### constructors ####
+
+// default constructor
+
+gmsh4_file::gmsh4_file()
+{
+  binary = 0;
+}
+
+// default destructor
+
+gmsh4_file::~gmsh4_file()
+{
+  close();
+}
+
+// #### methods ####
+
+void gmsh4_file::open(string& in_file_name)
+{
+  string str;
+  double version;
+  int data_size, one;
+
+  close();
+  mesh_file.clear();
+  mesh_file.open(&in_file_name[0],ios::in|ios::binary);
+  if (!mesh_file)
+    FatalError("Unable to open mesh file");
+
+  // Format: version, file type (0 ascii, 1 binary) and size of size_t
+  if (!find_section("MeshFormat"))
+    FatalError("$MeshFormat tag not found!");
+
+  mesh_file >> version >> binary >> data_size;
+  getline(mesh_file,str);
+
+  if (version<4.1 || version>=5.)
+    FatalError("Only Gmsh 2.x and 4.1 mesh files are supported");
+  if (data_size!=sizeof(size_t))
+    FatalError("Gmsh file was written with a different size_t than this build");
+
+  if (binary) {
+    mesh_file.read((char*)&one,sizeof(int));
+    if (one!=1)
+      FatalError("Binary Gmsh file has a different byte order than this machine");
+  }
+
+  // Physical names
+  phys_dim.clear();
+  phys_name.clear();
+
+  if (!find_section("PhysicalNames"))
+    FatalError("$PhysicalNames tag not found!");
+
+  int n_phys, dim, tag;
+  mesh_file >> n_phys;
+  getline(mesh_file,str);
+
+  phys_tags.setup(n_phys);
+  for (int i=0;i<n_phys;i++) {
+    getline(mesh_file,str);
+    sscanf(str.c_str(),"%d %d",&dim,&tag);
+    size_t q0 = str.find('"'), q1 = str.rfind('"');
+    if (q0==string::npos || q1==q0)
+      FatalError("Could not read Gmsh physical name");
+
+    phys_tags(i) = tag;
+    phys_dim[tag] = dim;
+    phys_name[tag] = str.substr(q0+1,q1-q0-1);
+  }
+
+  // Entities: keep the first physical group of each point, curve, surface and volume
+  for (int d=0;d<4;d++)
+    entity_phys[d].clear();
+
+  if (!find_section("Entities"))
+    FatalError("$Entities tag not found!");
+
+  size_t n_ents[4];
+  for (int d=0;d<4;d++)
+    n_ents[d] = read_size();
+
+  for (int d=0;d<4;d++) {
+    for (size_t i=0;i<n_ents[d];i++) {
+      tag = read_int();
+      skip_doubles((d==0) ? 3 : 6);
+
+      size_t n_tags = read_size();
+      for (size_t j=0;j<n_tags;j++) {
+        int phys = read_int();
+        if (j==0)
+          entity_phys[d][tag] = phys;
+      }
+
+      if (d>0) {
+        size_t n_bound = read_size();
+        for (size_t j=0;j<n_bound;j++)
+          read_int();
+      }
+    }
+  }
+}
+
+void gmsh4_file::close(void)
+{
+  if (mesh_file.is_open())
+    mesh_file.close();
+}
+
+bool gmsh4_file::find_section(const char* in_name)
+{
+  string str, target = string("$") + in_name;
+
+  while (getline(mesh_file,str)) {
+    if (!str.empty() && str[str.size()-1]=='\r')
+      str.erase(str.size()-1);
+
+    if (str==target)
+      return true;
+
+    // Binary node and element data can contain anything: skip them by size
+    if (binary && str=="$Nodes")
+      skip_nodes();
+    else if (binary && str=="$Elements")
+      skip_elements();
+  }
+
+  return false;
+}
+
+size_t gmsh4_file::read_size(void)
+{
+  size_t val;
+  if (binary)
+    mesh_file.read((char*)&val,sizeof(size_t));
+  else
+    mesh_file >> val;
+  return val;
+}
+
+int gmsh4_file::read_int(void)
+{
+  int val;
+  if (binary)
+    mesh_file.read((char*)&val,sizeof(int));
+  else
+    mesh_file >> val;
+  return val;
+}
+
+void gmsh4_file::read_sizes(size_t* out_vals, size_t in_n)
+{
+  if (binary)
+    mesh_file.read((char*)out_vals,in_n*sizeof(size_t));
+  else
+    for (size_t i=0;i<in_n;i++)
+      mesh_file >> out_vals[i];
+}
+
+void gmsh4_file::read_doubles(double* out_vals, size_t in_n)
+{
+  if (binary)
+    mesh_file.read((char*)out_vals,in_n*sizeof(double));
+  else
+    for (size_t i=0;i<in_n;i++)
+      mesh_file >> out_vals[i];
+}
+
+void gmsh4_file::skip_sizes(size_t in_n)
+{
+  size_t dummy;
+  if (binary)
+    mesh_file.seekg(in_n*sizeof(size_t),ios::cur);
+  else
+    for (size_t i=0;i<in_n;i++)
+      mesh_file >> dummy;
+}
+
+void gmsh4_file::skip_doubles(size_t in_n)
+{
+  double dummy;
+  if (binary)
+    mesh_file.seekg(in_n*sizeof(double),ios::cur);
+  else
+    for (size_t i=0;i<in_n;i++)
+      mesh_file >> dummy;
+}
+
+void gmsh4_file::skip_nodes(void)
+{
+  size_t n_blocks = read_size();
+  skip_sizes(3);
+
+  for (size_t b=0;b<n_blocks;b++) {
+    int dim = read_int();
+    read_int();
+    int parametric = read_int();
+    size_t n = read_size();
+
+    skip_sizes(n);
+    skip_doubles(n*(3+(parametric ? dim : 0)));
+  }
+}
+
+void gmsh4_file::skip_elements(void)
+{
+  size_t n_blocks = read_size();
+  skip_sizes(3);
+
+  for (size_t b=0;b<n_blocks;b++) {
+    read_int();
+    read_int();
+    int elmtype = read_int();
+    size_t n = read_size();
+
+    skip_sizes(n*(1+get_n_nodes(elmtype)));
+  }
+}
+
+int gmsh4_file::get_physical(int in_dim, int in_tag)
+{
+  map<int,int>::iterator it = entity_phys[in_dim].find(in_tag);
+  return (it==entity_phys[in_dim].end()) ? 0 : it->second;
+}
+
+int gmsh4_file::get_n_physicals(void)
+{
+  return phys_tags.get_dim(0);
+}
+
+int gmsh4_file::get_physical_tag(int in_i)
+{
+  return phys_tags(in_i);
+}
+
+int gmsh4_file::get_physical_dim(int in_phys)
+{
+  return phys_dim[in_phys];
+}
+
+string gmsh4_file::get_physical_name(int in_phys)
+{
+  return phys_name[in_phys];
+}
+
+int gmsh4_file::get_n_nodes(int in_elmtype)
+{
+  switch (in_elmtype) {
+    case 1: return 2;   // line
+    case 2: return 3;   // triangle
+    case 3: return 4;   // quadrangle
+    case 4: return 4;   // tetrahedron
+    case 5: return 8;   // hexahedron
+    case 6: return 6;   // prism
+    case 7: return 5;   // pyramid
+    case 8: return 3;   // quadratic line
+    case 9: return 6;   // quadratic triangle
+    case 10: return 9;  // 9-node quadrangle
+    case 11: return 10; // quadratic tetrahedron
+    case 12: return 27; // 27-node hexahedron
+    case 13: return 18; // 18-node prism
+    case 14: return 14; // 14-node pyramid
+    case 15: return 1;  // point
+    case 16: return 8;  // 8-node quadrangle
+    case 17: return 20; // 20-node hexahedron
+    case 18: return 15; // 15-node prism
+    case 19: return 13; // 13-node pyramid
+    case 21: return 10; // cubic triangle
+    case 26: return 4;  // cubic line
+    default:
+      cout << "elmtype=" << in_elmtype << endl;
+      FatalError("Gmsh element type not recognized");
+  }
+  return 0;
+}
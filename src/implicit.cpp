@@ -0,0 +1,429 @@
+/*!
+ * \file implicit.cpp
+ * \brief _____________________________
+ * \author - Original code: SD++ developed by Patrice Castonguay, Antony Jameson,
+ *                          Peter Vincent, David Williams (alphabetical by surname).
+ *         - Current development: Aerospace Computing Laboratory (ACL)
+ *                                
+ * \version 0.1.0
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ * Copyright (C) 2014 Aerospace Computing Laboratory (ACL).
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cmath>
+
+#include "../include/global.h"
+#include "../include/implicit.h"
+#include "../include/solver.h"
+#include "../include/error.h"
+
+#ifdef _MPI
+#include "mpi.h"
+#endif
+
+using namespace std;
+
+// LU factorization with partial pivoting of the column-major n x n matrix a,
+// returns false if the matrix is singular
+
+static bool lu_factor(double* a, int* piv, int n)
+{
+  for (int k=0;k<n;k++) {
+    int p = k;
+    for (int i=k+1;i<n;i++)
+      if (fabs(a[i+n*k]) > fabs(a[p+n*k]))
+        p = i;
+
+    piv[k] = p;
+    if (a[p+n*k] == 0.0)
+      return false;
+
+    if (p != k)
+      for (int j=0;j<n;j++) {
+        double temp = a[k+n*j];
+        a[k+n*j] = a[p+n*j];
+        a[p+n*j] = temp;
+      }
+
+    double inv_pivot = 1.0/a[k+n*k];
+    for (int i=k+1;i<n;i++)
+      a[i+n*k] *= inv_pivot;
+
+    for (int j=k+1;j<n;j++) {
+      double a_kj = a[k+n*j];
+      if (a_kj != 0.0)
+        for (int i=k+1;i<n;i++)
+          a[i+n*j] -= a[i+n*k]*a_kj;
+    }
+  }
+
+  return true;
+}
+
+// solve with the factors of lu_factor, b is overwritten with the solution
+
+static void lu_solve(double* a, int* piv, int n, double* b)
+{
+  for (int k=0;k<n;k++) {
+    double temp = b[piv[k]];
+    b[piv[k]] = b[k];
+    b[k] = temp;
+    for (int i=k+1;i<n;i++)
+      b[i] -= a[i+n*k]*b[k];
+  }
+  for (int k=n-1;k>=0;k--) {
+    b[k] /= a[k+n*k];
+    for (int i=0;i<k;i++)
+      b[i] -= a[i+n*k]*b[k];
+  }
+}
+
+// #### constructors ####
+
+// default constructor
+
+implicit_solver::implicit_solver()
+{
+  FlowSol = NULL;
+  n_iters = 0;
+}
+
+// default destructor
+
+implicit_solver::~implicit_solver() { }
+
+// #### methods ####
+
+// allocate the Newton-Krylov vectors and the element blocks
+
+void implicit_solver::setup(struct solution* in_FlowSol)
+{
+  FlowSol = in_FlowSol;
+
+#ifdef _GPU
+  FatalError("The implicit solver (adv_type=4) is only implemented on the CPU");
+#endif
+
+  if (run_input.motion)
+    FatalError("The implicit solver (adv_type=4) does not support moving meshes");
+
+  int n_ele_types = FlowSol->n_ele_types;
+  int n_dofs = 0;
+
+  n_colors = 0;
+  max_n_block = 0;
+  offset.setup(n_ele_types);
+  block.setup(n_ele_types);
+  pivot.setup(n_ele_types);
+
+  for (int t=0;t<n_ele_types;t++) {
+    eles* ele_type = FlowSol->mesh_eles(t);
+    int n_eles = ele_type->get_n_eles();
+    int n_block = ele_type->get_n_upts_per_ele()*ele_type->get_n_fields();
+
+    offset(t) = n_dofs;
+    if (n_eles == 0)
+      continue;
+
+    n_dofs += n_eles*n_block;
+    if (n_block > max_n_block)
+      max_n_block = n_block;
+
+    for (int ic=0;ic<n_eles;ic++)
+      if (ele_type->get_color(ic) >= n_colors)
+        n_colors = ele_type->get_color(ic)+1;
+
+    block(t).setup(n_block,n_block,n_eles);
+    pivot(t).setup(n_block,n_eles);
+  }
+
+#ifdef _MPI
+  // every rank has to take part in each residual evaluation of the block Jacobian
+  int n_local = n_colors;
+  MPI_Allreduce(&n_local,&n_colors,1,MPI_INT,MPI_MAX,MPI_COMM_WORLD);
+  n_local = max_n_block;
+  MPI_Allreduce(&n_local,&max_n_block,1,MPI_INT,MPI_MAX,MPI_COMM_WORLD);
+#endif
+
+  u.Initialize(n_dofs,1,0.0);
+  res.Initialize(n_dofs,1,0.0);
+  du.Initialize(n_dofs,1,0.0);
+  u_pert.Initialize(n_dofs,1,0.0);
+  res_pert.Initialize(n_dofs,1,0.0);
+  dtau_inv.Initialize(n_dofs,1,0.0);
+
+  cfl = run_input.CFL;
+  cfl_jac = cfl;
+
+  if (FlowSol->rank==0)
+    cout << "Implicit solver: " << n_colors << " element colours, "
+         << n_colors*max_n_block << " residual evaluations per block Jacobian" << endl;
+}
+
+// take one pseudo-transient Newton step towards the steady state
+
+void implicit_solver::advance(int in_file_num)
+{
+  int n_dofs = u.GetLocSize();
+
+  file_num = in_file_num;
+
+  if (n_iters == 0) {
+    for (int t=0;t<FlowSol->n_ele_types;t++) {
+      int n_ele_dofs = FlowSol->mesh_eles(t)->get_n_eles()*FlowSol->mesh_eles(t)->get_n_upts_per_ele()*FlowSol->mesh_eles(t)->get_n_fields();
+      double* disu = FlowSol->mesh_eles(t)->get_disu_upts_ptr_cpu();
+      for (int i=0;i<n_ele_dofs;i++)
+        u[offset(t)+i] = disu[i];
+    }
+    calc_residual(u,res);
+    res_norm = res.norm();
+  }
+
+  calc_dtau_inv();
+
+  // The blocks are lagged, but their I/dtau diagonal must follow the SER CFL
+  // ramp: rebuild them as soon as the CFL moved by more than a factor of 2.
+  // The CFL follows the global residual norm, so all ranks rebuild together.
+  if (n_iters % run_input.implicit_jac_freq == 0 || cfl > 2.0*cfl_jac || cfl < 0.5*cfl_jac) {
+    calc_block_jacobi();
+    cfl_jac = cfl;
+  }
+
+  // Solve (I/dtau - dR/du) du = R(u)
+  CSysSolve system;
+  CJacobianVectorProduct mat_vec(this);
+  CBlockJacobiPreconditioner precond(this);
+
+  du = 0.0;
+  int n_lin_iters = system.FGMRES(res,du,mat_vec,precond,run_input.implicit_krylov_tol,run_input.implicit_krylov_dim,false,FlowSol);
+
+  for (int i=0;i<n_dofs;i++)
+    u_pert[i] = u[i] + du[i];
+
+  calc_residual(u_pert,res_pert);
+  double new_res_norm = res_pert.norm();
+
+  // Accept the step unless the residual blew up (or is not a number), and
+  // scale the CFL with the residual drop (switched evolution relaxation)
+  if (new_res_norm < 10.0*res_norm) {
+    for (int i=0;i<n_dofs;i++) {
+      u[i] = u_pert[i];
+      res[i] = res_pert[i];
+    }
+    cfl = min(run_input.implicit_cfl_max, cfl*res_norm/max(new_res_norm,1e-300));
+    cfl = max(cfl, run_input.CFL);
+    res_norm = new_res_norm;
+  }
+  else {
+    cfl *= 0.5;
+    if (cfl < 1e-3*run_input.CFL)
+      FatalError("The implicit solver diverged");
+
+    // back to the last solution (and its residual for the monitoring)
+    calc_residual(u,res);
+  }
+
+  n_iters++;
+
+  if (FlowSol->rank==0 && n_iters%run_input.monitor_res_freq==0)
+    cout << "Implicit step " << n_iters << ": CFL = " << cfl << ", FGMRES iterations = " << n_lin_iters
+         << ", |R| = " << res_norm << endl;
+}
+
+// Jacobian-vector product, out_prod = v/dtau - dR/du v
+
+void implicit_solver::apply_jacobian(const CSysVector& in_v, CSysVector& out_prod)
+{
+  int n_dofs = u.GetLocSize();
+  double v_norm = in_v.norm();
+
+  if (v_norm == 0.0) {
+    out_prod = 0.0;
+    return;
+  }
+
+  double eps_fd = sqrt(eps)*(1.0+u.norm())/v_norm;
+
+  for (int i=0;i<n_dofs;i++)
+    u_pert[i] = u[i] + eps_fd*in_v[i];
+
+  calc_residual(u_pert,res_pert);
+
+  for (int i=0;i<n_dofs;i++)
+    out_prod[i] = dtau_inv[i]*in_v[i] - (res_pert[i]-res[i])/eps_fd;
+}
+
+// apply the element block Jacobi preconditioner
+
+void implicit_solver::apply_preconditioner(const CSysVector& in_v, CSysVector& out_prod)
+{
+  for (int t=0;t<FlowSol->n_ele_types;t++) {
+    int n_eles = FlowSol->mesh_eles(t)->get_n_eles();
+    int n_upts = FlowSol->mesh_eles(t)->get_n_upts_per_ele();
+    int n_block = n_upts*FlowSol->mesh_eles(t)->get_n_fields();
+
+    if (n_eles == 0)
+      continue;
+
+#pragma omp parallel
+    {
+      array<double> b(n_block);
+
+#pragma omp for schedule(static)
+      for (int ic=0;ic<n_eles;ic++) {
+        for (int j=0;j<n_block;j++)
+          b(j) = in_v[get_index(t,ic,j%n_upts,j/n_upts)];
+
+        lu_solve(block(t).get_ptr_cpu()+n_block*n_block*ic,pivot(t).get_ptr_cpu()+n_block*ic,n_block,b.get_ptr_cpu());
+
+        for (int j=0;j<n_block;j++)
+          out_prod[get_index(t,ic,j%n_upts,j/n_upts)] = b(j);
+      }
+    }
+  }
+}
+
+// copy in_u into the solution at the solution points of all elements
+
+void implicit_solver::set_solution(CSysVector& in_u)
+{
+  for (int t=0;t<FlowSol->n_ele_types;t++) {
+    int n_ele_dofs = FlowSol->mesh_eles(t)->get_n_eles()*FlowSol->mesh_eles(t)->get_n_upts_per_ele()*FlowSol->mesh_eles(t)->get_n_fields();
+    double* disu = FlowSol->mesh_eles(t)->get_disu_upts_ptr_cpu();
+    for (int i=0;i<n_ele_dofs;i++)
+      disu[i] = in_u[offset(t)+i];
+  }
+}
+
+// evaluate R(in_u) into out_res, leaving in_u as the solution
+
+void implicit_solver::calc_residual(CSysVector& in_u, CSysVector& out_res)
+{
+  set_solution(in_u);
+
+  CalcResidual(file_num,0,FlowSol);
+
+  for (int t=0;t<FlowSol->n_ele_types;t++)
+    if (FlowSol->mesh_eles(t)->get_n_eles() != 0)
+      FlowSol->mesh_eles(t)->get_dudt_upts(&out_res[offset(t)]);
+}
+
+// inverse of the pseudo time step of each element at the current CFL
+
+void implicit_solver::calc_dtau_inv(void)
+{
+  // calc_dt_local scales with run_input.CFL
+  set_solution(u);
+
+  for (int t=0;t<FlowSol->n_ele_types;t++) {
+    eles* ele_type = FlowSol->mesh_eles(t);
+    int n_eles = ele_type->get_n_eles();
+    int n_upts = ele_type->get_n_upts_per_ele();
+    int n_fields = ele_type->get_n_fields();
+
+    for (int ic=0;ic<n_eles;ic++) {
+      double inv = run_input.CFL/(cfl*ele_type->calc_dt_local(ic));
+      for (int i=0;i<n_fields;i++)
+        for (int inp=0;inp<n_upts;inp++)
+          dtau_inv[get_index(t,ic,inp,i)] = inv;
+    }
+  }
+}
+
+// build and factor the element blocks of I/dtau - dR/du
+
+void implicit_solver::calc_block_jacobi(void)
+{
+  int n_dofs = u.GetLocSize();
+  array< array<double> > step(FlowSol->n_ele_types);
+
+  for (int t=0;t<FlowSol->n_ele_types;t++)
+    step(t).setup(FlowSol->mesh_eles(t)->get_n_eles());
+
+  // Perturbing value k of all elements of one colour at once gives column k
+  // of their diagonal blocks, as no two elements of a colour share a
+  // neighbour. Ranks colour independently, so the blocks of elements on MPI
+  // faces can pick up some coupling from the other side; this only weakens
+  // the preconditioner.
+  for (int c=0;c<n_colors;c++) {
+    for (int k=0;k<max_n_block;k++) {
+
+      for (int i=0;i<n_dofs;i++)
+        u_pert[i] = u[i];
+
+      for (int t=0;t<FlowSol->n_ele_types;t++) {
+        eles* ele_type = FlowSol->mesh_eles(t);
+        int n_upts = ele_type->get_n_upts_per_ele();
+        if (k >= n_upts*ele_type->get_n_fields())
+          continue;
+
+        for (int ic=0;ic<ele_type->get_n_eles();ic++)
+          if (ele_type->get_color(ic) == c) {
+            int idx = get_index(t,ic,k%n_upts,k/n_upts);
+            step(t)(ic) = sqrt(eps)*(1.0+fabs(u[idx]));
+            u_pert[idx] += step(t)(ic);
+          }
+      }
+
+      calc_residual(u_pert,res_pert);
+
+      for (int t=0;t<FlowSol->n_ele_types;t++) {
+        eles* ele_type = FlowSol->mesh_eles(t);
+        int n_upts = ele_type->get_n_upts_per_ele();
+        int n_block = n_upts*ele_type->get_n_fields();
+        if (k >= n_block)
+          continue;
+
+        for (int ic=0;ic<ele_type->get_n_eles();ic++)
+          if (ele_type->get_color(ic) == c)
+            for (int j=0;j<n_block;j++) {
+              int idx = get_index(t,ic,j%n_upts,j/n_upts);
+              block(t)(j,k,ic) = -(res_pert[idx]-res[idx])/step(t)(ic);
+              if (j == k)
+                block(t)(j,k,ic) += dtau_inv[idx];
+            }
+      }
+    }
+  }
+
+  // FatalError cannot be called from inside the parallel region, count the singular blocks instead
+  int n_singular = 0;
+
+  for (int t=0;t<FlowSol->n_ele_types;t++) {
+    int n_eles = FlowSol->mesh_eles(t)->get_n_eles();
+    int n_block = FlowSol->mesh_eles(t)->get_n_upts_per_ele()*FlowSol->mesh_eles(t)->get_n_fields();
+
+#pragma omp parallel for schedule(dynamic) reduction(+:n_singular)
+    for (int ic=0;ic<n_eles;ic++)
+      if (!lu_factor(block(t).get_ptr_cpu()+n_block*n_block*ic,pivot(t).get_ptr_cpu()+n_block*ic,n_block))
+        n_singular++;
+  }
+
+  if (n_singular > 0)
+    FatalError("Singular element block in the implicit preconditioner");
+}
+
+// index of a solution point value in the solver vectors (the layout of disu_upts)
+
+int implicit_solver::get_index(int in_ele_type, int in_ele, int in_upt, int in_field)
+{
+  eles* ele_type = FlowSol->mesh_eles(in_ele_type);
+  int n_upts = ele_type->get_n_upts_per_ele();
+
+  return offset(in_ele_type) + in_upt + n_upts*(in_ele + ele_type->get_n_eles()*in_field);
+}
@@ -29,6 +29,7 @@
 #include <sstream>
 #include <cstring>
 #include <cmath>
+#include <climits>
 #include <cstdlib>
 #include <string>
 #include <vector>
@@ -104,14 +105,52 @@ void input::read_input_file(string fileName, int rank)
   opts.getScalarValue("equation",equation);
   opts.getScalarValue("order",order);
   opts.getScalarValue("viscous",viscous,0);
-  opts.getScalarValue("mesh_file",mesh_file);
+  opts.getScalarValue("mesh_gen",mesh_gen,0);
+  if (!mesh_gen)
+    opts.getScalarValue("mesh_file",mesh_file);
+  opts.getScalarValue("mesh_cache",mesh_cache,0);
+  if (mesh_gen && mesh_cache)
+    FatalError("mesh_cache does not apply to a generated mesh (mesh_gen=1)");
   opts.getScalarValue("ic_form",ic_form,1);
   opts.getScalarValue("test_case",test_case,0);
   opts.getScalarValue("n_steps",n_steps);
   opts.getScalarValue("restart_flag",restart_flag,0);
+  opts.getScalarValue("restart_bin",restart_bin,0);
   if (restart_flag == 1) {
     opts.getScalarValue("restart_iter",restart_iter);
-    opts.getScalarValue("n_restart_files",n_restart_files);
+    if (!restart_bin) // binary restarts find their files through the index
+      opts.getScalarValue("n_restart_files",n_restart_files);
+  }
+
+  /* ---- Mesh Generator Parameters ---- */
+
+  gen_n_cells.setup(3);
+  gen_min.setup(3);
+  gen_max.setup(3);
+  gen_stretch.setup(3);
+  gen_bc.setup(6);
+
+  if (mesh_gen) {
+    opts.getScalarValue("gen_ele_type",gen_ele_type);
+    opts.getScalarValue("gen_nx",gen_n_cells(0));
+    opts.getScalarValue("gen_ny",gen_n_cells(1));
+    opts.getScalarValue("gen_nz",gen_n_cells(2),1);
+    opts.getScalarValue("gen_x_min",gen_min(0),0.);
+    opts.getScalarValue("gen_x_max",gen_max(0),1.);
+    opts.getScalarValue("gen_y_min",gen_min(1),0.);
+    opts.getScalarValue("gen_y_max",gen_max(1),1.);
+    opts.getScalarValue("gen_z_min",gen_min(2),0.);
+    opts.getScalarValue("gen_z_max",gen_max(2),1.);
+    opts.getScalarValue("gen_stretch_x",gen_stretch(0),0.);
+    opts.getScalarValue("gen_stretch_y",gen_stretch(1),0.);
+    opts.getScalarValue("gen_stretch_z",gen_stretch(2),0.);
+    opts.getScalarValue("gen_curvature",gen_curvature,0.);
+    opts.getScalarValue("gen_bc_x_min",gen_bc(0),string("cyclic"));
+    opts.getScalarValue("gen_bc_x_max",gen_bc(1),string("cyclic"));
+    opts.getScalarValue("gen_bc_y_min",gen_bc(2),string("cyclic"));
+    opts.getScalarValue("gen_bc_y_max",gen_bc(3),string("cyclic"));
+    opts.getScalarValue("gen_bc_z_min",gen_bc(4),string("cyclic"));
+    opts.getScalarValue("gen_bc_z_max",gen_bc(5),string("cyclic"));
   }
 
   /* ---- Visualization / Monitoring / Output Parameters ---- */
@@ -127,6 +166,19 @@ void input::read_input_file(string fileName, int rank)
   opts.getScalarValue("res_norm_field",res_norm_field,0);
   opts.getScalarValue("p_res",p_res,3);
   opts.getScalarValue("write_type",write_type,1);
+  opts.getScalarValue("vtu_format",vtu_format,0);
+  opts.getScalarValue("vtu_compress",vtu_compress,0);
+  opts.getScalarValue("vtu_float64",vtu_float64,0);
+  if (vtu_format<0 || vtu_format>2)
+    FatalError("vtu_format must be 0 (ascii), 1 (base64 appended) or 2 (raw appended)");
+#ifndef _ZLIB
+  if (vtu_format!=0 && vtu_compress)
+    FatalError("vtu_compress requires building with _ZLIB");
+#endif
+  opts.getScalarValue("output_async",output_async,0);
+  opts.getScalarValue("output_queue_size",output_queue_size,2);
+  if (output_async && output_queue_size<1)
+    FatalError("output_queue_size must be at least 1");
   opts.getScalarValue("inters_cub_order",inters_cub_order,3);
   opts.getScalarValue("volume_cub_order", volume_cub_order,3);
 
@@ -149,6 +201,8 @@ void input::read_input_file(string fileName, int rank)
     std::transform(average_fields(i).begin(), average_fields(i).end(),
                    average_fields(i).begin(), ::tolower);
   }
+  if (n_average_fields > 0 && equation != 0)
+    FatalError("average_fields are only defined for the Euler/NS equations");
 
   /* ---- Basic Solver Parameters ---- */
 
@@ -156,20 +210,70 @@ void input::read_input_file(string fileName, int rank)
   opts.getScalarValue("vis_riemann_solve_type",vis_riemann_solve_type);
   opts.getScalarValue("adv_type",adv_type);
   opts.getScalarValue("dt_type",dt_type);
+  opts.getScalarValue("n_threads",n_threads,0);
+  opts.getScalarValue("mixed_precision",mixed_precision,0);
+#ifdef _GPU
+  if (mixed_precision)
+    FatalError("mixed_precision is not implemented on the GPU");
+#endif
+  // the finite-difference Jacobian products need the residual in double precision
+  if (mixed_precision && adv_type == 4)
+    FatalError("mixed_precision is not supported with the implicit solver (adv_type=4)");
   if (dt_type == 2 && rank == 0) {
     cout << "!!!!!!" << endl;
     cout << "  Note: Local timestepping is still in an experimental phase,";
     cout << "  especially for viscous simulations." << endl;
     cout << "!!!!!!" << endl;
   }
+  // the time averages are weighted by the physical time between the samples
+  if (dt_type == 2 && n_average_fields > 0)
+    FatalError("average_fields are not supported with local time stepping (dt_type=2)");
 
-  if (dt_type == 0) {
+  if (dt_type == 0 && adv_type != 4) {
     opts.getScalarValue("dt",dt);
   }
   else {
     opts.getScalarValue("CFL",CFL);
   }
 
+  if (adv_type == 5 || adv_type == 6) {
+    if (dt_type != 0)
+      FatalError("Adaptive RK time stepping needs dt_type=0 (dt is the initial step size)");
+    opts.getScalarValue("rk_atol",rk_atol,1.e-6);
+    opts.getScalarValue("rk_rtol",rk_rtol,1.e-6);
+    opts.getScalarValue("rk_safety",rk_safety,0.9);
+    opts.getScalarValue("rk_min_fac",rk_min_fac,0.3);
+    opts.getScalarValue("rk_max_fac",rk_max_fac,2.5);
+  }
+
+  opts.getScalarValue("pmg",pmg,0);
+  if (pmg) {
+    opts.getScalarValue("pmg_min_order",pmg_min_order,0);
+    opts.getScalarValue("pmg_n_smooth",pmg_n_smooth,1);
+  }
+
+  opts.getScalarValue("n_lts_levels",n_lts_levels,1);
+  if (n_lts_levels < 1)
+    FatalError("n_lts_levels must be at least 1");
+  if (n_lts_levels > 1) {
+#ifdef _GPU
+    FatalError("Local time stepping is not implemented on the GPU");
+#endif
+    if (adv_type != 0 && adv_type != 3)
+      FatalError("Local time stepping needs adv_type=0 or 3");
+    if (dt_type == 2)
+      FatalError("Local time stepping needs dt_type=0 or 1 (dt is the step of the coarsest level)");
+    if (pmg)
+      FatalError("Local time stepping is not supported with p-multigrid");
+  }
+
+  if (adv_type == 4) {
+    opts.getScalarValue("implicit_cfl_max",implicit_cfl_max,1.e6);
+    opts.getScalarValue("implicit_krylov_tol",implicit_krylov_tol,0.05);
+    opts.getScalarValue("implicit_krylov_dim",implicit_krylov_dim,30);
+    opts.getScalarValue("implicit_jac_freq",implicit_jac_freq,10);
+  }
+
   /* ---- Turbulence Modeling Parameters ---- */
 
   opts.getScalarValue("turb_model",turb_model,0);
@@ -211,6 +315,13 @@ void input::read_input_file(string fileName, int rank)
     opts.getScalarValue("restart_mesh_out",restart_mesh_out,0);
   }
 
+  // the output snapshots do not hold the moving mesh
+  if (output_async && motion != STATIC_MESH)
+    FatalError("output_async is not supported with mesh motion");
+
+  if (n_lts_levels > 1 && motion != STATIC_MESH)
+    FatalError("Local time stepping is not supported with mesh motion");
+
   /* ---- Gas Parameters ---- */
 
   opts.getScalarValue("gamma",gamma,1.4);
@@ -342,23 +453,70 @@ void input::setup(char* fileNameC, int rank)
   setup_params(rank);
 }
 
+void input::read_mpi_options(char* fileNameC)
+{
+  string fileNameS;
+  fileNameS.assign(fileNameC);
+
+  fileReader opts(fileNameS);
+  opts.getScalarValue("output_async",output_async,0);
+}
+
 void input::setup_params(int rank)
 {
   // --------------------
   // ERROR CHECKING
   // --------------------
   
-  if (monitor_res_freq == 0) monitor_res_freq = INFINITY;
-  if (monitor_cp_freq == 0) monitor_cp_freq = INFINITY;
-  if (monitor_integrals_freq == 0) monitor_integrals_freq = INFINITY;
+  if (monitor_res_freq == 0) monitor_res_freq = INT_MAX;
+  if (monitor_cp_freq == 0) monitor_cp_freq = INT_MAX;
+  if (monitor_integrals_freq == 0) monitor_integrals_freq = INT_MAX;
+  if (plot_freq == 0) plot_freq = INT_MAX;
+  if (restart_dump_freq == 0) restart_dump_freq = INT_MAX;
   
-  if (!mesh_file.compare(mesh_file.size()-3,3,"neu"))
+  if (mesh_gen)
+    mesh_format=2;
+  else if (!mesh_file.compare(mesh_file.size()-3,3,"neu"))
     mesh_format=0;
   else if (!mesh_file.compare(mesh_file.size()-3,3,"msh"))
     mesh_format=1;
   else
     FatalError("Mesh format not recognized");
-  
+
+  if (mesh_gen)
+  {
+    int n_dims = (gen_ele_type==0 || gen_ele_type==1) ? 2 : 3;
+
+    if (gen_ele_type<0 || gen_ele_type>4)
+      FatalError("gen_ele_type must be 0 (tri), 1 (quad), 2 (tet), 3 (prism) or 4 (hex)");
+
+    for (int d=0;d<n_dims;d++)
+    {
+      if (gen_n_cells(d)<1)
+        FatalError("The generated mesh needs at least one cell in each direction");
+      if (gen_max(d)<=gen_min(d))
+        FatalError("The generated box needs gen_*_max > gen_*_min");
+
+      // opposite sides are both cyclic or neither, they are matched by the box length
+      string bc_min = gen_bc(2*d), bc_max = gen_bc(2*d+1);
+      std::transform(bc_min.begin(), bc_min.end(), bc_min.begin(), ::tolower);
+      std::transform(bc_max.begin(), bc_max.end(), bc_max.begin(), ::tolower);
+
+      if (!bc_min.compare("cyclic") != !bc_max.compare("cyclic"))
+        FatalError("Both opposite sides of the generated box must be cyclic");
+
+      if (!bc_min.compare("cyclic"))
+      {
+        if (d==0) dx_cyclic = gen_max(d)-gen_min(d);
+        else if (d==1) dy_cyclic = gen_max(d)-gen_min(d);
+        else dz_cyclic = gen_max(d)-gen_min(d);
+      }
+    }
+
+    if (n_dims==2)
+      gen_n_cells(2) = 1;
+  }
+
   if (equation==0)
   {
     if (riemann_solve_type==1)
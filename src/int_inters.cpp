@@ -35,6 +35,7 @@
 #include "../include/output.h"
 #include "../include/flux.h"
 #include "../include/error.h"
+#include "../include/profiler.h"
 
 #if defined _GPU
 #include "../include/cuda_kernels.h"
@@ -224,13 +225,28 @@ void int_inters::mv_all_cpu_gpu(void)
 // calculate normal transformed continuous inviscid flux at the flux points
 void int_inters::calculate_common_invFlux(void)
 {
+  prof_timer timer(PROF_INT_INVFLUX,inters_type,32.*n_inters*n_fpts_per_inter*n_fields);
 
 #ifdef _CPU
+  // Batched Riemann solvers for the Euler / N-S equations
+  if (run_input.equation==0 && (run_input.riemann_solve_type==0 || (run_input.riemann_solve_type==2 && n_dims==2 && n_fields==4))
+      && (!viscous || run_input.vis_riemann_solve_type==0))
+  {
+    calculate_common_invFlux_batch();
+    return;
+  }
+
+#pragma omp parallel
+  {
+  // thread-private scratch (shadows the shared members of the same name)
+  array<double> temp_u_l(n_fields), temp_u_r(n_fields), temp_v(n_dims);
+  array<double> temp_f_l(n_fields,n_dims), temp_f_r(n_fields,n_dims);
   array<double> norm(n_dims), fn(n_fields);
 
   //viscous
   array<double> u_c(n_fields);
 
+#pragma omp for schedule(static)
   for(int i=0;i<n_inters;i++)
   {
     for(int j=0;j<n_fpts_per_inter;j++)
@@ -342,6 +358,7 @@ void int_inters::calculate_common_invFlux(void)
 
     }
   }
+  } // end omp parallel
 #endif
 
 #ifdef _GPU
@@ -354,14 +371,122 @@ void int_inters::calculate_common_invFlux(void)
 }
 
 
+// calculate normal transformed continuous inviscid flux at the flux points, in batches of
+// INTERS_BATCH_SIZE flux points gathered into contiguous buffers (Euler/NS with Rusanov or Roe flux)
+void int_inters::calculate_common_invFlux_batch(void)
+{
+  int n_pts = n_inters*n_fpts_per_inter;
+  int n_batches = (n_pts+INTERS_BATCH_SIZE-1)/INTERS_BATCH_SIZE;
+
+#pragma omp parallel
+  {
+  // thread-private batch buffers, indexing: (in_batch_fpt, in_field) or (in_batch_fpt, in_dim)
+  array<double> u_l(INTERS_BATCH_SIZE,n_fields), u_r(INTERS_BATCH_SIZE,n_fields), fn(INTERS_BATCH_SIZE,n_fields);
+  array<double> v_g(INTERS_BATCH_SIZE,n_dims), norm(INTERS_BATCH_SIZE,n_dims);
+
+  v_g.initialize_to_zero();
+
+#pragma omp for schedule(static)
+  for(int b=0;b<n_batches;b++)
+  {
+    int p0 = b*INTERS_BATCH_SIZE;
+    int n_pts_batch = min(INTERS_BATCH_SIZE,n_pts-p0);
+
+    // gather discontinuous solution, grid velocity and unit normal
+    for(int p=0;p<n_pts_batch;p++)
+    {
+      int i = (p0+p)/n_fpts_per_inter;
+      int j = (p0+p)%n_fpts_per_inter;
+
+      for(int k=0;k<n_fields;k++) {
+        u_l(p,k)=(*disu_fpts_l(j,i,k));
+        u_r(p,k)=(*disu_fpts_r(j,i,k));
+      }
+
+      if (motion) {
+        // Transform solution to dynamic space
+        double inv_J_l = 1./(*J_dyn_fpts_l(j,i));
+        double inv_J_r = 1./(*J_dyn_fpts_r(j,i));
+        for(int k=0;k<n_fields;k++) {
+          u_l(p,k) *= inv_J_l;
+          u_r(p,k) *= inv_J_r;
+        }
+        for(int m=0;m<n_dims;m++) {
+          v_g(p,m)=(*grid_vel_fpts(j,i,m));
+          norm(p,m)=(*norm_dyn_fpts(j,i,m));
+        }
+      }
+      else {
+        for(int m=0;m<n_dims;m++)
+          norm(p,m)=(*norm_fpts(j,i,m));
+      }
+    }
+
+    // Calling Riemann solver
+    if (run_input.riemann_solve_type==0)
+      rusanov_flux_batch(n_pts_batch,u_l.get_ptr_cpu(),u_r.get_ptr_cpu(),v_g.get_ptr_cpu(),norm.get_ptr_cpu(),fn.get_ptr_cpu(),n_dims,n_fields,run_input.gamma);
+    else
+      roe_flux_batch(n_pts_batch,u_l.get_ptr_cpu(),u_r.get_ptr_cpu(),v_g.get_ptr_cpu(),norm.get_ptr_cpu(),fn.get_ptr_cpu(),n_dims,n_fields,run_input.gamma);
+
+    // scatter, transforming back to reference space (and from dynamic to static space)
+    for(int p=0;p<n_pts_batch;p++)
+    {
+      int i = (p0+p)/n_fpts_per_inter;
+      int j = (p0+p)%n_fpts_per_inter;
+
+      double dA_l = (*tdA_fpts_l(j,i));
+      double dA_r = (*tdA_fpts_r(j,i));
+      if (motion) {
+        dA_l *= (*ndA_dyn_fpts_l(j,i));
+        dA_r *= (*ndA_dyn_fpts_r(j,i));
+      }
+
+      for(int k=0;k<n_fields;k++) {
+        (*norm_tconf_fpts_l(j,i,k)) = fn(p,k)*dA_l;
+        (*norm_tconf_fpts_r(j,i,k)) =-fn(p,k)*dA_r;
+      }
+
+      if(viscous)
+      {
+        // LDG common solution (interior switch), see ldg_solution
+        double pen_fact = run_input.pen_fact;
+        double n_sum = norm(p,0)+norm(p,1);
+        if (n_dims==3)
+          n_sum += sqrt(2.)*norm(p,2);
+        if (n_sum < 0.)
+          pen_fact = -pen_fact;
+
+        double J_l = (motion) ? (*J_dyn_fpts_l(j,i)) : 1.;
+        double J_r = (motion) ? (*J_dyn_fpts_r(j,i)) : 1.;
+
+        for(int k=0;k<n_fields;k++) {
+          double u_c = 0.5*(u_l(p,k) + u_r(p,k)) - pen_fact*(u_l(p,k) - u_r(p,k));
+          *delta_disu_fpts_l(j,i,k) = (u_c - u_l(p,k))*J_l;
+          *delta_disu_fpts_r(j,i,k) = (u_c - u_r(p,k))*J_r;
+        }
+      }
+    }
+  }
+  } // end omp parallel
+}
+
 // calculate normal transformed continuous viscous flux at the flux points
 
 void int_inters::calculate_common_viscFlux(void)
 {
+  prof_timer timer(PROF_INT_VISCFLUX,inters_type,32.*n_inters*n_fpts_per_inter*n_fields*(1+n_dims));
 
 #ifdef _CPU
+#pragma omp parallel
+  {
+  // thread-private scratch (shadows the shared members of the same name)
+  array<double> temp_u_l(n_fields), temp_u_r(n_fields);
+  array<double> temp_grad_u_l(n_fields,n_dims), temp_grad_u_r(n_fields,n_dims);
+  array<double> temp_f_l(n_fields,n_dims), temp_f_r(n_fields,n_dims);
+  array<double> temp_sgsf_l(n_fields,n_dims), temp_sgsf_r(n_fields,n_dims);
   array<double> norm(n_dims), fn(n_fields);
 
+#pragma omp for schedule(static)
   for(int i=0;i<n_inters;i++)
     {
       for(int j=0;j<n_fpts_per_inter;j++)
@@ -460,6 +585,7 @@ void int_inters::calculate_common_viscFlux(void)
 
         }
     }
+  } // end omp parallel
 
 #endif
 
@@ -175,12 +175,6 @@ void inters::setup_inters(int in_n_inters, int in_inters_type)
       temp_loc.setup(n_dims);
 
       lut.setup(n_fpts_per_inter);
-
-      // For Roe flux computation
-      v_l.setup(n_dims);
-      v_r.setup(n_dims);
-      um.setup(n_dims);
-      du.setup(n_fields);
 }
 
 // get look up table for flux point connectivity based on rotation tag
@@ -395,7 +389,9 @@ void inters::roe_flux(array<double> &u_l, array<double> &u_r, array<double> &v_g
   double lambda0,lambdaP,lambdaM;
   double rhoun_l, rhoun_r,eps;
   double a1,a2,a3,a4,a5,a6,aL1,bL1;
-  //array<double> um(n_dims);
+
+  // local rather than member scratch, so the flux can be called from several threads
+  array<double> v_l(n_dims), v_r(n_dims), um(n_dims), du(n_fields);
 
   // velocities
   for (int i=0;i<n_dims;i++)  {
@@ -520,6 +516,167 @@ void inters::roe_flux(array<double> &u_l, array<double> &u_r, array<double> &v_g
 }
 
 
+// Batched inviscid numerical fluxes
+//
+// The states, grid velocities and normals of up to INTERS_BATCH_SIZE flux points are stored field by field
+// (index: field*INTERS_BATCH_SIZE + point), so the loops over the points below have no indirection and no
+// branching on the number of dimensions or mesh motion, and can be vectorized by the compiler.
+
+template<int N_DIMS, int MOTION>
+static void rusanov_flux_batch_kernel(int n_pts, int n_fields, double* u_l, double* u_r, double* v_g, double* norm, double* fn, double gamma)
+{
+  const int s = INTERS_BATCH_SIZE;
+
+  for(int p=0;p<n_pts;p++)
+  {
+    double rho_l = u_l[p];
+    double rho_r = u_r[p];
+    double vn_l = 0., vn_r = 0., vn_g = 0., ke_l = 0., ke_r = 0.;
+
+    for(int d=0;d<N_DIMS;d++)
+    {
+      double vd_l = u_l[(d+1)*s+p]/rho_l;
+      double vd_r = u_r[(d+1)*s+p]/rho_r;
+      vn_l += vd_l*norm[d*s+p];
+      vn_r += vd_r*norm[d*s+p];
+      ke_l += vd_l*vd_l;
+      ke_r += vd_r*vd_r;
+      if(MOTION)
+        vn_g += v_g[d*s+p]*norm[d*s+p];
+    }
+
+    double e_l = u_l[(N_DIMS+1)*s+p];
+    double e_r = u_r[(N_DIMS+1)*s+p];
+    double p_l = (gamma-1.0)*(e_l-0.5*rho_l*ke_l);
+    double p_r = (gamma-1.0)*(e_r-0.5*rho_r*ke_r);
+
+    double vn_av_mag = sqrt(0.25*(vn_l+vn_r)*(vn_l+vn_r));
+    double c_av = sqrt((gamma*(p_l+p_r))/(rho_l+rho_r));
+    double eig = fabs(vn_av_mag - vn_g + c_av);
+
+    // normal flux (minus the grid velocity flux on moving meshes) on each side
+    fn[p] = 0.5*( (rho_l*(vn_l-vn_g) + rho_r*(vn_r-vn_g)) - eig*(rho_r-rho_l) );
+
+    for(int d=0;d<N_DIMS;d++)
+    {
+      double m_l = u_l[(d+1)*s+p];
+      double m_r = u_r[(d+1)*s+p];
+      fn[(d+1)*s+p] = 0.5*( (m_l*(vn_l-vn_g) + m_r*(vn_r-vn_g) + (p_l+p_r)*norm[d*s+p]) - eig*(m_r-m_l) );
+    }
+
+    fn[(N_DIMS+1)*s+p] = 0.5*( ((e_l+p_l)*vn_l - e_l*vn_g + (e_r+p_r)*vn_r - e_r*vn_g) - eig*(e_r-e_l) );
+
+    // passive scalars (e.g. SA working variable), not corrected for grid velocity as in calc_alef_2d/3d
+    for(int k=N_DIMS+2;k<n_fields;k++)
+      fn[k*s+p] = 0.5*( (u_l[k*s+p]*vn_l + u_r[k*s+p]*vn_r) - eig*(u_r[k*s+p]-u_l[k*s+p]) );
+  }
+}
+
+template<int MOTION>
+static void roe_flux_batch_kernel_2d(int n_pts, double* u_l, double* u_r, double* v_g, double* norm, double* fn, double gamma)
+{
+  const int s = INTERS_BATCH_SIZE;
+
+  for(int p=0;p<n_pts;p++)
+  {
+    double nx = norm[p];
+    double ny = norm[s+p];
+
+    double rho_l = u_l[p], rho_r = u_r[p];
+    double vx_l = u_l[s+p]/rho_l, vx_r = u_r[s+p]/rho_r;
+    double vy_l = u_l[2*s+p]/rho_l, vy_r = u_r[2*s+p]/rho_r;
+
+    double p_l = (gamma-1.0)*(u_l[3*s+p]-(0.5*rho_l*((vx_l*vx_l)+(vy_l*vy_l))));
+    double p_r = (gamma-1.0)*(u_r[3*s+p]-(0.5*rho_r*((vx_r*vx_r)+(vy_r*vy_r))));
+
+    double h_l = (u_l[3*s+p]+p_l)/rho_l;
+    double h_r = (u_r[3*s+p]+p_r)/rho_r;
+
+    double sq_rho = sqrt(rho_r/rho_l);
+    double rrho = 1./(sq_rho+1.);
+
+    double umx = rrho*(vx_l+sq_rho*vx_r);
+    double umy = rrho*(vy_l+sq_rho*vy_r);
+    double hm = rrho*(h_l+sq_rho*h_r);
+
+    double usq = 0.5*umx*umx + 0.5*umy*umy;
+    double am_sq = (gamma-1.)*(hm-usq);
+    double am = sqrt(am_sq);
+    double unm = umx*nx + umy*ny;
+    double vgn = MOTION ? v_g[p]*nx + v_g[s+p]*ny : 0.;
+
+    // Euler flux (first part)
+    double rhoun_l = u_l[s+p]*nx + u_l[2*s+p]*ny;
+    double rhoun_r = u_r[s+p]*nx + u_r[2*s+p]*ny;
+
+    double f0 = rhoun_l + rhoun_r;
+    double f1 = rhoun_l*vx_l + rhoun_r*vx_r + (p_l+p_r)*nx;
+    double f2 = rhoun_l*vy_l + rhoun_r*vy_r + (p_l+p_r)*ny;
+    double f3 = rhoun_l*h_l + rhoun_r*h_r;
+
+    double du0 = u_r[p]-u_l[p];
+    double du1 = u_r[s+p]-u_l[s+p];
+    double du2 = u_r[2*s+p]-u_l[2*s+p];
+    double du3 = u_r[3*s+p]-u_l[3*s+p];
+
+    double lambda0 = fabs(unm-vgn);
+    double lambdaP = fabs(unm-vgn+am);
+    double lambdaM = fabs(unm-vgn-am);
+
+    // Entropy fix
+    double eps = 0.5*(fabs(rhoun_l/rho_l-rhoun_r/rho_r) + fabs(sqrt(gamma*p_l/rho_l)-sqrt(gamma*p_r/rho_r)));
+    lambda0 = (lambda0 < 2.*eps) ? 0.25*lambda0*lambda0/eps + eps : lambda0;
+    lambdaP = (lambdaP < 2.*eps) ? 0.25*lambdaP*lambdaP/eps + eps : lambdaP;
+    lambdaM = (lambdaM < 2.*eps) ? 0.25*lambdaM*lambdaM/eps + eps : lambdaM;
+
+    double a2 = 0.5*(lambdaP+lambdaM)-lambda0;
+    double a3 = 0.5*(lambdaP-lambdaM)/am;
+    double a1 = a2*(gamma-1.)/am_sq;
+    double a4 = a3*(gamma-1.);
+    double a5 = usq*du0-umx*du1-umy*du2+du3;
+    double a6 = unm*du0-nx*du1-ny*du2;
+
+    double aL1 = a1*a5 - a3*a6;
+    double bL1 = a4*a5 - a2*a6;
+
+    // Euler flux (second part)
+    f0 -= lambda0*du0+aL1;
+    f1 -= lambda0*du1+aL1*umx+bL1*nx;
+    f2 -= lambda0*du2+aL1*umy+bL1*ny;
+    f3 -= lambda0*du3+aL1*hm +bL1*unm;
+
+    fn[p]     = 0.5*f0 - 0.5*vgn*(u_r[p]+u_l[p]);
+    fn[s+p]   = 0.5*f1 - 0.5*vgn*(u_r[s+p]+u_l[s+p]);
+    fn[2*s+p] = 0.5*f2 - 0.5*vgn*(u_r[2*s+p]+u_l[2*s+p]);
+    fn[3*s+p] = 0.5*f3 - 0.5*vgn*(u_r[3*s+p]+u_l[3*s+p]);
+  }
+}
+
+// Rusanov inviscid numerical flux for a batch of flux points
+void inters::rusanov_flux_batch(int n_pts, double* u_l, double* u_r, double* v_g, double* norm, double* fn, int n_dims, int n_fields, double gamma)
+{
+  if(n_dims==2) {
+      if(motion) rusanov_flux_batch_kernel<2,1>(n_pts,n_fields,u_l,u_r,v_g,norm,fn,gamma);
+      else       rusanov_flux_batch_kernel<2,0>(n_pts,n_fields,u_l,u_r,v_g,norm,fn,gamma);
+    }
+  else if(n_dims==3) {
+      if(motion) rusanov_flux_batch_kernel<3,1>(n_pts,n_fields,u_l,u_r,v_g,norm,fn,gamma);
+      else       rusanov_flux_batch_kernel<3,0>(n_pts,n_fields,u_l,u_r,v_g,norm,fn,gamma);
+    }
+  else
+    FatalError("ERROR: Invalid number of dimensions ... ");
+}
+
+// Roe inviscid numerical flux for a batch of flux points
+void inters::roe_flux_batch(int n_pts, double* u_l, double* u_r, double* v_g, double* norm, double* fn, int n_dims, int n_fields, double gamma)
+{
+  if(n_dims!=2 || n_fields!=4)
+    FatalError("Roe not implemented in 3D");
+
+  if(motion) roe_flux_batch_kernel_2d<1>(n_pts,u_l,u_r,v_g,norm,fn,gamma);
+  else       roe_flux_batch_kernel_2d<0>(n_pts,u_l,u_r,v_g,norm,fn,gamma);
+}
+
 // Rusanov inviscid numerical flux
 void inters::lax_friedrich(array<double> &u_l, array<double> &u_r, array<double> &norm, array<double> &fn, int n_dims, int n_fields, double lambda, array<double>& wave_speed)
 {
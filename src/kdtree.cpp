@@ -0,0 +1,201 @@
+/*!
+ * \file kdtree.cpp
+ * \brief _____________________________
+ * \author - Original code: SD++ developed by Patrice Castonguay, Antony Jameson,
+ *                          Peter Vincent, David Williams (alphabetical by surname).
+ *         - Current development: Aerospace Computing Laboratory (ACL)
+ *                                
+ * \version 0.1.0
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ * Copyright (C) 2014 Aerospace Computing Laboratory (ACL).
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "../include/kdtree.h"
+
+using namespace std;
+
+// orders point indices by one coordinate
+struct kdtree_compare {
+  const double* pts;
+  int n_dims;
+  int dim;
+
+  bool operator()(int a, int b) const
+  {
+    return pts[a*n_dims+dim] < pts[b*n_dims+dim];
+  }
+};
+
+// #### constructors ####
+
+// default constructor
+
+kdtree::kdtree()
+{
+  n_dims = 0;
+  n_pts = 0;
+}
+
+// default destructor
+
+kdtree::~kdtree() { }
+
+// #### methods ####
+
+// build the tree
+
+void kdtree::setup(array<double>& in_pts)
+{
+  n_dims = in_pts.get_dim(0);
+  n_pts = in_pts.get_dim(1);
+
+  pts.setup(n_dims,max(n_pts,1));
+  split_dim.setup(max(n_pts,1));
+
+  if (n_pts==0)
+    return;
+
+  vector<int> perm(n_pts);
+  for (int i=0;i<n_pts;i++)
+    perm[i] = i;
+
+  build(0,n_pts,in_pts,&perm[0]);
+
+  // store the points in tree order
+  for (int i=0;i<n_pts;i++)
+    for (int k=0;k<n_dims;k++)
+      pts(k,i) = in_pts(k,perm[i]);
+}
+
+// split an index range at the median of its widest coordinate
+
+void kdtree::build(int in_lo, int in_hi, array<double>& in_pts, int* perm)
+{
+  if (in_hi-in_lo<=KDTREE_LEAF_SIZE) {
+    for (int i=in_lo;i<in_hi;i++)
+      split_dim(i) = -1;
+    return;
+  }
+
+  int mid = (in_lo+in_hi)/2;
+  int dim = 0;
+  double width = -1.;
+
+  for (int k=0;k<n_dims;k++) {
+    double lo = in_pts(k,perm[in_lo]), hi = lo;
+    for (int i=in_lo+1;i<in_hi;i++) {
+      lo = min(lo,in_pts(k,perm[i]));
+      hi = max(hi,in_pts(k,perm[i]));
+    }
+    if (hi-lo>width) {
+      width = hi-lo;
+      dim = k;
+    }
+  }
+
+  kdtree_compare comp;
+  comp.pts = in_pts.get_ptr_cpu();
+  comp.n_dims = n_dims;
+  comp.dim = dim;
+  nth_element(perm+in_lo,perm+mid,perm+in_hi,comp);
+
+  split_dim(mid) = dim;
+  build(in_lo,mid,in_pts,perm);
+  build(mid+1,in_hi,in_pts,perm);
+}
+
+int kdtree::get_n_pts(void)
+{
+  return n_pts;
+}
+
+double* kdtree::get_pt(int in_pt)
+{
+  return pts.get_ptr_cpu(0,in_pt);
+}
+
+void kdtree::get_bounds(array<double>& out_min, array<double>& out_max)
+{
+  out_min.setup(n_dims);
+  out_max.setup(n_dims);
+
+  for (int k=0;k<n_dims;k++) {
+    out_min(k) = 1e20;
+    out_max(k) = -1e20;
+    for (int i=0;i<n_pts;i++) {
+      out_min(k) = min(out_min(k),pts(k,i));
+      out_max(k) = max(out_max(k),pts(k,i));
+    }
+  }
+}
+
+// nearest point within the given squared distance
+
+int kdtree::nearest(const double* in_pos, double& io_dist2)
+{
+  int pt = -1;
+
+  if (n_pts!=0)
+    search(0,n_pts,in_pos,pt,io_dist2);
+
+  return pt;
+}
+
+void kdtree::search(int in_lo, int in_hi, const double* in_pos, int& io_pt, double& io_dist2)
+{
+  if (in_hi-in_lo<=KDTREE_LEAF_SIZE) {
+    for (int i=in_lo;i<in_hi;i++) {
+      double dist2 = 0.;
+      for (int k=0;k<n_dims;k++)
+        dist2 += (in_pos[k]-pts(k,i))*(in_pos[k]-pts(k,i));
+
+      if (dist2<io_dist2) {
+        io_dist2 = dist2;
+        io_pt = i;
+      }
+    }
+    return;
+  }
+
+  int mid = (in_lo+in_hi)/2;
+  int dim = split_dim(mid);
+  double diff = in_pos[dim]-pts(dim,mid);
+
+  double dist2 = 0.;
+  for (int k=0;k<n_dims;k++)
+    dist2 += (in_pos[k]-pts(k,mid))*(in_pos[k]-pts(k,mid));
+
+  if (dist2<io_dist2) {
+    io_dist2 = dist2;
+    io_pt = mid;
+  }
+
+  // near side first, the far side only if the splitting plane is closer than the best point
+  if (diff<0.) {
+    search(in_lo,mid,in_pos,io_pt,io_dist2);
+    if (diff*diff<io_dist2)
+      search(mid+1,in_hi,in_pos,io_pt,io_dist2);
+  }
+  else {
+    search(mid+1,in_hi,in_pos,io_pt,io_dist2);
+    if (diff*diff<io_dist2)
+      search(in_lo,mid,in_pos,io_pt,io_dist2);
+  }
+}
@@ -0,0 +1,193 @@
+/*!
+ * \file mesh_cache.cpp
+ * \brief _____________________________
+ * \author - Original code: SD++ developed by Patrice Castonguay, Antony Jameson,
+ *                          Peter Vincent, David Williams (alphabetical by surname).
+ *         - Current development: Aerospace Computing Laboratory (ACL)
+ *                                
+ * \version 0.1.0
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ * Copyright (C) 2014 Aerospace Computing Laboratory (ACL).
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <sys/stat.h>
+
+#include "../include/mesh_cache.h"
+#include "../include/global.h"
+
+#ifdef _MPI
+#include "mpi.h"
+#endif
+
+using namespace std;
+
+#define MESH_CACHE_MAGIC "HFMSHCCH"
+#define MESH_CACHE_END "HFMSHEND"
+#define MESH_CACHE_VERSION 1
+
+// #### constructors ####
+
+// default constructor
+
+mesh_cache::mesh_cache()
+{
+  mode = 0;
+}
+
+// default destructor
+
+mesh_cache::~mesh_cache()
+{
+  close();
+}
+
+// #### methods ####
+
+// open the cache of this rank
+
+int mesh_cache::open(struct solution* FlowSol)
+{
+  struct stat mesh_stat;
+  char magic[8];
+  int valid = 1;
+  int nproc = 1;
+
+#ifdef _MPI
+  nproc = FlowSol->nproc;
+#endif
+
+  stringstream name;
+  name << run_input.mesh_file << ".np" << nproc << ".p";
+  name.width(4);
+  name.fill('0');
+  name << FlowSol->rank << ".cache";
+
+  // the cache is tied to the mesh file through its size and modification time
+  if (stat(run_input.mesh_file.c_str(),&mesh_stat) != 0)
+    FatalError("Could not stat the mesh file");
+
+  header.setup(10);
+  header(0) = MESH_CACHE_VERSION;
+  header(1) = nproc;
+  header(2) = FlowSol->rank;
+  header(3) = run_input.mesh_format;
+  header(4) = (double)mesh_stat.st_size;
+  header(5) = (double)mesh_stat.st_mtime;
+  header(6) = run_input.dx_cyclic;
+  header(7) = run_input.dy_cyclic;
+  header(8) = run_input.dz_cyclic;
+  header(9) = run_input.motion; // edges are only built for moving meshes
+
+  cache_file.open(name.str().c_str(),ios::in | ios::binary);
+  if (!cache_file.is_open())
+    valid = 0;
+
+  // a complete cache with a matching header
+  if (valid) {
+    array<double> cached(10);
+    cache_file.read(magic,8);
+    cache_file.read((char*)cached.get_ptr_cpu(),10*sizeof(double));
+    if (!cache_file || strncmp(magic,MESH_CACHE_MAGIC,8))
+      valid = 0;
+    for (int i=0;i<10 && valid;i++)
+      if (cached(i) != header(i))
+        valid = 0;
+
+    if (valid) {
+      streampos data_start = cache_file.tellg();
+      cache_file.seekg(-8,ios::end);
+      cache_file.read(magic,8);
+      if (!cache_file || strncmp(magic,MESH_CACHE_END,8))
+        valid = 0;
+      cache_file.seekg(data_start);
+    }
+  }
+
+#ifdef _MPI
+  // all ranks must read or all must rebuild, as the MPI face matching is collective
+  int valid_all;
+  MPI_Allreduce(&valid,&valid_all,1,MPI_INT,MPI_MIN,MPI_COMM_WORLD);
+  valid = valid_all;
+#endif
+
+  if (valid) {
+    mode = 1;
+    if (FlowSol->rank==0) cout << "Reading the preprocessed mesh cache" << endl;
+    return 1;
+  }
+
+  if (cache_file.is_open())
+    cache_file.close();
+  cache_file.clear();
+
+  cache_file.open(name.str().c_str(),ios::out | ios::trunc | ios::binary);
+  if (!cache_file.is_open()) {
+    cout << "Could not open the mesh cache " << name.str() << " for writing, continuing without it" << endl;
+    mode = 0;
+    return 0;
+  }
+
+  mode = 2;
+  cache_file.write(MESH_CACHE_MAGIC,8);
+  cache_file.write((char*)header.get_ptr_cpu(),10*sizeof(double));
+  if (FlowSol->rank==0) cout << "Writing the preprocessed mesh cache" << endl;
+
+  return 0;
+}
+
+// close the cache, marking a written cache as complete
+
+void mesh_cache::close(void)
+{
+  if (mode==2)
+    cache_file.write(MESH_CACHE_END,8);
+
+  if (mode==1 && !cache_file)
+    FatalError("The preprocessed mesh cache is truncated");
+
+  if (cache_file.is_open())
+    cache_file.close();
+
+  mode = 0;
+}
+
+// read or write a value
+
+void mesh_cache::io(int& inout_val)
+{
+  if (mode==2)
+    cache_file.write((char*)&inout_val,sizeof(int));
+  else if (mode==1)
+    cache_file.read((char*)&inout_val,sizeof(int));
+}
+
+// read or write an array of arrays
+
+void mesh_cache::io(array< array<int> >& inout_array)
+{
+  int n = inout_array.get_dim(0);
+
+  io(n);
+  if (mode==1)
+    inout_array.setup(n);
+
+  for (int i=0;i<n;i++)
+    io(inout_array(i));
+}
@@ -35,6 +35,7 @@
 #include "../include/output.h"
 #include "../include/flux.h"
 #include "../include/error.h"
+#include "../include/profiler.h"
 
 #ifdef _MPI
 #include "mpi.h"
@@ -50,7 +51,12 @@ using namespace std;
 
 // default constructor
 
-mpi_inters::mpi_inters() { }
+mpi_inters::mpi_inters()
+{
+  solution_in_flight = 0;
+  grad_in_flight = 0;
+  sgsf_in_flight = 0;
+}
 
 mpi_inters::~mpi_inters() { }
 
@@ -123,6 +129,7 @@ void mpi_inters::set_mpi_requests(int in_number_of_requests)
 #ifdef _MPI
   mpi_in_requests = (MPI_Request*) malloc(in_number_of_requests*sizeof(MPI_Request));
   mpi_out_requests = (MPI_Request*) malloc(in_number_of_requests*sizeof(MPI_Request));
+  mpi_completed = (int*) malloc(in_number_of_requests*sizeof(int));
 #endif
   if (viscous)
     {
@@ -184,6 +191,9 @@ void mpi_inters::set_mpi(int in_inter, int in_ele_type_l, int in_ele_l, int in_l
 
       get_lut(rot_tag);
 
+      // the element's flux point values are sent before the interior work
+      FlowSol->mesh_eles(in_ele_type_l)->set_halo_ele(in_ele_l);
+
       for(j=0;j<n_fpts_per_inter;j++)
         {
           for(i=0;i<n_fields;i++)
@@ -311,6 +321,7 @@ void mpi_inters::send_solution()
               request_count++;
             }
         }
+      solution_in_flight = 1;
 
     }
 }
@@ -319,11 +330,13 @@ void mpi_inters::receive_solution()
 {
 
   if (n_inters!=0) {
+      prof_timer timer(PROF_MPI_WAIT,inters_type);
       // Receive in_buffer
 #ifdef _MPI
       MPI_Waitall(Nmess,mpi_in_requests,MPI_STATUSES_IGNORE);
       MPI_Waitall(Nmess,mpi_out_requests,MPI_STATUSES_IGNORE);
 #endif
+      solution_in_flight = 0;
 #ifdef _GPU
       in_buffer_disu.cp_cpu_gpu();
 #endif
@@ -373,6 +386,7 @@ void mpi_inters::send_corrected_gradient()
               request_count++;
             }
         }
+      grad_in_flight = 1;
     }
 
 }
@@ -381,10 +395,12 @@ void mpi_inters::receive_corrected_gradient()
 {
   if (n_inters!=0)
     {
+      prof_timer timer(PROF_MPI_WAIT,inters_type);
 #ifdef _MPI
       MPI_Waitall(Nmess,mpi_in_requests_grad,MPI_STATUSES_IGNORE);
       MPI_Waitall(Nmess,mpi_out_requests_grad,MPI_STATUSES_IGNORE);
 #endif
+      grad_in_flight = 0;
 #ifdef _GPU
       in_buffer_grad_disu.cp_cpu_gpu();
 #endif
@@ -434,6 +450,7 @@ void mpi_inters::send_sgsf_fpts()
               request_count++;
             }
         }
+      sgsf_in_flight = 1;
     }
 
 }
@@ -442,10 +459,12 @@ void mpi_inters::receive_sgsf_fpts()
 {
   if (n_inters!=0)
     {
+      prof_timer timer(PROF_MPI_WAIT,inters_type);
 #ifdef _MPI
       MPI_Waitall(Nmess,mpi_in_requests_sgsf,MPI_STATUSES_IGNORE);
       MPI_Waitall(Nmess,mpi_out_requests_sgsf,MPI_STATUSES_IGNORE);
 #endif
+      sgsf_in_flight = 0;
 #ifdef _GPU
       in_buffer_sgsf.cp_cpu_gpu();
 #endif
@@ -453,14 +472,41 @@ void mpi_inters::receive_sgsf_fpts()
 
 }
 
+// test the messages in flight, so that MPI progresses them while the interior work is done
+
+void mpi_inters::progress()
+{
+#ifdef _MPI
+  int n_completed;
+
+  if (n_inters!=0) {
+    if (solution_in_flight)
+      MPI_Testsome(Nmess,mpi_in_requests,&n_completed,mpi_completed,MPI_STATUSES_IGNORE);
+
+    if (grad_in_flight)
+      MPI_Testsome(Nmess,mpi_in_requests_grad,&n_completed,mpi_completed,MPI_STATUSES_IGNORE);
+
+    if (sgsf_in_flight)
+      MPI_Testsome(Nmess,mpi_in_requests_sgsf,&n_completed,mpi_completed,MPI_STATUSES_IGNORE);
+  }
+#endif
+}
+
 // calculate normal transformed continuous inviscid flux at the flux points at mpi faces
 void mpi_inters::calculate_common_invFlux(void)
 {
+  prof_timer timer(PROF_MPI_INVFLUX,inters_type,32.*n_inters*n_fpts_per_inter*n_fields);
 
 #ifdef _CPU
+#pragma omp parallel
+  {
+  // thread-private scratch (shadows the shared members of the same name)
+  array<double> temp_u_l(n_fields), temp_u_r(n_fields), temp_v(n_dims);
+  array<double> temp_f_l(n_fields,n_dims), temp_f_r(n_fields,n_dims);
   array<double> norm(n_dims), fn(n_fields);
   array<double> u_c(n_fields);
 
+#pragma omp for schedule(static)
   for(int i=0;i<n_inters;i++)
     {
       for(int j=0;j<n_fpts_per_inter;j++)
@@ -569,6 +615,7 @@ void mpi_inters::calculate_common_invFlux(void)
 
         }
     }
+  } // end omp parallel
 #endif
 
 #ifdef _GPU
@@ -581,11 +628,20 @@ void mpi_inters::calculate_common_invFlux(void)
 
 void mpi_inters::calculate_common_viscFlux(void)
 {
+  prof_timer timer(PROF_MPI_VISCFLUX,inters_type,32.*n_inters*n_fpts_per_inter*n_fields*(1+n_dims));
 
 #ifdef _CPU
 
+#pragma omp parallel
+  {
+  // thread-private scratch (shadows the shared members of the same name)
+  array<double> temp_u_l(n_fields), temp_u_r(n_fields);
+  array<double> temp_grad_u_l(n_fields,n_dims), temp_grad_u_r(n_fields,n_dims);
+  array<double> temp_f_l(n_fields,n_dims), temp_f_r(n_fields,n_dims);
+  array<double> temp_sgsf_l(n_fields,n_dims), temp_sgsf_r(n_fields,n_dims);
   array<double> norm(n_dims), fn(n_fields);
 
+#pragma omp for schedule(static)
   for(int i=0;i<n_inters;i++)
     {
       for(int j=0;j<n_fpts_per_inter;j++)
@@ -678,6 +734,7 @@ void mpi_inters::calculate_common_viscFlux(void)
           }
         }
     }
+  } // end omp parallel
 
   //cout << "done viscous mpi" << endl;
 #endif
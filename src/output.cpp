@@ -26,6 +26,12 @@
 #include <iostream>
 #include <sstream>
 #include <cmath>
+#include <string>
+#include <vector>
+#include <deque>
+
+// Used for the background output thread
+#include <pthread.h>
 
 // Used for making sub-directories
 #include <sys/types.h>
@@ -41,11 +47,16 @@
 #include "../include/funcs.h"
 #include "../include/error.h"
 #include "../include/solution.h"
+#include "../include/profiler.h"
 
 #ifdef _TECIO
 #include "TECIO.h"
 #endif
 
+#ifdef _ZLIB
+#include "zlib.h"
+#endif
+
 #ifdef _MPI
 #include "mpi.h"
 #include "metis.h"
@@ -58,6 +69,36 @@
 
 using namespace std;
 
+/*! a plot or restart file waiting to be written by the background output thread */
+struct output_request {
+  int type;      /*!< OUTPUT_PLOT or OUTPUT_RESTART */
+  int file_num;  /*!< file number */
+  int slot;      /*!< solution snapshot to write */
+  double time;   /*!< solution time of the snapshot */
+};
+
+static pthread_t output_thread;
+static pthread_mutex_t output_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t output_cond = PTHREAD_COND_INITIALIZER;
+static deque<output_request> output_queue;
+static vector<int> output_free_slots;
+static bool output_stop = false;
+
+/*! true while the output routines run on the background thread, they then write the time of the snapshot */
+static bool output_from_snapshot = false;
+static double output_snapshot_time = 0.;
+
+#ifdef _MPI
+/*! communicator of the output routines, a duplicate of MPI_COMM_WORLD while they run on the background thread */
+static MPI_Comm output_comm = MPI_COMM_WORLD;
+#endif
+
+/*! solution time to write to the output files */
+static double output_time(struct solution* FlowSol)
+{
+  return output_from_snapshot ? output_snapshot_time : FlowSol->time;
+}
+
 #define MAX_V_PER_F 4
 #define MAX_F_PER_C 6
 #define MAX_E_PER_C 12
@@ -66,6 +107,7 @@ using namespace std;
 // method to write out a tecplot file
 void write_tec(int in_file_num, struct solution* FlowSol)
 {
+  double time_out = output_time(FlowSol);
   int i,j,k,l,m;
 
   int vertex_0, vertex_1, vertex_2, vertex_3, vertex_4, vertex_5, vertex_6, vertex_7;
@@ -104,7 +146,7 @@ void write_tec(int in_file_num, struct solution* FlowSol)
   n_average_fields = run_input.n_average_fields;
 
 #ifdef _MPI
-  MPI_Barrier(MPI_COMM_WORLD);
+  MPI_Barrier(output_comm);
   sprintf(file_name_s,"%s_%.09d_p%.04d.plt",run_input.data_file_name.c_str(),in_file_num,FlowSol->rank);
   if (FlowSol->rank==0) cout << "Writing Tecplot file number " << in_file_num << " ...." << endl;
 #else
@@ -229,7 +271,7 @@ void write_tec(int in_file_num, struct solution* FlowSol)
 
           if(time_iter == 0)
             {
-              write_tec <<"SolutionTime=" << FlowSol->time << endl;
+              write_tec <<"SolutionTime=" << time_out << endl;
               time_iter = 1;
             }
 
@@ -260,7 +302,7 @@ void write_tec(int in_file_num, struct solution* FlowSol)
               /*! Calculate the diagnostic fields at the plot points */
               if(n_diag_fields > 0)
                 {
-                  FlowSol->mesh_eles(i)->calc_diagnostic_fields_ppts(j, disu_ppts_temp, grad_disu_ppts_temp, sensor_ppts_temp, epsilon_ppts_temp, diag_ppts_temp, FlowSol->time);
+                  FlowSol->mesh_eles(i)->calc_diagnostic_fields_ppts(j, disu_ppts_temp, grad_disu_ppts_temp, sensor_ppts_temp, epsilon_ppts_temp, diag_ppts_temp);
                 }
 
               for(k=0;k<n_ppts_per_ele;k++)
@@ -560,7 +602,7 @@ void write_tec(int in_file_num, struct solution* FlowSol)
   write_tec.close();
 
 #ifdef _MPI
-  MPI_Barrier(MPI_COMM_WORLD);
+  MPI_Barrier(output_comm);
   if (FlowSol->rank==0) cout << "Done writing Tecplot file number " << in_file_num << " ...." << endl;
 #else
   cout << "Done writing Tecplot file number " << in_file_num << " ...." << endl;
@@ -568,6 +610,127 @@ void write_tec(int in_file_num, struct solution* FlowSol)
 
 }
 
+/*! true on little endian machines, binary .vtu data is written in native byte order */
+static bool is_little_endian(void)
+{
+  int one = 1;
+  return *((char*)&one)==1;
+}
+
+/*! base64 encoding of a block of bytes, appended to out */
+static void vtu_base64(const unsigned char* in, size_t n_bytes, string& out)
+{
+  static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t i;
+
+  out.reserve(out.size()+4*((n_bytes+2)/3));
+  for (i=0;i+2<n_bytes;i+=3) {
+    out += table[in[i]>>2];
+    out += table[((in[i]&0x03)<<4) | (in[i+1]>>4)];
+    out += table[((in[i+1]&0x0f)<<2) | (in[i+2]>>6)];
+    out += table[in[i+2]&0x3f];
+  }
+  if (i+1==n_bytes) {
+    out += table[in[i]>>2];
+    out += table[(in[i]&0x03)<<4];
+    out += "==";
+  }
+  else if (i+2==n_bytes) {
+    out += table[in[i]>>2];
+    out += table[((in[i]&0x03)<<4) | (in[i+1]>>4)];
+    out += table[(in[i+1]&0x0f)<<2];
+    out += '=';
+  }
+}
+
+/*! append a header or data part of a .vtu data block to out, base64 encoded if required (the two parts are encoded separately) */
+static void vtu_append_bytes(const void* in, size_t n_bytes, string& out)
+{
+  if (run_input.vtu_format==1)
+    vtu_base64((const unsigned char*)in,n_bytes,out);
+  else
+    out.append((const char*)in,n_bytes);
+}
+
+/*! encode one DataArray for the appended data section of a .vtu file: UInt64 size header and the data, or the zlib block header and compressed blocks */
+static void vtu_encode_block(const void* in, size_t n_bytes, string& out)
+{
+  out.clear();
+
+  if (!run_input.vtu_compress) {
+    unsigned long long header = n_bytes;
+    vtu_append_bytes(&header,sizeof(header),out);
+    vtu_append_bytes(in,n_bytes,out);
+  }
+  else {
+#ifdef _ZLIB
+    const size_t block_size = 65536;
+    size_t n_blocks = (n_bytes+block_size-1)/block_size;
+    vector<unsigned long long> header(3+n_blocks);
+    string data;
+
+    header[0] = n_blocks;
+    header[1] = block_size;
+    header[2] = n_bytes%block_size;
+
+    vector<Bytef> buffer(compressBound(block_size));
+    for (size_t i=0;i<n_blocks;i++) {
+      uLong len = (i==n_blocks-1 && header[2]!=0) ? header[2] : block_size;
+      uLongf c_len = buffer.size();
+      if (compress2(&buffer[0],&c_len,(const Bytef*)in+i*block_size,len,Z_BEST_SPEED)!=Z_OK)
+        FatalError("zlib compression of .vtu data failed");
+      header[3+i] = c_len;
+      data.append((const char*)&buffer[0],c_len);
+    }
+
+    vtu_append_bytes(&header[0],header.size()*sizeof(unsigned long long),out);
+    vtu_append_bytes(data.data(),data.size(),out);
+#else
+    FatalError("vtu_compress requires building with _ZLIB");
+#endif
+  }
+}
+
+/*! add a DataArray of strided point data to a binary .vtu file, vectors of in_n_comp components are written with 3 components padded with zeros */
+static void vtu_add_float_array(ostringstream& xml, vector<string>& blocks, size_t& offset, const char* in_name, int in_n_comp, int in_n_pts, const double* in_vals, int in_pt_stride, int in_comp_stride)
+{
+  int n_comp_out = (in_n_comp==1) ? 1 : 3;
+  size_t n_vals = (size_t)in_n_pts*n_comp_out;
+
+  xml << "				<DataArray type=\"" << (run_input.vtu_float64 ? "Float64" : "Float32") << "\"";
+  if (in_name!=NULL) xml << " Name=\"" << in_name << "\"";
+  if (n_comp_out!=1) xml << " NumberOfComponents=\"3\"";
+  xml << " format=\"appended\" offset=\"" << offset << "\" />" << endl;
+
+  blocks.push_back(string());
+  if (run_input.vtu_float64) {
+    vector<double> vals(n_vals,0.);
+    for (int i=0;i<in_n_pts;i++)
+      for (int j=0;j<in_n_comp;j++)
+        vals[(size_t)i*n_comp_out+j] = in_vals[(size_t)in_pt_stride*i+(size_t)in_comp_stride*j];
+    vtu_encode_block(&vals[0],n_vals*sizeof(double),blocks.back());
+  }
+  else {
+    vector<float> vals(n_vals,0.f);
+    for (int i=0;i<in_n_pts;i++)
+      for (int j=0;j<in_n_comp;j++)
+        vals[(size_t)i*n_comp_out+j] = (float)in_vals[(size_t)in_pt_stride*i+(size_t)in_comp_stride*j];
+    vtu_encode_block(&vals[0],n_vals*sizeof(float),blocks.back());
+  }
+  offset += blocks.back().size();
+}
+
+/*! add an integer DataArray to a binary .vtu file */
+template <typename T>
+static void vtu_add_int_array(ostringstream& xml, vector<string>& blocks, size_t& offset, const char* in_type, const char* in_name, vector<T>& in_vals)
+{
+  xml << "				<DataArray type=\"" << in_type << "\" Name=\"" << in_name << "\" format=\"appended\" offset=\"" << offset << "\" />" << endl;
+
+  blocks.push_back(string());
+  vtu_encode_block(in_vals.empty() ? NULL : &in_vals[0],in_vals.size()*sizeof(T),blocks.back());
+  offset += blocks.back().size();
+}
+
 /*! Method to write out a Paraview .vtu file.
 Used in run mode.
 input: in_file_num																						current timestep
@@ -649,6 +812,9 @@ void write_vtu(int in_file_num, struct solution* FlowSol)
   /*! no. of optional time-averaged diagnostic fields */
   n_average_fields = run_input.n_average_fields;
 
+  /*! Type of the point data in the .vtu files */
+  string float_type = (run_input.vtu_format!=0 && run_input.vtu_float64) ? "Float64" : "Float32";
+
 #ifdef _MPI
 
   /*! Get rank of each process */
@@ -692,37 +858,44 @@ void write_vtu(int in_file_num, struct solution* FlowSol)
 
       write_pvtu.open(pvtu);
       write_pvtu << "<?xml version=\"1.0\" ?>" << endl;
-      write_pvtu << "<VTKFile type=\"PUnstructuredGrid\" version=\"0.1\" byte_order=\"LittleEndian\" compressor=\"vtkZLibDataCompressor\">" << endl;
+      if (run_input.vtu_format==0)
+        write_pvtu << "<VTKFile type=\"PUnstructuredGrid\" version=\"0.1\" byte_order=\"LittleEndian\" compressor=\"vtkZLibDataCompressor\">" << endl;
+      else
+        write_pvtu << "<VTKFile type=\"PUnstructuredGrid\" version=\"1.0\" byte_order=\"" << (is_little_endian() ? "LittleEndian" : "BigEndian") << "\" header_type=\"UInt64\">" << endl;
       write_pvtu << "	<PUnstructuredGrid GhostLevel=\"1\">" << endl;
 
       /*! Write point data */
       write_pvtu << "		<PPointData Scalars=\"Density\" Vectors=\"Velocity\">" << endl;
-      write_pvtu << "			<PDataArray type=\"Float32\" Name=\"Density\" />" << endl;
-      write_pvtu << "			<PDataArray type=\"Float32\" Name=\"Velocity\" NumberOfComponents=\"3\" />" << endl;
-      write_pvtu << "			<PDataArray type=\"Float32\" Name=\"Energy\" />" << endl;
+      write_pvtu << "			<PDataArray type=\"" << float_type << "\" Name=\"Density\" />" << endl;
+      write_pvtu << "			<PDataArray type=\"" << float_type << "\" Name=\"Velocity\" NumberOfComponents=\"3\" />" << endl;
+      write_pvtu << "			<PDataArray type=\"" << float_type << "\" Name=\"Energy\" />" << endl;
 
       /*! write out modified turbulent viscosity */
       if (run_input.turb_model==1) {
-        write_pvtu << "			<PDataArray type=\"Float32\" Name=\"Mu_Tilde\" />" << endl;
+        write_pvtu << "			<PDataArray type=\"" << float_type << "\" Name=\"Nu_Tilde\" />" << endl;
+      }
+
+      if (run_input.motion) {
+        write_pvtu << "			<PDataArray type=\"" << float_type << "\" Name=\"GridVelocity\" NumberOfComponents=\"3\" />" << endl;
       }
 
       // Optional time-averaged diagnostic fields
       for(m=0;m<n_average_fields;m++)
         {
-          write_pvtu << "			<PDataArray type=\"Float32\" Name=\"" << run_input.average_fields(m) << "\" />" << endl;
+          write_pvtu << "			<PDataArray type=\"" << float_type << "\" Name=\"" << run_input.average_fields(m) << "\" />" << endl;
         }
 
       // Optional diagnostic fields
       for(m=0;m<n_diag_fields;m++)
         {
-          write_pvtu << "			<PDataArray type=\"Float32\" Name=\"" << run_input.diagnostic_fields(m) << "\" />" << endl;
+          write_pvtu << "			<PDataArray type=\"" << float_type << "\" Name=\"" << run_input.diagnostic_fields(m) << "\" />" << endl;
         }
 
       write_pvtu << "		</PPointData>" << endl;
 
       /*! Write points */
       write_pvtu << "		<PPoints>" << endl;
-      write_pvtu << "			<PDataArray type=\"Float32\" Name=\"Points\" NumberOfComponents=\"3\" />" << endl;
+      write_pvtu << "			<PDataArray type=\"" << float_type << "\" Name=\"Points\" NumberOfComponents=\"3\" />" << endl;
       write_pvtu << "		</PPoints>" << endl;
 
       /*! Write names of source .vtu files to include */
@@ -746,10 +919,19 @@ void write_vtu(int in_file_num, struct solution* FlowSol)
 #ifdef _MPI
 
   /*! Wait for all processes to get to this point, otherwise there won't be a directory to put .vtus into */
-  MPI_Barrier(MPI_COMM_WORLD);
+  MPI_Barrier(output_comm);
 
 #endif
 
+  /*! Binary .vtu files are written as one piece per element type */
+  if (run_input.vtu_format!=0) {
+    write_vtu_bin(vtu, FlowSol);
+#ifndef _MPI
+    cout << "done." << endl;
+#endif
+    return;
+  }
+
   /*! Each process writes its own .vtu file */
   write_vtu.open(vtu);
   /*! File header */
@@ -845,7 +1027,7 @@ void write_vtu(int in_file_num, struct solution* FlowSol)
                 }
 
                 /*! Calculate the diagnostic fields at the plot points */
-                FlowSol->mesh_eles(i)->calc_diagnostic_fields_ppts(j, disu_ppts_temp, grad_disu_ppts_temp, sensor_ppts_temp, epsilon_ppts_temp, diag_ppts_temp, FlowSol->time);
+                FlowSol->mesh_eles(i)->calc_diagnostic_fields_ppts(j, disu_ppts_temp, grad_disu_ppts_temp, sensor_ppts_temp, epsilon_ppts_temp, diag_ppts_temp);
               }
 
               /*! write out solution to file */
@@ -1054,8 +1236,160 @@ void write_vtu(int in_file_num, struct solution* FlowSol)
 #endif
 }
 
+/*! Method to write out the .vtu file of this rank with binary appended data.
+Each element type is written as one piece and its plot point data is computed with one operator application for all elements.
+input: in_vtu																									name of the .vtu file
+input: FlowSol																								solution structure
+*/
+
+void write_vtu_bin(char* in_vtu, struct solution* FlowSol)
+{
+  int i,j,k,l,m;
+  int n_fields, n_dims, n_eles, n_points, n_cells, n_verts;
+  int n_diag_fields = run_input.n_diagnostic_fields;
+  int n_average_fields = run_input.n_average_fields;
+
+  /*! VTK element types (different to HiFiLES element type) */
+  /*! tri, quad, tet, prism (undefined), hex */
+  int vtktypes[5] = {5,9,10,0,12};
+
+  /*! Plot point data of all elements of a type, indexing: (ppt,ele,...) */
+  array<double> disu_ppts, diag_ppts, disu_average_ppts, pos_ppts, vel_ppts;
+  /*! Plot point data of one element */
+  array<double> pos_ppts_temp;
+  array<double> grid_vel_ppts_temp;
+  array<int> con;
+
+  /*! XML part of the file and the encoded data arrays of the appended section */
+  ostringstream xml;
+  vector<string> blocks;
+  size_t offset = 0;
+
+  xml << "<?xml version=\"1.0\" ?>" << endl;
+  xml << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"" << (is_little_endian() ? "LittleEndian" : "BigEndian") << "\" header_type=\"UInt64\"";
+  if (run_input.vtu_compress) xml << " compressor=\"vtkZLibDataCompressor\"";
+  xml << ">" << endl;
+  xml << "	<UnstructuredGrid>" << endl;
+
+  for(i=0;i<FlowSol->n_ele_types;i++)
+    {
+      eles* mesh_eles = FlowSol->mesh_eles(i);
+
+      n_eles = mesh_eles->get_n_eles();
+      if (n_eles==0) continue;
+
+      n_points = mesh_eles->get_n_ppts_per_ele();
+      n_cells  = mesh_eles->get_n_peles_per_ele();
+      n_verts  = mesh_eles->get_n_verts_per_ele();
+      n_fields = mesh_eles->get_n_fields();
+      n_dims   = mesh_eles->get_n_dims();
+
+      int n_pts_all = n_eles*n_points;
+
+      if ((double)n_eles*n_cells*n_verts > 2147483647.)
+        FatalError("Too many plot points for Int32 connectivity in one .vtu piece");
+
+      /*! Solution and time-averaged fields at the plot points of all elements */
+      mesh_eles->calc_disu_ppts_all(disu_ppts);
+
+      if(n_average_fields > 0)
+        mesh_eles->calc_time_average_ppts_all(disu_average_ppts);
+
+      /*! Diagnostic fields at the plot points of all elements */
+      if(n_diag_fields > 0)
+        mesh_eles->calc_diagnostic_fields_ppts_all(disu_ppts,diag_ppts);
+
+      xml << "		<Piece NumberOfPoints=\"" << n_pts_all << "\" NumberOfCells=\"" << n_eles*n_cells << "\">" << endl;
+      xml << "			<PointData>" << endl;
+
+      /*! density */
+      vtu_add_float_array(xml,blocks,offset,"Density",1,n_pts_all,disu_ppts.get_ptr_cpu(),1,n_pts_all);
+
+      /*! velocity, energy and modified turbulent viscosity are divided by density */
+      vel_ppts.setup(n_points,n_eles,n_fields-1);
+      for(m=1;m<n_fields;m++)
+        for(j=0;j<n_eles;j++)
+          for(k=0;k<n_points;k++)
+            vel_ppts(k,j,m-1) = disu_ppts(k,j,m)/disu_ppts(k,j,0);
+
+      vtu_add_float_array(xml,blocks,offset,"Velocity",n_dims,n_pts_all,vel_ppts.get_ptr_cpu(),1,n_pts_all);
+      vtu_add_float_array(xml,blocks,offset,"Energy",1,n_pts_all,vel_ppts.get_ptr_cpu(0,0,n_dims),1,n_pts_all);
+
+      if (run_input.turb_model == 1)
+        vtu_add_float_array(xml,blocks,offset,"Nu_Tilde",1,n_pts_all,vel_ppts.get_ptr_cpu(0,0,n_dims+1),1,n_pts_all);
+
+      /*! grid velocity, indexing: (dim,ppt,ele) */
+      if (run_input.motion) {
+        mesh_eles->set_grid_vel_ppts();
+        grid_vel_ppts_temp = mesh_eles->get_grid_vel_ppts();
+        vtu_add_float_array(xml,blocks,offset,"GridVelocity",n_dims,n_pts_all,grid_vel_ppts_temp.get_ptr_cpu(),n_dims,1);
+      }
+
+      for(m=0;m<n_average_fields;m++)
+        vtu_add_float_array(xml,blocks,offset,run_input.average_fields(m).c_str(),1,n_pts_all,disu_average_ppts.get_ptr_cpu(0,0,m),1,n_pts_all);
+
+      for(m=0;m<n_diag_fields;m++)
+        vtu_add_float_array(xml,blocks,offset,run_input.diagnostic_fields(m).c_str(),1,n_pts_all,diag_ppts.get_ptr_cpu(0,0,m),1,n_pts_all);
+
+      xml << "			</PointData>" << endl;
+
+      /*! plot point coordinates */
+      pos_ppts.setup(n_points,n_eles,n_dims);
+      pos_ppts_temp.setup(n_points,n_dims);
+      for(j=0;j<n_eles;j++) {
+        mesh_eles->calc_pos_ppts(j,pos_ppts_temp);
+        for(l=0;l<n_dims;l++)
+          for(k=0;k<n_points;k++)
+            pos_ppts(k,j,l) = pos_ppts_temp(k,l);
+      }
+
+      xml << "			<Points>" << endl;
+      vtu_add_float_array(xml,blocks,offset,NULL,n_dims,n_pts_all,pos_ppts.get_ptr_cpu(),1,n_pts_all);
+      xml << "			</Points>" << endl;
+
+      /*! connectivity of the plot sub-elements, the plot points of element j are numbered from j*n_points */
+      con = mesh_eles->get_connectivity_plot();
+
+      vector<int> connectivity((size_t)n_eles*n_cells*n_verts), offsets((size_t)n_eles*n_cells);
+      vector<unsigned char> types((size_t)n_eles*n_cells,(unsigned char)vtktypes[i]);
+
+      for(j=0;j<n_eles;j++)
+        for(k=0;k<n_cells;k++) {
+          for(l=0;l<n_verts;l++)
+            connectivity[((size_t)j*n_cells+k)*n_verts+l] = con(l,k)+j*n_points;
+          offsets[(size_t)j*n_cells+k] = (j*n_cells+k+1)*n_verts;
+        }
+
+      xml << "			<Cells>" << endl;
+      vtu_add_int_array(xml,blocks,offset,"Int32","connectivity",connectivity);
+      vtu_add_int_array(xml,blocks,offset,"Int32","offsets",offsets);
+      vtu_add_int_array(xml,blocks,offset,"UInt8","types",types);
+      xml << "			</Cells>" << endl;
+      xml << "		</Piece>" << endl;
+    }
+
+  xml << "	</UnstructuredGrid>" << endl;
+  xml << "	<AppendedData encoding=\"" << (run_input.vtu_format==1 ? "base64" : "raw") << "\">" << endl;
+
+  ofstream write_vtu(in_vtu, ios::out | ios::binary);
+  if (!write_vtu)
+    FatalError("Could not open .vtu file for writing");
+
+  string xml_s = xml.str();
+  write_vtu.write(xml_s.data(),xml_s.size());
+  write_vtu << "_";
+  for(unsigned int b=0;b<blocks.size();b++)
+    write_vtu.write(blocks[b].data(),blocks[b].size());
+  write_vtu << endl;
+  write_vtu << "	</AppendedData>" << endl;
+  write_vtu << "</VTKFile>" << endl;
+
+  write_vtu.close();
+}
+
 void write_restart(int in_file_num, struct solution* FlowSol)
 {
+  double time_out = output_time(FlowSol);
 
   char file_name_s[256], file_name_s2[256];
   char *file_name;
@@ -1075,23 +1409,30 @@ void write_restart(int in_file_num, struct solution* FlowSol)
 #endif
 
 
-  file_name = &file_name_s[0];
-  restart_file.open(file_name);
+  if (run_input.restart_bin) {
+    write_restart_bin(in_file_num, FlowSol);
+  }
+  else {
+    file_name = &file_name_s[0];
+    restart_file.open(file_name);
 
-  restart_file << FlowSol->time << endl;
+    restart_file << time_out << endl;
+  }
 
   if (run_input.restart_mesh_out) {
     file_name = &file_name_s2[0];
     restart_mesh.open(file_name);
-    restart_mesh << FlowSol->time << endl;
+    restart_mesh << time_out << endl;
   }
 
   //header
   for (int i=0;i<FlowSol->n_ele_types;i++) {
       if (FlowSol->mesh_eles(i)->get_n_eles()!=0) {
 
-          FlowSol->mesh_eles(i)->write_restart_info(restart_file);
-          FlowSol->mesh_eles(i)->write_restart_data(restart_file);
+          if (!run_input.restart_bin) {
+            FlowSol->mesh_eles(i)->write_restart_info(restart_file);
+            FlowSol->mesh_eles(i)->write_restart_data(restart_file);
+          }
 
           // Output handy file of point locations for easy post-processing
           if (run_input.restart_mesh_out) {
@@ -1102,8 +1443,233 @@ void write_restart(int in_file_num, struct solution* FlowSol)
         }
     }
 
+  if (!run_input.restart_bin)
+    restart_file.close();
+
+  if (run_input.restart_mesh_out)
+    restart_mesh.close();
+}
+
+void write_restart_bin(int in_file_num, struct solution* FlowSol)
+{
+  double time_out = output_time(FlowSol);
+  char file_name_s[256];
+  ofstream restart_file;
+  int n_types = 0;
+
+  // One file per rank: header with the restart info and global element numbers of each element type, then the data
+
+  sprintf(file_name_s,"Rest_%.09d_p%.04d.bin",in_file_num,FlowSol->rank);
+  restart_file.open(file_name_s, ios::out | ios::binary);
+  if (!restart_file)
+    FatalError("Could not open binary restart file");
+
+  for (int i=0;i<FlowSol->n_ele_types;i++)
+    if (FlowSol->mesh_eles(i)->get_n_eles()!=0)
+      n_types++;
+
+  restart_file.write(RESTART_BIN_MAGIC,8);
+  restart_file.write((char*)&time_out,sizeof(double));
+  restart_file.write((char*)&n_types,sizeof(int));
+
+  for (int i=0;i<FlowSol->n_ele_types;i++)
+    if (FlowSol->mesh_eles(i)->get_n_eles()!=0)
+      FlowSol->mesh_eles(i)->write_restart_header_bin(restart_file);
+
+  for (int i=0;i<FlowSol->n_ele_types;i++)
+    if (FlowSol->mesh_eles(i)->get_n_eles()!=0)
+      FlowSol->mesh_eles(i)->write_restart_data_bin(restart_file);
+
   restart_file.close();
 
+  // Index of all elements by global element number: (file, position in the data of that file)
+
+  int n_local = 0, n_files = 1, n_global = 0;
+  for (int i=0;i<FlowSol->n_ele_types;i++)
+    n_local += FlowSol->mesh_eles(i)->get_n_eles();
+
+  array<int> local_gid(max(n_local,1)), local_pos(max(n_local,1));
+  int count = 0;
+  for (int i=0;i<FlowSol->n_ele_types;i++) {
+    for (int j=0;j<FlowSol->mesh_eles(i)->get_n_eles();j++) {
+      local_gid(count) = FlowSol->mesh_eles(i)->get_ele2global_ele(j);
+      local_pos(count) = count;
+      count++;
+    }
+  }
+
+#ifdef _MPI
+  n_files = FlowSol->nproc;
+  array<int> counts(n_files), displs(n_files);
+  MPI_Gather(&n_local,1,MPI_INT,counts.get_ptr_cpu(),1,MPI_INT,0,output_comm);
+
+  int n_total = 0;
+  if (FlowSol->rank==0) {
+    for (int i=0;i<n_files;i++) {
+      displs(i) = n_total;
+      n_total += counts(i);
+    }
+  }
+
+  array<int> all_gid(max(n_total,1)), all_pos(max(n_total,1));
+  MPI_Gatherv(local_gid.get_ptr_cpu(),n_local,MPI_INT,all_gid.get_ptr_cpu(),counts.get_ptr_cpu(),displs.get_ptr_cpu(),MPI_INT,0,output_comm);
+  MPI_Gatherv(local_pos.get_ptr_cpu(),n_local,MPI_INT,all_pos.get_ptr_cpu(),counts.get_ptr_cpu(),displs.get_ptr_cpu(),MPI_INT,0,output_comm);
+#else
+  int n_total = n_local;
+  array<int> counts(1), displs(1);
+  counts(0) = n_local;
+  displs(0) = 0;
+  array<int>& all_gid = local_gid;
+  array<int>& all_pos = local_pos;
+#endif
+
+  if (FlowSol->rank==0) {
+    for (int i=0;i<n_total;i++)
+      n_global = max(n_global,all_gid(i)+1);
+
+    // indexing: (0: file / 1: position, global element)
+    array<int> index(2,max(n_global,1));
+    for (int i=0;i<n_global;i++) {
+      index(0,i) = -1;
+      index(1,i) = -1;
+    }
+
+    for (int i=0;i<n_files;i++) {
+      for (int j=displs(i);j<displs(i)+counts(i);j++) {
+        index(0,all_gid(j)) = i;
+        index(1,all_gid(j)) = all_pos(j);
+      }
+    }
+
+    sprintf(file_name_s,"Rest_%.09d.idx",in_file_num);
+    restart_file.open(file_name_s, ios::out | ios::binary);
+    if (!restart_file)
+      FatalError("Could not open binary restart index file");
+
+    restart_file.write(RESTART_IDX_MAGIC,8);
+    restart_file.write((char*)&n_files,sizeof(int));
+    restart_file.write((char*)&n_global,sizeof(int));
+    restart_file.write((char*)index.get_ptr_cpu(),2*n_global*sizeof(int));
+    restart_file.close();
+  }
+}
+
+void write_plot(int in_file_num, struct solution* FlowSol)
+{
+  if (FlowSol->write_type == 0) write_vtu(in_file_num, FlowSol);
+  else if (FlowSol->write_type == 1) write_tec(in_file_num, FlowSol);
+  else FatalError("ERROR: Trying to write unrecognized file format ... ");
+}
+
+/*! Background output thread: writes the queued files in order from their solution snapshots */
+static void* output_thread_main(void* in_FlowSol)
+{
+  struct solution* FlowSol = (struct solution*)in_FlowSol;
+  output_request req;
+
+  pthread_mutex_lock(&output_mutex);
+  while (true) {
+    while (output_queue.empty() && !output_stop)
+      pthread_cond_wait(&output_cond,&output_mutex);
+
+    if (output_queue.empty())
+      break;
+
+    req = output_queue.front();
+    output_queue.pop_front();
+    pthread_mutex_unlock(&output_mutex);
+
+    for (int i=0;i<FlowSol->n_ele_types;i++)
+      FlowSol->mesh_eles(i)->set_output_slot(req.slot);
+    output_snapshot_time = req.time;
+
+    if (req.type == OUTPUT_PLOT)
+      write_plot(req.file_num, FlowSol);
+    else
+      write_restart(req.file_num, FlowSol);
+
+    // hand the snapshot back to the solver
+    pthread_mutex_lock(&output_mutex);
+    output_free_slots.push_back(req.slot);
+    pthread_cond_broadcast(&output_cond);
+  }
+  pthread_mutex_unlock(&output_mutex);
+
+  return NULL;
+}
+
+void output_async_start(struct solution* FlowSol)
+{
+#ifdef _MPI
+  // the output routines call MPI from their own thread, on their own communicator
+  int provided;
+  MPI_Query_thread(&provided);
+  if (provided < MPI_THREAD_MULTIPLE)
+    FatalError("output_async requires an MPI library providing MPI_THREAD_MULTIPLE");
+  MPI_Comm_dup(MPI_COMM_WORLD,&output_comm);
+#endif
+
+  for (int i=0;i<FlowSol->n_ele_types;i++)
+    FlowSol->mesh_eles(i)->setup_output_slots(run_input.output_queue_size);
+
+  output_free_slots.clear();
+  for (int i=run_input.output_queue_size-1;i>=0;i--)
+    output_free_slots.push_back(i);
+
+  output_queue.clear();
+  output_stop = false;
+  output_from_snapshot = true;
+
+  if (pthread_create(&output_thread,NULL,output_thread_main,(void*)FlowSol)!=0)
+    FatalError("Could not start the output thread");
+}
+
+void output_async_submit(int in_type, int in_file_num, struct solution* FlowSol)
+{
+  output_request req;
+
+  // back-pressure: wait until the output thread has released a snapshot
+  pthread_mutex_lock(&output_mutex);
+  while (output_free_slots.empty())
+    pthread_cond_wait(&output_cond,&output_mutex);
+
+  req.slot = output_free_slots.back();
+  output_free_slots.pop_back();
+  pthread_mutex_unlock(&output_mutex);
+
+  // the free snapshot is not touched by the output thread, copy the solution into it without holding the lock
+  for (int i=0;i<FlowSol->n_ele_types;i++)
+    FlowSol->mesh_eles(i)->stage_output(req.slot);
+
+  req.type = in_type;
+  req.file_num = in_file_num;
+  req.time = FlowSol->time;
+
+  pthread_mutex_lock(&output_mutex);
+  output_queue.push_back(req);
+  pthread_cond_broadcast(&output_cond);
+  pthread_mutex_unlock(&output_mutex);
+}
+
+void output_async_finish(struct solution* FlowSol)
+{
+  pthread_mutex_lock(&output_mutex);
+  output_stop = true;
+  pthread_cond_broadcast(&output_cond);
+  pthread_mutex_unlock(&output_mutex);
+
+  pthread_join(output_thread,NULL);
+
+  output_from_snapshot = false;
+  for (int i=0;i<FlowSol->n_ele_types;i++) {
+    FlowSol->mesh_eles(i)->set_output_slot(-1);
+    FlowSol->mesh_eles(i)->setup_output_slots(0);
+  }
+
+#ifdef _MPI
+  MPI_Comm_free(&output_comm);
+  output_comm = MPI_COMM_WORLD;
+#endif
 }
 
 void CalcForces(int in_file_num, struct solution* FlowSol) {
@@ -1242,16 +1808,15 @@ void CalcIntegralQuantities(int in_file_num, struct solution* FlowSol) {
 
   int nintq = run_input.n_integral_quantities;
 
+  // initialize to zero, then sum over the element types
+  for(int j=0;j<nintq;++j)
+    FlowSol->integral_quantities(j) = 0.0;
+
   // Loop over element types
   for(int i=0;i<FlowSol->n_ele_types;i++)
     {
       if (FlowSol->mesh_eles(i)->get_n_eles()!=0)
         {
-          // initialize to zero
-          for(int j=0;j<nintq;++j)
-            {
-              FlowSol->integral_quantities(j) = 0.0;
-            }
           FlowSol->mesh_eles(i)->CalcIntegralQuantities(nintq, FlowSol->integral_quantities);
         }
     }
@@ -1522,10 +2087,10 @@ void CalcNormResidual(struct solution* FlowSol) {
   }
 }
 
-void HistoryOutput(int in_file_num, clock_t init, ofstream *write_hist, struct solution* FlowSol) {
+void HistoryOutput(int in_file_num, double init, ofstream *write_hist, struct solution* FlowSol) {
   
   int i, n_fields;
-  clock_t final;
+  double final;
   // TODO: write heads when starting from a restart file
   bool open_hist, write_heads;
   int n_diags = run_input.n_integral_quantities;
@@ -1538,14 +2103,17 @@ void HistoryOutput(int in_file_num, clock_t init, ofstream *write_hist, struct s
     n_fields++;
   }
   
-  // set write flag
+  // throughput since the last output, reduced over all ranks
+  double dof_rate = prof_dof_rate();
+  
+  // set write flag, every 20*monitor_res_freq files (the product overflows for a never monitored residual)
   if (run_input.restart_flag==0) {
     open_hist = (in_file_num == 1);
-    write_heads = (((in_file_num % (run_input.monitor_res_freq*20)) == 0) || (in_file_num == 1));
+    write_heads = ((in_file_num % 20 == 0 && (in_file_num/20) % run_input.monitor_res_freq == 0) || (in_file_num == 1));
   }
   else {
     open_hist = (in_file_num == run_input.restart_iter+1);
-    write_heads = (((in_file_num % (run_input.monitor_res_freq*20)) == 0) || (in_file_num == run_input.restart_iter+1));
+    write_heads = ((in_file_num % 20 == 0 && (in_file_num/20) % run_input.monitor_res_freq == 0) || (in_file_num == run_input.restart_iter+1));
   }
 
   if (FlowSol->rank == 0) {
@@ -1568,7 +2136,10 @@ void HistoryOutput(int in_file_num, clock_t init, ofstream *write_hist, struct s
         write_hist[0] << ",\"Diagnostics[" << i << "]\"";
 
       // Add physical and computational time
-      write_hist[0] << ",\"Time<sub>Physical</sub>\",\"Time<sub>Comp</sub>(m)\"" << endl;
+      write_hist[0] << ",\"Time<sub>Physical</sub>\",\"Time<sub>Comp</sub>(m)\"";
+
+      // Add throughput
+      write_hist[0] << ",\"DOF updates/s\"" << endl;
       
       write_hist[0] << "ZONE T= \"Convergence history\"" << endl;
     }
@@ -1576,12 +2147,12 @@ void HistoryOutput(int in_file_num, clock_t init, ofstream *write_hist, struct s
     // Write the header
     if (write_heads) {
       if (FlowSol->n_dims==2) {
-        if (n_fields == 4) cout << "\n  Iter       Res[Rho]   Res[RhoVelx]   Res[RhoVely]      Res[RhoE]       Fx_Total       Fy_Total" << endl;
-        else cout << "\n  Iter       Res[Rho]   Res[RhoVelx]   Res[RhoVely]      Res[RhoE]   Res[MuTilde]       Fx_Total       Fy_Total" << endl;
+        if (n_fields == 4) cout << "\n  Iter       Res[Rho]   Res[RhoVelx]   Res[RhoVely]      Res[RhoE]       Fx_Total       Fy_Total          DOF/s" << endl;
+        else cout << "\n  Iter       Res[Rho]   Res[RhoVelx]   Res[RhoVely]      Res[RhoE]   Res[MuTilde]       Fx_Total       Fy_Total          DOF/s" << endl;
       }
       else {
-        if (n_fields == 5) cout <<  "\n  Iter       Res[Rho]   Res[RhoVelx]   Res[RhoVely]   Res[RhoVelz]      Res[RhoE]       Fx_Total       Fy_Total       Fz_Total" << endl;
-        else cout <<  "\n  Iter       Res[Rho]   Res[RhoVelx]   Res[RhoVely]   Res[RhoVelz]      Res[RhoE]   Res[MuTilde]       Fx_Total       Fy_Total       Fz_Total" << endl;
+        if (n_fields == 5) cout <<  "\n  Iter       Res[Rho]   Res[RhoVelx]   Res[RhoVely]   Res[RhoVelz]      Res[RhoE]       Fx_Total       Fy_Total       Fz_Total          DOF/s" << endl;
+        else cout <<  "\n  Iter       Res[Rho]   Res[RhoVelx]   Res[RhoVely]   Res[RhoVelz]      Res[RhoE]   Res[MuTilde]       Fx_Total       Fy_Total       Fz_Total          DOF/s" << endl;
       }
     }
     
@@ -1601,6 +2172,9 @@ void HistoryOutput(int in_file_num, clock_t init, ofstream *write_hist, struct s
       write_hist[0] << ", " << FlowSol->inv_force(i) + FlowSol->vis_force(i);
     }
     
+    // Output throughput
+    cout.width(15); cout << (long)dof_rate;
+    
     // Output lift and drag coeffs
     write_hist[0] << ", " << FlowSol->coeff_lift  << ", " << FlowSol->coeff_drag;
     
@@ -1612,8 +2186,11 @@ void HistoryOutput(int in_file_num, clock_t init, ofstream *write_hist, struct s
     write_hist[0] << ", " << in_time;
     
     // Compute execution time
-    final = clock()-init;
-    write_hist[0] << ", " << (double) final/(((double) CLOCKS_PER_SEC) * 60.0) << endl;
+    final = prof_wall_time()-init;
+    write_hist[0] << ", " << final/60.0;
+
+    // Output throughput
+    write_hist[0] << ", " << dof_rate << endl;
   }
 }
 
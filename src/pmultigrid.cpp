@@ -0,0 +1,338 @@
+/*!
+ * \file pmultigrid.cpp
+ * \brief _____________________________
+ * \author - Original code: SD++ developed by Patrice Castonguay, Antony Jameson,
+ *                          Peter Vincent, David Williams (alphabetical by surname).
+ *         - Current development: Aerospace Computing Laboratory (ACL)
+ *                                
+ * \version 0.1.0
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ * Copyright (C) 2014 Aerospace Computing Laboratory (ACL).
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cmath>
+
+#if defined _ACCELERATE_BLAS
+#include <Accelerate/Accelerate.h>
+#endif
+
+#if defined _MKL_BLAS
+#include "mkl.h"
+#endif
+
+#if defined _STANDARD_BLAS
+extern "C"
+{
+#include "cblas.h"
+}
+#endif
+
+#include "../include/global.h"
+#include "../include/pmultigrid.h"
+#include "../include/geometry.h"
+#include "../include/solver.h"
+#include "../include/error.h"
+
+using namespace std;
+
+p_multigrid::p_multigrid()
+{
+  n_levels = 1;
+}
+
+p_multigrid::~p_multigrid()
+{
+  for (int l=1;l<level_mesh.get_dim(0);l++) {
+      delete level_mesh(l);
+      delete level_sol(l);
+    }
+}
+
+void p_multigrid::setup(struct solution* FlowSol)
+{
+#ifdef _GPU
+  FatalError("p-multigrid is only implemented on the CPU");
+#endif
+
+  if (FlowSol->adv_type != 0 && FlowSol->adv_type != 3)
+    FatalError("p-multigrid needs an explicit RK scheme (adv_type 0 or 3) as smoother");
+
+  if (run_input.motion)
+    FatalError("p-multigrid is not implemented for moving meshes");
+
+  int fine_order = run_input.order;
+  n_levels = fine_order - max(run_input.pmg_min_order,0) + 1;
+
+  if (n_levels < 2)
+    FatalError("p-multigrid needs order > pmg_min_order");
+
+  level_sol.setup(n_levels);
+  level_mesh.setup(n_levels);
+  level_sol(0) = FlowSol;
+  level_mesh(0) = NULL;
+
+  // The coarse levels run the preprocessing again at their order; the
+  // transfer operators need element i to be the same cell on every level,
+  // so the partition and element numbering of each level are compared with
+  // the fine one (without mesh_cache every level reads and partitions the
+  // mesh again)
+  for (int l=1;l<n_levels;l++) {
+      if (FlowSol->rank==0) cout << "Setting up p-multigrid level " << l << " (order " << fine_order-l << ")" << endl;
+
+      run_input.order = fine_order-l;
+      level_sol(l) = new solution;
+      level_mesh(l) = new mesh;
+      SetInput(level_sol(l));
+      GeoPreprocess(level_sol(l),*level_mesh(l));
+
+      int mismatch = 0;
+      for (int t=0;t<FlowSol->n_ele_types;t++) {
+          eles* fine = FlowSol->mesh_eles(t);
+          eles* coarse = level_sol(l)->mesh_eles(t);
+
+          if (coarse->get_n_eles() != fine->get_n_eles()) {
+              mismatch = 1;
+              continue;
+            }
+          for (int i=0;i<fine->get_n_eles();i++)
+            if (coarse->get_ele2global_ele(i) != fine->get_ele2global_ele(i))
+              mismatch = 1;
+        }
+
+#ifdef _MPI
+      int mismatch_all;
+      MPI_Allreduce(&mismatch,&mismatch_all,1,MPI_INT,MPI_MAX,MPI_COMM_WORLD);
+      mismatch = mismatch_all;
+#endif
+
+      if (mismatch)
+        FatalError("p-multigrid levels are partitioned or numbered differently, use mesh_cache");
+
+      for (int t=0;t<FlowSol->n_ele_types;t++)
+        if (level_sol(l)->mesh_eles(t)->get_n_eles()!=0)
+          level_sol(l)->mesh_eles(t)->set_disu_upts_to_zero_other_levels();
+    }
+  run_input.order = fine_order;
+
+  // Transfer operators: the polynomial of one level evaluated at the
+  // solution points of the other
+  array<double> loc(FlowSol->n_dims);
+
+  restrict_op.setup(n_levels-1,FlowSol->n_ele_types);
+  prolong_op.setup(n_levels-1,FlowSol->n_ele_types);
+
+  for (int l=0;l<n_levels-1;l++) {
+      for (int t=0;t<FlowSol->n_ele_types;t++) {
+          eles* fine = level_sol(l)->mesh_eles(t);
+          eles* coarse = level_sol(l+1)->mesh_eles(t);
+
+          if (fine->get_n_eles()==0)
+            continue;
+
+          int n_upts_f = fine->get_n_upts_per_ele();
+          int n_upts_c = coarse->get_n_upts_per_ele();
+
+          restrict_op(l,t).setup(n_upts_c,n_upts_f);
+          for (int i=0;i<n_upts_c;i++) {
+              for (int m=0;m<FlowSol->n_dims;m++)
+                loc(m) = coarse->get_loc_upt(i,m);
+              for (int j=0;j<n_upts_f;j++)
+                restrict_op(l,t)(i,j) = fine->eval_nodal_basis(j,loc);
+            }
+
+          prolong_op(l,t).setup(n_upts_f,n_upts_c);
+          for (int i=0;i<n_upts_f;i++) {
+              for (int m=0;m<FlowSol->n_dims;m++)
+                loc(m) = fine->get_loc_upt(i,m);
+              for (int j=0;j<n_upts_c;j++)
+                prolong_op(l,t)(i,j) = coarse->eval_nodal_basis(j,loc);
+            }
+        }
+    }
+
+  u0.setup(n_levels,FlowSol->n_ele_types);
+  forcing.setup(n_levels,FlowSol->n_ele_types);
+  work.setup(n_levels,FlowSol->n_ele_types);
+
+  for (int l=0;l<n_levels;l++) {
+      for (int t=0;t<FlowSol->n_ele_types;t++) {
+          eles* ele_type = level_sol(l)->mesh_eles(t);
+
+          if (ele_type->get_n_eles()==0)
+            continue;
+
+          work(l,t).setup(ele_type->get_n_upts_per_ele(),ele_type->get_n_eles(),ele_type->get_n_fields());
+          if (l>0) {
+              u0(l,t).setup(ele_type->get_n_upts_per_ele(),ele_type->get_n_eles(),ele_type->get_n_fields());
+              forcing(l,t).setup(ele_type->get_n_upts_per_ele(),ele_type->get_n_eles(),ele_type->get_n_fields());
+            }
+        }
+    }
+}
+
+void p_multigrid::cycle(int in_file_num)
+{
+  // the coarse levels take their own time steps
+  double dt = run_input.dt;
+
+  file_num = in_file_num;
+
+  for (int l=1;l<n_levels;l++)
+    level_sol(l)->time = level_sol(0)->time;
+
+  calc_residual(0);
+  restrict_level(0);
+  coarse_cycle(1);
+  prolong_correction(0);
+
+  run_input.dt = dt;
+}
+
+void p_multigrid::coarse_cycle(int in_level)
+{
+  smooth(in_level,run_input.pmg_n_smooth);
+
+  if (in_level < n_levels-1) {
+      calc_residual(in_level);
+      restrict_level(in_level);
+      coarse_cycle(in_level+1);
+      prolong_correction(in_level);
+
+      smooth(in_level,run_input.pmg_n_smooth);
+    }
+}
+
+void p_multigrid::smooth(int in_level, int in_n_steps)
+{
+  struct solution* sol = level_sol(in_level);
+  int n_RK_steps = (sol->adv_type == 0) ? 1 : 5;
+
+  for (int s=0;s<in_n_steps;s++) {
+      for (int i=0;i<n_RK_steps;i++) {
+          if (i==0 && run_input.dt_type==1)
+            start_global_dt(sol);
+
+          CalcResidual(file_num,i,sol);
+
+          if (i==0 && run_input.dt_type==1)
+            finish_global_dt(sol);
+
+          if (in_level>0)
+            for (int t=0;t<sol->n_ele_types;t++)
+              if (sol->mesh_eles(t)->get_n_eles()!=0)
+                sol->mesh_eles(t)->add_dudt_forcing(forcing(in_level,t).get_ptr_cpu());
+
+          for (int t=0;t<sol->n_ele_types;t++)
+            sol->mesh_eles(t)->AdvanceSolution(i,sol->adv_type);
+        }
+    }
+}
+
+void p_multigrid::calc_residual(int in_level)
+{
+  struct solution* sol = level_sol(in_level);
+
+  CalcResidual(file_num,0,sol);
+
+  if (in_level>0)
+    for (int t=0;t<sol->n_ele_types;t++)
+      if (sol->mesh_eles(t)->get_n_eles()!=0)
+        sol->mesh_eles(t)->add_dudt_forcing(forcing(in_level,t).get_ptr_cpu());
+}
+
+void p_multigrid::restrict_level(int in_level)
+{
+  struct solution* fine = level_sol(in_level);
+  struct solution* coarse = level_sol(in_level+1);
+  int n_ele_types = fine->n_ele_types;
+
+  for (int t=0;t<n_ele_types;t++) {
+      eles* ele_f = fine->mesh_eles(t);
+      eles* ele_c = coarse->mesh_eles(t);
+
+      if (ele_f->get_n_eles()==0)
+        continue;
+
+      int n_eles = ele_f->get_n_eles();
+      int n_fields = ele_f->get_n_fields();
+
+      // solution
+      apply_op(restrict_op(in_level,t),ele_f->get_disu_upts_ptr_cpu(),0.0,ele_c->get_disu_upts_ptr_cpu(),n_eles,n_fields);
+
+      int n_vals = ele_c->get_n_upts_per_ele()*n_eles*n_fields;
+      double* u_c = ele_c->get_disu_upts_ptr_cpu();
+      for (int i=0;i<n_vals;i++)
+        u0(in_level+1,t)(i) = u_c[i];
+
+      // restricted residual of the finer level
+      ele_f->get_dudt_upts(work(in_level,t).get_ptr_cpu());
+      apply_op(restrict_op(in_level,t),work(in_level,t).get_ptr_cpu(),0.0,forcing(in_level+1,t).get_ptr_cpu(),n_eles,n_fields);
+    }
+
+  // forcing = restricted residual - coarse residual at the restricted solution
+  CalcResidual(file_num,0,coarse);
+
+  for (int t=0;t<n_ele_types;t++) {
+      eles* ele_c = coarse->mesh_eles(t);
+
+      if (ele_c->get_n_eles()==0)
+        continue;
+
+      int n_vals = ele_c->get_n_upts_per_ele()*ele_c->get_n_eles()*ele_c->get_n_fields();
+
+      ele_c->get_dudt_upts(work(in_level+1,t).get_ptr_cpu());
+      for (int i=0;i<n_vals;i++)
+        forcing(in_level+1,t)(i) -= work(in_level+1,t)(i);
+    }
+}
+
+void p_multigrid::prolong_correction(int in_level)
+{
+  struct solution* fine = level_sol(in_level);
+  struct solution* coarse = level_sol(in_level+1);
+
+  for (int t=0;t<fine->n_ele_types;t++) {
+      eles* ele_f = fine->mesh_eles(t);
+      eles* ele_c = coarse->mesh_eles(t);
+
+      if (ele_f->get_n_eles()==0)
+        continue;
+
+      int n_vals = ele_c->get_n_upts_per_ele()*ele_c->get_n_eles()*ele_c->get_n_fields();
+      double* u_c = ele_c->get_disu_upts_ptr_cpu();
+
+      for (int i=0;i<n_vals;i++)
+        work(in_level+1,t)(i) = u_c[i] - u0(in_level+1,t)(i);
+
+      apply_op(prolong_op(in_level,t),work(in_level+1,t).get_ptr_cpu(),1.0,ele_f->get_disu_upts_ptr_cpu(),ele_f->get_n_eles(),ele_f->get_n_fields());
+    }
+}
+
+void p_multigrid::apply_op(array<double>& in_op, double* in, double in_beta, double* out, int in_n_eles, int in_n_fields)
+{
+  // the (upt,ele,field) layout is a n_upts x (n_eles*n_fields) column-major matrix
+  int Arows = in_op.get_dim(0);
+  int Acols = in_op.get_dim(1);
+  int Bcols = in_n_eles*in_n_fields;
+
+#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
+  cblas_dgemm(CblasColMajor,CblasNoTrans,CblasNoTrans,Arows,Bcols,Acols,1.0,in_op.get_ptr_cpu(),Arows,in,Acols,in_beta,out,Arows);
+#elif defined _NO_BLAS
+  dgemm(Arows,Bcols,Acols,1.0,in_beta,in_op.get_ptr_cpu(),in,out);
+#endif
+}
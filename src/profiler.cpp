@@ -0,0 +1,248 @@
+/*!
+ * \file profiler.cpp
+ * \brief _____________________________
+ * \author - Original code: SD++ developed by Patrice Castonguay, Antony Jameson,
+ *                          Peter Vincent, David Williams (alphabetical by surname).
+ *         - Current development: Aerospace Computing Laboratory (ACL)
+ *
+ * \version 0.1.0
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ * Copyright (C) 2014 Aerospace Computing Laboratory (ACL).
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sys/time.h>
+
+#include "../include/profiler.h"
+#include "../include/solution.h"
+#include "../include/error.h"
+
+#ifdef _MPI
+#include "mpi.h"
+#endif
+
+using namespace std;
+
+// no. of values of the profile: time, calls, bytes, flops of each stage and type
+#define PROF_N_ENTRIES (PROF_N_STAGES*PROF_N_TYPES)
+
+static double prof_time[PROF_N_ENTRIES];
+static double prof_calls[PROF_N_ENTRIES];
+static double prof_bytes[PROF_N_ENTRIES];
+static double prof_flops[PROF_N_ENTRIES];
+
+static double prof_start_time = 0.;
+static double prof_dof_updates = 0.;
+static double prof_dof_time = 0.;
+
+static const char* prof_stage_names[PROF_N_STAGES] = {
+  "extrapolate_solution",
+  "calculate_gradient",
+  "evaluate_invFlux",
+  "correct_gradient",
+  "extrapolate_gradient",
+  "evaluate_viscFlux",
+  "extrapolate_flux",
+  "divergence",
+  "corrected_divergence",
+  "int_inters_invFlux",
+  "int_inters_viscFlux",
+  "bdy_inters_invFlux",
+  "bdy_inters_viscFlux",
+  "mpi_inters_invFlux",
+  "mpi_inters_viscFlux",
+  "mpi_wait",
+  "advance_solution",
+  "output"
+};
+
+// whether the types of a stage are element types, otherwise interface types
+
+static bool prof_ele_stage(int in_stage)
+{
+  return (in_stage <= PROF_CORRECTED_DIVERGENCE || in_stage == PROF_ADVANCE);
+}
+
+static const char* prof_type_name(int in_stage, int in_type)
+{
+  static const char* ele_names[PROF_N_TYPES] = {"tri", "quad", "tet", "pri", "hex"};
+  static const char* inter_names[PROF_N_TYPES] = {"edge", "tri", "quad", "", ""};
+
+  if (in_stage == PROF_OUTPUT)
+    return "";
+  return prof_ele_stage(in_stage) ? ele_names[in_type] : inter_names[in_type];
+}
+
+double prof_wall_time(void)
+{
+#ifdef _MPI
+  return MPI_Wtime();
+#else
+  struct timeval tv;
+  gettimeofday(&tv,NULL);
+  return tv.tv_sec + 1.e-6*tv.tv_usec;
+#endif
+}
+
+prof_timer::prof_timer(int in_stage, int in_type, double in_bytes, double in_flops)
+{
+  stage = in_stage;
+  type = in_type;
+  bytes = in_bytes;
+  flops = in_flops;
+  start = prof_wall_time();
+}
+
+prof_timer::~prof_timer()
+{
+  int k = type + PROF_N_TYPES*stage;
+
+  prof_time[k] += prof_wall_time()-start;
+  prof_calls[k] += 1.;
+  prof_bytes[k] += bytes;
+  prof_flops[k] += flops;
+}
+
+void prof_reset(void)
+{
+  for (int k=0;k<PROF_N_ENTRIES;k++) {
+    prof_time[k] = 0.;
+    prof_calls[k] = 0.;
+    prof_bytes[k] = 0.;
+    prof_flops[k] = 0.;
+  }
+
+  prof_start_time = prof_wall_time();
+  prof_dof_updates = 0.;
+  prof_dof_time = prof_start_time;
+}
+
+void prof_add_dof_updates(double in_n_dof_updates)
+{
+  prof_dof_updates += in_n_dof_updates;
+}
+
+void prof_get_entry(int in_stage, int in_type, double& out_time, double& out_calls, double& out_bytes, double& out_flops)
+{
+  int k = in_type + PROF_N_TYPES*in_stage;
+
+  out_time = prof_time[k];
+  out_calls = prof_calls[k];
+  out_bytes = prof_bytes[k];
+  out_flops = prof_flops[k];
+}
+
+double prof_dof_rate(void)
+{
+  double now = prof_wall_time();
+  double n_dof_updates = prof_dof_updates;
+
+#ifdef _MPI
+  MPI_Reduce(&prof_dof_updates,&n_dof_updates,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+#endif
+
+  double rate = (now > prof_dof_time) ? n_dof_updates/(now-prof_dof_time) : 0.;
+
+  prof_dof_updates = 0.;
+  prof_dof_time = now;
+
+  return rate;
+}
+
+void prof_write_summary(struct solution* FlowSol)
+{
+  int k;
+  double run_time = prof_wall_time()-prof_start_time;
+
+  // min, avg and max time over the ranks, totals of the rest
+  double time_min[PROF_N_ENTRIES], time_max[PROF_N_ENTRIES], time_sum[PROF_N_ENTRIES];
+  double calls[PROF_N_ENTRIES], bytes[PROF_N_ENTRIES], flops[PROF_N_ENTRIES];
+  double run_time_max = run_time;
+
+#ifdef _MPI
+  MPI_Reduce(prof_time,time_min,PROF_N_ENTRIES,MPI_DOUBLE,MPI_MIN,0,MPI_COMM_WORLD);
+  MPI_Reduce(prof_time,time_max,PROF_N_ENTRIES,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+  MPI_Reduce(prof_time,time_sum,PROF_N_ENTRIES,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+  MPI_Reduce(prof_calls,calls,PROF_N_ENTRIES,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+  MPI_Reduce(prof_bytes,bytes,PROF_N_ENTRIES,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+  MPI_Reduce(prof_flops,flops,PROF_N_ENTRIES,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+  MPI_Reduce(&run_time,&run_time_max,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+#else
+  for (k=0;k<PROF_N_ENTRIES;k++) {
+    time_min[k] = time_max[k] = time_sum[k] = prof_time[k];
+    calls[k] = prof_calls[k];
+    bytes[k] = prof_bytes[k];
+    flops[k] = prof_flops[k];
+  }
+#endif
+
+  if (FlowSol->rank != 0)
+    return;
+
+  int n_ranks = 1;
+#ifdef _MPI
+  n_ranks = FlowSol->nproc;
+#endif
+  streamsize precision = cout.precision();
+
+  ofstream json("profile.json");
+  if (!json)
+    FatalError("Unable to open profile.json");
+
+  json.precision(9);
+  json << "{\n  \"n_ranks\": " << n_ranks << ",\n  \"wall_time\": " << run_time_max << ",\n  \"stages\": [";
+
+  cout << endl << "Profile (wall time over " << n_ranks << " rank(s), " << run_time_max << " s in total)" << endl;
+  cout << "  " << left << setw(22) << "stage" << setw(6) << "type" << right << setw(10) << "calls"
+       << setw(12) << "min [s]" << setw(12) << "avg [s]" << setw(12) << "max [s]" << setw(8) << "%"
+       << setw(10) << "GB/s" << setw(10) << "GFLOP/s" << endl;
+
+  bool first = true;
+  for (int s=0;s<PROF_N_STAGES;s++) {
+    for (int t=0;t<PROF_N_TYPES;t++) {
+      k = t + PROF_N_TYPES*s;
+      if (calls[k] == 0.)
+        continue;
+
+      double time_avg = time_sum[k]/n_ranks;
+      // rates of the whole job, with the slowest rank setting the time
+      double gbytes = (time_max[k] > 0.) ? 1.e-9*bytes[k]/time_max[k] : 0.;
+      double gflops = (time_max[k] > 0.) ? 1.e-9*flops[k]/time_max[k] : 0.;
+
+      cout << "  " << left << setw(22) << prof_stage_names[s] << setw(6) << prof_type_name(s,t) << right
+           << setw(10) << (long)(calls[k]/n_ranks) << fixed << setprecision(4)
+           << setw(12) << time_min[k] << setw(12) << time_avg << setw(12) << time_max[k]
+           << setprecision(1) << setw(8) << 100.*time_avg/run_time_max
+           << setprecision(2) << setw(10) << gbytes << setw(10) << gflops << endl;
+      cout.unsetf(ios::floatfield);
+
+      json << (first ? "\n" : ",\n") << "    {\"stage\": \"" << prof_stage_names[s] << "\", \"type\": \"" << prof_type_name(s,t)
+           << "\", \"calls\": " << (long)(calls[k]/n_ranks) << ", \"time_min\": " << time_min[k] << ", \"time_avg\": " << time_avg
+           << ", \"time_max\": " << time_max[k] << ", \"bytes\": " << bytes[k] << ", \"flops\": " << flops[k]
+           << ", \"gbytes_per_s\": " << gbytes << ", \"gflops_per_s\": " << gflops << "}";
+      first = false;
+    }
+  }
+
+  json << "\n  ]\n}" << endl;
+  json.close();
+
+  cout.precision(precision);
+  cout << "Profile written to profile.json" << endl;
+}
@@ -26,6 +26,9 @@
 #include <iostream>
 #include <sstream>
 #include <cmath>
+#include <cstring>
+#include <vector>
+#include <algorithm>
 
 #include "../include/global.h"
 #include "../include/array.h"
@@ -62,6 +65,45 @@ using namespace std;
 #define MULTI_ZONE
 //#define SINGLE_ZONE
 
+// let MPI progress the messages in flight on the MPI interfaces (nothing to do in serial)
+
+#ifdef _MPI
+static void progress_mpi(struct solution* FlowSol)
+{
+  if (FlowSol->nproc>1)
+    for(int i=0; i<FlowSol->n_mpi_inter_types; i++)
+      FlowSol->mesh_mpi_inters(i).progress();
+}
+#else
+static void progress_mpi(struct solution*) {}
+#endif
+
+// local time stepping: whether an element slot or interface group is part of the current residual evaluation
+
+static bool ele_active(int in_ele_type, struct solution* FlowSol)
+{
+  return FlowSol->lts_active(FlowSol->mesh_eles(in_ele_type)->get_lts_level());
+}
+
+static bool int_inters_active(int in_inter_type, struct solution* FlowSol)
+{
+  return FlowSol->lts_active(FlowSol->int_inters_level(in_inter_type,0)) || FlowSol->lts_active(FlowSol->int_inters_level(in_inter_type,1));
+}
+
+static bool bdy_inters_active(int in_inter_type, struct solution* FlowSol)
+{
+  return FlowSol->lts_active(FlowSol->bdy_inters_level(in_inter_type));
+}
+
+#ifdef _MPI
+// the elements on the MPI interfaces are all on the finest level
+
+static bool mpi_inters_active(struct solution* FlowSol)
+{
+  return FlowSol->lts_active(FlowSol->lts_active.get_dim(0)-1);
+}
+#endif
+
 void CalcResidual(int in_file_num, int in_rk_stage, struct solution* FlowSol) {
 
   int in_disu_upts_from = 0;        /*!< Define... */
@@ -72,7 +114,8 @@ void CalcResidual(int in_file_num, int in_rk_stage, struct solution* FlowSol) {
   if(run_input.LES==1 && in_disu_upts_from==0) {
       if(run_input.SGS_model==2 || run_input.SGS_model==3 || run_input.SGS_model==4) {
           for(i=0; i<FlowSol->n_ele_types; i++)
-            FlowSol->mesh_eles(i)->calc_sgs_terms(in_disu_upts_from);
+            if (ele_active(i,FlowSol))
+              FlowSol->mesh_eles(i)->calc_sgs_terms(in_disu_upts_from);
         }
     }
 
@@ -86,38 +129,59 @@ void CalcResidual(int in_file_num, int in_rk_stage, struct solution* FlowSol) {
       if(run_input.artif_type == 1){
           /*! This routine does shock detection. For concentration method filter is also applied in this routine itself */
           for(i=0;i<FlowSol->n_ele_types;i++)
-            FlowSol->mesh_eles(i)->shock_capture_concentration(in_disu_upts_from);
+            if (ele_active(i,FlowSol))
+              FlowSol->mesh_eles(i)->shock_capture_concentration(in_disu_upts_from);
       }
 
       if (run_input.artif_type == 2) {
           /*LLAV method added by pengyang in 2020/5/10 */
           for (i = 0; i < FlowSol->n_ele_types; i++)
-              FlowSol->mesh_eles(i)->shock_capture_llav(in_disu_upts_from);
+              if (ele_active(i,FlowSol))
+                FlowSol->mesh_eles(i)->shock_capture_llav(in_disu_upts_from);
       }
 
     // #endif
   }
 
   /*! Compute the solution at the flux points. */
-  for(i=0; i<FlowSol->n_ele_types; i++)
-    FlowSol->mesh_eles(i)->extrapolate_solution(in_disu_upts_from);
-
 #ifdef _MPI
-  /*! Send the solution at the flux points across the MPI interfaces. */
-  if (FlowSol->nproc>1)
-    for(i=0; i<FlowSol->n_mpi_inter_types; i++)
-      FlowSol->mesh_mpi_inters(i).send_solution();
+  if (FlowSol->nproc>1 && mpi_inters_active(FlowSol)) {
+      /*! Elements on the MPI interfaces first: send their solution at the flux points across the MPI interfaces,
+       then do the interior work while the messages are in flight. */
+      for(i=0; i<FlowSol->n_ele_types; i++)
+        if (ele_active(i,FlowSol))
+          FlowSol->mesh_eles(i)->extrapolate_solution_halo(in_disu_upts_from);
+
+      for(i=0; i<FlowSol->n_mpi_inter_types; i++)
+        FlowSol->mesh_mpi_inters(i).send_solution();
+
+      for(i=0; i<FlowSol->n_ele_types; i++) {
+          if (!ele_active(i,FlowSol)) continue;
+          FlowSol->mesh_eles(i)->extrapolate_solution_interior(in_disu_upts_from);
+          progress_mpi(FlowSol);
+        }
+    }
+  else
 #endif
+    for(i=0; i<FlowSol->n_ele_types; i++)
+      if (ele_active(i,FlowSol))
+        FlowSol->mesh_eles(i)->extrapolate_solution(in_disu_upts_from);
 
   if (FlowSol->viscous) {
       /*! Compute the uncorrected gradient of the solution at the solution points. */
-      for(i=0; i<FlowSol->n_ele_types; i++)
-        FlowSol->mesh_eles(i)->calculate_gradient(in_disu_upts_from);
+      for(i=0; i<FlowSol->n_ele_types; i++) {
+          if (!ele_active(i,FlowSol)) continue;
+          FlowSol->mesh_eles(i)->calculate_gradient(in_disu_upts_from);
+          progress_mpi(FlowSol);
+        }
     }
 
   /*! Compute the inviscid flux at the solution points and store in total flux storage. */
-  for(i=0; i<FlowSol->n_ele_types; i++)
-    FlowSol->mesh_eles(i)->evaluate_invFlux(in_disu_upts_from);
+  for(i=0; i<FlowSol->n_ele_types; i++) {
+      if (!ele_active(i,FlowSol)) continue;
+      FlowSol->mesh_eles(i)->evaluate_invFlux(in_disu_upts_from);
+      progress_mpi(FlowSol);
+    }
 
 
   // If running periodic channel or periodic hill cases,
@@ -127,10 +191,12 @@ void CalcResidual(int in_file_num, int in_rk_stage, struct solution* FlowSol) {
 #ifdef _GPU
   // copy disu_upts for body force calculation
   for(i=0; i<FlowSol->n_ele_types; i++)
-    FlowSol->mesh_eles(i)->cp_disu_upts_gpu_cpu();
+    if (ele_active(i,FlowSol))
+      FlowSol->mesh_eles(i)->cp_disu_upts_gpu_cpu();
 #endif
 
     for(i=0;i<FlowSol->n_ele_types;i++) {
+      if (!ele_active(i,FlowSol)) continue;
       FlowSol->mesh_eles(i)->evaluate_body_force(in_file_num);
     }
   }
@@ -138,14 +204,18 @@ void CalcResidual(int in_file_num, int in_rk_stage, struct solution* FlowSol) {
   /*! Compute the inviscid numerical fluxes.
    Compute the common solution and solution corrections (viscous only). */
   for(i=0; i<FlowSol->n_int_inter_types; i++)
-    FlowSol->mesh_int_inters(i).calculate_common_invFlux();
+    if (int_inters_active(i,FlowSol))
+      FlowSol->mesh_int_inters(i).calculate_common_invFlux();
+
+  progress_mpi(FlowSol);
 
   for(i=0; i<FlowSol->n_bdy_inter_types; i++)
-    FlowSol->mesh_bdy_inters(i).evaluate_boundaryConditions_invFlux(FlowSol->time);
+    if (bdy_inters_active(i,FlowSol))
+      FlowSol->mesh_bdy_inters(i).evaluate_boundaryConditions_invFlux(FlowSol->time);
 
 #ifdef _MPI
   /*! Send the previously computed values across the MPI interfaces. */
-  if (FlowSol->nproc>1) {
+  if (FlowSol->nproc>1 && mpi_inters_active(FlowSol)) {
       for(i=0; i<FlowSol->n_mpi_inter_types; i++)
         FlowSol->mesh_mpi_inters(i).receive_solution();
 
@@ -157,14 +227,17 @@ void CalcResidual(int in_file_num, int in_rk_stage, struct solution* FlowSol) {
   if (FlowSol->viscous) {
       /*! Compute corrected gradient of the solution at the solution and flux points. */
       for(i=0; i<FlowSol->n_ele_types; i++)
-        FlowSol->mesh_eles(i)->correct_gradient();
-
-      for(i=0; i<FlowSol->n_ele_types; i++)
-        FlowSol->mesh_eles(i)->extrapolate_corrected_gradient();
+        if (ele_active(i,FlowSol))
+          FlowSol->mesh_eles(i)->correct_gradient();
 
 #ifdef _MPI
-      /*! Send the corrected value and SGS flux across the MPI interface. */
-      if (FlowSol->nproc>1) {
+      /*! Send the corrected value and SGS flux across the MPI interface, before extrapolating the
+       corrected gradient of the interior elements. */
+      if (FlowSol->nproc>1 && mpi_inters_active(FlowSol)) {
+          for(i=0; i<FlowSol->n_ele_types; i++)
+            if (ele_active(i,FlowSol))
+              FlowSol->mesh_eles(i)->extrapolate_corrected_gradient_halo();
+
           for(i=0; i<FlowSol->n_mpi_inter_types; i++)
             FlowSol->mesh_mpi_inters(i).send_corrected_gradient();
 
@@ -172,39 +245,61 @@ void CalcResidual(int in_file_num, int in_rk_stage, struct solution* FlowSol) {
             for(i=0; i<FlowSol->n_mpi_inter_types; i++)
               FlowSol->mesh_mpi_inters(i).send_sgsf_fpts();
           }
+
+          for(i=0; i<FlowSol->n_ele_types; i++) {
+              if (!ele_active(i,FlowSol)) continue;
+              FlowSol->mesh_eles(i)->extrapolate_corrected_gradient_interior();
+              progress_mpi(FlowSol);
+            }
         }
+      else
 #endif
+        for(i=0; i<FlowSol->n_ele_types; i++)
+          if (ele_active(i,FlowSol))
+            FlowSol->mesh_eles(i)->extrapolate_corrected_gradient();
 
       /*! Compute discontinuous viscous flux at upts and add to inviscid flux at upts. */
-      for(i=0; i<FlowSol->n_ele_types; i++)
-        FlowSol->mesh_eles(i)->evaluate_viscFlux(in_disu_upts_from);
+      for(i=0; i<FlowSol->n_ele_types; i++) {
+          if (!ele_active(i,FlowSol)) continue;
+          FlowSol->mesh_eles(i)->evaluate_viscFlux(in_disu_upts_from);
+          progress_mpi(FlowSol);
+        }
     }
 
   /*! If using LES, compute the SGS flux at flux points. */
   if (run_input.LES) {
 	  for(i=0; i<FlowSol->n_ele_types; i++)
-			FlowSol->mesh_eles(i)->evaluate_sgsFlux();
+			if (ele_active(i,FlowSol))
+			  FlowSol->mesh_eles(i)->evaluate_sgsFlux();
   }
 
   /*! For viscous or inviscid, compute the normal discontinuous flux at flux points. */
-  for(i=0; i<FlowSol->n_ele_types; i++)
-    FlowSol->mesh_eles(i)->extrapolate_totalFlux();
+  for(i=0; i<FlowSol->n_ele_types; i++) {
+      if (!ele_active(i,FlowSol)) continue;
+      FlowSol->mesh_eles(i)->extrapolate_totalFlux();
+      progress_mpi(FlowSol);
+    }
 
   /*! For viscous or inviscid, compute the divergence of flux at solution points. */
-  for(i=0; i<FlowSol->n_ele_types; i++)
-    FlowSol->mesh_eles(i)->calculate_divergence(in_div_tconf_upts_to);
+  for(i=0; i<FlowSol->n_ele_types; i++) {
+      if (!ele_active(i,FlowSol)) continue;
+      FlowSol->mesh_eles(i)->calculate_divergence(in_div_tconf_upts_to);
+      progress_mpi(FlowSol);
+    }
 
   if (FlowSol->viscous) {
       /*! Compute normal interface viscous flux and add to normal inviscid flux. */
       for(i=0; i<FlowSol->n_int_inter_types; i++)
-        FlowSol->mesh_int_inters(i).calculate_common_viscFlux();
+        if (int_inters_active(i,FlowSol))
+          FlowSol->mesh_int_inters(i).calculate_common_viscFlux();
 
       for(i=0; i<FlowSol->n_bdy_inter_types; i++)
-        FlowSol->mesh_bdy_inters(i).evaluate_boundaryConditions_viscFlux(FlowSol->time);
+        if (bdy_inters_active(i,FlowSol))
+          FlowSol->mesh_bdy_inters(i).evaluate_boundaryConditions_viscFlux(FlowSol->time);
 
 #if _MPI
       /*! Evaluate the MPI interfaces. */
-      if (FlowSol->nproc>1) {
+      if (FlowSol->nproc>1 && mpi_inters_active(FlowSol)) {
           for(i=0; i<FlowSol->n_mpi_inter_types; i++)
             FlowSol->mesh_mpi_inters(i).receive_corrected_gradient();
 
@@ -221,15 +316,214 @@ void CalcResidual(int in_file_num, int in_rk_stage, struct solution* FlowSol) {
 
   /*! Compute the divergence of the transformed continuous flux. */
   for(i=0; i<FlowSol->n_ele_types; i++)
-    FlowSol->mesh_eles(i)->calculate_corrected_divergence(in_div_tconf_upts_to);
+    if (ele_active(i,FlowSol))
+      FlowSol->mesh_eles(i)->calculate_corrected_divergence(in_div_tconf_upts_to);
 
   /*! Compute source term */
   if (run_input.turb_model==1) {
     for (i=0; i<FlowSol->n_ele_types; i++)
-      FlowSol->mesh_eles(i)->calc_src_upts_SA(in_disu_upts_from);
+      if (ele_active(i,FlowSol))
+        FlowSol->mesh_eles(i)->calc_src_upts_SA(in_disu_upts_from);
   }
 }
 
+void start_global_dt(struct solution* FlowSol) {
+
+#ifdef _CPU
+  FlowSol->dt_min_loc = 1e16;
+  // with local time stepping, the step of the coarsest level: 2^level times that of each element
+  for (int i=0; i<FlowSol->n_ele_types; i++)
+    if (FlowSol->mesh_eles(i)->get_n_eles()!=0)
+      FlowSol->dt_min_loc = min(FlowSol->dt_min_loc, FlowSol->mesh_eles(i)->calc_dt_min()*(1 << FlowSol->mesh_eles(i)->get_lts_level()));
+
+  // one reduction over all element types, overlapped with the first residual
+#ifdef _MPI
+  MPI_Iallreduce(&FlowSol->dt_min_loc, &FlowSol->dt_min, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD, &FlowSol->dt_request);
+#else
+  FlowSol->dt_min = FlowSol->dt_min_loc;
+#endif
+#endif
+}
+
+void finish_global_dt(struct solution* FlowSol) {
+
+#ifdef _CPU
+#ifdef _MPI
+  MPI_Wait(&FlowSol->dt_request, MPI_STATUS_IGNORE);
+#endif
+  run_input.dt = FlowSol->dt_min;
+#endif
+}
+
+void AdvanceSolutionAdaptive(int in_file_num, struct solution* FlowSol) {
+
+  if (run_input.motion)
+    FatalError("Adaptive RK time stepping is not implemented for moving meshes");
+
+  int n_stages = (FlowSol->adv_type == 5) ? 4 : 5;
+
+  // the error estimate is of order n_stages-1, PI gains as in Hairer & Wanner
+  double k = n_stages-1;
+  double alpha = 0.7/k;
+  double beta = 0.4/k;
+
+  // a step is given up after this many rejections in a row, e.g. for a diverged (NaN) solution
+  const int max_n_reject = 20;
+
+  bool accepted = false;
+  int n_reject = 0;
+
+  while (!accepted) {
+
+      run_input.dt = FlowSol->dt_next;
+
+      for (int i=0; i<n_stages; i++) {
+          CalcResidual(in_file_num, i, FlowSol);
+
+          for (int j=0; j<FlowSol->n_ele_types; j++)
+            FlowSol->mesh_eles(j)->AdvanceSolution(i, FlowSol->adv_type);
+        }
+
+      // RMS of the error estimate scaled by the tolerances, over all ranks
+      double err[2] = {0., 0.};
+      for (int j=0; j<FlowSol->n_ele_types; j++)
+        FlowSol->mesh_eles(j)->calc_rk_error(err[0], err[1]);
+
+#ifdef _MPI
+      MPI_Allreduce(MPI_IN_PLACE, err, 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+#endif
+
+      double err_norm = sqrt(err[0]/max(err[1],1.));
+      double fac;
+
+      if (err_norm <= 1.) {
+          err_norm = max(err_norm, 1e-10);
+          accepted = true;
+          fac = run_input.rk_safety*pow(err_norm,-alpha)*pow(FlowSol->rk_err_prev,beta);
+          FlowSol->rk_err_prev = err_norm;
+        }
+      else {
+          // also a NaN error estimate, the step is cut by rk_min_fac
+          fac = isnan(err_norm) ? run_input.rk_min_fac : run_input.rk_safety*pow(err_norm,-1./k);
+
+          for (int j=0; j<FlowSol->n_ele_types; j++)
+            FlowSol->mesh_eles(j)->reject_rk_step();
+
+          if (FlowSol->rank==0)
+            cout << "Step rejected, error estimate = " << err_norm << ", dt = " << run_input.dt << endl;
+
+          if (++n_reject >= max_n_reject)
+            FatalError("The adaptive time step was rejected too many times in a row");
+        }
+
+      FlowSol->dt_next = min(run_input.rk_max_fac, max(run_input.rk_min_fac, fac))*run_input.dt;
+
+      // the floor is absolute at time 0
+      if (FlowSol->dt_next < 1e-12*max(FlowSol->time, FlowSol->dt_init))
+        FatalError("The adaptive time step collapsed");
+    }
+}
+
+// take one RK step of the elements of one local time stepping level
+
+static void advance_lts_level(int in_file_num, int in_level, double in_time, double in_dt, bool in_refresh, struct solution* FlowSol)
+{
+  int n_stages = (FlowSol->adv_type == 3) ? 5 : 1;
+
+  for (int l=0; l<run_input.n_lts_levels; l++)
+    FlowSol->lts_active(l) = (l == in_level);
+
+  FlowSol->time = in_time;
+  run_input.dt = in_dt;
+
+  for (int i=0; i<n_stages; i++) {
+      CalcResidual(in_file_num, i, FlowSol);
+
+      double w = in_dt*FlowSol->mesh_eles(0)->get_rk_weight(i, FlowSol->adv_type);
+
+      // integrate the flux at the faces to the next finer level over this level's step, and
+      // the flux this level computes at the faces of the next coarser one
+      for (int j=0; j<FlowSol->n_ele_types; j++) {
+          eles* mesh_eles = FlowSol->mesh_eles(j);
+
+          if (mesh_eles->get_lts_level() == in_level) {
+              mesh_eles->accumulate_lts_flux(1, w);
+              mesh_eles->AdvanceSolution(i, FlowSol->adv_type);
+            }
+          else if (mesh_eles->get_lts_level() == in_level-1)
+            mesh_eles->accumulate_lts_flux(0, w);
+        }
+    }
+
+  // over this step the finer neighbours have taken theirs: correct by the flux they used,
+  // and give the neighbours on other levels the solution at the end of the step
+  for (int j=0; j<FlowSol->n_ele_types; j++) {
+      eles* mesh_eles = FlowSol->mesh_eles(j);
+
+      if (mesh_eles->get_lts_level() == in_level && mesh_eles->get_n_eles()!=0) {
+          mesh_eles->reflux_lts();
+          if (in_refresh)
+            mesh_eles->extrapolate_solution(0);
+        }
+    }
+}
+
+void AdvanceSolutionLTS(int in_file_num, struct solution* FlowSol) {
+
+  int n_levels = run_input.n_lts_levels;
+  int n_sub = 1 << (n_levels-1);
+
+  // the step of the coarsest level is needed before the first residual
+  if (run_input.dt_type == 1) {
+      start_global_dt(FlowSol);
+      finish_global_dt(FlowSol);
+    }
+
+  double dt = run_input.dt;
+  double time = FlowSol->time;
+
+  // The interfaces between levels read the flux point values of the inactive neighbours: bring
+  // every level's solution (and corrected gradient when viscous) at the flux points up to date,
+  // which also initializes them on the first step and after a restart
+  for (int l=0; l<n_levels; l++)
+    FlowSol->lts_active(l) = 1;
+
+  if (FlowSol->viscous)
+    CalcResidual(in_file_num, 0, FlowSol);
+  else
+    for (int j=0; j<FlowSol->n_ele_types; j++)
+      FlowSol->mesh_eles(j)->extrapolate_solution(0);
+
+  // At the end of each step of the finest level, the levels whose step ends there are advanced,
+  // finest first, so that each level is corrected by the flux of its finer neighbours
+  for (int j=0; j<n_sub; j++) {
+      int k_min = n_levels-1;
+      while (k_min > 0 && (j+1) % (1 << (n_levels-k_min)) == 0)
+        k_min--;
+
+      for (int k=n_levels-1; k>=k_min; k--) {
+          double dt_k = dt/(1 << k);
+          advance_lts_level(in_file_num, k, time+(j+1)*(dt/n_sub)-dt_k, dt_k, k_min < n_levels-1, FlowSol);
+        }
+
+      // the corrected gradient at the flux points needs the common solution with the neighbours,
+      // so the levels advanced together are refreshed by one residual evaluation
+      if (FlowSol->viscous && k_min < n_levels-1 && j < n_sub-1) {
+          for (int l=0; l<n_levels; l++)
+            FlowSol->lts_active(l) = (l >= k_min);
+
+          FlowSol->time = time+(j+1)*(dt/n_sub);
+          CalcResidual(in_file_num, 0, FlowSol);
+        }
+    }
+
+  for (int l=0; l<n_levels; l++)
+    FlowSol->lts_active(l) = 1;
+
+  FlowSol->time = time;
+  run_input.dt = dt;
+}
+
 #ifdef _MPI
 void set_rank_nproc(int in_rank, int in_nproc, struct solution* FlowSol)
 {
@@ -372,7 +666,10 @@ void InitSolution(struct solution* FlowSol)
   else
     {
       FlowSol->ini_iter = run_input.restart_iter;
-      read_restart(run_input.restart_iter,run_input.n_restart_files,FlowSol);
+      if (run_input.restart_bin)
+        read_restart_bin(run_input.restart_iter,FlowSol);
+      else
+        read_restart(run_input.restart_iter,run_input.n_restart_files,FlowSol);
     }
 
   for (int i=0;i<FlowSol->n_ele_types;i++) {
@@ -449,3 +746,167 @@ void read_restart(int in_file_num, int in_n_files, struct solution* FlowSol)
   cout << "Rank=" << FlowSol->rank << " Done reading restart files" << endl;
 }
 
+/*! location of one of my elements in the binary restart files */
+struct restart_ele_loc {
+  int gid;    /*!< global element number */
+  int type;   /*!< element type */
+  int ele;    /*!< local element number */
+  int file;   /*!< restart file (rank that wrote it) */
+  int pos;    /*!< position in the data of that file */
+};
+
+static bool restart_ele_loc_by_gid(const restart_ele_loc& a, const restart_ele_loc& b)
+{
+  return a.gid < b.gid;
+}
+
+static bool restart_ele_loc_by_file(const restart_ele_loc& a, const restart_ele_loc& b)
+{
+  if (a.file != b.file) return a.file < b.file;
+  return a.pos < b.pos;
+}
+
+void read_restart_bin(int in_file_num, struct solution* FlowSol)
+{
+  char file_name_s[256];
+  char magic[8];
+  ifstream index_file, restart_file;
+  int n_files, n_global;
+  int entry[2];
+
+  // Look up the file and position of each of my elements in the index, in order of global element number
+
+  sprintf(file_name_s,"Rest_%.09d.idx",in_file_num);
+  index_file.open(file_name_s, ios::in | ios::binary);
+  if (!index_file)
+    FatalError("Could not open binary restart index file");
+
+  index_file.read(magic,8);
+  if (strncmp(magic,RESTART_IDX_MAGIC,8)!=0)
+    FatalError("Not a binary restart index file");
+
+  index_file.read((char*)&n_files,sizeof(int));
+  index_file.read((char*)&n_global,sizeof(int));
+  streamoff index_start = index_file.tellg();
+
+  vector<restart_ele_loc> locs;
+  for (int i=0;i<FlowSol->n_ele_types;i++) {
+    for (int j=0;j<FlowSol->mesh_eles(i)->get_n_eles();j++) {
+      restart_ele_loc loc;
+      loc.gid = FlowSol->mesh_eles(i)->get_ele2global_ele(j);
+      loc.type = i;
+      loc.ele = j;
+      locs.push_back(loc);
+    }
+  }
+
+  sort(locs.begin(),locs.end(),restart_ele_loc_by_gid);
+
+  for (unsigned int i=0;i<locs.size();i++) {
+    if (locs[i].gid<0 || locs[i].gid>=n_global)
+      FatalError("Element not found in binary restart index");
+
+    index_file.seekg(index_start + (streamoff)(2*sizeof(int))*locs[i].gid);
+    index_file.read((char*)entry,2*sizeof(int));
+    if (index_file.fail() || entry[0]<0 || entry[0]>=n_files)
+      FatalError("Element not found in binary restart index");
+
+    locs[i].file = entry[0];
+    locs[i].pos = entry[1];
+  }
+  index_file.close();
+
+  // Now read my elements from only the files that hold them
+
+  sort(locs.begin(),locs.end(),restart_ele_loc_by_file);
+
+  array<int> info_read(FlowSol->n_ele_types);
+  for (int i=0;i<FlowSol->n_ele_types;i++)
+    info_read(i) = 0;
+
+  unsigned int i_loc = 0;
+  while (i_loc<locs.size())
+  {
+    int file = locs[i_loc].file;
+    int n_types;
+
+    sprintf(file_name_s,"Rest_%.09d_p%.04d.bin",in_file_num,file);
+    restart_file.open(file_name_s, ios::in | ios::binary);
+    if (!restart_file)
+      FatalError("Could not open binary restart file");
+
+    restart_file.read(magic,8);
+    if (strncmp(magic,RESTART_BIN_MAGIC,8)!=0)
+      FatalError("Not a binary restart file");
+
+    restart_file.read((char*)&FlowSol->time,sizeof(double));
+    restart_file.read((char*)&n_types,sizeof(int));
+
+    // header of each block of elements in the file, indexing: (block); the writer may have
+    // split an element type over several blocks (local time stepping levels)
+    array<int> type_file(n_types), n_eles_file(n_types), n_upts_file(n_types), n_fields_file(n_types), first_file(n_types);
+    array<streamoff> data_start(n_types);
+    array<string> info(n_types);
+
+    for (int i=0;i<n_types;i++) {
+      int info_len;
+      restart_file.read((char*)&type_file(i),sizeof(int));
+      if (type_file(i)<0 || type_file(i)>4)
+        FatalError("Unknown element type in binary restart file");
+
+      restart_file.read((char*)&n_eles_file(i),sizeof(int));
+      restart_file.read((char*)&n_upts_file(i),sizeof(int));
+      restart_file.read((char*)&n_fields_file(i),sizeof(int));
+      restart_file.read((char*)&info_len,sizeof(int));
+
+      info(i).resize(info_len);
+      restart_file.read(&info(i)[0],info_len);
+
+      // skip the global element numbers, the index already has them
+      restart_file.seekg((streamoff)(n_eles_file(i)*sizeof(int)),ios::cur);
+    }
+
+    streamoff pos = restart_file.tellg();
+    int first = 0;
+    for (int i=0;i<n_types;i++) {
+      data_start(i) = pos;
+      first_file(i) = first;
+      pos += (streamoff)n_eles_file(i)*n_upts_file(i)*n_fields_file(i)*sizeof(double);
+      first += n_eles_file(i);
+    }
+
+    for (;i_loc<locs.size() && locs[i_loc].file==file;i_loc++)
+    {
+      int type = locs[i_loc].type;
+      eles* mesh_eles = FlowSol->mesh_eles(type);
+
+      int block = n_types-1;
+      while (block>=0 && first_file(block)>locs[i_loc].pos)
+        block--;
+
+      if (block<0 || locs[i_loc].pos>=first_file(block)+n_eles_file(block))
+        FatalError("Element not found in binary restart file");
+      if (type_file(block)!=mesh_eles->get_ele_type())
+        FatalError("Element type in binary restart file does not match");
+
+      if (!info_read(type)) {
+        if (!mesh_eles->read_restart_info_bin(info(block)))
+          FatalError("Could not read restart info from binary restart file");
+        if (n_fields_file(block)!=mesh_eles->get_n_fields())
+          FatalError("Number of fields in binary restart file does not match");
+        info_read(type) = 1;
+      }
+
+      restart_file.seekg(data_start(block) + (streamoff)(locs[i_loc].pos-first_file(block))*n_upts_file(block)*n_fields_file(block)*sizeof(double));
+      mesh_eles->read_restart_ele_bin(restart_file,locs[i_loc].ele);
+    }
+
+    restart_file.close();
+  }
+
+  for (int i=0;i<FlowSol->n_ele_types;i++)
+    if (FlowSol->mesh_eles(i)->get_n_eles()!=0)
+      FlowSol->mesh_eles(i)->set_h_ref();
+
+  cout << "Rank=" << FlowSol->rank << " Done reading binary restart files" << endl;
+}